@@ -0,0 +1,479 @@
+#!/bin/bash
+# File:     bench.sh
+# Purpose:  Build and run the kernels listed in bench.conf for a sweep of
+#           sizes and thread or process counts, check their output, and
+#           append the times to a CSV file.  Report the statistics,
+#           speedup and efficiency of each kernel, and flag regressions
+#           against the previous commit on the same host.
+#
+# Usage:
+#    ./bench.sh list
+#    ./bench.sh run [-k kernels] [-n sizes] [-p counts] [-r reps]
+#    ./bench.sh report [-k kernels] [-c commit] [-b base commit]
+#
+#    -k:  comma-separated kernel names or shell patterns (default: all)
+#    -n:  space-separated sizes (default: the sizes in bench.conf)
+#    -p:  space-separated thread or process counts (default: "1 2 4")
+#    -r:  repetitions of each run (default: 3)
+#    -c:  commit to report (default: the last commit in the results
+#         from this host)
+#    -b:  commit to compare with (default: the commit before -c in the
+#         results from this host)
+#
+# Environment:
+#    BENCH_DB         results file (default: bench_results.csv in this
+#                     directory, which git ignores)
+#    BENCH_BUILD      directory for executables and logs
+#                     (default: /tmp/bench_$USER)
+#    BENCH_THRESHOLD  relative slowdown flagged as a regression
+#                     (default: 0.10)
+#    BENCH_TIMEOUT    seconds before a run is killed (default: 600)
+#    BENCH_KEEP_LOGS  if set, keep the output of every run
+#    MPIEXEC, MPIEXEC_FLAGS
+#                     MPI launcher (default: mpiexec) and extra flags,
+#                     e.g., "--oversubscribe"
+#
+# Output:
+#    run:     one line per run.  Each run is appended to BENCH_DB as
+#
+#       date,commit,host,cpu,cores,compiler,kernel,n,p,rep,seconds,status
+#
+#             status is ok, invalid (the check failed), notime (no
+#             time in the output), or failed (nonzero exit status or
+#             timeout).  commit ends in + if the tree had uncommitted
+#             changes.
+#    report:  for each kernel, size and count, the number of good runs,
+#             the minimum, median, mean and standard deviation of the
+#             times, the speedup and efficiency, and the median of the
+#             base commit with the change.
+#
+# Notes:
+# 1.  Speedup is T(p0)/T(p)*p0 and efficiency is speedup/p, where p0
+#     is the smallest count that was run for the same kernel and size
+#     (usually 1), and T is the median time.
+# 2.  A configuration is flagged as a regression if its median is more
+#     than BENCH_THRESHOLD slower than the base commit's median, and
+#     the difference is more than twice the larger standard deviation.
+#     report exits with status 1 if it flags a regression.
+# 3.  Kernels of kind serial are only run with p = 1.
+#
+
+BENCH_DIR=$(cd "$(dirname "$0")" && pwd)
+CONF=$BENCH_DIR/bench.conf
+DB=${BENCH_DB:-$BENCH_DIR/bench_results.csv}
+BUILD=${BENCH_BUILD:-/tmp/bench_${USER:-$(id -un)}}
+THRESHOLD=${BENCH_THRESHOLD:-0.10}
+TIMEOUT=${BENCH_TIMEOUT:-600}
+MPIEXEC=${MPIEXEC:-mpiexec}
+
+KERNELS=""
+SIZES=""
+COUNTS="1 2 4"
+REPS=3
+COMMIT=""
+BASE=""
+
+#-------------------------------------------------------------------
+# Function:  Usage
+# Purpose:   Print the command line and exit
+Usage() {
+   sed -n '/^# Usage:/,/^# Environment:/p' "$0" | sed '$d; s/^#//' >&2
+   exit 2
+}  # Usage
+
+#-------------------------------------------------------------------
+# Function:  Trim
+# Purpose:   Print $1 without leading and trailing blanks
+Trim() {
+   local s="$1"
+   s="${s#"${s%%[![:space:]]*}"}"
+   s="${s%"${s##*[![:space:]]}"}"
+   printf '%s' "$s"
+}  # Trim
+
+#-------------------------------------------------------------------
+# Function:  Selected
+# Purpose:   Return 0 if kernel $1 matches one of the patterns in -k
+Selected() {
+   local pat pats
+   [ -z "$KERNELS" ] && return 0
+   IFS=, read -ra pats <<< "$KERNELS"
+   for pat in "${pats[@]}"; do
+      # shellcheck disable=SC2053
+      [[ $1 == $pat ]] && return 0
+   done
+   return 1
+}  # Selected
+
+#-------------------------------------------------------------------
+# Function:  Read_conf
+# Purpose:   Read the selected kernels from bench.conf into the arrays
+#            K_NAME, K_DIR, . . . , K_CHECK
+Read_conf() {
+   local name dir kind sizes build run input time check i=0
+   while IFS='|' read -r name dir kind sizes build run input time check; do
+      name=$(Trim "$name")
+      [ -z "$name" ] || [ "${name:0:1}" = "#" ] && continue
+      Selected "$name" || continue
+      K_NAME[i]=$name
+      K_DIR[i]=$(Trim "$dir")
+      K_KIND[i]=$(Trim "$kind")
+      K_SIZES[i]=$(Trim "$sizes")
+      K_BUILD[i]=$(Trim "$build")
+      K_RUN[i]=$(Trim "$run")
+      K_INPUT[i]=$(Trim "$input")
+      K_TIME[i]=$(Trim "$time")
+      K_CHECK[i]=$(Trim "$check")
+      i=$((i + 1))
+   done < "$CONF"
+   if [ $i -eq 0 ]; then
+      echo "bench.sh:  no kernels match $KERNELS" >&2
+      exit 2
+   fi
+}  # Read_conf
+
+#-------------------------------------------------------------------
+# Function:  Subst
+# Purpose:   Replace the placeholders in $1 for size $2, count $3,
+#            executable $4
+Subst() {
+   local s="$1"
+   s=${s//\{bin\}/$4}
+   s=${s//\{n\}/$2}
+   s=${s//\{p\}/$3}
+   s=${s//\{mpi\}/$MPIEXEC $MPIEXEC_FLAGS -n $3}
+   s=${s//\{tmp\}/$BUILD/tmp}
+   printf '%s' "$s"
+}  # Subst
+
+#-------------------------------------------------------------------
+# Function:  Number
+# Purpose:   Print number k of the first line of file $1 matching the
+#            extended regular expression $2.  If k is 0, print the last
+#            number on the line.
+Number() {
+   awk -v re="$2" -v k="${3:-0}" '
+      $0 ~ re {
+         m = 0
+         for (i = 1; i <= NF; i++) {
+            f = $i
+            gsub(/^[^-+.0-9]+|[^0-9]+$/, "", f)
+            if (f ~ /^[-+]?([0-9]+\.?[0-9]*|\.[0-9]+)([eE][-+]?[0-9]+)?$/) {
+               m++
+               if (k == 0) last = f
+               else if (m == k) { print f; exit }
+            }
+         }
+         if (k == 0 && m > 0) print last
+         exit
+      }' "$1"
+}  # Number
+
+#-------------------------------------------------------------------
+# Function:  Check
+# Purpose:   Return 0 if the output in file $1 passes check $2.  $3 is
+#            the key of the reference value for same.
+Check() {
+   local log=$1 how=${2%%:*} rest=${2#*:} re val tol v
+   case $how in
+      -|"")
+         return 0 ;;
+      grep)
+         grep -Eq -- "$rest" "$log" ;;
+      near)
+         IFS=: read -r re val tol <<< "$rest"
+         v=$(Number "$log" "$re")
+         [ -n "$v" ] && awk -v v="$v" -v w="$val" -v t="$tol" \
+            'BEGIN { d = v - w; exit !(d <= t && -d <= t) }' ;;
+      max)
+         IFS=: read -r re tol <<< "$rest"
+         v=$(Number "$log" "$re")
+         [ -n "$v" ] && awk -v v="$v" -v t="$tol" \
+            'BEGIN { if (v < 0) v = -v; exit !(v <= t) }' ;;
+      same)
+         IFS=: read -r re tol <<< "$rest"
+         v=$(Number "$log" "$re")
+         [ -z "$v" ] && return 1
+         if [ -z "${REF[$3]}" ]; then
+            REF[$3]=$v
+            return 0
+         fi
+         awk -v v="$v" -v w="${REF[$3]}" -v t="$tol" \
+            'BEGIN { d = v - w; if (d < 0) d = -d;
+                     if (w < 0) w = -w; exit !(d <= t*w) }' ;;
+      *)
+         echo "bench.sh:  unknown check $2" >&2
+         return 1 ;;
+   esac
+}  # Check
+
+#-------------------------------------------------------------------
+# Function:  Metadata
+# Purpose:   Set COMMIT_ID, HOST, CPU, CORES and COMPILER for the CSV
+Metadata() {
+   COMMIT_ID=$(git -C "$BENCH_DIR" rev-parse --short HEAD 2>/dev/null)
+   COMMIT_ID=${COMMIT_ID:-none}
+   if ! git -C "$BENCH_DIR" diff --quiet HEAD 2>/dev/null; then
+      COMMIT_ID="$COMMIT_ID+"
+   fi
+   HOST=$(hostname 2>/dev/null || uname -n)
+   CPU=$(awk -F': *' '/^model name/ { print $2; exit }' /proc/cpuinfo \
+         2>/dev/null)
+   CPU=${CPU:-$(uname -m)}
+   CPU=${CPU//,/ }
+   CORES=$(nproc 2>/dev/null || echo 1)
+   COMPILER="gcc $(gcc -dumpversion 2>/dev/null)"
+}  # Metadata
+
+#-------------------------------------------------------------------
+# Function:  Build
+# Purpose:   Build kernel $1 with count $2 if it isn't built yet, and
+#            set BIN to the executable
+Build() {
+   local i=$1 p=$2 cmd
+   BIN=$BUILD/bin/${K_NAME[i]}
+   [[ ${K_BUILD[i]} == *"{p}"* ]] && BIN=$BIN.p$p
+   [ -n "${BUILT[$BIN]}" ] && return "${BUILT[$BIN]}"
+   cmd=$(Subst "${K_BUILD[i]}" 0 "$p" "$BIN")
+   if (cd "$BENCH_DIR/${K_DIR[i]}" && eval "$cmd") \
+         > "$BUILD/logs/${BIN##*/}.build" 2>&1; then
+      BUILT[$BIN]=0
+   else
+      echo "${K_NAME[i]}:  build failed, see $BUILD/logs/${BIN##*/}.build" >&2
+      BUILT[$BIN]=1
+   fi
+   return "${BUILT[$BIN]}"
+}  # Build
+
+#-------------------------------------------------------------------
+# Function:  Run_one
+# Purpose:   Run kernel $1 with size $2, count $3, repetition $4, check
+#            it, and append the result to the CSV file
+Run_one() {
+   local i=$1 n=$2 p=$3 rep=$4 cmd input log status=ok secs="" re k
+   local t0 t1
+   cmd=$(Subst "${K_RUN[i]}" "$n" "$p" "$BIN")
+   log=$BUILD/logs/${K_NAME[i]}.$n.$p.$rep.log
+   if [ "${K_INPUT[i]}" = "-" ]; then
+      input=""
+   else
+      input=$(Subst "${K_INPUT[i]}" "$n" "$p" "$BIN")
+      input="${input//\\n/$'\n'}"$'\n'
+   fi
+   rm -rf "$BUILD/tmp" && mkdir -p "$BUILD/tmp"
+
+   t0=$(date +%s%N)
+   if ! (cd "$BENCH_DIR/${K_DIR[i]}" && printf '%s' "$input" |
+         timeout "$TIMEOUT" bash -c "$cmd") > "$log" 2>&1; then
+      status=failed
+   fi
+   t1=$(date +%s%N)
+
+   if [ $status = ok ]; then
+      if [ "${K_TIME[i]}" = "-" ]; then
+         secs=$(awk -v a="$t0" -v b="$t1" 'BEGIN { printf "%e", (b-a)/1e9 }')
+      else
+         re=$(Subst "${K_TIME[i]}" "$n" "$p" "$BIN")
+         k=0
+         if [[ $re == *" #"[0-9]* ]]; then
+            k=${re##* #}
+            re=${re% #*}
+         fi
+         secs=$(Number "$log" "$re" "$k")
+      fi
+      if [ -z "$secs" ]; then
+         status=notime
+      elif ! Check "$log" "$(Subst "${K_CHECK[i]}" "$n" "$p" "$BIN")" \
+            "${K_NAME[i]},$n"; then
+         status=invalid
+      fi
+   fi
+
+   printf '%-22s n = %-10s p = %-3s rep %d:  %-12s %s\n' \
+      "${K_NAME[i]}" "$n" "$p" "$rep" "${secs:--}" "$status"
+   printf '%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s\n' \
+      "$(date -u +%Y-%m-%dT%H:%M:%SZ)" "$COMMIT_ID" "$HOST" "$CPU" \
+      "$CORES" "$COMPILER" "${K_NAME[i]}" "$n" "$p" "$rep" "$secs" \
+      "$status" >> "$DB"
+   [ $status = ok ] && [ -z "$BENCH_KEEP_LOGS" ] && rm -f "$log"
+   [ $status = ok ]
+}  # Run_one
+
+#-------------------------------------------------------------------
+# Function:  Run
+# Purpose:   Run the sweep for the selected kernels
+Run() {
+   local i n p rep counts bad=0
+   declare -gA BUILT REF
+   Read_conf
+   Metadata
+   mkdir -p "$BUILD/bin" "$BUILD/logs"
+   if [ ! -s "$DB" ]; then
+      echo "date,commit,host,cpu,cores,compiler,kernel,n,p,rep,seconds,status" \
+         > "$DB"
+   fi
+
+   for i in "${!K_NAME[@]}"; do
+      counts=$COUNTS
+      [ "${K_KIND[i]}" = serial ] && counts=1
+      for n in ${SIZES:-${K_SIZES[i]}}; do
+         for p in $(printf '%s\n' $counts | sort -n -u); do
+            Build "$i" "$p" || { bad=1; continue; }
+            for ((rep = 1; rep <= REPS; rep++)); do
+               Run_one "$i" "$n" "$p" "$rep" || bad=1
+            done
+         done
+      done
+   done
+   rm -rf "$BUILD/tmp"
+   echo "Results appended to $DB"
+   return $bad
+}  # Run
+
+#-------------------------------------------------------------------
+# Function:  List
+# Purpose:   Print the kernels in bench.conf
+List() {
+   local i
+   Read_conf
+   printf '%-22s %-6s %-7s %s\n' kernel dir kind sizes
+   for i in "${!K_NAME[@]}"; do
+      printf '%-22s %-6s %-7s %s\n' "${K_NAME[i]}" "${K_DIR[i]}" \
+         "${K_KIND[i]}" "${K_SIZES[i]}"
+   done
+}  # List
+
+#-------------------------------------------------------------------
+# Function:  Report
+# Purpose:   Print statistics, speedup, efficiency and regressions for
+#            the runs of one commit on this host
+Report() {
+   local host
+   if [ ! -s "$DB" ]; then
+      echo "bench.sh:  no results in $DB" >&2
+      exit 2
+   fi
+   Metadata
+   host=$HOST
+   awk -F, -v host="$host" -v commit="$COMMIT" -v base="$BASE" \
+         -v kernels="$KERNELS" -v thr="$THRESHOLD" '
+      function selected(k,   n, pats, i, re) {
+         if (kernels == "") return 1
+         n = split(kernels, pats, ",")
+         for (i = 1; i <= n; i++) {
+            re = pats[i]
+            gsub(/\./, "\\.", re); gsub(/\*/, ".*", re); gsub(/\?/, ".", re)
+            if (k ~ ("^" re "$")) return 1
+         }
+         return 0
+      }
+      # Sort the times of configuration c and set med, mean, sd, min
+      function stats(c,   m, i, j, v, s, ss) {
+         m = cnt[c]
+         for (i = 1; i <= m; i++) v[i] = t[c, i]
+         for (i = 2; i <= m; i++)
+            for (j = i; j > 1 && v[j-1] > v[j]; j--) {
+               s = v[j]; v[j] = v[j-1]; v[j-1] = s
+            }
+         min = v[1]
+         med = (m % 2) ? v[(m+1)/2] : (v[m/2] + v[m/2+1])/2
+         s = 0; for (i = 1; i <= m; i++) s += v[i]
+         mean = s/m
+         ss = 0; for (i = 1; i <= m; i++) ss += (v[i] - mean)^2
+         sd = (m > 1) ? sqrt(ss/(m-1)) : 0
+      }
+      NR == 1 { next }
+      $3 != host || !selected($7) { next }
+      {
+         if (!($2 in seen)) { seen[$2] = ++ncommits; order[ncommits] = $2 }
+         key = $2 SUBSEP $7 SUBSEP $8 SUBSEP $9
+         if (!(key in total)) total[key] = 0
+         total[key]++
+         if ($12 == "ok") t[key, ++cnt[key]] = $11
+         else bad[key]++
+      }
+      END {
+         if (ncommits == 0) { print "No results for host " host; exit 2 }
+         if (commit == "") commit = order[ncommits]
+         if (!(commit in seen)) { print "No results for commit " commit; exit 2 }
+         if (base == "" && seen[commit] > 1) base = order[seen[commit] - 1]
+
+         printf "Host %s, commit %s", host, commit
+         if (base != "") printf ", compared with %s", base
+         printf "\n\n"
+         printf "%-22s %10s %4s %4s %12s %12s %12s %10s %8s %6s", \
+            "kernel", "n", "p", "ok", "min", "median", "mean", "sd", \
+            "speedup", "eff"
+         if (base != "") printf " %12s %8s", "base median", "change"
+         printf "\n"
+
+         # Configurations of commit, sorted by kernel, n, p
+         nc = 0
+         for (key in total) {
+            split(key, f, SUBSEP)
+            if (f[1] != commit) continue
+            conf[++nc] = sprintf("%s%c%020d%c%010d", f[2], 1, f[3], 1, f[4])
+            ckey[conf[nc]] = key
+         }
+         for (i = 2; i <= nc; i++)
+            for (j = i; j > 1 && conf[j-1] > conf[j]; j--) {
+               s = conf[j]; conf[j] = conf[j-1]; conf[j-1] = s
+            }
+
+         regressions = 0
+         for (i = 1; i <= nc; i++) {
+            key = ckey[conf[i]]
+            split(key, f, SUBSEP)
+            kn = f[2] SUBSEP f[3]
+            printf "%-22s %10s %4s %4d", f[2], f[3], f[4], cnt[key]
+            if (cnt[key] == 0) { printf "   (no good runs)\n"; continue }
+            stats(key)
+            if (!(kn in p0)) { p0[kn] = f[4]; t0[kn] = med }
+            sp = (med > 0) ? t0[kn]/med*p0[kn] : 0
+            printf " %12.5e %12.5e %12.5e %10.3e %8.3f %6.3f", \
+               min, med, mean, sd, sp, sp/f[4]
+            bkey = base SUBSEP f[2] SUBSEP f[3] SUBSEP f[4]
+            if (base != "" && cnt[bkey] > 0) {
+               cur_med = med; cur_sd = sd
+               stats(bkey)
+               change = (cur_med - med)/med
+               printf " %12.5e %+7.1f%%", med, 100*change
+               noise = 2*((cur_sd > sd) ? cur_sd : sd)
+               if (change > thr && cur_med - med > noise) {
+                  printf "  REGRESSION"
+                  regressions++
+               }
+            }
+            if (bad[key] > 0) printf "  (%d bad runs)", bad[key]
+            printf "\n"
+         }
+         if (regressions > 0) {
+            printf "\n%d regressions (threshold %.0f%%)\n", regressions, 100*thr
+            exit 1
+         }
+      }' "$DB"
+}  # Report
+
+#-------------------------------------------------------------------
+# Main
+cmd=$1
+[ -z "$cmd" ] && Usage
+shift
+while getopts "k:n:p:r:c:b:" opt; do
+   case $opt in
+      k) KERNELS=$OPTARG ;;
+      n) SIZES=$OPTARG ;;
+      p) COUNTS=$OPTARG ;;
+      r) REPS=$OPTARG ;;
+      c) COMMIT=$OPTARG ;;
+      b) BASE=$OPTARG ;;
+      *) Usage ;;
+   esac
+done
+
+case $cmd in
+   list)   List ;;
+   run)    Run ;;
+   report) Report ;;
+   *)      Usage ;;
+esac
@@ -0,0 +1,341 @@
+/* File:     coalesce.c
+ *
+ * Purpose:  Implement a message-coalescing layer on top of MPI.
+ *           Small messages to a destination are appended to a buffer
+ *           as records (int length followed by the data).  A buffer
+ *           is sent as one MPI message when it reaches flush_bytes,
+ *           when its oldest record is older than max_delay seconds,
+ *           or when the caller asks.  The receiver unpacks each
+ *           batch and calls a handler once for every record.
+ *
+ * Coalesce_init:     set up buffers for every destination
+ * Coalesce_send:     queue a message for dest
+ * Coalesce_flush:    send the queued messages for dest now
+ * Coalesce_progress: handle batches that have arrived and send
+ *                    buffers that have waited too long
+ * Coalesce_finish:   collective:  flush everything and handle
+ *                    messages until every batch sent to this
+ *                    process has arrived
+ * Coalesce_free:     release buffers
+ *
+ * Notes:
+ * 1.  Each destination has two buffers, so a process can keep
+ *     adding records while the previous batch is being sent.
+ * 2.  A message larger than flush_bytes is sent in a batch by
+ *     itself.
+ * 3.  Processes should call Coalesce_progress now and then, e.g.,
+ *     every few hundred sends, so that incoming batches don't pile
+ *     up in the MPI library.
+ * 4.  While a process waits for one of its batches to be sent, it
+ *     handles incoming batches.  Otherwise two processes sending
+ *     large batches to each other could deadlock.  So the handler
+ *     may be called from inside Coalesce_send or Coalesce_flush.
+ *     The handler may itself call Coalesce_send (e.g., to reply), so
+ *     Handle_batch takes the receive buffer away from c while it calls
+ *     the handlers, and a nested Handle_batch gets a buffer of its own.
+ *     Coalesce_finish keeps going until no process has sent a batch
+ *     from a handler, so replies are handled too.
+ * 5.  Not thread safe:  only one thread per process should call
+ *     these functions.
+ *
+ * IPP:  Not discussed, but motivated by the comparison in
+ *       mpi_many_msgs.c, Section 3.5 (pp. 116 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "coalesce.h"
+
+static void Ensure_capacity(struct coalesce_s* c,
+      struct coalesce_dest_s* d, int bytes);
+static void Wait_send(struct coalesce_s* c, struct coalesce_dest_s* d);
+static void Wait_request(struct coalesce_s* c, MPI_Request* req_p);
+static int  Drain(struct coalesce_s* c);
+static void Handle_batch(struct coalesce_s* c, int src, int bytes);
+
+/*-------------------------------------------------------------------
+ * Function:  Coalesce_init
+ * Purpose:   Initialize c
+ * In args:   comm:         communicator used for all messages
+ *            flush_bytes:  batch size that triggers a send
+ *            max_delay:    seconds a record may wait before its
+ *                          batch is sent by Coalesce_progress.  Use
+ *                          a negative value for no deadline.
+ *            handler, ctx: handler(src, data, bytes, ctx) is called
+ *                          for each message received
+ * Out arg:   c
+ */
+void Coalesce_init(struct coalesce_s* c, MPI_Comm comm, int flush_bytes,
+      double max_delay, coalesce_handler_t handler, void* ctx) {
+   int dest;
+
+   c->comm = comm;
+   MPI_Comm_size(comm, &c->comm_sz);
+   c->flush_bytes = flush_bytes;
+   c->max_delay = max_delay;
+   c->handler = handler;
+   c->ctx = ctx;
+   c->dests = malloc(c->comm_sz*sizeof(struct coalesce_dest_s));
+   c->batches_sent = calloc(c->comm_sz, sizeof(int));
+   c->batches_recvd = 0;
+   c->recv_cap = flush_bytes + sizeof(int);
+   c->recv_buf = malloc(c->recv_cap);
+   for (dest = 0; dest < c->comm_sz; dest++) {
+      c->dests[dest].cap = flush_bytes + sizeof(int);
+      c->dests[dest].buf = malloc(c->dests[dest].cap);
+      c->dests[dest].send_buf = malloc(c->dests[dest].cap);
+      c->dests[dest].count = 0;
+      c->dests[dest].first_time = 0.0;
+      c->dests[dest].req = MPI_REQUEST_NULL;
+   }
+}  /* Coalesce_init */
+
+/*-------------------------------------------------------------------
+ * Function:  Ensure_capacity
+ * Purpose:   Make sure both buffers of d can hold bytes bytes.  The
+ *            send buffer is only reallocated after its send is done.
+ */
+static void Ensure_capacity(struct coalesce_s* c,
+      struct coalesce_dest_s* d, int bytes) {
+   if (bytes <= d->cap) return;
+   Wait_send(c, d);
+   if (bytes <= d->cap) return;   /* A handler made it bigger */
+   d->cap = bytes;
+   d->buf = realloc(d->buf, d->cap);
+   d->send_buf = realloc(d->send_buf, d->cap);
+}  /* Ensure_capacity */
+
+/*-------------------------------------------------------------------
+ * Function:  Coalesce_send
+ * Purpose:   Queue bytes bytes of data for dest.  data can be reused
+ *            as soon as the function returns.
+ */
+void Coalesce_send(struct coalesce_s* c, int dest, void* data,
+      int bytes) {
+   struct coalesce_dest_s* d = &c->dests[dest];
+   int rec_bytes = sizeof(int) + bytes;
+
+   /* Both calls may run handlers that add records to d.  After the */
+   /* flush, d->buf is empty, and nothing runs before it's filled.  */
+   Ensure_capacity(c, d, rec_bytes);
+   if (d->count > 0 && d->count + rec_bytes > c->flush_bytes)
+      Coalesce_flush(c, dest);
+
+   if (d->count == 0) d->first_time = MPI_Wtime();
+   memcpy(d->buf + d->count, &bytes, sizeof(int));
+   memcpy(d->buf + d->count + sizeof(int), data, bytes);
+   d->count += rec_bytes;
+
+   if (d->count >= c->flush_bytes)
+      Coalesce_flush(c, dest);
+}  /* Coalesce_send */
+
+/*-------------------------------------------------------------------
+ * Function:  Coalesce_flush
+ * Purpose:   Start sending the records queued for dest
+ */
+void Coalesce_flush(struct coalesce_s* c, int dest) {
+   struct coalesce_dest_s* d = &c->dests[dest];
+   char* tmp;
+
+   if (d->count == 0) return;
+
+   /* The previous batch must be gone before we reuse its buffer.  */
+   /* The handlers called while we wait may send records to dest,  */
+   /* and they may flush them, so check the count again.           */
+   Wait_send(c, d);
+   if (d->count == 0) return;
+   tmp = d->send_buf;
+   d->send_buf = d->buf;
+   d->buf = tmp;
+   MPI_Isend(d->send_buf, d->count, MPI_CHAR, dest, COALESCE_TAG,
+         c->comm, &d->req);
+   d->count = 0;
+   c->batches_sent[dest]++;
+}  /* Coalesce_flush */
+
+/*-------------------------------------------------------------------
+ * Function:  Wait_send
+ * Purpose:   Wait for the batch being sent to d to go, handling
+ *            incoming batches in the meantime
+ */
+static void Wait_send(struct coalesce_s* c, struct coalesce_dest_s* d) {
+   Wait_request(c, &d->req);
+}  /* Wait_send */
+
+/*-------------------------------------------------------------------
+ * Function:  Wait_request
+ * Purpose:   Wait for *req_p to complete, handling incoming batches in
+ *            the meantime
+ * Note:      A handler may replace *req_p (e.g., a nested flush to the
+ *            same destination), so *req_p is tested each time.
+ */
+static void Wait_request(struct coalesce_s* c, MPI_Request* req_p) {
+   int done;
+
+   MPI_Test(req_p, &done, MPI_STATUS_IGNORE);
+   while (!done) {
+      Drain(c);
+      MPI_Test(req_p, &done, MPI_STATUS_IGNORE);
+   }
+}  /* Wait_request */
+
+/*-------------------------------------------------------------------
+ * Function:    Drain
+ * Purpose:     Handle every batch that has already arrived
+ * Return val:  Number of batches handled
+ */
+static int Drain(struct coalesce_s* c) {
+   int flag, bytes, handled = 0;
+   MPI_Status status;
+
+   MPI_Iprobe(MPI_ANY_SOURCE, COALESCE_TAG, c->comm, &flag, &status);
+   while (flag) {
+      MPI_Get_count(&status, MPI_CHAR, &bytes);
+      Handle_batch(c, status.MPI_SOURCE, bytes);
+      handled++;
+      MPI_Iprobe(MPI_ANY_SOURCE, COALESCE_TAG, c->comm, &flag, &status);
+   }
+   return handled;
+}  /* Drain */
+
+/*-------------------------------------------------------------------
+ * Function:  Handle_batch
+ * Purpose:   Receive a batch that has been probed, and call the
+ *            handler for each record in it
+ * Note:      A handler can call Coalesce_send, which can call
+ *            Handle_batch again.  So the buffer is taken from c before
+ *            the handlers are called, and the nested call allocates a
+ *            new one.  When we're done, the larger buffer is kept.
+ */
+static void Handle_batch(struct coalesce_s* c, int src, int bytes) {
+   int pos = 0, rec_bytes, cap = c->recv_cap;
+   char* buf = c->recv_buf;
+
+   c->recv_buf = NULL;
+   c->recv_cap = 0;
+   if (bytes > cap || buf == NULL) {
+      free(buf);
+      cap = (bytes > cap) ? bytes : cap;
+      buf = malloc(cap);
+   }
+   MPI_Recv(buf, bytes, MPI_CHAR, src, COALESCE_TAG, c->comm,
+         MPI_STATUS_IGNORE);
+   c->batches_recvd++;
+
+   while (pos < bytes) {
+      memcpy(&rec_bytes, buf + pos, sizeof(int));
+      pos += sizeof(int);
+      c->handler(src, buf + pos, rec_bytes, c->ctx);
+      pos += rec_bytes;
+   }
+
+   if (cap > c->recv_cap) {
+      free(c->recv_buf);
+      c->recv_buf = buf;
+      c->recv_cap = cap;
+   } else {
+      free(buf);
+   }
+}  /* Handle_batch */
+
+/*-------------------------------------------------------------------
+ * Function:    Coalesce_progress
+ * Purpose:     Handle every batch that has already arrived, and flush
+ *              any buffer whose oldest record has waited longer than
+ *              max_delay
+ * Return val:  Number of batches handled
+ */
+int Coalesce_progress(struct coalesce_s* c) {
+   int handled, dest;
+   double now;
+
+   handled = Drain(c);
+
+   if (c->max_delay >= 0.0) {
+      now = MPI_Wtime();
+      for (dest = 0; dest < c->comm_sz; dest++)
+         if (c->dests[dest].count > 0 &&
+               now - c->dests[dest].first_time > c->max_delay)
+            Coalesce_flush(c, dest);
+   }
+   return handled;
+}  /* Coalesce_progress */
+
+/*-------------------------------------------------------------------
+ * Function:  Coalesce_finish
+ * Purpose:   Flush all buffers, and handle incoming batches until
+ *            every batch sent to this process has been handled.
+ *            Must be called by every process in c->comm.
+ * Note:      The number of batches to expect is found by summing
+ *            copies of the batches_sent arrays with
+ *            MPI_Ireduce_scatter_block.  If a handler sent anything
+ *            after the copy was made, on any process, there's another
+ *            round.  The collectives are nonblocking, and incoming
+ *            batches are handled while they complete, since other
+ *            processes may still be waiting for their sends to this
+ *            process to finish.
+ */
+void Coalesce_finish(struct coalesce_s* c) {
+   int dest, expected, bytes, more, any_more;
+   int* sent_copy = malloc(c->comm_sz*sizeof(int));
+   long sent;
+   MPI_Status status;
+   MPI_Request req;
+
+   do {
+      for (dest = 0; dest < c->comm_sz; dest++)
+         Coalesce_flush(c, dest);
+      for (sent = 0, dest = 0; dest < c->comm_sz; dest++) {
+         sent_copy[dest] = c->batches_sent[dest];
+         sent += sent_copy[dest];
+      }
+      MPI_Ireduce_scatter_block(sent_copy, &expected, 1, MPI_INT,
+            MPI_SUM, c->comm, &req);
+      Wait_request(c, &req);
+
+      while (c->batches_recvd < expected) {
+         MPI_Probe(MPI_ANY_SOURCE, COALESCE_TAG, c->comm, &status);
+         MPI_Get_count(&status, MPI_CHAR, &bytes);
+         Handle_batch(c, status.MPI_SOURCE, bytes);
+      }
+
+      /* Did a handler send or queue anything? */
+      more = 0;
+      for (dest = 0; dest < c->comm_sz; dest++) {
+         sent -= c->batches_sent[dest];
+         if (c->dests[dest].count > 0) more = 1;
+      }
+      if (sent != 0) more = 1;
+      MPI_Iallreduce(&more, &any_more, 1, MPI_INT, MPI_MAX, c->comm,
+            &req);
+      Wait_request(c, &req);
+   } while (any_more);
+   free(sent_copy);
+
+   for (dest = 0; dest < c->comm_sz; dest++) {
+      MPI_Wait(&c->dests[dest].req, MPI_STATUS_IGNORE);
+      c->batches_sent[dest] = 0;
+   }
+   c->batches_recvd = 0;
+
+   /* Don't let a process start sending the next round of messages */
+   /* while another is still counting batches from this round      */
+   MPI_Barrier(c->comm);
+}  /* Coalesce_finish */
+
+/*-------------------------------------------------------------------
+ * Function:  Coalesce_free
+ * Purpose:   Free the storage used by c.  Call Coalesce_finish first.
+ */
+void Coalesce_free(struct coalesce_s* c) {
+   int dest;
+
+   for (dest = 0; dest < c->comm_sz; dest++) {
+      free(c->dests[dest].buf);
+      free(c->dests[dest].send_buf);
+   }
+   free(c->dests);
+   free(c->batches_sent);
+   free(c->recv_buf);
+}  /* Coalesce_free */
@@ -0,0 +1,64 @@
+/* File:     coalesce.h
+ * Purpose:  Header file for coalesce.c, which implements a layer that
+ *           combines many small MPI messages into a few large ones.
+ *
+ * Usage:
+ *    struct coalesce_s c;
+ *    Coalesce_init(&c, comm, 65536, 1.0e-3, Handler, &my_data);
+ *    . . .
+ *    Coalesce_send(&c, dest, &x, sizeof(double));   (many times)
+ *    Coalesce_progress(&c);                          (now and then)
+ *    . . .
+ *    Coalesce_finish(&c);   (collective:  returns when every message
+ *                            sent by any process has been handled)
+ *    Coalesce_free(&c);
+ *
+ *    Handler(src, data, bytes, &my_data) is called once for each
+ *    message, in the order the messages were sent by src.
+ *
+ * IPP:  Not discussed, but motivated by the comparison in
+ *       mpi_many_msgs.c, Section 3.5 (pp. 116 and ff.)
+ */
+#ifndef _COALESCE_H_
+#define _COALESCE_H_
+
+#include <mpi.h>
+
+#define COALESCE_TAG 4242
+
+typedef void (*coalesce_handler_t)(int src, void* data, int bytes,
+      void* ctx);
+
+/* Buffers for one destination */
+struct coalesce_dest_s {
+   char*       buf;         /* Records being collected             */
+   char*       send_buf;    /* Batch being sent, if req is active  */
+   int         count;       /* Bytes used in buf                   */
+   int         cap;         /* Capacity of buf and send_buf        */
+   double      first_time;  /* When the oldest record was added    */
+   MPI_Request req;
+};
+
+struct coalesce_s {
+   MPI_Comm                comm;
+   int                     comm_sz;
+   int                     flush_bytes;  /* Send a batch at this size */
+   double                  max_delay;    /* ... or when this old      */
+   coalesce_handler_t      handler;
+   void*                   ctx;
+   struct coalesce_dest_s* dests;
+   int*                    batches_sent; /* Per destination           */
+   long                    batches_recvd;
+   char*                   recv_buf;
+   int                     recv_cap;
+};
+
+void Coalesce_init(struct coalesce_s* c, MPI_Comm comm, int flush_bytes,
+      double max_delay, coalesce_handler_t handler, void* ctx);
+void Coalesce_send(struct coalesce_s* c, int dest, void* data, int bytes);
+void Coalesce_flush(struct coalesce_s* c, int dest);
+int  Coalesce_progress(struct coalesce_s* c);
+void Coalesce_finish(struct coalesce_s* c);
+void Coalesce_free(struct coalesce_s* c);
+
+#endif
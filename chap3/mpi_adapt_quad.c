@@ -0,0 +1,552 @@
+/* File:     mpi_adapt_quad.c
+ * Purpose:  Use MPI to estimate a definite integral with adaptive
+ *           quadrature.  Since the amount of work needed on a
+ *           subinterval isn't known in advance, a static partition
+ *           of [a, b] can be badly unbalanced.  So each process keeps
+ *           a stack of subintervals that still need work, and a
+ *           process whose stack is empty steals half of the stack of
+ *           a randomly chosen process.
+ *
+ * Input:    a, b, tol
+ * Output:   Estimate of the integral from a to b of f(x), its error,
+ *           the number of evaluations of f, the number of successful
+ *           steals, and the elapsed time
+ *
+ * Compile:  mpicc -g -Wall -O2 -o mpi_adapt_quad mpi_adapt_quad.c -lm
+ * Run:      mpiexec -n <number of processes> ./mpi_adapt_quad <f> <rule>
+ *              f:     x2, peak, sqrt, or sin (as in
+ *                     chap5/omp_adapt_quad.c)
+ *              rule:  s for adaptive Simpson, k for adaptive
+ *                     7-point Gauss/15-point Kronrod
+ *
+ * Algorithm:
+ *    1.  [a, b] is divided into INIT_PER_PROC*comm_sz equal pieces,
+ *        and each process gets a block of consecutive pieces.
+ *    2.  A process pops a subinterval [l, r] off its stack.  If the
+ *        error estimate is at most tol*(r-l)/(b-a), the estimate is
+ *        added to the process' sum.  Otherwise the two halves are
+ *        pushed.
+ *    3.  A process with an empty stack sends STEAL_TAG to a random
+ *        victim, which replies with the bottom half of its stack
+ *        (WORK_TAG), or NO_WORK_TAG if it has less than two
+ *        subintervals.
+ *    4.  Termination:  each initial piece has "measure" 2^MAX_DEPTH,
+ *        and the two halves of a subinterval each get half of its
+ *        measure.  Whenever a process runs out of work it sends the
+ *        measure of the subintervals it accepted to process 0.  When
+ *        the accepted measure adds up to the measure of [a, b], no
+ *        subintervals are left anywhere, and process 0 sends
+ *        TERM_TAG to everyone.
+ *    5.  A process may still have a steal request outstanding when
+ *        it's told to stop.  So after waiting for its own reply, each
+ *        process answers requests until an MPI_Ibarrier completes.
+ *    6.  The sums and counts are added with MPI_Reduce.
+ *
+ * IPP:      Not discussed.  Compare the trapezoidal rule programs,
+ *           Section 3.4.2 (pp. 104 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+
+#define MAX_DEPTH 40
+#define INIT_PER_PROC 16
+#define POLL_INTERVAL 16   /* Subintervals processed between polls */
+
+#define STEAL_TAG    1
+#define WORK_TAG     2
+#define NO_WORK_TAG  3
+#define MEASURE_TAG  4
+#define TERM_TAG     5
+
+typedef unsigned long long measure_t;
+
+/* A subinterval that still needs work.  For Simpson, est is the     */
+/* Simpson estimate and fa, fm, fb are f at a, (a+b)/2, and b.  For  */
+/* Gauss-Kronrod, est and err are the Kronrod estimate and its error */
+struct interval_s {
+   double a, b;
+   double fa, fm, fb;
+   double est, err;
+   int    depth;
+};
+
+struct stack_s {
+   struct interval_s* list;
+   int                count;
+   int                cap;
+};
+
+/* Integrands */
+double X2(double x);
+double Peak(double x);
+double Sqrt(double x);
+double Sin(double x);
+double X2_exact(double a, double b);
+double Peak_exact(double a, double b);
+double Sqrt_exact(double a, double b);
+double Sin_exact(double a, double b);
+
+struct integrand_s {
+   char*       name;
+   double      (*f)(double x);
+   double      (*exact)(double a, double b);
+};
+
+struct integrand_s integrands[] = {
+   {"x2",   X2,   X2_exact},
+   {"peak", Peak, Peak_exact},
+   {"sqrt", Sqrt, Sqrt_exact},
+   {"sin",  Sin,  Sin_exact}
+};
+#define NUM_INTEGRANDS (sizeof(integrands)/sizeof(struct integrand_s))
+
+int      my_rank, comm_sz;
+MPI_Comm comm;
+double   (*f)(double x);
+char     rule;
+double   total_a, total_b, total_tol;
+long     evals = 0;
+double   local_sum = 0.0;
+measure_t accepted = 0;   /* Measure not yet reported to 0 */
+
+void Get_args(int argc, char* argv[], struct integrand_s** ig_pp);
+void Get_input(double* a_p, double* b_p, double* tol_p);
+void Push(struct stack_s* s, struct interval_s* iv);
+void Make_interval(double a, double b, int depth, struct interval_s* iv);
+double Gauss_kronrod(double a, double b, double* err_p);
+void Process(struct stack_s* s, struct interval_s* iv);
+void Answer_steal(struct stack_s* s, int thief);
+int  Poll(struct stack_s* s, int* outstanding_p, measure_t* total_p,
+      measure_t goal, int* steals_p);
+void Report_measure(measure_t* total_p, measure_t goal, int* done_p);
+void Send_term(void);
+void Shutdown(struct stack_s* s, int outstanding);
+
+int main(int argc, char* argv[]) {
+   struct integrand_s* ig;
+   struct stack_s stack = {NULL, 0, 0};
+   struct interval_s iv;
+   int i, n0, my_first, done = 0, outstanding = 0, victim;
+   int steals = 0, total_steals;
+   long total_evals, min_evals, max_evals;
+   double h, sum, start, finish, elapsed, exact;
+   measure_t goal, total = 0;
+
+   MPI_Init(&argc, &argv);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+
+   Get_args(argc, argv, &ig);
+   f = ig->f;
+   Get_input(&total_a, &total_b, &total_tol);
+   srandom(my_rank + 1);
+
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+
+   n0 = INIT_PER_PROC*comm_sz;
+   goal = ((measure_t) n0) << MAX_DEPTH;
+   h = (total_b - total_a)/n0;
+   my_first = my_rank*INIT_PER_PROC;
+   /* Push in reverse so the leftmost piece is on top */
+   for (i = INIT_PER_PROC-1; i >= 0; i--) {
+      Make_interval(total_a + (my_first + i)*h,
+            total_a + (my_first + i + 1)*h, 0, &iv);
+      Push(&stack, &iv);
+   }
+
+   while (!done) {
+      for (i = 0; i < POLL_INTERVAL && stack.count > 0; i++) {
+         iv = stack.list[--stack.count];
+         Process(&stack, &iv);
+      }
+      done = Poll(&stack, &outstanding, &total, goal, &steals);
+      if (done || stack.count > 0) continue;
+
+      Report_measure(&total, goal, &done);
+      if (!done && !outstanding && comm_sz > 1) {
+         victim = random() % (comm_sz - 1);
+         if (victim >= my_rank) victim++;
+         MPI_Send(NULL, 0, MPI_BYTE, victim, STEAL_TAG, comm);
+         outstanding = 1;
+      }
+   }
+   Shutdown(&stack, outstanding);
+
+   finish = MPI_Wtime();
+   elapsed = finish - start;
+   MPI_Reduce(&local_sum, &sum, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+   MPI_Reduce(&evals, &total_evals, 1, MPI_LONG, MPI_SUM, 0, comm);
+   MPI_Reduce(&evals, &min_evals, 1, MPI_LONG, MPI_MIN, 0, comm);
+   MPI_Reduce(&evals, &max_evals, 1, MPI_LONG, MPI_MAX, 0, comm);
+   MPI_Reduce(&steals, &total_steals, 1, MPI_INT, MPI_SUM, 0, comm);
+   MPI_Reduce(&elapsed, &finish, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+   if (my_rank == 0) {
+      exact = ig->exact(total_a, total_b);
+      printf("Adaptive %s estimate of the integral of %s from %f to %f\n",
+            rule == 's' ? "Simpson" : "Gauss-Kronrod", ig->name,
+            total_a, total_b);
+      printf("   = %.14e\n", sum);
+      printf("   Error = %.3e, tol = %.3e\n", fabs(sum - exact), total_tol);
+      printf("   Function evaluations = %ld (min %ld, max %ld per process)\n",
+            total_evals, min_evals, max_evals);
+      printf("   Successful steals = %d\n", total_steals);
+      printf("   Elapsed time = %e seconds\n", finish);
+   }
+
+   free(stack.list);
+   MPI_Finalize();
+   return 0;
+}  /* main */
+
+/*-------------------------------------------------------------------*/
+void Get_args(
+      int                  argc     /* in  */,
+      char*                argv[]   /* in  */,
+      struct integrand_s** ig_pp    /* out */) {
+   int i;
+
+   *ig_pp = NULL;
+   if (argc == 3) {
+      for (i = 0; i < NUM_INTEGRANDS; i++)
+         if (strcmp(argv[1], integrands[i].name) == 0)
+            *ig_pp = &integrands[i];
+      rule = argv[2][0];
+   }
+   if (*ig_pp == NULL || (rule != 's' && rule != 'k')) {
+      if (my_rank == 0) {
+         fprintf(stderr, "usage:  mpiexec -n <p> %s <f> <s|k>\n", argv[0]);
+         fprintf(stderr, "   f is one of");
+         for (i = 0; i < NUM_INTEGRANDS; i++)
+            fprintf(stderr, " %s", integrands[i].name);
+         fprintf(stderr, "\n");
+      }
+      MPI_Finalize();
+      exit(0);
+   }
+}  /* Get_args */
+
+/*-------------------------------------------------------------------*/
+void Get_input(
+      double* a_p    /* out */,
+      double* b_p    /* out */,
+      double* tol_p  /* out */) {
+
+   if (my_rank == 0) {
+      printf("Enter a, b, and tol\n");
+      scanf("%lf %lf %lf", a_p, b_p, tol_p);
+   }
+   MPI_Bcast(a_p, 1, MPI_DOUBLE, 0, comm);
+   MPI_Bcast(b_p, 1, MPI_DOUBLE, 0, comm);
+   MPI_Bcast(tol_p, 1, MPI_DOUBLE, 0, comm);
+}  /* Get_input */
+
+/*-------------------------------------------------------------------
+ * Integrands:  each function f is paired with a function that
+ * returns the exact integral of f from a to b.
+ */
+double X2(double x) { return x*x; }
+double X2_exact(double a, double b) { return (b*b*b - a*a*a)/3.0; }
+
+#define PEAK_EPS 1.0e-6
+#define PEAK_X 0.3
+double Peak(double x) {
+   return 1.0/(PEAK_EPS + (x - PEAK_X)*(x - PEAK_X));
+}
+double Peak_exact(double a, double b) {
+   double s = sqrt(PEAK_EPS);
+   return (atan((b - PEAK_X)/s) - atan((a - PEAK_X)/s))/s;
+}
+
+double Sqrt(double x) { return sqrt(fabs(x)); }
+double Sqrt_exact(double a, double b) {
+   double Fb = (b >= 0 ? 1 : -1)*2.0/3.0*pow(fabs(b), 1.5);
+   double Fa = (a >= 0 ? 1 : -1)*2.0/3.0*pow(fabs(a), 1.5);
+   return Fb - Fa;
+}
+
+double Sin(double x) { return sin(x); }
+double Sin_exact(double a, double b) { return cos(a) - cos(b); }
+
+/*-------------------------------------------------------------------
+ * Function:  Push
+ * Purpose:   Push a copy of *iv onto the stack s
+ */
+void Push(struct stack_s* s, struct interval_s* iv) {
+   if (s->count == s->cap) {
+      s->cap = (s->cap == 0) ? 64 : 2*s->cap;
+      s->list = realloc(s->list, s->cap*sizeof(struct interval_s));
+   }
+   s->list[s->count++] = *iv;
+}  /* Push */
+
+/*-------------------------------------------------------------------
+ * Function:  Make_interval
+ * Purpose:   Evaluate f where the current rule needs it on [a, b],
+ *            and store the result in *iv
+ */
+void Make_interval(double a, double b, int depth, struct interval_s* iv) {
+   iv->a = a;
+   iv->b = b;
+   iv->depth = depth;
+   if (rule == 's') {
+      iv->fa = f(a);
+      iv->fm = f((a+b)/2);
+      iv->fb = f(b);
+      evals += 3;
+      iv->est = (b-a)/6*(iv->fa + 4*iv->fm + iv->fb);
+   } else {
+      iv->est = Gauss_kronrod(a, b, &iv->err);
+   }
+}  /* Make_interval */
+
+/*-------------------------------------------------------------------
+ * Function:    Gauss_kronrod
+ * Purpose:     Apply the 15-point Kronrod rule to [a, b], and estimate
+ *              its error by comparing it with the embedded 7-point
+ *              Gauss rule
+ * Out arg:     err_p
+ * Return val:  Kronrod estimate of the integral
+ */
+double Gauss_kronrod(double a, double b, double* err_p) {
+   static const double xgk[8] = {
+      0.991455371120812639206854697526329,
+      0.949107912342758524526189684047851,
+      0.864864423359769072789712788640926,
+      0.741531185599394439863864773280788,
+      0.586087235467691130294144845693013,
+      0.405845151377397166906606412076961,
+      0.207784955007898467600689403773245,
+      0.000000000000000000000000000000000};
+   static const double wgk[8] = {
+      0.022935322010529224963732008058970,
+      0.063092092629978553290700663189204,
+      0.104790010322250183839876322541518,
+      0.140653259715525918745189590510238,
+      0.169004726639267902826583426598550,
+      0.190350578064785409913256402421014,
+      0.204432940075298892414161999234649,
+      0.209482141084727828012999174891714};
+   static const double wg[4] = {
+      0.129484966168869693270611432679082,
+      0.279705391489276667901467771423780,
+      0.381830050505118944950369775488975,
+      0.417959183673469387755102040816327};
+   double c = (a + b)/2, h = (b - a)/2;
+   double fc = f(c), f1, f2, resk, resg;
+   int j;
+
+   resk = wgk[7]*fc;
+   resg = wg[3]*fc;
+   for (j = 0; j < 7; j++) {
+      f1 = f(c - h*xgk[j]);
+      f2 = f(c + h*xgk[j]);
+      resk += wgk[j]*(f1 + f2);
+      if (j % 2 == 1) resg += wg[j/2]*(f1 + f2);
+   }
+   evals += 15;
+   *err_p = fabs((resk - resg)*h);
+   return resk*h;
+}  /* Gauss_kronrod */
+
+/*-------------------------------------------------------------------
+ * Function:  Process
+ * Purpose:   Either accept the estimate on *iv, adding it to local_sum
+ *            and its measure to accepted, or push its two halves
+ *            onto s
+ */
+void Process(struct stack_s* s, struct interval_s* iv) {
+   double a = iv->a, b = iv->b, m = (a + b)/2;
+   double tol = total_tol*(b - a)/(total_b - total_a);
+   double flm, frm, left, right, delta;
+   struct interval_s half;
+
+   if (rule == 's') {
+      flm = f((a + m)/2);
+      frm = f((m + b)/2);
+      evals += 2;
+      left = (b-a)/12*(iv->fa + 4*flm + iv->fm);
+      right = (b-a)/12*(iv->fm + 4*frm + iv->fb);
+      delta = left + right - iv->est;
+      if (iv->depth >= MAX_DEPTH || fabs(delta) <= 15*tol) {
+         local_sum += left + right + delta/15;
+         accepted += ((measure_t) 1) << (MAX_DEPTH - iv->depth);
+         return;
+      }
+      half.depth = iv->depth + 1;
+      half.a = m; half.b = b;
+      half.fa = iv->fm; half.fm = frm; half.fb = iv->fb;
+      half.est = right;
+      Push(s, &half);
+      half.a = a; half.b = m;
+      half.fa = iv->fa; half.fm = flm; half.fb = iv->fm;
+      half.est = left;
+      Push(s, &half);
+   } else {
+      if (iv->depth >= MAX_DEPTH || iv->err <= tol) {
+         local_sum += iv->est;
+         accepted += ((measure_t) 1) << (MAX_DEPTH - iv->depth);
+         return;
+      }
+      Make_interval(m, b, iv->depth + 1, &half);
+      Push(s, &half);
+      Make_interval(a, m, iv->depth + 1, &half);
+      Push(s, &half);
+   }
+}  /* Process */
+
+/*-------------------------------------------------------------------
+ * Function:  Answer_steal
+ * Purpose:   Reply to a steal request from thief.  If there are at
+ *            least two subintervals on s, send the bottom half of the
+ *            stack:  these are the oldest, and usually the largest,
+ *            subintervals.
+ */
+void Answer_steal(struct stack_s* s, int thief) {
+   int give = s->count/2;
+
+   if (give == 0) {
+      MPI_Send(NULL, 0, MPI_BYTE, thief, NO_WORK_TAG, comm);
+      return;
+   }
+   MPI_Send(s->list, give*sizeof(struct interval_s), MPI_BYTE, thief,
+         WORK_TAG, comm);
+   memmove(s->list, s->list + give,
+         (s->count - give)*sizeof(struct interval_s));
+   s->count -= give;
+}  /* Answer_steal */
+
+/*-------------------------------------------------------------------
+ * Function:    Poll
+ * Purpose:     Handle every message that has arrived
+ * In/out args: s, outstanding_p:  whether a steal request is waiting
+ *                 for a reply
+ *              total_p:  on process 0, the measure accepted so far
+ *              steals_p:  number of successful steals
+ * Return val:  1 if the computation is over, 0 otherwise
+ */
+int Poll(struct stack_s* s, int* outstanding_p, measure_t* total_p,
+      measure_t goal, int* steals_p) {
+   int flag, bytes, done = 0;
+   measure_t m;
+   MPI_Status status;
+
+   MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &flag, &status);
+   while (flag) {
+      switch (status.MPI_TAG) {
+         case STEAL_TAG:
+            MPI_Recv(NULL, 0, MPI_BYTE, status.MPI_SOURCE, STEAL_TAG,
+                  comm, MPI_STATUS_IGNORE);
+            Answer_steal(s, status.MPI_SOURCE);
+            break;
+         case WORK_TAG:
+            MPI_Get_count(&status, MPI_BYTE, &bytes);
+            while (s->cap < s->count + bytes/sizeof(struct interval_s)) {
+               s->cap = (s->cap == 0) ? 64 : 2*s->cap;
+               s->list = realloc(s->list, s->cap*sizeof(struct interval_s));
+            }
+            MPI_Recv(s->list + s->count, bytes, MPI_BYTE,
+                  status.MPI_SOURCE, WORK_TAG, comm, MPI_STATUS_IGNORE);
+            s->count += bytes/sizeof(struct interval_s);
+            *outstanding_p = 0;
+            (*steals_p)++;
+            break;
+         case NO_WORK_TAG:
+            MPI_Recv(NULL, 0, MPI_BYTE, status.MPI_SOURCE, NO_WORK_TAG,
+                  comm, MPI_STATUS_IGNORE);
+            *outstanding_p = 0;
+            break;
+         case MEASURE_TAG:
+            MPI_Recv(&m, 1, MPI_UNSIGNED_LONG_LONG, status.MPI_SOURCE,
+                  MEASURE_TAG, comm, MPI_STATUS_IGNORE);
+            *total_p += m;
+            if (*total_p == goal) {
+               Send_term();
+               done = 1;
+            }
+            break;
+         case TERM_TAG:
+            MPI_Recv(NULL, 0, MPI_BYTE, 0, TERM_TAG, comm,
+                  MPI_STATUS_IGNORE);
+            done = 1;
+            break;
+      }
+      if (done) break;
+      MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &flag, &status);
+   }
+   return done;
+}  /* Poll */
+
+/*-------------------------------------------------------------------
+ * Function:  Report_measure
+ * Purpose:   Send the measure accepted since the last report to
+ *            process 0.  On process 0, add it to the total, and if
+ *            everything has been accepted, tell everyone to stop.
+ */
+void Report_measure(measure_t* total_p, measure_t goal, int* done_p) {
+   if (accepted == 0) return;
+   if (my_rank == 0) {
+      *total_p += accepted;
+      if (*total_p == goal) {
+         Send_term();
+         *done_p = 1;
+      }
+   } else {
+      MPI_Send(&accepted, 1, MPI_UNSIGNED_LONG_LONG, 0, MEASURE_TAG, comm);
+   }
+   accepted = 0;
+}  /* Report_measure */
+
+/*-------------------------------------------------------------------
+ * Function:  Send_term
+ * Purpose:   Called by process 0:  tell the other processes to stop
+ */
+void Send_term(void) {
+   int q;
+
+   for (q = 1; q < comm_sz; q++)
+      MPI_Send(NULL, 0, MPI_BYTE, q, TERM_TAG, comm);
+}  /* Send_term */
+
+/*-------------------------------------------------------------------
+ * Function:  Shutdown
+ * Purpose:   Wait for the reply to our own steal request, if any, and
+ *            then answer the requests of other processes until every
+ *            process has reached this point.  No subintervals are
+ *            left, so every answer is NO_WORK_TAG.
+ */
+void Shutdown(struct stack_s* s, int outstanding) {
+   int flag, done = 0;
+   MPI_Request req;
+   MPI_Status status;
+
+   while (outstanding) {
+      MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &status);
+      if (status.MPI_TAG == STEAL_TAG) {
+         MPI_Recv(NULL, 0, MPI_BYTE, status.MPI_SOURCE, STEAL_TAG, comm,
+               MPI_STATUS_IGNORE);
+         Answer_steal(s, status.MPI_SOURCE);
+      } else {
+         /* NO_WORK_TAG */
+         MPI_Recv(NULL, 0, MPI_BYTE, status.MPI_SOURCE, status.MPI_TAG,
+               comm, MPI_STATUS_IGNORE);
+         outstanding = 0;
+      }
+   }
+
+   MPI_Ibarrier(comm, &req);
+   while (!done) {
+      MPI_Iprobe(MPI_ANY_SOURCE, STEAL_TAG, comm, &flag, &status);
+      if (flag) {
+         MPI_Recv(NULL, 0, MPI_BYTE, status.MPI_SOURCE, STEAL_TAG, comm,
+               MPI_STATUS_IGNORE);
+         Answer_steal(s, status.MPI_SOURCE);
+      }
+      MPI_Test(&req, &done, MPI_STATUS_IGNORE);
+   }
+}  /* Shutdown */
@@ -0,0 +1,210 @@
+/* File:     mpi_many_msgs_coalesce.c
+ * Purpose:  Compare the time needed for each process to send n
+ *           messages consisting of a single double each to the next
+ *           process in a ring, when each message is a separate MPI
+ *           message and when the messages are combined by the
+ *           coalescing layer in coalesce.c.
+ *
+ * Compile:  mpicc -g -Wall -O2 -o mpi_many_msgs_coalesce \
+ *              mpi_many_msgs_coalesce.c coalesce.c
+ * Run:      mpiexec -n <p> mpi_many_msgs_coalesce <number of doubles>
+ *              [flush bytes] [max delay in microseconds]
+ *
+ * Input:    none
+ * Output:   Elapsed time for n separate messages, elapsed time for
+ *           n coalesced messages, elapsed time for n coalesced
+ *           messages that are answered by the receiver, and whether
+ *           each process received the values that were sent to it
+ *
+ * Notes:
+ * 1.  flush bytes defaults to 65536, and max delay to 1000
+ *     microseconds
+ * 2.  The message from process q with index i is the double q*n + i
+ * 3.  In the last test, the handler of the receiver sends each value
+ *     back to the sender from inside the handler, as the reply to a
+ *     request would be.  This checks that the coalescing layer can be
+ *     reentered from a handler.  A small flush bytes (e.g., 64) makes
+ *     the handlers run inside sends more often.
+ *
+ * IPP:      Section 3.5 (pp. 116 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "coalesce.h"
+
+#define PROGRESS_INTERVAL 256
+
+int      my_rank;
+int      comm_sz;
+MPI_Comm comm;
+
+struct recv_info_s {
+   double sum;
+   long   count;
+};
+
+/* Messages of the request-reply test */
+struct echo_msg_s {
+   int    is_reply;
+   double x;
+};
+
+struct echo_info_s {
+   struct coalesce_s* c;
+   double             reply_sum;
+   long               requests;
+   long               replies;
+};
+
+void Get_args(int argc, char* argv[], int* n_p, int* flush_bytes_p,
+      double* max_delay_p);
+void Handler(int src, void* data, int bytes, void* ctx);
+void Echo_handler(int src, void* data, int bytes, void* ctx);
+
+int main(int argc, char* argv[]) {
+   int         i, n, flush_bytes, dest, source;
+   double      x, max_delay, start, finish, elapsed[3], expected, mine;
+   struct coalesce_s  c;
+   struct recv_info_s info = {0.0, 0};
+   struct echo_info_s echo = {&c, 0.0, 0, 0};
+   struct echo_msg_s  msg;
+   double      direct_sum = 0.0;
+   int         ok, all_ok;
+
+   MPI_Init(&argc, &argv);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+
+   Get_args(argc, argv, &n, &flush_bytes, &max_delay);
+   dest = (my_rank + 1) % comm_sz;
+   source = (my_rank + comm_sz - 1) % comm_sz;
+
+   /* One MPI message per double */
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   for (i = 0; i < n; i++) {
+      x = (double) my_rank*n + i;
+      MPI_Sendrecv_replace(&x, 1, MPI_DOUBLE, dest, 0, source, 0, comm,
+            MPI_STATUS_IGNORE);
+      direct_sum += x;
+   }
+   finish = MPI_Wtime();
+   elapsed[0] = finish - start;
+
+   /* Coalesced messages */
+   Coalesce_init(&c, comm, flush_bytes, max_delay, Handler, &info);
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   for (i = 0; i < n; i++) {
+      x = (double) my_rank*n + i;
+      Coalesce_send(&c, dest, &x, sizeof(double));
+      if (i % PROGRESS_INTERVAL == 0) Coalesce_progress(&c);
+   }
+   Coalesce_finish(&c);
+   finish = MPI_Wtime();
+   elapsed[1] = finish - start;
+   Coalesce_free(&c);
+
+   /* Coalesced requests, answered from inside the handler */
+   Coalesce_init(&c, comm, flush_bytes, max_delay, Echo_handler, &echo);
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   msg.is_reply = 0;
+   for (i = 0; i < n; i++) {
+      msg.x = (double) my_rank*n + i;
+      Coalesce_send(&c, dest, &msg, sizeof(msg));
+      if (i % PROGRESS_INTERVAL == 0) Coalesce_progress(&c);
+   }
+   Coalesce_finish(&c);
+   finish = MPI_Wtime();
+   elapsed[2] = finish - start;
+   Coalesce_free(&c);
+
+   expected = (double) source*n*n + 0.5*n*(n-1.0);
+   mine = (double) my_rank*n*n + 0.5*n*(n-1.0);
+   ok = (info.count == n && info.sum == expected && direct_sum == expected
+         && echo.requests == n && echo.replies == n
+         && echo.reply_sum == mine);
+   MPI_Reduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, 0, comm);
+
+   printf("Proc %d > Separate messages took %e seconds\n", my_rank,
+         elapsed[0]);
+   printf("Proc %d > Coalesced messages took %e seconds\n", my_rank,
+         elapsed[1]);
+   printf("Proc %d > Coalesced messages with replies took %e seconds\n",
+         my_rank, elapsed[2]);
+   fflush(stdout);
+   MPI_Barrier(comm);
+   if (my_rank == 0)
+      printf("All values received correctly:  %s\n", all_ok ? "yes" : "no");
+
+   MPI_Finalize();
+   return 0;
+}  /* main */
+
+/*-------------------------------------------------------------------
+ * Function:  Handler
+ * Purpose:   Called by the coalescing layer for each double received.
+ *            Adds it to the sum in ctx.
+ */
+void Handler(int src, void* data, int bytes, void* ctx) {
+   struct recv_info_s* info = (struct recv_info_s*) ctx;
+
+   info->sum += *((double*) data);
+   info->count++;
+}  /* Handler */
+
+/*-------------------------------------------------------------------
+ * Function:  Echo_handler
+ * Purpose:   Called by the coalescing layer for each message of the
+ *            request-reply test.  A request is sent back to src as a
+ *            reply, from inside the handler.  The values of the replies
+ *            are added to the sum in ctx.
+ */
+void Echo_handler(int src, void* data, int bytes, void* ctx) {
+   struct echo_info_s* echo = (struct echo_info_s*) ctx;
+   struct echo_msg_s msg;
+
+   memcpy(&msg, data, sizeof(msg));
+   if (msg.is_reply) {
+      echo->reply_sum += msg.x;
+      echo->replies++;
+   } else {
+      echo->requests++;
+      msg.is_reply = 1;
+      Coalesce_send(echo->c, src, &msg, sizeof(msg));
+   }
+}  /* Echo_handler */
+
+/*-------------------------------------------------------------------*/
+void Get_args(
+      int     argc           /* in  */,
+      char*   argv[]         /* in  */,
+      int*    n_p            /* out */,
+      int*    flush_bytes_p  /* out */,
+      double* max_delay_p    /* out */) {
+
+   *flush_bytes_p = 65536;
+   *max_delay_p = 1.0e-3;
+   if (my_rank == 0) {
+      if (argc < 2 || argc > 4) {
+         fprintf(stderr, "usage:  mpiexec -n <p> %s <number of doubles> "
+               "[flush bytes] [max delay in microseconds]\n", argv[0]);
+         *n_p = 0;
+      } else {
+         *n_p = strtol(argv[1], NULL, 10);
+         if (argc > 2) *flush_bytes_p = strtol(argv[2], NULL, 10);
+         if (argc > 3) *max_delay_p = 1.0e-6*strtod(argv[3], NULL);
+      }
+   }
+   MPI_Bcast(n_p, 1, MPI_INT, 0, comm);
+   MPI_Bcast(flush_bytes_p, 1, MPI_INT, 0, comm);
+   MPI_Bcast(max_delay_p, 1, MPI_DOUBLE, 0, comm);
+   if (*n_p <= 0 || *flush_bytes_p <= 0) {
+      MPI_Finalize();
+      exit(0);
+   }
+}  /* Get_args */
@@ -0,0 +1,442 @@
+/* File:     mpi_mat_mat_summa.c
+ *
+ * Purpose:  Implement parallel matrix-matrix multiplication C = AB
+ *           with the SUMMA (Scalable Universal Matrix Multiplication
+ *           Algorithm) broadcast algorithm.  The comm_sz = q*q
+ *           processes are arranged in a q x q grid, and process
+ *           (i,j) stores the b x b blocks A_ij, B_ij, and C_ij,
+ *           where b = n/q.  This version generates random matrices
+ *           A and B.  It prints out the run-time.
+ *
+ * Algorithm:
+ *    For each panel of kb columns of A (and kb rows of B):
+ *    1.  The grid column that owns the panel of A broadcasts its
+ *        b x kb piece across each grid row.
+ *    2.  The grid row that owns the panel of B broadcasts its
+ *        kb x b piece down each grid column.
+ *    3.  Each process adds the product of the two pieces into its
+ *        block of C with a cache-blocked local matrix multiply.
+ *
+ *    Only one panel of A and one panel of B are held at a time, so
+ *    each process needs storage for about 3*n*n/comm_sz + 2*b*kb
+ *    doubles.
+ *
+ * Compile:  mpicc -g -Wall -O2 -o mpi_mat_mat_summa mpi_mat_mat_summa.c -lm
+ *           add -DBLOCK=<t> to change the tile size of the local
+ *           multiply (default 64)
+ *           add -fopenmp for a hybrid MPI + OpenMP build, in which
+ *           the local multiply on each process is split among
+ *           OMP_NUM_THREADS threads
+ * Run:      mpiexec -n <number of processes> ./mpi_mat_mat_summa
+ *
+ * Input:    Order of the matrices, n
+ *           Panel width, kb
+ * Output:   Elapsed time for execution of the multiplication
+ *
+ * Notes:
+ *    1. The number of processes must be a perfect square, q*q.
+ *       q should evenly divide n, and kb should evenly divide n/q.
+ *       Blocks are sent as single messages, so b*b must be at most
+ *       INT_MAX.
+ *    2. Define DEBUG for verbose output, including a check of C
+ *       against a serial product.  Only use DEBUG with small n,
+ *       since process 0 gathers all three matrices.
+ *    3. In the hybrid build only the master thread makes MPI calls,
+ *       so MPI is initialized with MPI_THREAD_FUNNELED.  Start one
+ *       process per NUMA domain, e.g., with Open MPI
+ *
+ *          mpiexec --map-by ppr:1:numa:pe=<cores per domain> \
+ *             --bind-to core -x OMP_NUM_THREADS=<cores per domain> \
+ *             ./mpi_mat_mat_summa
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef BLOCK
+#define BLOCK 64
+#endif
+
+void Check_for_error(int local_ok, char fname[], char message[],
+      MPI_Comm comm);
+void Setup_grid(int* q_p, int* my_row_p, int* my_col_p,
+      MPI_Comm* row_comm_p, MPI_Comm* col_comm_p, int my_rank,
+      int comm_sz, MPI_Comm comm);
+void Get_dims(int* n_p, int* b_p, int* kb_p, int my_rank, int q,
+      MPI_Comm comm);
+void Allocate_arrays(double** local_A_pp, double** local_B_pp,
+      double** local_C_pp, double** A_panel_pp, double** B_panel_pp,
+      int b, int kb, MPI_Comm comm);
+void Generate_matrix(double local_A[], int b);
+void Local_gemm(double A[], double B[], double C[], int m, int n,
+      int k, int lda, int ldb, int ldc);
+void Summa(double local_A[], double local_B[], double local_C[],
+      double A_panel[], double B_panel[], int n, int b, int kb,
+      int my_row, int my_col, MPI_Comm row_comm, MPI_Comm col_comm);
+#ifdef DEBUG
+void Gather_matrix(double local_A[], double A[], int n, int b,
+      int my_rank, int q, MPI_Comm comm);
+void Check_result(double local_A[], double local_B[],
+      double local_C[], int n, int b, int my_rank, int q,
+      MPI_Comm comm);
+#endif
+
+/*-------------------------------------------------------------------*/
+int main(void) {
+   double *local_A, *local_B, *local_C;
+   double *A_panel, *B_panel;
+   int n, b, kb;
+   int my_rank, comm_sz, q, my_row, my_col;
+   MPI_Comm comm, row_comm, col_comm;
+   double start, finish, loc_elapsed, elapsed;
+
+#  ifdef _OPENMP
+   int provided;
+
+   MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &provided);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+   Check_for_error(provided >= MPI_THREAD_FUNNELED, "main",
+         "MPI library doesn't support MPI_THREAD_FUNNELED", comm);
+   if (my_rank == 0)
+      printf("Using %d processes with %d threads each\n", comm_sz,
+            omp_get_max_threads());
+#  else
+   MPI_Init(NULL, NULL);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+#  endif
+
+   Setup_grid(&q, &my_row, &my_col, &row_comm, &col_comm, my_rank,
+         comm_sz, comm);
+   Get_dims(&n, &b, &kb, my_rank, q, comm);
+   Allocate_arrays(&local_A, &local_B, &local_C, &A_panel, &B_panel,
+         b, kb, comm);
+
+   srandom(my_rank);
+   Generate_matrix(local_A, b);
+   Generate_matrix(local_B, b);
+
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   Summa(local_A, local_B, local_C, A_panel, B_panel, n, b, kb,
+         my_row, my_col, row_comm, col_comm);
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+#  ifdef DEBUG
+   Check_result(local_A, local_B, local_C, n, b, my_rank, q, comm);
+#  endif
+
+   if (my_rank == 0)
+      printf("Elapsed time = %e\n", elapsed);
+
+   free(local_A);
+   free(local_B);
+   free(local_C);
+   free(A_panel);
+   free(B_panel);
+   MPI_Comm_free(&row_comm);
+   MPI_Comm_free(&col_comm);
+   MPI_Finalize();
+   return 0;
+}  /* main */
+
+
+/*-------------------------------------------------------------------*/
+void Check_for_error(
+      int       local_ok   /* in */,
+      char      fname[]    /* in */,
+      char      message[]  /* in */,
+      MPI_Comm  comm       /* in */) {
+   int ok;
+
+   MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+   if (ok == 0) {
+      int my_rank;
+      MPI_Comm_rank(comm, &my_rank);
+      if (my_rank == 0) {
+         fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+               message);
+         fflush(stderr);
+      }
+      MPI_Finalize();
+      exit(-1);
+   }
+}  /* Check_for_error */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Setup_grid
+ * Purpose:   Arrange the processes in a q x q grid, and build one
+ *            communicator for each grid row and one for each grid
+ *            column.  Process rank r is at grid position
+ *            (r/q, r%q).  In row_comm a process' rank is its grid
+ *            column, and in col_comm it is its grid row.
+ */
+void Setup_grid(
+      int*      q_p         /* out */,
+      int*      my_row_p    /* out */,
+      int*      my_col_p    /* out */,
+      MPI_Comm* row_comm_p  /* out */,
+      MPI_Comm* col_comm_p  /* out */,
+      int       my_rank     /* in  */,
+      int       comm_sz     /* in  */,
+      MPI_Comm  comm        /* in  */) {
+   int q = (int) (sqrt((double) comm_sz) + 0.5);
+
+   Check_for_error(q*q == comm_sz, "Setup_grid",
+         "comm_sz must be a perfect square", comm);
+   *q_p = q;
+   *my_row_p = my_rank/q;
+   *my_col_p = my_rank % q;
+   MPI_Comm_split(comm, *my_row_p, *my_col_p, row_comm_p);
+   MPI_Comm_split(comm, *my_col_p, *my_row_p, col_comm_p);
+}  /* Setup_grid */
+
+
+/*-------------------------------------------------------------------*/
+void Get_dims(
+      int*      n_p        /* out */,
+      int*      b_p        /* out */,
+      int*      kb_p       /* out */,
+      int       my_rank    /* in  */,
+      int       q          /* in  */,
+      MPI_Comm  comm       /* in  */) {
+   int local_ok = 1;
+
+   if (my_rank == 0) {
+      printf("Enter the order of the matrices\n");
+      scanf("%d", n_p);
+      printf("Enter the panel width\n");
+      scanf("%d", kb_p);
+   }
+   MPI_Bcast(n_p, 1, MPI_INT, 0, comm);
+   MPI_Bcast(kb_p, 1, MPI_INT, 0, comm);
+   if (*n_p <= 0 || *n_p % q != 0 || *kb_p <= 0 ||
+         (*n_p/q) % *kb_p != 0) local_ok = 0;
+   Check_for_error(local_ok, "Get_dims",
+      "n must be divisible by sqrt(comm_sz) and kb must divide n/sqrt(comm_sz)",
+      comm);
+   /* Counts of the blocks in MPI calls are ints */
+   Check_for_error((long) (*n_p/q)*(*n_p/q) <= INT_MAX, "Get_dims",
+      "(n/sqrt(comm_sz))^2 must be at most INT_MAX", comm);
+
+   *b_p = *n_p/q;
+}  /* Get_dims */
+
+/*-------------------------------------------------------------------*/
+void Allocate_arrays(
+      double**  local_A_pp  /* out */,
+      double**  local_B_pp  /* out */,
+      double**  local_C_pp  /* out */,
+      double**  A_panel_pp  /* out */,
+      double**  B_panel_pp  /* out */,
+      int       b           /* in  */,
+      int       kb          /* in  */,
+      MPI_Comm  comm        /* in  */) {
+
+   int local_ok = 1;
+
+   *local_A_pp = malloc((size_t) b*b*sizeof(double));
+   *local_B_pp = malloc((size_t) b*b*sizeof(double));
+   *local_C_pp = malloc((size_t) b*b*sizeof(double));
+   *A_panel_pp = malloc((size_t) b*kb*sizeof(double));
+   *B_panel_pp = malloc((size_t) kb*b*sizeof(double));
+
+   if (*local_A_pp == NULL || *local_B_pp == NULL ||
+         *local_C_pp == NULL || *A_panel_pp == NULL ||
+         *B_panel_pp == NULL) local_ok = 0;
+   Check_for_error(local_ok, "Allocate_arrays",
+         "Can't allocate local arrays", comm);
+}  /* Allocate_arrays */
+
+/*-------------------------------------------------------------------*/
+void Generate_matrix(
+      double local_A[]  /* out */,
+      int    b          /* in  */) {
+   int i, j;
+
+   for (i = 0; i < b; i++)
+      for (j = 0; j < b; j++)
+         local_A[i*b + j] = ((double) random())/((double) RAND_MAX);
+}  /* Generate_matrix */
+
+/*-------------------------------------------------------------------
+ * Function:  Local_gemm
+ * Purpose:   C += A*B, where A is m x k, B is k x n, and C is m x n.
+ *            All three are stored by rows with leading dimensions
+ *            lda, ldb, ldc.  The loops are tiled by BLOCK so that
+ *            the tiles of B and C stay in cache, and the innermost
+ *            loop runs along rows of B and C with unit stride.
+ *            In the hybrid build the row tiles of C are split among
+ *            the threads, so no two threads update the same entry.
+ */
+void Local_gemm(
+      double  A[]  /* in     */,
+      double  B[]  /* in     */,
+      double  C[]  /* in/out */,
+      int     m    /* in     */,
+      int     n    /* in     */,
+      int     k    /* in     */,
+      int     lda  /* in     */,
+      int     ldb  /* in     */,
+      int     ldc  /* in     */) {
+   int ii, jj, kk, i, j, p;
+   int i_end, j_end, p_end;
+   double a_ip;
+
+#  ifdef _OPENMP
+#  pragma omp parallel for default(none) \
+      private(ii, jj, kk, i, j, p, i_end, j_end, p_end, a_ip) \
+      shared(A, B, C, m, n, k, lda, ldb, ldc) schedule(static)
+#  endif
+   for (ii = 0; ii < m; ii += BLOCK) {
+      i_end = (ii + BLOCK < m) ? ii + BLOCK : m;
+      for (kk = 0; kk < k; kk += BLOCK) {
+         p_end = (kk + BLOCK < k) ? kk + BLOCK : k;
+         for (jj = 0; jj < n; jj += BLOCK) {
+            j_end = (jj + BLOCK < n) ? jj + BLOCK : n;
+            for (i = ii; i < i_end; i++)
+               for (p = kk; p < p_end; p++) {
+                  a_ip = A[i*lda + p];
+                  for (j = jj; j < j_end; j++)
+                     C[i*ldc + j] += a_ip*B[p*ldb + j];
+               }
+         }
+      }
+   }
+}  /* Local_gemm */
+
+/*-------------------------------------------------------------------
+ * Function:  Summa
+ * Purpose:   Compute C = AB using SUMMA with panel width kb
+ * In args:   local_A, local_B, n, b, kb, my_row, my_col, row_comm,
+ *            col_comm
+ * Out arg:   local_C
+ * Scratch:   A_panel (b x kb), B_panel (kb x b)
+ */
+void Summa(
+      double    local_A[]  /* in      */,
+      double    local_B[]  /* in      */,
+      double    local_C[]  /* out     */,
+      double    A_panel[]  /* scratch */,
+      double    B_panel[]  /* scratch */,
+      int       n          /* in      */,
+      int       b          /* in      */,
+      int       kb         /* in      */,
+      int       my_row     /* in      */,
+      int       my_col     /* in      */,
+      MPI_Comm  row_comm   /* in      */,
+      MPI_Comm  col_comm   /* in      */) {
+   int k, root, offset, i;
+
+   memset(local_C, 0, (size_t) b*b*sizeof(double));
+
+   for (k = 0; k < n; k += kb) {
+      root = k/b;      /* Grid column owning A panel, grid row owning B */
+      offset = k % b;  /* Offset of the panel within the owner's block  */
+
+      /* Copy the kb columns of A_i,root into a contiguous panel */
+      if (my_col == root)
+         for (i = 0; i < b; i++)
+            memcpy(A_panel + i*kb, local_A + i*b + offset,
+                  kb*sizeof(double));
+      MPI_Bcast(A_panel, b*kb, MPI_DOUBLE, root, row_comm);
+
+      /* The kb rows of B_root,j are already contiguous */
+      if (my_row == root)
+         memcpy(B_panel, local_B + offset*b,
+               (size_t) kb*b*sizeof(double));
+      MPI_Bcast(B_panel, kb*b, MPI_DOUBLE, root, col_comm);
+
+      Local_gemm(A_panel, B_panel, local_C, b, b, kb, kb, b, b);
+   }
+}  /* Summa */
+
+#ifdef DEBUG
+/*-------------------------------------------------------------------
+ * Function:  Gather_matrix
+ * Purpose:   Collect the blocks of a distributed matrix into the
+ *            n x n matrix A on process 0
+ */
+void Gather_matrix(
+      double    local_A[]  /* in  */,
+      double    A[]        /* out */,
+      int       n          /* in  */,
+      int       b          /* in  */,
+      int       my_rank    /* in  */,
+      int       q          /* in  */,
+      MPI_Comm  comm       /* in  */) {
+   double* blk;
+   int proc, i;
+
+   if (my_rank != 0) {
+      MPI_Send(local_A, b*b, MPI_DOUBLE, 0, 0, comm);
+      return;
+   }
+   blk = malloc((size_t) b*b*sizeof(double));
+   for (proc = 0; proc < q*q; proc++) {
+      if (proc == 0)
+         memcpy(blk, local_A, (size_t) b*b*sizeof(double));
+      else
+         MPI_Recv(blk, b*b, MPI_DOUBLE, proc, 0, comm,
+               MPI_STATUS_IGNORE);
+      for (i = 0; i < b; i++)
+         memcpy(A + ((size_t) (proc/q)*b + i)*n + (proc % q)*b, blk + i*b,
+               b*sizeof(double));
+   }
+   free(blk);
+}  /* Gather_matrix */
+
+/*-------------------------------------------------------------------
+ * Function:  Check_result
+ * Purpose:   Gather A, B, and C onto process 0 and compare C with a
+ *            serial product
+ */
+void Check_result(
+      double    local_A[]  /* in */,
+      double    local_B[]  /* in */,
+      double    local_C[]  /* in */,
+      int       n          /* in */,
+      int       b          /* in */,
+      int       my_rank    /* in */,
+      int       q          /* in */,
+      MPI_Comm  comm       /* in */) {
+   double *A = NULL, *B = NULL, *C = NULL, sum, max_err = 0.0;
+   int i, j, k;
+
+   if (my_rank == 0) {
+      A = malloc((size_t) n*n*sizeof(double));
+      B = malloc((size_t) n*n*sizeof(double));
+      C = malloc((size_t) n*n*sizeof(double));
+   }
+   Gather_matrix(local_A, A, n, b, my_rank, q, comm);
+   Gather_matrix(local_B, B, n, b, my_rank, q, comm);
+   Gather_matrix(local_C, C, n, b, my_rank, q, comm);
+   if (my_rank != 0) return;
+
+   for (i = 0; i < n; i++)
+      for (j = 0; j < n; j++) {
+         sum = 0.0;
+         for (k = 0; k < n; k++)
+            sum += A[i*n + k]*B[k*n + j];
+         if (fabs(sum - C[i*n + j]) > max_err)
+            max_err = fabs(sum - C[i*n + j]);
+      }
+   printf("Max difference from serial product = %e\n", max_err);
+
+   free(A);
+   free(B);
+   free(C);
+}  /* Check_result */
+#endif
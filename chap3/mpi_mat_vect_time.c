@@ -7,23 +7,92 @@
  *           generates a random matrix A and a random vector x.
  *           It prints out the run-time.
  *
+ *           With -DGRID_2D the matrix has a two-dimensional block
+ *           distribution instead.  The comm_sz = q*q processes are
+ *           arranged in a q x q grid, and process (i,j) stores the
+ *           (m/q) x (n/q) block A_ij.  Block j of x and block i of
+ *           y live on the diagonal processes (j,j) and (i,i).
+ *           Diagonal process (j,j) broadcasts x_j down grid column j,
+ *           each process computes the partial product A_ij * x_j,
+ *           and the partial products are summed across grid row i
+ *           onto process (i,i).  So each process sends and receives
+ *           O(n/q + m/q) doubles instead of O(n).
+ *
+ *           With -DOVERLAP the block row product is also timed with
+ *           two versions that overlap communication with computation,
+ *           and their results are compared with Mat_vect_mult's:
+ *
+ *           1.  Ibcast:  each block of x is broadcast with its own
+ *               MPI_Ibcast.  The process multiplies with its own
+ *               block first, and then with each of the other blocks
+ *               as soon as its broadcast completes.
+ *           2.  Ring:  blocks of x are passed around a ring of
+ *               processes with MPI_Isend/MPI_Irecv.  Each block is
+ *               multiplied as soon as it arrives, while the next
+ *               block is in transit.
+ *
+ *           A single MPI_Iallgather would only overlap the gather with
+ *           the product with the process' own block, 1/comm_sz of the
+ *           work, since none of the other blocks can be used until
+ *           the whole gather completes.
+ *
+ *           With -fopenmp the build is hybrid MPI + OpenMP:  within
+ *           each process the local rows of A are split among
+ *           OMP_NUM_THREADS threads, as in Omp_mat_vect in
+ *           chap5/omp_mat_vect.c.  Compared to one single-threaded
+ *           process per core, the collectives involve a factor of
+ *           OMP_NUM_THREADS fewer processes and messages.
+ *
  * Compile:  mpicc -g -Wall -o mpi_mat_vect_time mpi_mat_vect_time.c
+ *           mpicc -g -Wall -DGRID_2D -o mpi_mat_vect_2d \
+ *              mpi_mat_vect_time.c -lm
+ *           mpicc -g -Wall -DOVERLAP -o mpi_mat_vect_overlap \
+ *              mpi_mat_vect_time.c -lm
+ *           add -fopenmp to any of these for a hybrid build
  * Run:      mpiexec -n <number of processes> ./mpi_mat_vect_time
  *
  * Input:    Dimensions of the matrix (m = number of rows, n
  *              = number of columns)
- * Output:   Elapsed time for execution of the multiplication
+ * Output:   Elapsed time for execution of the multiplication.  With
+ *           -DOVERLAP, also the elapsed time of each overlapped
+ *           version and the largest difference of its product from
+ *           Mat_vect_mult's.
  *
  * Notes:     
- *    1. Number of processes should evenly divide both m and n
+ *    1. Number of processes should evenly divide both m and n.
+ *       With -DGRID_2D the number of processes must be a perfect
+ *       square, q*q, and q should evenly divide both m and n.
  *    2. Define DEBUG for verbose output, including the product
- *       vector y
+ *       vector y.  With -DGRID_2D, DEBUG also checks y against a
+ *       serial product.
+ *    3. GRID_2D and OVERLAP can't both be defined.
+ *    4. In the hybrid build only the master thread makes MPI calls,
+ *       so MPI is initialized with MPI_THREAD_FUNNELED.  Start one
+ *       process per NUMA domain, e.g., with Open MPI
+ *
+ *          mpiexec --map-by ppr:1:numa:pe=<cores per domain> \
+ *             --bind-to core -x OMP_NUM_THREADS=<cores per domain> \
+ *             ./mpi_mat_vect_time
  *
  * IPP:  Section 3.6.2 (pp. 122 and ff.)
  */
 #include <stdio.h>
 #include <stdlib.h>
 #include <mpi.h>
+#if defined(GRID_2D) || defined(OVERLAP)
+#include <math.h>
+#endif
+#ifdef GRID_2D
+#define DIMS_DIVISOR "sqrt(comm_sz)"
+#else
+#define DIMS_DIVISOR "comm_sz"
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(GRID_2D) && defined(OVERLAP)
+#error "GRID_2D and OVERLAP can't both be defined"
+#endif
 
 void Check_for_error(int local_ok, char fname[], char message[], 
       MPI_Comm comm);
@@ -45,6 +114,35 @@ void Print_vector(char title[], double local_vec[], int n,
 void Mat_vect_mult(double local_A[], double local_x[], 
       double local_y[], int local_m, int n, int local_n, 
       MPI_Comm comm);
+#ifdef OVERLAP
+void Block_mult(double local_A[], double x_blk[], double local_y[],
+      int local_m, int n, int local_n, int blk);
+void Mat_vect_mult_ibcast(double local_A[], double local_x[],
+      double local_y[], double x[], MPI_Request requests[],
+      int local_m, int n, int local_n, int my_rank, int comm_sz,
+      MPI_Comm comm);
+void Mat_vect_mult_ring(double local_A[], double local_x[],
+      double local_y[], double blk_bufs[], int local_m, int n,
+      int local_n, int my_rank, int comm_sz, MPI_Comm comm);
+double Max_diff(double local_y[], double local_z[], int local_m,
+      MPI_Comm comm);
+void Time_overlap(double local_A[], double local_x[], double local_y[],
+      int local_m, int n, int local_n, int my_rank, int comm_sz,
+      MPI_Comm comm);
+#endif
+#ifdef GRID_2D
+void Setup_grid(int* q_p, int* my_row_p, int* my_col_p,
+      MPI_Comm* row_comm_p, MPI_Comm* col_comm_p, int my_rank,
+      int comm_sz, MPI_Comm comm);
+void Mat_vect_mult_2d(double local_A[], double local_x[],
+      double local_y[], double part_y[], int local_m, int local_n,
+      int my_row, int my_col, MPI_Comm row_comm, MPI_Comm col_comm);
+#ifdef DEBUG
+void Check_result(double local_A[], double local_x[], double local_y[],
+      int m, int local_m, int n, int local_n, int my_rank, int q,
+      MPI_Comm comm);
+#endif
+#endif
 
 /*-------------------------------------------------------------------*/
 int main(void) {
@@ -55,12 +153,48 @@ int main(void) {
    int my_rank, comm_sz;
    MPI_Comm comm;
    double start, finish, loc_elapsed, elapsed;
+#  ifdef GRID_2D
+   double* part_y;
+   int q, my_row, my_col;
+   MPI_Comm row_comm, col_comm;
+#  endif
+
+#  ifdef _OPENMP
+   int provided;
 
+   MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &provided);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+   Check_for_error(provided >= MPI_THREAD_FUNNELED, "main",
+         "MPI library doesn't support MPI_THREAD_FUNNELED", comm);
+   if (my_rank == 0)
+      printf("Using %d processes with %d threads each\n", comm_sz,
+            omp_get_max_threads());
+#  else
    MPI_Init(NULL, NULL);
    comm = MPI_COMM_WORLD;
    MPI_Comm_size(comm, &comm_sz);
    MPI_Comm_rank(comm, &my_rank);
+#  endif
+
+#  ifdef GRID_2D
+   Setup_grid(&q, &my_row, &my_col, &row_comm, &col_comm, my_rank,
+         comm_sz, comm);
+   /* Each process has an (m/q) x (n/q) block of A */
+   Get_dims(&m, &local_m, &n, &local_n, my_rank, q, comm);
+   Allocate_arrays(&local_A, &local_x, &local_y, local_m, local_n,
+         local_n, comm);
+   part_y = malloc(local_m*sizeof(double));
+   Check_for_error(part_y != NULL, "main",
+         "Can't allocate partial product", comm);
 
+   srandom(my_rank);
+   Generate_matrix(local_A, local_m, local_n);
+   /* Only the diagonal processes own blocks of x */
+   if (my_row == my_col)
+      Generate_vector(local_x, local_n);
+#  else
    Get_dims(&m, &local_m, &n, &local_n, my_rank, comm_sz, comm);
    Allocate_arrays(&local_A, &local_x, &local_y, local_m, n, local_n, comm);
 // Read_matrix("A", local_A, m, local_m, n, my_rank, comm);
@@ -73,25 +207,45 @@ int main(void) {
    Generate_vector(local_x, local_n);
 #  ifdef DEBUG
    Print_vector("x", local_x, n, local_n, my_rank, comm);
+#  endif
 #  endif
 
    MPI_Barrier(comm);
    start = MPI_Wtime();
+#  ifdef GRID_2D
+   Mat_vect_mult_2d(local_A, local_x, local_y, part_y, local_m, local_n,
+         my_row, my_col, row_comm, col_comm);
+#  else
    Mat_vect_mult(local_A, local_x, local_y, local_m, n, local_n, comm);
+#  endif
    finish = MPI_Wtime();
    loc_elapsed = finish-start;
    MPI_Reduce(&loc_elapsed, &elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
 
 #  ifdef DEBUG
+#  ifdef GRID_2D
+   Check_result(local_A, local_x, local_y, m, local_m, n, local_n,
+         my_rank, q, comm);
+#  else
    Print_vector("y", local_y, m, local_m, my_rank, comm);
+#  endif
 #  endif
 
    if (my_rank == 0)
       printf("Elapsed time = %e\n", elapsed);
+#  ifdef OVERLAP
+   Time_overlap(local_A, local_x, local_y, local_m, n, local_n, my_rank,
+         comm_sz, comm);
+#  endif
 
    free(local_A);
    free(local_x);
    free(local_y);
+#  ifdef GRID_2D
+   free(part_y);
+   MPI_Comm_free(&row_comm);
+   MPI_Comm_free(&col_comm);
+#  endif
    MPI_Finalize();
    return 0;
 }  /* main */
@@ -142,7 +296,7 @@ void Get_dims(
    if (*m_p <= 0 || *n_p <= 0 || *m_p % comm_sz != 0 
          || *n_p % comm_sz != 0) local_ok = 0;
    Check_for_error(local_ok, "Get_dims",
-      "m and n must be positive and evenly divisible by comm_sz", 
+      "m and n must be positive and evenly divisible by " DIMS_DIVISOR,
       comm);
 
    *local_m_p = *m_p/comm_sz;
@@ -165,8 +319,8 @@ void Allocate_arrays(
    *local_x_pp = malloc(local_n*sizeof(double));
    *local_y_pp = malloc(local_m*sizeof(double));
 
-   if (*local_A_pp == NULL || local_x_pp == NULL ||
-         local_y_pp == NULL) local_ok = 0;
+   if (*local_A_pp == NULL || *local_x_pp == NULL ||
+         *local_y_pp == NULL) local_ok = 0;
    Check_for_error(local_ok, "Allocate_arrays",
          "Can't allocate local arrays", comm);
 }  /* Allocate_arrays */
@@ -342,6 +496,10 @@ void Mat_vect_mult(
    MPI_Allgather(local_x, local_n, MPI_DOUBLE,
          x, local_n, MPI_DOUBLE, comm);
 
+#  ifdef _OPENMP
+#  pragma omp parallel for default(none) private(local_i, j) \
+      shared(local_A, local_y, x, local_m, n)
+#  endif
    for (local_i = 0; local_i < local_m; local_i++) {
       local_y[local_i] = 0.0;
       for (j = 0; j < n; j++)
@@ -349,3 +507,356 @@ void Mat_vect_mult(
    }
    free(x);
 }  /* Mat_vect_mult */
+
+#ifdef OVERLAP
+/*-------------------------------------------------------------------
+ * Function:  Block_mult
+ * Purpose:   Add the product of the columns of local_A belonging to
+ *            block blk of x into local_y:
+ *
+ *               local_y += local_A[:, blk*local_n : (blk+1)*local_n]
+ *                          * x_blk
+ */
+void Block_mult(
+      double    local_A[]  /* in     */,
+      double    x_blk[]    /* in     */,
+      double    local_y[]  /* in/out */,
+      int       local_m    /* in     */,
+      int       n          /* in     */,
+      int       local_n    /* in     */,
+      int       blk        /* in     */) {
+   int local_i, j;
+   double* row;
+   double temp;
+
+#  ifdef _OPENMP
+#  pragma omp parallel for default(none) private(local_i, j, row, temp) \
+      shared(local_A, x_blk, local_y, local_m, n, local_n, blk)
+#  endif
+   for (local_i = 0; local_i < local_m; local_i++) {
+      row = local_A + local_i*n + blk*local_n;
+      temp = 0.0;
+      for (j = 0; j < local_n; j++)
+         temp += row[j]*x_blk[j];
+      local_y[local_i] += temp;
+   }
+}  /* Block_mult */
+
+/*-------------------------------------------------------------------
+ * Function:  Mat_vect_mult_ibcast
+ * Purpose:   Multiply by broadcasting each block of x with its own
+ *            MPI_Ibcast.  The product with the process' own block
+ *            is computed while the broadcasts are in flight, and the
+ *            product with each other block as soon as its broadcast
+ *            completes.
+ * Scratch:   x:  n doubles
+ *            requests:  comm_sz requests
+ * Note:      Every process starts the broadcasts in the same order,
+ *            as MPI requires for nonblocking collectives.
+ */
+void Mat_vect_mult_ibcast(
+      double       local_A[]   /* in      */,
+      double       local_x[]   /* in      */,
+      double       local_y[]   /* out     */,
+      double       x[]         /* scratch */,
+      MPI_Request  requests[]  /* scratch */,
+      int          local_m     /* in      */,
+      int          n           /* in      */,
+      int          local_n     /* in      */,
+      int          my_rank     /* in      */,
+      int          comm_sz     /* in      */,
+      MPI_Comm     comm        /* in      */) {
+   int local_i, j, blk, done;
+
+   for (j = 0; j < local_n; j++)
+      x[my_rank*local_n + j] = local_x[j];
+   for (blk = 0; blk < comm_sz; blk++)
+      MPI_Ibcast(x + blk*local_n, local_n, MPI_DOUBLE, blk, comm,
+            &requests[blk]);
+
+   for (local_i = 0; local_i < local_m; local_i++)
+      local_y[local_i] = 0.0;
+   Block_mult(local_A, local_x, local_y, local_m, n, local_n, my_rank);
+
+   for (done = 0; done < comm_sz; done++) {
+      MPI_Waitany(comm_sz, requests, &blk, MPI_STATUS_IGNORE);
+      if (blk != my_rank)
+         Block_mult(local_A, x + blk*local_n, local_y, local_m, n,
+               local_n, blk);
+   }
+}  /* Mat_vect_mult_ibcast */
+
+/*-------------------------------------------------------------------
+ * Function:  Mat_vect_mult_ring
+ * Purpose:   Multiply by passing the blocks of x around a ring.  At
+ *            stage s a process holds the block that belongs to
+ *            process (my_rank - s) mod comm_sz:  it forwards that
+ *            block to its successor while it multiplies with it.
+ * Scratch:   blk_bufs:  2*local_n doubles, used as a double buffer
+ */
+void Mat_vect_mult_ring(
+      double    local_A[]  /* in      */,
+      double    local_x[]  /* in      */,
+      double    local_y[]  /* out     */,
+      double    blk_bufs[] /* scratch */,
+      int       local_m    /* in      */,
+      int       n          /* in      */,
+      int       local_n    /* in      */,
+      int       my_rank    /* in      */,
+      int       comm_sz    /* in      */,
+      MPI_Comm  comm       /* in      */) {
+   int local_i, stage, blk;
+   int succ = (my_rank + 1) % comm_sz;
+   int pred = (my_rank + comm_sz - 1) % comm_sz;
+   double *curr = local_x, *next = blk_bufs, *tmp;
+   MPI_Request requests[2];
+
+   for (local_i = 0; local_i < local_m; local_i++)
+      local_y[local_i] = 0.0;
+
+   for (stage = 0; stage < comm_sz; stage++) {
+      blk = (my_rank - stage + comm_sz) % comm_sz;
+      if (stage < comm_sz-1) {
+         MPI_Irecv(next, local_n, MPI_DOUBLE, pred, 0, comm,
+               &requests[0]);
+         MPI_Isend(curr, local_n, MPI_DOUBLE, succ, 0, comm,
+               &requests[1]);
+      }
+      Block_mult(local_A, curr, local_y, local_m, n, local_n, blk);
+      if (stage < comm_sz-1) {
+         MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+         /* Don't overwrite local_x:  alternate between the two */
+         /* halves of blk_bufs                                   */
+         tmp = (next == blk_bufs) ? blk_bufs + local_n : blk_bufs;
+         curr = next;
+         next = tmp;
+      }
+   }
+}  /* Mat_vect_mult_ring */
+
+/*-------------------------------------------------------------------
+ * Function:  Max_diff
+ * Purpose:   Find max |y[i] - z[i]| over the distributed vectors
+ * Return:    The max on process 0
+ */
+double Max_diff(
+      double    local_y[]  /* in */,
+      double    local_z[]  /* in */,
+      int       local_m    /* in */,
+      MPI_Comm  comm       /* in */) {
+   double local_max = 0.0, max = 0.0;
+   int local_i;
+
+   for (local_i = 0; local_i < local_m; local_i++)
+      if (fabs(local_y[local_i] - local_z[local_i]) > local_max)
+         local_max = fabs(local_y[local_i] - local_z[local_i]);
+   MPI_Reduce(&local_max, &max, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+   return max;
+}  /* Max_diff */
+
+/*-------------------------------------------------------------------
+ * Function:  Time_overlap
+ * Purpose:   Time Mat_vect_mult_ibcast and Mat_vect_mult_ring, and
+ *            compare their products with local_y, the product
+ *            computed by Mat_vect_mult
+ */
+void Time_overlap(
+      double    local_A[]  /* in */,
+      double    local_x[]  /* in */,
+      double    local_y[]  /* in */,
+      int       local_m    /* in */,
+      int       n          /* in */,
+      int       local_n    /* in */,
+      int       my_rank    /* in */,
+      int       comm_sz    /* in */,
+      MPI_Comm  comm       /* in */) {
+   double *local_z, *x, *blk_bufs;
+   MPI_Request* requests;
+   double start, finish, loc_elapsed, elapsed, diff;
+   int local_ok = 1;
+
+   local_z = malloc(local_m*sizeof(double));
+   x = malloc(n*sizeof(double));
+   blk_bufs = malloc(2*local_n*sizeof(double));
+   requests = malloc(comm_sz*sizeof(MPI_Request));
+   if (local_z == NULL || x == NULL || blk_bufs == NULL ||
+         requests == NULL) local_ok = 0;
+   Check_for_error(local_ok, "Time_overlap",
+         "Can't allocate temporary arrays", comm);
+
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   Mat_vect_mult_ibcast(local_A, local_x, local_z, x, requests, local_m,
+         n, local_n, my_rank, comm_sz, comm);
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+   diff = Max_diff(local_y, local_z, local_m, comm);
+   if (my_rank == 0)
+      printf("Ibcast elapsed time = %e, max difference = %e\n",
+            elapsed, diff);
+
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   Mat_vect_mult_ring(local_A, local_x, local_z, blk_bufs, local_m, n,
+         local_n, my_rank, comm_sz, comm);
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+   diff = Max_diff(local_y, local_z, local_m, comm);
+   if (my_rank == 0)
+      printf("Ring elapsed time = %e, max difference = %e\n",
+            elapsed, diff);
+
+   free(local_z);
+   free(x);
+   free(blk_bufs);
+   free(requests);
+}  /* Time_overlap */
+#endif
+
+#ifdef GRID_2D
+/*-------------------------------------------------------------------
+ * Function:  Setup_grid
+ * Purpose:   Arrange the processes in a q x q grid, and build one
+ *            communicator for each grid row and one for each grid
+ *            column.  Process rank r is at grid position
+ *            (r/q, r%q).  In row_comm a process' rank is its grid
+ *            column, and in col_comm it is its grid row.
+ */
+void Setup_grid(
+      int*      q_p         /* out */,
+      int*      my_row_p    /* out */,
+      int*      my_col_p    /* out */,
+      MPI_Comm* row_comm_p  /* out */,
+      MPI_Comm* col_comm_p  /* out */,
+      int       my_rank     /* in  */,
+      int       comm_sz     /* in  */,
+      MPI_Comm  comm        /* in  */) {
+   int q = (int) (sqrt((double) comm_sz) + 0.5);
+
+   Check_for_error(q*q == comm_sz, "Setup_grid",
+         "comm_sz must be a perfect square", comm);
+   *q_p = q;
+   *my_row_p = my_rank/q;
+   *my_col_p = my_rank % q;
+   MPI_Comm_split(comm, *my_row_p, *my_col_p, row_comm_p);
+   MPI_Comm_split(comm, *my_col_p, *my_row_p, col_comm_p);
+}  /* Setup_grid */
+
+/*-------------------------------------------------------------------
+ * Function:  Mat_vect_mult_2d
+ * Purpose:   Compute y = Ax with A distributed by 2d blocks.  On
+ *            entry x_j is on process (j,j).  On return y_i is on
+ *            process (i,i).  On other processes local_x is
+ *            overwritten with x_{my_col} and local_y is unchanged.
+ * Scratch:   part_y
+ */
+void Mat_vect_mult_2d(
+      double    local_A[]  /* in     */,
+      double    local_x[]  /* in/out */,
+      double    local_y[]  /* out    */,
+      double    part_y[]   /* scratch */,
+      int       local_m    /* in     */,
+      int       local_n    /* in     */,
+      int       my_row     /* in     */,
+      int       my_col     /* in     */,
+      MPI_Comm  row_comm   /* in     */,
+      MPI_Comm  col_comm   /* in     */) {
+   int local_i, j;
+
+   /* x_j is on the diagonal process, which has rank my_col */
+   /* in col_comm                                             */
+   MPI_Bcast(local_x, local_n, MPI_DOUBLE, my_col, col_comm);
+
+#  ifdef _OPENMP
+#  pragma omp parallel for default(none) private(local_i, j) \
+      shared(local_A, local_x, part_y, local_m, local_n)
+#  endif
+   for (local_i = 0; local_i < local_m; local_i++) {
+      part_y[local_i] = 0.0;
+      for (j = 0; j < local_n; j++)
+         part_y[local_i] += local_A[local_i*local_n+j]*local_x[j];
+   }
+
+   /* y_i goes to the diagonal process, which has rank my_row */
+   /* in row_comm                                               */
+   MPI_Reduce(part_y, local_y, local_m, MPI_DOUBLE, MPI_SUM, my_row,
+         row_comm);
+}  /* Mat_vect_mult_2d */
+
+#ifdef DEBUG
+/*-------------------------------------------------------------------
+ * Function:  Check_result
+ * Purpose:   Gather A, x, and y onto process 0, print y, and compare
+ *            it with a serial product
+ */
+void Check_result(
+      double    local_A[]  /* in */,
+      double    local_x[]  /* in */,
+      double    local_y[]  /* in */,
+      int       m          /* in */,
+      int       local_m    /* in */,
+      int       n          /* in */,
+      int       local_n    /* in */,
+      int       my_rank    /* in */,
+      int       q          /* in */,
+      MPI_Comm  comm       /* in */) {
+   double *A, *x, *y, *blk, sum, max_err = 0.0;
+   int proc, row, col, i, j;
+
+   if (my_rank != 0) {
+      MPI_Send(local_A, local_m*local_n, MPI_DOUBLE, 0, 0, comm);
+      if (my_rank/q == my_rank % q) {
+         MPI_Send(local_x, local_n, MPI_DOUBLE, 0, 0, comm);
+         MPI_Send(local_y, local_m, MPI_DOUBLE, 0, 0, comm);
+      }
+      return;
+   }
+
+   A = malloc(m*n*sizeof(double));
+   x = malloc(n*sizeof(double));
+   y = malloc(m*sizeof(double));
+   blk = malloc(local_m*local_n*sizeof(double));
+   for (proc = 0; proc < q*q; proc++) {
+      row = proc/q;
+      col = proc % q;
+      if (proc == 0) {
+         for (i = 0; i < local_m*local_n; i++) blk[i] = local_A[i];
+         for (j = 0; j < local_n; j++) x[j] = local_x[j];
+         for (i = 0; i < local_m; i++) y[i] = local_y[i];
+      } else {
+         MPI_Recv(blk, local_m*local_n, MPI_DOUBLE, proc, 0, comm,
+               MPI_STATUS_IGNORE);
+         if (row == col) {
+            MPI_Recv(x + col*local_n, local_n, MPI_DOUBLE, proc, 0,
+                  comm, MPI_STATUS_IGNORE);
+            MPI_Recv(y + row*local_m, local_m, MPI_DOUBLE, proc, 0,
+                  comm, MPI_STATUS_IGNORE);
+         }
+      }
+      for (i = 0; i < local_m; i++)
+         for (j = 0; j < local_n; j++)
+            A[(row*local_m + i)*n + col*local_n + j] = blk[i*local_n + j];
+   }
+
+   printf("\nThe vector y\n");
+   for (i = 0; i < m; i++)
+      printf("%f ", y[i]);
+   printf("\n");
+
+   for (i = 0; i < m; i++) {
+      sum = 0.0;
+      for (j = 0; j < n; j++)
+         sum += A[i*n + j]*x[j];
+      if (fabs(sum - y[i]) > max_err) max_err = fabs(sum - y[i]);
+   }
+   printf("Max difference from serial product = %e\n", max_err);
+
+   free(A);
+   free(x);
+   free(y);
+   free(blk);
+}  /* Check_result */
+#endif
+#endif
@@ -0,0 +1,447 @@
+/* File:     mpi_msg_bench.c
+ * Purpose:  Measure the latency and bandwidth of MPI communication
+ *           over a sweep of message sizes.  This extends the
+ *           comparison in mpi_many_msgs.c to a suite of tests:
+ *
+ *           p  pingpong:  one-way time for a message bounced
+ *                         between processes 0 and 1
+ *           s  stream:    process 0 sends a window of WINDOW
+ *                         messages to process 1 with MPI_Isend
+ *           b  bidir:     processes 0 and 1 each send a window of
+ *                         messages to the other at the same time
+ *           e  eager:     time for MPI_Send on process 0 to return
+ *                         when process 1 posts its receive late.
+ *                         Sends that return before the receive is
+ *                         posted use the eager protocol, the others
+ *                         use rendezvous.
+ *           a  aggregate: time to move AGG_BYTES from 0 to 1 as
+ *                         AGG_BYTES/bytes messages of size bytes
+ *           c  collectives: MPI_Bcast, MPI_Reduce, MPI_Allgather,
+ *                         and MPI_Alltoall on all processes.  For
+ *                         Allgather and Alltoall bytes is the size
+ *                         of the block sent to each process.
+ *
+ * Compile:  mpicc -g -Wall -O2 -o mpi_msg_bench mpi_msg_bench.c -lm
+ * Run:      mpiexec -n <p> mpi_msg_bench [max bytes] [reps] [tests]
+ *              max bytes:  largest message size, default 4194304
+ *              reps:       repetitions of each measurement,
+ *                          default 10
+ *              tests:      letters of the tests to run, default
+ *                          "psbeac"
+ *
+ * Input:    none
+ * Output:   One line of comma-separated values per test and message
+ *           size, preceded by a header line:
+ *
+ *              test,bytes,procs,reps,min_us,median_us,mean_us,
+ *              max_us,stddev_us,MB_per_s
+ *
+ *           Times are per message (per operation for collectives).
+ *           The bandwidth uses the median time.  The eager test is
+ *           followed by a line with test = eager_limit giving the
+ *           largest size for which MPI_Send returned early.
+ *
+ * Notes:
+ * 1.  p must be at least 2.  Only processes 0 and 1 take part in
+ *     the point-to-point tests.
+ * 2.  Message sizes are 0 and the powers of 2 up to max bytes,
+ *     which can be at most INT_MAX/2.  Each repetition times a batch
+ *     of messages, so the statistics are over reps batch averages.
+ * 3.  Each process allocates two buffers of max bytes times the
+ *     largest of:  1 for the p and e tests, WINDOW for the s and b
+ *     tests, and comm_sz for the c test (Allgather and Alltoall).
+ *     Each buffer is at least AGG_BYTES.
+ *
+ * IPP:      Section 3.5 (pp. 116 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <mpi.h>
+
+#define WINDOW 64
+#define AGG_BYTES 1048576
+#define AGG_MIN_BYTES 8
+#define EAGER_DELAY 1.0e-3   /* seconds process 1 waits before Recv */
+
+int      my_rank;
+int      comm_sz;
+MPI_Comm comm;
+
+void Get_args(int argc, char* argv[], int* max_bytes_p, int* reps_p,
+      char tests[]);
+int  Batch_size(int bytes);
+void Print_row(char test[], int bytes, int procs, double times[],
+      int reps, double bytes_per_msg);
+int  Compare(const void* a_p, const void* b_p);
+void Pair_sync(void);
+void Delay(double seconds);
+void Pingpong(char buf[], int max_bytes, int reps, double times[]);
+void Stream(char buf[], int max_bytes, int reps, double times[]);
+void Bidir(char buf[], char buf2[], int max_bytes, int reps,
+      double times[]);
+void Eager(char buf[], int max_bytes, int reps, double times[]);
+void Aggregate(char buf[], int reps, double times[]);
+void Collectives(char buf[], char buf2[], int max_bytes, int reps,
+      double times[]);
+
+int main(int argc, char* argv[]) {
+   int    max_bytes, reps;
+   char   tests[16];
+   char   *buf, *buf2;
+   double *times;
+   long   buf_sz;
+
+   MPI_Init(&argc, &argv);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+
+   Get_args(argc, argv, &max_bytes, &reps, tests);
+
+   /* Big enough for a window of WINDOW messages in the stream */
+   /* tests, and for one message per process in Alltoall        */
+   buf_sz = max_bytes;
+   if ((strchr(tests, 's') || strchr(tests, 'b')) &&
+         buf_sz < (long) max_bytes*WINDOW)
+      buf_sz = (long) max_bytes*WINDOW;
+   if (strchr(tests, 'c') && buf_sz < (long) max_bytes*comm_sz)
+      buf_sz = (long) max_bytes*comm_sz;
+   if (buf_sz < AGG_BYTES) buf_sz = AGG_BYTES;
+   buf = malloc(buf_sz);
+   buf2 = malloc(buf_sz);
+   times = malloc(reps*sizeof(double));
+   memset(buf, 1, buf_sz);
+   memset(buf2, 2, buf_sz);
+
+   if (my_rank == 0)
+      printf("test,bytes,procs,reps,min_us,median_us,mean_us,max_us,"
+            "stddev_us,MB_per_s\n");
+
+   if (strchr(tests, 'p')) Pingpong(buf, max_bytes, reps, times);
+   if (strchr(tests, 's')) Stream(buf, max_bytes, reps, times);
+   if (strchr(tests, 'b')) Bidir(buf, buf2, max_bytes, reps, times);
+   if (strchr(tests, 'e')) Eager(buf, max_bytes, reps, times);
+   if (strchr(tests, 'a')) Aggregate(buf, reps, times);
+   if (strchr(tests, 'c')) Collectives(buf, buf2, max_bytes, reps, times);
+
+   free(buf);
+   free(buf2);
+   free(times);
+   MPI_Finalize();
+   return 0;
+}  /* main */
+
+/*-------------------------------------------------------------------*/
+void Get_args(
+      int   argc         /* in  */,
+      char* argv[]       /* in  */,
+      int*  max_bytes_p  /* out */,
+      int*  reps_p       /* out */,
+      char  tests[]      /* out */) {
+   long max_bytes = 4194304;
+
+   *max_bytes_p = 4194304;
+   *reps_p = 10;
+   strcpy(tests, "psbeac");
+   if (my_rank == 0) {
+      if (argc > 1) max_bytes = strtol(argv[1], NULL, 10);
+      if (argc > 2) *reps_p = strtol(argv[2], NULL, 10);
+      if (argc > 3) {
+         strncpy(tests, argv[3], 15);
+         tests[15] = '\0';
+      }
+      if (argc > 4 || comm_sz < 2 || max_bytes < 0 ||
+            max_bytes > INT_MAX/2 || *reps_p <= 0) {
+         fprintf(stderr, "usage:  mpiexec -n <p> %s [max bytes] [reps]"
+               " [tests]\n", argv[0]);
+         fprintf(stderr, "   p >= 2, max bytes <= %d, tests is a subset "
+               "of psbeac\n", INT_MAX/2);
+         *reps_p = 0;
+      } else {
+         *max_bytes_p = max_bytes;
+      }
+   }
+   MPI_Bcast(max_bytes_p, 1, MPI_INT, 0, comm);
+   MPI_Bcast(reps_p, 1, MPI_INT, 0, comm);
+   MPI_Bcast(tests, 16, MPI_CHAR, 0, comm);
+   if (*reps_p <= 0) {
+      MPI_Finalize();
+      exit(0);
+   }
+}  /* Get_args */
+
+/*-------------------------------------------------------------------
+ * Function:   Batch_size
+ * Purpose:    Number of messages to time together in one
+ *             repetition, so that short messages are timed over
+ *             an interval much longer than the timer resolution
+ */
+int Batch_size(int bytes) {
+   if (bytes <= 1024) return 100;
+   else if (bytes <= 65536) return 20;
+   else return 4;
+}  /* Batch_size */
+
+/*-------------------------------------------------------------------
+ * Function:    Compare
+ * Purpose:     Compare 2 doubles.  Used by qsort.
+ */
+int Compare(const void* a_p, const void* b_p) {
+   double a = *((double*)a_p);
+   double b = *((double*)b_p);
+
+   if (a < b)
+      return -1;
+   else if (a == b)
+      return 0;
+   else /* a > b */
+      return 1;
+}  /* Compare */
+
+/*-------------------------------------------------------------------
+ * Function:   Print_row
+ * Purpose:    Compute statistics of times[] (seconds) and print one
+ *             line of output.  Called only by process 0.
+ * In args:    bytes_per_msg:  bytes moved per timed message, used
+ *                for the bandwidth
+ * In/out arg: times:  sorted on return
+ */
+void Print_row(char test[], int bytes, int procs, double times[],
+      int reps, double bytes_per_msg) {
+   double min, median, mean = 0.0, max, var = 0.0;
+   int i;
+
+   qsort(times, reps, sizeof(double), Compare);
+   min = times[0];
+   max = times[reps-1];
+   median = (reps % 2 == 1) ? times[reps/2] :
+      (times[reps/2-1] + times[reps/2])/2.0;
+   for (i = 0; i < reps; i++)
+      mean += times[i];
+   mean /= reps;
+   for (i = 0; i < reps; i++)
+      var += (times[i] - mean)*(times[i] - mean);
+   var = (reps > 1) ? var/(reps-1) : 0.0;
+
+   printf("%s,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", test, bytes,
+         procs, reps, 1e6*min, 1e6*median, 1e6*mean, 1e6*max,
+         1e6*sqrt(var), (median > 0.0) ? bytes_per_msg/median/1e6 : 0.0);
+   fflush(stdout);
+}  /* Print_row */
+
+/*-------------------------------------------------------------------
+ * Function:   Pair_sync
+ * Purpose:    Synchronize processes 0 and 1 with a zero-byte
+ *             exchange
+ */
+void Pair_sync(void) {
+   int partner = 1 - my_rank;
+
+   MPI_Sendrecv(NULL, 0, MPI_CHAR, partner, 1, NULL, 0, MPI_CHAR,
+         partner, 1, comm, MPI_STATUS_IGNORE);
+}  /* Pair_sync */
+
+/*-------------------------------------------------------------------
+ * Function:   Delay
+ * Purpose:    Busy-wait for the given number of seconds
+ */
+void Delay(double seconds) {
+   double start = MPI_Wtime();
+
+   while (MPI_Wtime() - start < seconds);
+}  /* Delay */
+
+/*-------------------------------------------------------------------*/
+void Pingpong(char buf[], int max_bytes, int reps, double times[]) {
+   int bytes, rep, i, batch;
+   double start;
+
+   for (bytes = 0; bytes <= max_bytes; bytes = (bytes == 0) ? 1 : 2*bytes) {
+      batch = Batch_size(bytes);
+      for (rep = 0; rep < reps && my_rank < 2; rep++) {
+         Pair_sync();
+         start = MPI_Wtime();
+         for (i = 0; i < batch; i++)
+            if (my_rank == 0) {
+               MPI_Send(buf, bytes, MPI_CHAR, 1, 0, comm);
+               MPI_Recv(buf, bytes, MPI_CHAR, 1, 0, comm,
+                     MPI_STATUS_IGNORE);
+            } else {
+               MPI_Recv(buf, bytes, MPI_CHAR, 0, 0, comm,
+                     MPI_STATUS_IGNORE);
+               MPI_Send(buf, bytes, MPI_CHAR, 0, 0, comm);
+            }
+         times[rep] = (MPI_Wtime() - start)/(2*batch);
+      }
+      if (my_rank == 0)
+         Print_row("pingpong", bytes, 2, times, reps, bytes);
+   }
+   MPI_Barrier(comm);
+}  /* Pingpong */
+
+/*-------------------------------------------------------------------*/
+void Stream(char buf[], int max_bytes, int reps, double times[]) {
+   int bytes, rep, i;
+   MPI_Request requests[WINDOW];
+   double start;
+
+   for (bytes = 0; bytes <= max_bytes; bytes = (bytes == 0) ? 1 : 2*bytes) {
+      for (rep = 0; rep < reps && my_rank < 2; rep++) {
+         Pair_sync();
+         start = MPI_Wtime();
+         if (my_rank == 0) {
+            for (i = 0; i < WINDOW; i++)
+               MPI_Isend(buf + (long) i*bytes, bytes, MPI_CHAR, 1, 0,
+                     comm, &requests[i]);
+            MPI_Waitall(WINDOW, requests, MPI_STATUSES_IGNORE);
+            /* Wait for the receiver to acknowledge */
+            MPI_Recv(NULL, 0, MPI_CHAR, 1, 2, comm, MPI_STATUS_IGNORE);
+         } else {
+            for (i = 0; i < WINDOW; i++)
+               MPI_Irecv(buf + (long) i*bytes, bytes, MPI_CHAR, 0, 0,
+                     comm, &requests[i]);
+            MPI_Waitall(WINDOW, requests, MPI_STATUSES_IGNORE);
+            MPI_Send(NULL, 0, MPI_CHAR, 0, 2, comm);
+         }
+         times[rep] = (MPI_Wtime() - start)/WINDOW;
+      }
+      if (my_rank == 0)
+         Print_row("stream", bytes, 2, times, reps, bytes);
+   }
+   MPI_Barrier(comm);
+}  /* Stream */
+
+/*-------------------------------------------------------------------*/
+void Bidir(char buf[], char buf2[], int max_bytes, int reps,
+      double times[]) {
+   int bytes, rep, i, partner = 1 - my_rank;
+   MPI_Request requests[2*WINDOW];
+   double start;
+
+   for (bytes = 0; bytes <= max_bytes; bytes = (bytes == 0) ? 1 : 2*bytes) {
+      for (rep = 0; rep < reps && my_rank < 2; rep++) {
+         Pair_sync();
+         start = MPI_Wtime();
+         for (i = 0; i < WINDOW; i++)
+            MPI_Irecv(buf2 + (long) i*bytes, bytes, MPI_CHAR, partner, 0,
+                  comm, &requests[i]);
+         for (i = 0; i < WINDOW; i++)
+            MPI_Isend(buf + (long) i*bytes, bytes, MPI_CHAR, partner, 0,
+                  comm, &requests[WINDOW + i]);
+         MPI_Waitall(2*WINDOW, requests, MPI_STATUSES_IGNORE);
+         times[rep] = (MPI_Wtime() - start)/WINDOW;
+      }
+      /* Both directions move bytes in each time step */
+      if (my_rank == 0)
+         Print_row("bidir", bytes, 2, times, reps, 2.0*bytes);
+   }
+   MPI_Barrier(comm);
+}  /* Bidir */
+
+/*-------------------------------------------------------------------*/
+void Eager(char buf[], int max_bytes, int reps, double times[]) {
+   int bytes, rep, eager_limit = -1, eager;
+   double start;
+
+   for (bytes = 0; bytes <= max_bytes; bytes = (bytes == 0) ? 1 : 2*bytes) {
+      for (rep = 0; rep < reps && my_rank < 2; rep++) {
+         Pair_sync();
+         if (my_rank == 0) {
+            start = MPI_Wtime();
+            MPI_Send(buf, bytes, MPI_CHAR, 1, 0, comm);
+            times[rep] = MPI_Wtime() - start;
+         } else {
+            Delay(EAGER_DELAY);
+            MPI_Recv(buf, bytes, MPI_CHAR, 0, 0, comm, MPI_STATUS_IGNORE);
+         }
+      }
+      if (my_rank == 0) {
+         Print_row("eager_send", bytes, 2, times, reps, bytes);
+         /* times is sorted:  use the median */
+         eager = times[reps/2] < EAGER_DELAY/2;
+         if (eager && eager_limit == bytes/2) eager_limit = bytes;
+         if (eager && bytes == 0) eager_limit = 0;
+      }
+   }
+   if (my_rank == 0) {
+      printf("eager_limit,%d,2,%d,,,,,,\n", eager_limit, reps);
+      fflush(stdout);
+   }
+   MPI_Barrier(comm);
+}  /* Eager */
+
+/*-------------------------------------------------------------------*/
+void Aggregate(char buf[], int reps, double times[]) {
+   int bytes, rep, i, n_msgs;
+   double start;
+
+   for (bytes = AGG_MIN_BYTES; bytes <= AGG_BYTES; bytes *= 2) {
+      n_msgs = AGG_BYTES/bytes;
+      for (rep = 0; rep < reps && my_rank < 2; rep++) {
+         Pair_sync();
+         start = MPI_Wtime();
+         if (my_rank == 0) {
+            for (i = 0; i < n_msgs; i++)
+               MPI_Send(buf + (long) i*bytes, bytes, MPI_CHAR, 1, 0, comm);
+            MPI_Recv(NULL, 0, MPI_CHAR, 1, 2, comm, MPI_STATUS_IGNORE);
+         } else {
+            for (i = 0; i < n_msgs; i++)
+               MPI_Recv(buf + (long) i*bytes, bytes, MPI_CHAR, 0, 0, comm,
+                     MPI_STATUS_IGNORE);
+            MPI_Send(NULL, 0, MPI_CHAR, 0, 2, comm);
+         }
+         /* Time for the whole AGG_BYTES transfer */
+         times[rep] = MPI_Wtime() - start;
+      }
+      if (my_rank == 0)
+         Print_row("aggregate", bytes, 2, times, reps, AGG_BYTES);
+   }
+   MPI_Barrier(comm);
+}  /* Aggregate */
+
+/*-------------------------------------------------------------------*/
+void Collectives(char buf[], char buf2[], int max_bytes, int reps,
+      double times[]) {
+   int bytes, rep, i, batch, test, count;
+   double start, my_time;
+   char* names[] = {"bcast", "reduce", "allgather", "alltoall"};
+
+   for (test = 0; test < 4; test++)
+      for (bytes = 0; bytes <= max_bytes;
+            bytes = (bytes == 0) ? 1 : 2*bytes) {
+         /* Reduce needs whole doubles */
+         if (test == 1 && bytes % sizeof(double) != 0) continue;
+         count = bytes/sizeof(double);
+         batch = Batch_size(bytes);
+         for (rep = 0; rep < reps; rep++) {
+            MPI_Barrier(comm);
+            start = MPI_Wtime();
+            for (i = 0; i < batch; i++)
+               switch (test) {
+                  case 0:
+                     MPI_Bcast(buf, bytes, MPI_CHAR, 0, comm);
+                     break;
+                  case 1:
+                     MPI_Reduce(buf, buf2, count, MPI_DOUBLE, MPI_SUM, 0,
+                           comm);
+                     break;
+                  case 2:
+                     MPI_Allgather(buf, bytes, MPI_CHAR, buf2, bytes,
+                           MPI_CHAR, comm);
+                     break;
+                  default:
+                     MPI_Alltoall(buf, bytes, MPI_CHAR, buf2, bytes,
+                           MPI_CHAR, comm);
+               }
+            my_time = (MPI_Wtime() - start)/batch;
+            /* An operation is done when the slowest process is done */
+            MPI_Reduce(&my_time, &times[rep], 1, MPI_DOUBLE, MPI_MAX, 0,
+                  comm);
+         }
+         if (my_rank == 0)
+            Print_row(names[test], bytes, comm_sz, times, reps, bytes);
+      }
+}  /* Collectives */
@@ -0,0 +1,863 @@
+/*
+ * File:     mpi_odd_even_ooc.c
+ * Purpose:  Out-of-core ("external memory") parallel sort of a binary
+ *           file of ints that may be much larger than the combined
+ *           memory of the participating processes.
+ *
+ * Algorithm:
+ *    1.  Run formation:  the input file is split into chunks of
+ *        chunk_n ints.  Chunk c is assigned to process c % p, which
+ *        reads it with one large MPI-IO read, sorts it with qsort,
+ *        and spills it to the run file <outfile>.run<c> with one
+ *        large sequential write.
+ *    2.  Splitter selection:  each process takes p regularly spaced
+ *        samples from each of its runs.  Process 0 gathers and sorts
+ *        the samples and broadcasts p-1 splitters.
+ *    3.  Parallel multiway merge:  process q is responsible for the
+ *        keys k with splitter[q-1] <= k < splitter[q].  It binary
+ *        searches every run file for its key range, merges the
+ *        pieces with a heap using buffered sequential reads, and
+ *        writes the result to its slice of the output file.  The
+ *        output offset of each slice is found with MPI_Exscan.
+ *        At most fan_in pieces are merged at once:  each process
+ *        has a buffer of at least MIN_MERGE_BUF ints for each
+ *        piece and needs a file descriptor for each.  If there are
+ *        more pieces, groups of fan_in pieces are first merged into
+ *        temporary files, and this is repeated until there are at
+ *        most fan_in pieces left.
+ *
+ * Compile:  mpicc -g -Wall -O2 -o mpi_odd_even_ooc mpi_odd_even_ooc.c
+ * Run:
+ *    mpiexec -n <p> mpi_odd_even_ooc g <file> <global_n> <chunk_n>
+ *    mpiexec -n <p> mpi_odd_even_ooc s <infile> <outfile> <chunk_n>
+ *    mpiexec -n <p> mpi_odd_even_ooc v <file> <chunk_n>
+ *       - p: the number of processes
+ *       - g: generate a file of global_n random ints
+ *       - s: sort infile into outfile
+ *       - v: verify that file is sorted
+ *       - chunk_n: number of ints each process holds in memory
+ *         at one time (the run length)
+ *
+ * Input:    Binary file of native ints (s and v modes)
+ * Output:   Sorted binary file of native ints (s mode), elapsed
+ *           time for each phase, result of verification (v mode)
+ *
+ * Notes:
+ * 1.  The run files are created next to outfile and must be visible
+ *     to every process, e.g. on a shared parallel file system.  They
+ *     are removed after the merge.
+ * 2.  Peak memory per process is one buffer of chunk_n ints during
+ *     run formation, since qsort sorts it in place, regardless of the
+ *     size of the input file.  During the merge it's about chunk_n
+ *     ints (at least 3*MIN_MERGE_BUF ints) plus a few words per run.
+ * 3.  Keys equal to a splitter all go to one process, so inputs
+ *     with very few distinct keys can give an unbalanced merge.
+ * 4.  Optional -DDEBUG compile flag for verbose output
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <mpi.h>
+
+#define NAME_MAX_LEN 1024
+#define RUN_NAME_MAX_LEN (NAME_MAX_LEN + 64)
+#define MIN_MERGE_BUF 16384    /* ints, so each read is >= 64 KB */
+#define FD_RESERVE 32          /* descriptors left for stdio, MPI  */
+
+/* One run being consumed by the multiway merge */
+struct run_reader_s {
+   FILE*      fp;
+   int*       buf;
+   int        buf_n;     /* Capacity of buf                    */
+   int        buf_count; /* Number of valid ints in buf         */
+   int        buf_i;     /* Next unread int in buf              */
+   long long  left;      /* Ints in the run not yet read into buf */
+};
+typedef struct run_reader_s run_reader_t;
+
+/* The part of a run, or of a temporary file, that lies in this
+ * process' key range.  Level 0 pieces are in run files, level l > 0
+ * pieces are in temporary files written by merge pass l. */
+struct run_piece_s {
+   int        level;
+   long long  id;        /* Run number or number of temporary file */
+   long long  first;     /* Index of the first int of the piece     */
+   long long  len;       /* Number of ints in the piece             */
+};
+typedef struct run_piece_s run_piece_t;
+
+/* Local functions */
+void Usage(char* program);
+int  Compare(const void* a_p, const void* b_p);
+void Run_name(char name[], char outfile[], long long run);
+void Piece_name(char name[], char outfile[], run_piece_t* piece,
+         int my_rank);
+int  Merge_fan_in(int chunk_n);
+long long Lower_bound(FILE* fp, long long len, int key);
+int  Reader_refill(run_reader_t* rdr);
+void Heap_sift_down(int heap[], int heap_n, int i, run_reader_t rdrs[]);
+
+/* Functions involving communication */
+void Check_for_error(int local_ok, char fname[], char message[],
+         MPI_Comm comm);
+void Get_args(int argc, char* argv[], char* mode_p, char infile[],
+         char outfile[], long long* global_n_p, int* chunk_n_p,
+         int my_rank, MPI_Comm comm);
+void Generate_file(char file[], long long global_n, int chunk_n,
+         int my_rank, int p, MPI_Comm comm);
+long long Form_runs(char infile[], char outfile[], int chunk_n,
+         long long* global_n_p, int my_rank, int p, MPI_Comm comm);
+void Get_splitters(int splitters[], char outfile[], long long global_n,
+         long long n_runs, int chunk_n, int my_rank, int p,
+         MPI_Comm comm);
+int  Merge_pieces(char outfile[], run_piece_t pieces[], int k,
+         run_reader_t rdrs[], int heap[], int out_buf[], int buf_n,
+         FILE* out_fp, MPI_File fh, MPI_Offset offset, int my_rank);
+void Merge_runs(char outfile[], int splitters[], long long global_n,
+         long long n_runs, int chunk_n, int my_rank, int p,
+         MPI_Comm comm);
+void Verify_file(char file[], int chunk_n, int my_rank, int p,
+         MPI_Comm comm);
+
+
+/*-------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int my_rank, p;
+   char mode;
+   char infile[NAME_MAX_LEN], outfile[NAME_MAX_LEN];
+   long long global_n, n_runs, run;
+   int chunk_n;
+   int* splitters;
+   char name[RUN_NAME_MAX_LEN];
+   double start, runs_done, split_done, finish;
+   MPI_Comm comm;
+
+   MPI_Init(&argc, &argv);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &p);
+   MPI_Comm_rank(comm, &my_rank);
+
+   Get_args(argc, argv, &mode, infile, outfile, &global_n, &chunk_n,
+         my_rank, comm);
+
+   if (mode == 'g') {
+      Generate_file(infile, global_n, chunk_n, my_rank, p, comm);
+   } else if (mode == 'v') {
+      Verify_file(infile, chunk_n, my_rank, p, comm);
+   } else {
+      splitters = malloc(p*sizeof(int));
+      MPI_Barrier(comm);
+      start = MPI_Wtime();
+      n_runs = Form_runs(infile, outfile, chunk_n, &global_n,
+            my_rank, p, comm);
+      MPI_Barrier(comm);
+      runs_done = MPI_Wtime();
+      Get_splitters(splitters, outfile, global_n, n_runs, chunk_n,
+            my_rank, p, comm);
+      split_done = MPI_Wtime();
+      Merge_runs(outfile, splitters, global_n, n_runs, chunk_n,
+            my_rank, p, comm);
+      MPI_Barrier(comm);
+      finish = MPI_Wtime();
+
+      /* Each process removes the runs it created */
+      for (run = my_rank; run < n_runs; run += p) {
+         Run_name(name, outfile, run);
+         remove(name);
+      }
+
+      if (my_rank == 0) {
+         printf("Sorted %lld ints in %lld runs\n", global_n, n_runs);
+         printf("   Run formation time = %e seconds\n",
+               runs_done - start);
+         printf("   Splitter time      = %e seconds\n",
+               split_done - runs_done);
+         printf("   Merge time         = %e seconds\n",
+               finish - split_done);
+         printf("   Total time         = %e seconds\n", finish - start);
+      }
+      free(splitters);
+   }
+
+   MPI_Finalize();
+   return 0;
+}  /* main */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Usage
+ * Purpose:   Print command line to start program
+ * In arg:    program:  name of executable
+ * Note:      Purely local, run only by process 0;
+ */
+void Usage(char* program) {
+   fprintf(stderr, "usage:  mpiexec -n <p> %s g <file> <global_n> "
+         "<chunk_n>\n", program);
+   fprintf(stderr, "        mpiexec -n <p> %s s <infile> <outfile> "
+         "<chunk_n>\n", program);
+   fprintf(stderr, "        mpiexec -n <p> %s v <file> <chunk_n>\n",
+         program);
+   fprintf(stderr, "   - p: the number of processes \n");
+   fprintf(stderr, "   - g: generate a binary file of random ints\n");
+   fprintf(stderr, "   - s: sort infile into outfile\n");
+   fprintf(stderr, "   - v: verify that file is sorted\n");
+   fprintf(stderr, "   - chunk_n: ints held in memory per process\n");
+   fflush(stderr);
+}  /* Usage */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Check_for_error
+ * Purpose:     Check whether any process has found an error.  If so,
+ *              print message and terminate all processes.  Otherwise,
+ *              continue execution.
+ * In args:     local_ok:  1 if calling process has found an error, 0
+ *                 otherwise
+ *              fname:     name of function calling Check_for_error
+ *              message:   message to print if there's an error
+ *              comm:      communicator containing processes calling
+ *                         Check_for_error:  should be MPI_COMM_WORLD.
+ */
+void Check_for_error(int local_ok, char fname[], char message[],
+      MPI_Comm comm) {
+   int ok;
+
+   MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+   if (ok == 0) {
+      int my_rank;
+      MPI_Comm_rank(comm, &my_rank);
+      if (my_rank == 0) {
+         fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+               message);
+         fflush(stderr);
+      }
+      MPI_Finalize();
+      exit(-1);
+   }
+}  /* Check_for_error */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Get_args
+ * Purpose:     Get and check command line arguments
+ * Input args:  argc, argv, my_rank, comm
+ * Output args: mode_p, infile, outfile, global_n_p, chunk_n_p
+ */
+void Get_args(int argc, char* argv[], char* mode_p, char infile[],
+      char outfile[], long long* global_n_p, int* chunk_n_p,
+      int my_rank, MPI_Comm comm) {
+   int local_ok = 1;
+
+   *mode_p = 0;
+   infile[0] = outfile[0] = '\0';
+   *global_n_p = 0;
+   *chunk_n_p = 0;
+   if (my_rank == 0) {
+      if (argc == 5 && argv[1][0] == 'g') {
+         strncpy(infile, argv[2], NAME_MAX_LEN-1);
+         *global_n_p = strtoll(argv[3], NULL, 10);
+         *chunk_n_p = strtol(argv[4], NULL, 10);
+         *mode_p = 'g';
+         if (*global_n_p <= 0) local_ok = 0;
+      } else if (argc == 5 && argv[1][0] == 's') {
+         strncpy(infile, argv[2], NAME_MAX_LEN-1);
+         strncpy(outfile, argv[3], NAME_MAX_LEN-1);
+         *chunk_n_p = strtol(argv[4], NULL, 10);
+         *mode_p = 's';
+      } else if (argc == 4 && argv[1][0] == 'v') {
+         strncpy(infile, argv[2], NAME_MAX_LEN-1);
+         *chunk_n_p = strtol(argv[3], NULL, 10);
+         *mode_p = 'v';
+      } else {
+         local_ok = 0;
+      }
+      if (*chunk_n_p <= 0) local_ok = 0;
+      if (!local_ok) Usage(argv[0]);
+   }
+   Check_for_error(local_ok, "Get_args", "bad command line", comm);
+
+   MPI_Bcast(mode_p, 1, MPI_CHAR, 0, comm);
+   MPI_Bcast(infile, NAME_MAX_LEN, MPI_CHAR, 0, comm);
+   MPI_Bcast(outfile, NAME_MAX_LEN, MPI_CHAR, 0, comm);
+   MPI_Bcast(global_n_p, 1, MPI_LONG_LONG, 0, comm);
+   MPI_Bcast(chunk_n_p, 1, MPI_INT, 0, comm);
+#  ifdef DEBUG
+   printf("Proc %d > mode = %c, infile = %s, outfile = %s, "
+         "global_n = %lld, chunk_n = %d\n", my_rank, *mode_p, infile,
+         outfile, *global_n_p, *chunk_n_p);
+   fflush(stdout);
+#  endif
+}  /* Get_args */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Compare
+ * Purpose:     Compare 2 ints, return -1, 0, or 1, respectively, when
+ *              the first int is less than, equal, or greater than
+ *              the second.  Used by qsort.
+ */
+int Compare(const void* a_p, const void* b_p) {
+   int a = *((int*)a_p);
+   int b = *((int*)b_p);
+
+   if (a < b)
+      return -1;
+   else if (a == b)
+      return 0;
+   else /* a > b */
+      return 1;
+}  /* Compare */
+
+
+/*-------------------------------------------------------------------
+ * Function:   Run_name
+ * Purpose:    Build the name of the file holding run number run
+ * In args:    outfile, run
+ * Out arg:    name
+ */
+void Run_name(char name[], char outfile[], long long run) {
+   snprintf(name, RUN_NAME_MAX_LEN, "%s.run%lld", outfile, run);
+}  /* Run_name */
+
+
+/*-------------------------------------------------------------------
+ * Function:   Piece_name
+ * Purpose:    Build the name of the file holding a piece:  the run
+ *             file for level 0, otherwise a temporary file private
+ *             to the process
+ * In args:    outfile, piece, my_rank
+ * Out arg:    name
+ */
+void Piece_name(char name[], char outfile[], run_piece_t* piece,
+      int my_rank) {
+   if (piece->level == 0)
+      Run_name(name, outfile, piece->id);
+   else
+      snprintf(name, RUN_NAME_MAX_LEN, "%s.p%d.l%d.%lld", outfile,
+            my_rank, piece->level, piece->id);
+}  /* Piece_name */
+
+
+/*-------------------------------------------------------------------
+ * Function:   Generate_file
+ * Purpose:    Write global_n random ints to file.  Each process
+ *             writes a contiguous block, chunk_n ints at a time.
+ * In args:    all
+ */
+void Generate_file(char file[], long long global_n, int chunk_n,
+      int my_rank, int p, MPI_Comm comm) {
+   MPI_File fh;
+   long long my_first, my_last, i;
+   int* buf;
+   int count, j, local_ok;
+
+   local_ok = (MPI_File_open(comm, file, MPI_MODE_CREATE|MPI_MODE_WRONLY,
+         MPI_INFO_NULL, &fh) == MPI_SUCCESS);
+   Check_for_error(local_ok, "Generate_file", "can't open file", comm);
+   MPI_File_set_size(fh, 0);
+
+   buf = malloc(chunk_n*sizeof(int));
+   my_first = global_n*my_rank/p;
+   my_last = global_n*(my_rank+1)/p;
+   srandom(my_rank+1);
+   for (i = my_first; i < my_last; i += count) {
+      count = (my_last - i < chunk_n) ? my_last - i : chunk_n;
+      for (j = 0; j < count; j++)
+         buf[j] = random();
+      MPI_File_write_at(fh, (MPI_Offset) i*sizeof(int), buf, count,
+            MPI_INT, MPI_STATUS_IGNORE);
+   }
+
+   free(buf);
+   MPI_File_close(&fh);
+   if (my_rank == 0)
+      printf("Wrote %lld random ints to %s\n", global_n, file);
+}  /* Generate_file */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Form_runs
+ * Purpose:     Read the input file chunk_n ints at a time, sort each
+ *              chunk, and write it to its own run file.  Chunks are
+ *              dealt out to the processes cyclically.
+ * In args:     infile, outfile, chunk_n, my_rank, p, comm
+ * Out arg:     global_n_p:  number of ints in infile
+ * Return val:  Total number of runs
+ */
+long long Form_runs(char infile[], char outfile[], int chunk_n,
+      long long* global_n_p, int my_rank, int p, MPI_Comm comm) {
+   MPI_File fh;
+   MPI_Offset size;
+   long long n_runs, run, first;
+   int *buf, count, local_ok;
+   char name[RUN_NAME_MAX_LEN];
+   FILE* fp;
+
+   local_ok = (MPI_File_open(comm, infile, MPI_MODE_RDONLY,
+         MPI_INFO_NULL, &fh) == MPI_SUCCESS);
+   Check_for_error(local_ok, "Form_runs", "can't open input file",
+         comm);
+   MPI_File_get_size(fh, &size);
+   *global_n_p = size/sizeof(int);
+   n_runs = (*global_n_p + chunk_n - 1)/chunk_n;
+
+   buf = malloc(chunk_n*sizeof(int));
+   local_ok = (buf != NULL);
+   Check_for_error(local_ok, "Form_runs", "can't allocate run buffer",
+         comm);
+
+   for (run = my_rank; run < n_runs && local_ok; run += p) {
+      first = run*chunk_n;
+      count = (*global_n_p - first < chunk_n) ?
+         *global_n_p - first : chunk_n;
+      MPI_File_read_at(fh, (MPI_Offset) first*sizeof(int), buf, count,
+            MPI_INT, MPI_STATUS_IGNORE);
+      qsort(buf, count, sizeof(int), Compare);
+
+      Run_name(name, outfile, run);
+      fp = fopen(name, "wb");
+      if (fp == NULL || fwrite(buf, sizeof(int), count, fp) != count)
+         local_ok = 0;
+      if (fp != NULL) fclose(fp);
+#     ifdef DEBUG
+      printf("Proc %d > wrote run %lld, %d ints\n", my_rank, run, count);
+      fflush(stdout);
+#     endif
+   }
+   Check_for_error(local_ok, "Form_runs", "can't write run file", comm);
+
+   free(buf);
+   MPI_File_close(&fh);
+   return n_runs;
+}  /* Form_runs */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Get_splitters
+ * Purpose:     Choose p-1 splitters so that each process gets about
+ *              global_n/p keys in the merge.  Uses regular sampling
+ *              of the sorted runs.
+ * In args:     outfile, global_n, n_runs, chunk_n, my_rank, p, comm
+ * Out arg:     splitters:  splitters[0..p-2] on every process
+ */
+void Get_splitters(int splitters[], char outfile[], long long global_n,
+      long long n_runs, int chunk_n, int my_rank, int p,
+      MPI_Comm comm) {
+   int *samples, *all_samples = NULL, *counts = NULL, *displs = NULL;
+   int my_count = 0, total = 0, q, s, len;
+   long long run;
+   char name[RUN_NAME_MAX_LEN];
+   FILE* fp;
+
+   /* p samples from each of my runs */
+   samples = malloc(((n_runs + p - 1)/p)*p*sizeof(int) + sizeof(int));
+   for (run = my_rank; run < n_runs; run += p) {
+      len = (global_n - run*chunk_n < chunk_n) ?
+         global_n - run*chunk_n : chunk_n;
+      Run_name(name, outfile, run);
+      fp = fopen(name, "rb");
+      for (s = 0; s < p && fp != NULL; s++) {
+         fseeko(fp, (off_t) ((long long) len*s/p)*sizeof(int), SEEK_SET);
+         if (fread(&samples[my_count], sizeof(int), 1, fp) == 1)
+            my_count++;
+      }
+      if (fp != NULL) fclose(fp);
+   }
+
+   if (my_rank == 0) {
+      counts = malloc(p*sizeof(int));
+      displs = malloc(p*sizeof(int));
+   }
+   MPI_Gather(&my_count, 1, MPI_INT, counts, 1, MPI_INT, 0, comm);
+   if (my_rank == 0) {
+      for (q = 0; q < p; q++) {
+         displs[q] = total;
+         total += counts[q];
+      }
+      all_samples = malloc((total + 1)*sizeof(int));
+   }
+   MPI_Gatherv(samples, my_count, MPI_INT, all_samples, counts, displs,
+         MPI_INT, 0, comm);
+
+   if (my_rank == 0) {
+      qsort(all_samples, total, sizeof(int), Compare);
+      for (q = 1; q < p; q++)
+         splitters[q-1] = (total > 0) ? all_samples[(long long)total*q/p]
+            : 0;
+      free(all_samples);
+      free(counts);
+      free(displs);
+   }
+   MPI_Bcast(splitters, p-1, MPI_INT, 0, comm);
+   free(samples);
+
+#  ifdef DEBUG
+   if (my_rank == 0) {
+      printf("Splitters: ");
+      for (q = 0; q < p-1; q++)
+         printf("%d ", splitters[q]);
+      printf("\n");
+      fflush(stdout);
+   }
+#  endif
+}  /* Get_splitters */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Lower_bound
+ * Purpose:     Find the index of the first int in a sorted run file
+ *              that is >= key
+ * In args:     fp, len, key
+ * Return val:  Index in 0..len
+ */
+long long Lower_bound(FILE* fp, long long len, int key) {
+   long long lo = 0, hi = len, mid;
+   int val;
+
+   while (lo < hi) {
+      mid = lo + (hi - lo)/2;
+      fseeko(fp, (off_t) mid*sizeof(int), SEEK_SET);
+      if (fread(&val, sizeof(int), 1, fp) != 1) break;
+      if (val < key)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   return lo;
+}  /* Lower_bound */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Reader_refill
+ * Purpose:     Read the next block of a run into its buffer
+ * In/out arg:  rdr
+ * Return val:  1 if the buffer holds at least one int, 0 if the
+ *              run is exhausted
+ */
+int Reader_refill(run_reader_t* rdr) {
+   int count = (rdr->left < rdr->buf_n) ? rdr->left : rdr->buf_n;
+
+   rdr->buf_i = 0;
+   rdr->buf_count = (count > 0) ?
+      fread(rdr->buf, sizeof(int), count, rdr->fp) : 0;
+   rdr->left -= rdr->buf_count;
+   return rdr->buf_count > 0;
+}  /* Reader_refill */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Heap_sift_down
+ * Purpose:     Restore the min-heap property of the subtree of heap[]
+ *              rooted at i.  heap[] stores indices into rdrs,
+ *              ordered by the current key of each reader.
+ * In args:     heap_n, i, rdrs
+ * In/out arg:  heap
+ */
+void Heap_sift_down(int heap[], int heap_n, int i, run_reader_t rdrs[]) {
+   int child, tmp;
+   run_reader_t *a, *b;
+
+   while ((child = 2*i + 1) < heap_n) {
+      if (child + 1 < heap_n) {
+         a = &rdrs[heap[child+1]];
+         b = &rdrs[heap[child]];
+         if (a->buf[a->buf_i] < b->buf[b->buf_i]) child++;
+      }
+      a = &rdrs[heap[child]];
+      b = &rdrs[heap[i]];
+      if (a->buf[a->buf_i] >= b->buf[b->buf_i]) break;
+      tmp = heap[i];
+      heap[i] = heap[child];
+      heap[child] = tmp;
+      i = child;
+   }
+}  /* Heap_sift_down */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Merge_fan_in
+ * Purpose:     Find the largest number of pieces that can be merged
+ *              at once:  each needs an open file and a buffer of at
+ *              least MIN_MERGE_BUF ints, and the buffers and the
+ *              output buffer share chunk_n ints
+ * In arg:      chunk_n
+ * Return val:  The fan-in, at least 2
+ */
+int Merge_fan_in(int chunk_n) {
+   struct rlimit lim;
+   int k = chunk_n/MIN_MERGE_BUF - 1;
+
+   if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur != RLIM_INFINITY
+         && lim.rlim_cur < (rlim_t) k + FD_RESERVE + 1)
+      k = (int) lim.rlim_cur - FD_RESERVE - 1;
+   if (k < 2) k = 2;
+   return k;
+}  /* Merge_fan_in */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Merge_pieces
+ * Purpose:     Merge k sorted pieces and write the result either to
+ *              out_fp, or, if out_fp is NULL, to fh starting at int
+ *              offset.  Temporary files are removed after they're
+ *              read.
+ * In args:     outfile, pieces, k, buf_n, out_fp, fh, offset, my_rank
+ * Scratch:     rdrs, heap:  k elements each
+ *              out_buf:  buf_n ints
+ * Return val:  1 if all the files could be read and written, 0
+ *              otherwise
+ */
+int Merge_pieces(char outfile[], run_piece_t pieces[], int k,
+      run_reader_t rdrs[], int heap[], int out_buf[], int buf_n,
+      FILE* out_fp, MPI_File fh, MPI_Offset offset, int my_rank) {
+   int heap_n = 0, out_count = 0, opened, r, ok = 1;
+   long long written = 0;
+   char name[RUN_NAME_MAX_LEN];
+   run_reader_t* top;
+
+   for (opened = 0; opened < k; opened++) {
+      Piece_name(name, outfile, &pieces[opened], my_rank);
+      rdrs[opened].fp = fopen(name, "rb");
+      if (rdrs[opened].fp == NULL) {
+         ok = 0;
+         break;
+      }
+      fseeko(rdrs[opened].fp, (off_t) pieces[opened].first*sizeof(int),
+            SEEK_SET);
+      rdrs[opened].buf_n = buf_n;
+      rdrs[opened].left = pieces[opened].len;
+      if (Reader_refill(&rdrs[opened]))
+         heap[heap_n++] = opened;
+   }
+
+   /* Build the heap */
+   if (!ok) heap_n = 0;
+   for (r = heap_n/2 - 1; r >= 0; r--)
+      Heap_sift_down(heap, heap_n, r, rdrs);
+
+   while (heap_n > 0) {
+      top = &rdrs[heap[0]];
+      out_buf[out_count++] = top->buf[top->buf_i++];
+      if (top->buf_i == top->buf_count && !Reader_refill(top))
+         heap[0] = heap[--heap_n];
+      Heap_sift_down(heap, heap_n, 0, rdrs);
+
+      if (out_count == buf_n || heap_n == 0) {
+         if (out_fp != NULL) {
+            if (fwrite(out_buf, sizeof(int), out_count, out_fp)
+                  != out_count) ok = 0;
+         } else {
+            MPI_File_write_at(fh, (offset + written)*sizeof(int),
+                  out_buf, out_count, MPI_INT, MPI_STATUS_IGNORE);
+         }
+         written += out_count;
+         out_count = 0;
+      }
+   }
+
+   for (r = 0; r < opened; r++) {
+      if (rdrs[r].left > 0 || rdrs[r].buf_i < rdrs[r].buf_count) ok = 0;
+      fclose(rdrs[r].fp);
+      if (pieces[r].level > 0) {
+         Piece_name(name, outfile, &pieces[r], my_rank);
+         remove(name);
+      }
+   }
+   return ok;
+}  /* Merge_pieces */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Merge_runs
+ * Purpose:     Merge this process' key range from every run and
+ *              write it to its slice of the output file
+ * In args:     all
+ * Notes:
+ * 1.  Uses about chunk_n ints of buffer space: one input buffer
+ *     for each of the fan_in pieces merged at once plus one output
+ *     buffer.
+ * 2.  Each pass before the last merges groups of fan_in pieces into
+ *     temporary files, so there are
+ *     ceil(log_{fan_in}(n_runs)) passes over the data.
+ */
+void Merge_runs(char outfile[], int splitters[], long long global_n,
+      long long n_runs, int chunk_n, int my_rank, int p,
+      MPI_Comm comm) {
+   run_piece_t *pieces, next;
+   run_reader_t* rdrs;
+   int *heap, *out_buf;
+   int fan_in, buf_n, level = 0, local_ok = 1, r, k;
+   long long n_pieces = 0, new_n, g, run, len, lo, hi, my_n = 0,
+             my_offset = 0;
+   char name[RUN_NAME_MAX_LEN];
+   MPI_File fh;
+   FILE* fp;
+
+   fan_in = Merge_fan_in(chunk_n);
+   buf_n = chunk_n/(fan_in + 1);
+   if (buf_n < MIN_MERGE_BUF) buf_n = MIN_MERGE_BUF;
+   pieces = malloc(n_runs*sizeof(run_piece_t));
+
+   /* Find my key range in each run, one run file open at a time */
+   for (run = 0; run < n_runs && local_ok; run++) {
+      len = (global_n - run*chunk_n < chunk_n) ?
+         global_n - run*chunk_n : chunk_n;
+      Run_name(name, outfile, run);
+      fp = fopen(name, "rb");
+      if (fp == NULL) {
+         local_ok = 0;
+         break;
+      }
+      lo = (my_rank == 0) ? 0 :
+         Lower_bound(fp, len, splitters[my_rank-1]);
+      hi = (my_rank == p-1) ? len :
+         Lower_bound(fp, len, splitters[my_rank]);
+      fclose(fp);
+      if (hi > lo) {
+         pieces[n_pieces].level = 0;
+         pieces[n_pieces].id = run;
+         pieces[n_pieces].first = lo;
+         pieces[n_pieces].len = hi - lo;
+         n_pieces++;
+      }
+      my_n += hi - lo;
+   }
+   Check_for_error(local_ok, "Merge_runs", "can't open run file", comm);
+
+   rdrs = malloc(fan_in*sizeof(run_reader_t));
+   heap = malloc(fan_in*sizeof(int));
+   out_buf = malloc(buf_n*sizeof(int));
+   for (r = 0; r < fan_in; r++)
+      rdrs[r].buf = malloc(buf_n*sizeof(int));
+
+   /* Merge groups of fan_in pieces until at most fan_in are left.
+    * Piece new_n is stored after the pieces in its group are read,
+    * and new_n <= g, so pieces can be overwritten in place. */
+   while (n_pieces > fan_in && local_ok) {
+      level++;
+      new_n = 0;
+      for (g = 0; g < n_pieces && local_ok; g += fan_in) {
+         k = (n_pieces - g < fan_in) ? n_pieces - g : fan_in;
+         if (k == 1) {
+            pieces[new_n++] = pieces[g];
+            continue;
+         }
+         next.level = level;
+         next.id = new_n;
+         next.first = 0;
+         next.len = 0;
+         for (r = 0; r < k; r++)
+            next.len += pieces[g+r].len;
+         Piece_name(name, outfile, &next, my_rank);
+         fp = fopen(name, "wb");
+         if (fp == NULL) {
+            local_ok = 0;
+            break;
+         }
+         local_ok = Merge_pieces(outfile, pieces + g, k, rdrs, heap,
+               out_buf, buf_n, fp, MPI_FILE_NULL, 0, my_rank);
+         if (fclose(fp) != 0) local_ok = 0;
+         pieces[new_n++] = next;
+      }
+      n_pieces = new_n;
+#     ifdef DEBUG
+      printf("Proc %d > merge pass %d left %lld pieces\n", my_rank,
+            level, n_pieces);
+      fflush(stdout);
+#     endif
+   }
+   Check_for_error(local_ok, "Merge_runs", "can't write temporary file",
+         comm);
+
+   MPI_Exscan(&my_n, &my_offset, 1, MPI_LONG_LONG, MPI_SUM, comm);
+   if (my_rank == 0) my_offset = 0;
+#  ifdef DEBUG
+   printf("Proc %d > merging %lld ints to offset %lld\n", my_rank,
+         my_n, my_offset);
+   fflush(stdout);
+#  endif
+
+   local_ok = (MPI_File_open(comm, outfile,
+         MPI_MODE_CREATE|MPI_MODE_WRONLY, MPI_INFO_NULL, &fh)
+         == MPI_SUCCESS);
+   Check_for_error(local_ok, "Merge_runs", "can't open output file",
+         comm);
+   MPI_File_set_size(fh, (MPI_Offset) global_n*sizeof(int));
+
+   local_ok = Merge_pieces(outfile, pieces, n_pieces, rdrs, heap, out_buf,
+         buf_n, NULL, fh, my_offset, my_rank);
+   MPI_File_close(&fh);
+   Check_for_error(local_ok, "Merge_runs", "can't read run file", comm);
+
+   for (r = 0; r < fan_in; r++)
+      free(rdrs[r].buf);
+   free(rdrs);
+   free(heap);
+   free(out_buf);
+   free(pieces);
+}  /* Merge_runs */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Verify_file
+ * Purpose:     Check that a binary file of ints is sorted.  Each
+ *              process checks a contiguous block, chunk_n ints at a
+ *              time, and compares its first key with the last key of
+ *              the process to its left.
+ * In args:     all
+ */
+void Verify_file(char file[], int chunk_n, int my_rank, int p,
+      MPI_Comm comm) {
+   MPI_File fh;
+   MPI_Offset size;
+   long long global_n, my_first, my_last, i, bad = 0, total_bad;
+   int *buf, count, j, prev = 0, have_prev = 0, local_ok;
+   int first_last[2];   /* first and last key of my block */
+   int left_last, has_keys, left_has_keys = 0;
+   int left = (my_rank > 0) ? my_rank-1 : MPI_PROC_NULL;
+   int right = (my_rank < p-1) ? my_rank+1 : MPI_PROC_NULL;
+
+   local_ok = (MPI_File_open(comm, file, MPI_MODE_RDONLY, MPI_INFO_NULL,
+         &fh) == MPI_SUCCESS);
+   Check_for_error(local_ok, "Verify_file", "can't open file", comm);
+   MPI_File_get_size(fh, &size);
+   global_n = size/sizeof(int);
+
+   buf = malloc(chunk_n*sizeof(int));
+   my_first = global_n*my_rank/p;
+   my_last = global_n*(my_rank+1)/p;
+   for (i = my_first; i < my_last; i += count) {
+      count = (my_last - i < chunk_n) ? my_last - i : chunk_n;
+      MPI_File_read_at(fh, (MPI_Offset) i*sizeof(int), buf, count,
+            MPI_INT, MPI_STATUS_IGNORE);
+      for (j = 0; j < count; j++) {
+         if (!have_prev) first_last[0] = buf[j];
+         if (have_prev && buf[j] < prev) bad++;
+         prev = buf[j];
+         have_prev = 1;
+      }
+   }
+   first_last[1] = prev;
+   has_keys = have_prev;
+
+   /* Compare my first key with the last key on my left neighbor */
+   MPI_Sendrecv(&has_keys, 1, MPI_INT, right, 0, &left_has_keys, 1,
+         MPI_INT, left, 0, comm, MPI_STATUS_IGNORE);
+   MPI_Sendrecv(&first_last[1], 1, MPI_INT, right, 0, &left_last, 1,
+         MPI_INT, left, 0, comm, MPI_STATUS_IGNORE);
+   if (left != MPI_PROC_NULL && left_has_keys && has_keys
+         && first_last[0] < left_last) bad++;
+
+   MPI_Reduce(&bad, &total_bad, 1, MPI_LONG_LONG, MPI_SUM, 0, comm);
+   if (my_rank == 0) {
+      if (total_bad == 0)
+         printf("%s: %lld ints, sorted\n", file, global_n);
+      else
+         printf("%s: %lld ints, %lld out of order\n", file, global_n,
+               total_bad);
+   }
+
+   free(buf);
+   MPI_File_close(&fh);
+}  /* Verify_file */
@@ -8,7 +8,7 @@
  * Output:   Estimate of the integral from a to b of f(x)
  *           using the trapezoidal rule and n trapezoids.
  *
- * Compile:  mpicc -g -Wall -o mpi_trap2 mpi_trap2.c
+ * Compile:  mpicc -g -Wall -O3 -fopenmp-simd -o mpi_trap2 mpi_trap2.c
  * Run:      mpiexec -n <number of processes> ./mpi_trap2
  *
  * Algorithm:
@@ -21,6 +21,7 @@
  *        the individual processes and prints the result.
  *
  * Note:  f(x) is all hardwired.
+ *        f(x) is defined by F_kernel in trap_batch.h.
  *
  * IPP:   Section 3.3.2  (pp. 100 and ff.)
  */
@@ -29,6 +30,9 @@
 /* We'll be using MPI routines, definitions, etc. */
 #include <mpi.h>
 
+/* Batched evaluation of f in Trap */
+#include "trap_batch.h"
+
 /* Get the input values */
 void Get_input(int my_rank, int comm_sz, double* a_p, double* b_p,
       int* n_p);
@@ -142,14 +146,10 @@ double Trap(
       double right_endpt /* in */, 
       int    trap_count  /* in */, 
       double base_len    /* in */) {
-   double estimate, x; 
-   int i;
+   double estimate; 
 
    estimate = (f(left_endpt) + f(right_endpt))/2.0;
-   for (i = 1; i <= trap_count-1; i++) {
-      x = left_endpt + i*base_len;
-      estimate += f(x);
-   }
+   estimate += Trap_sum(left_endpt, base_len, 1, trap_count-1);
    estimate = estimate*base_len;
 
    return estimate;
@@ -162,5 +162,5 @@ double Trap(
  * Input args:  x
  */
 double f(double x) {
-   return x*x;
+   return F_kernel(x);
 } /* f */
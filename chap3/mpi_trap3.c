@@ -8,8 +8,8 @@
  * Output:   Estimate of the integral from a to b of f(x)
  *           using the trapezoidal rule and n trapezoids.
  *
- * Compile:  mpicc -g -Wall -o mpi_trap2 mpi_trap2.c
- * Run:      mpiexec -n <number of processes> ./mpi_trap2
+ * Compile:  mpicc -g -Wall -O3 -fopenmp-simd -o mpi_trap3 mpi_trap3.c
+ * Run:      mpiexec -n <number of processes> ./mpi_trap3
  *
  * Algorithm:
  *    1.  Each process calculates "its" interval of
@@ -21,6 +21,15 @@
  *        the individual processes and prints the result.
  *
  * Note:  f(x) is all hardwired.
+ *        F_kernel in trap_batch.h defines f(x).
+ *
+ *        If REPRO is defined, the points are divided into leaves of
+ *        REPRO_BLOCK points, each process gets a block of leaves, and
+ *        MPI_Reduce is replaced by Repro_mpi_sum.  Then the estimate
+ *        is the same for every number of processes.  Compile with
+ *
+ *           mpicc -g -Wall -O3 -fopenmp-simd -DREPRO -o mpi_trap3 mpi_trap3.c \
+ *              repro_sum.c repro_mpi.c
  *
  * IPP:   Section 3.4.2 (pp. 104 and ff.)
  */
@@ -29,6 +38,12 @@
 /* We'll be using MPI routines, definitions, etc. */
 #include <mpi.h>
 
+/* Batched evaluation of f in Trap */
+#include "trap_batch.h"
+#ifdef REPRO
+#include "repro_mpi.h"
+#endif
+
 /* Get the input values */
 void Get_input(int my_rank, int comm_sz, double* a_p, double* b_p,
       int* n_p);
@@ -41,9 +56,15 @@ double Trap(double left_endpt, double right_endpt, int trap_count,
 double f(double x); 
 
 int main(void) {
-   int my_rank, comm_sz, n, local_n;   
-   double a, b, h, local_a, local_b;
-   double local_int, total_int;
+   int my_rank, comm_sz, n;
+   double a, b, h, total_int;
+#  ifdef REPRO
+   struct repro_acc_s acc;
+   long first_leaf, last_leaf;
+#  else
+   int local_n;
+   double local_a, local_b, local_int;
+#  endif
 
    /* Let the system do what it needs to start up MPI */
    MPI_Init(NULL, NULL);
@@ -56,6 +77,15 @@ int main(void) {
 
    Get_input(my_rank, comm_sz, &a, &b, &n);
 
+#  ifdef REPRO
+   h = (b-a)/n;
+   Repro_leaf_range(Trap_leaves(n), my_rank, comm_sz, &first_leaf,
+         &last_leaf);
+   Repro_acc_init(&acc);
+   Trap_blocks(a, h, n, first_leaf, last_leaf, &acc);
+   total_int = Repro_mpi_sum(&acc, Trap_leaves(n), 0, MPI_COMM_WORLD);
+   total_int = h*((f(a) + f(b))/2.0 + total_int);
+#  else
    h = (b-a)/n;          /* h is the same for all processes */
    local_n = n/comm_sz;  /* So is the number of trapezoids  */
 
@@ -69,6 +99,7 @@ int main(void) {
    /* Add up the integrals calculated by each process */
    MPI_Reduce(&local_int, &total_int, 1, MPI_DOUBLE, MPI_SUM, 0,
          MPI_COMM_WORLD);
+#  endif
 
    /* Print the result */
    if (my_rank == 0) {
@@ -122,14 +153,10 @@ double Trap(
       double right_endpt /* in */, 
       int    trap_count  /* in */, 
       double base_len    /* in */) {
-   double estimate, x; 
-   int i;
+   double estimate; 
 
    estimate = (f(left_endpt) + f(right_endpt))/2.0;
-   for (i = 1; i <= trap_count-1; i++) {
-      x = left_endpt + i*base_len;
-      estimate += f(x);
-   }
+   estimate += Trap_sum(left_endpt, base_len, 1, trap_count-1);
    estimate = estimate*base_len;
 
    return estimate;
@@ -142,5 +169,5 @@ double Trap(
  * Input args:  x
  */
 double f(double x) {
-   return x*x;
+   return F_kernel(x);
 } /* f */
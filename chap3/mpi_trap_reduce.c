@@ -0,0 +1,370 @@
+/* File:     mpi_trap_reduce.c
+ * Purpose:  Use MPI to implement a parallel version of the trapezoidal
+ *           rule, and compare several ways of computing the global
+ *           sum of the processes' integrals:
+ *
+ *           linear:        each process != 0 sends its integral to 0,
+ *                          which receives them one at a time, as in
+ *                          mpi_trap1.c
+ *           MPI_Reduce:    as in mpi_trap3.c
+ *           tree:          our own binomial tree reduction to 0 with
+ *                          blocking sends and receives
+ *           tree_nb:       binomial tree reduction in which each
+ *                          process posts the receives from all of its
+ *                          children at once with MPI_Irecv
+ *           MPI_Allreduce: as in mpi_trap4.c
+ *           rec_dbl:       our own recursive-doubling allreduce with
+ *                          MPI_Sendrecv
+ *           rec_dbl_nb:    recursive-doubling allreduce with
+ *                          MPI_Isend/MPI_Irecv
+ *
+ * Input:    None.
+ * Output:   Estimate of the integral from a to b of f(x), and for each
+ *           reduction the time per call (max over the processes) and
+ *           the sum it computed
+ *
+ * Compile:  mpicc -g -Wall -O2 -o mpi_trap_reduce mpi_trap_reduce.c -lm
+ * Run:      mpiexec -n <number of processes> ./mpi_trap_reduce
+ *              [n] [reps]
+ *
+ * Algorithm:
+ *    1.  Each process calculates "its" interval of integration, and
+ *        estimates the integral over it with the trapezoidal rule.
+ *    2.  Each reduction is called reps times, and the average time
+ *        per call is computed.
+ *
+ * Notes:
+ *    1.  f(x), a, and b are hardwired.  n defaults to 1024, and reps
+ *        to 1000.  n should be evenly divisible by comm_sz.
+ *    2.  The linear reduction takes p-1 steps on process 0.  The
+ *        tree and recursive-doubling reductions take about log2(p)
+ *        steps.
+ *    3.  The reductions add in different orders, so the sums can
+ *        differ in the last few bits.
+ *
+ * IPP:   Section 3.4.1 (pp. 102 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <mpi.h>
+
+#define NUM_METHODS 7
+
+typedef double (*reduce_fn_t)(double local_val, int my_rank,
+      int comm_sz, MPI_Comm comm);
+
+/* Calculate local integral  */
+double Trap(double left_endpt, double right_endpt, int trap_count,
+   double base_len);
+
+/* Function we're integrating */
+double f(double x);
+
+/* Global sums:  all return the sum on process 0, and the allreduce */
+/* versions return it on every process                               */
+double Linear_sum(double local_val, int my_rank, int comm_sz,
+      MPI_Comm comm);
+double Mpi_reduce_sum(double local_val, int my_rank, int comm_sz,
+      MPI_Comm comm);
+double Tree_sum(double local_val, int my_rank, int comm_sz,
+      MPI_Comm comm);
+double Tree_sum_nb(double local_val, int my_rank, int comm_sz,
+      MPI_Comm comm);
+double Mpi_allreduce_sum(double local_val, int my_rank, int comm_sz,
+      MPI_Comm comm);
+double Rec_dbl_sum(double local_val, int my_rank, int comm_sz,
+      MPI_Comm comm);
+double Rec_dbl_sum_nb(double local_val, int my_rank, int comm_sz,
+      MPI_Comm comm);
+
+int main(int argc, char* argv[]) {
+   int my_rank, comm_sz, n = 1024, local_n, reps = 1000, rep, m;
+   double a = 0.0, b = 3.0, h, local_a, local_b;
+   double local_int, total_int = 0.0;
+   double start, my_time, max_time;
+   MPI_Comm comm;
+   reduce_fn_t methods[NUM_METHODS] = {Linear_sum, Mpi_reduce_sum,
+      Tree_sum, Tree_sum_nb, Mpi_allreduce_sum, Rec_dbl_sum,
+      Rec_dbl_sum_nb};
+   char* names[NUM_METHODS] = {"linear", "MPI_Reduce", "tree",
+      "tree_nb", "MPI_Allreduce", "rec_dbl", "rec_dbl_nb"};
+
+   MPI_Init(&argc, &argv);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_rank(comm, &my_rank);
+   MPI_Comm_size(comm, &comm_sz);
+
+   if (argc > 1) n = strtol(argv[1], NULL, 10);
+   if (argc > 2) reps = strtol(argv[2], NULL, 10);
+   if (n <= 0 || n % comm_sz != 0 || reps <= 0) {
+      if (my_rank == 0)
+         fprintf(stderr, "usage: mpiexec -n <p> %s [n] [reps]\n"
+               "   n must be evenly divisible by p\n", argv[0]);
+      MPI_Finalize();
+      return 0;
+   }
+
+   h = (b-a)/n;
+   local_n = n/comm_sz;
+   local_a = a + my_rank*local_n*h;
+   local_b = local_a + local_n*h;
+   local_int = Trap(local_a, local_b, local_n, h);
+
+   if (my_rank == 0) {
+      printf("With n = %d trapezoids and comm_sz = %d\n", n, comm_sz);
+      printf("%-14s %14s %24s\n", "reduction", "time (s)", "sum");
+   }
+   for (m = 0; m < NUM_METHODS; m++) {
+      MPI_Barrier(comm);
+      start = MPI_Wtime();
+      for (rep = 0; rep < reps; rep++)
+         total_int = methods[m](local_int, my_rank, comm_sz, comm);
+      my_time = (MPI_Wtime() - start)/reps;
+      MPI_Reduce(&my_time, &max_time, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+      if (my_rank == 0)
+         printf("%-14s %14e %24.15e\n", names[m], max_time, total_int);
+   }
+
+   MPI_Finalize();
+   return 0;
+} /*  main  */
+
+
+/*------------------------------------------------------------------
+ * Function:     Trap
+ * Purpose:      Serial function for estimating a definite integral
+ *               using the trapezoidal rule
+ * Input args:   left_endpt
+ *               right_endpt
+ *               trap_count
+ *               base_len
+ * Return val:   Trapezoidal rule estimate of integral from
+ *               left_endpt to right_endpt using trap_count
+ *               trapezoids
+ */
+double Trap(
+      double left_endpt  /* in */,
+      double right_endpt /* in */,
+      int    trap_count  /* in */,
+      double base_len    /* in */) {
+   double estimate, x;
+   int i;
+
+   estimate = (f(left_endpt) + f(right_endpt))/2.0;
+   for (i = 1; i <= trap_count-1; i++) {
+      x = left_endpt + i*base_len;
+      estimate += f(x);
+   }
+   estimate = estimate*base_len;
+
+   return estimate;
+} /*  Trap  */
+
+
+/*------------------------------------------------------------------
+ * Function:    f
+ * Purpose:     Compute value of function to be integrated
+ * Input args:  x
+ */
+double f(double x) {
+   return x*x;
+} /* f */
+
+
+/*------------------------------------------------------------------
+ * Function:    Linear_sum
+ * Purpose:     Process 0 receives the values of the other processes
+ *              one at a time, as in mpi_trap1.c
+ * Return val:  The sum on process 0
+ */
+double Linear_sum(double local_val, int my_rank, int comm_sz,
+      MPI_Comm comm) {
+   double total = local_val, val;
+   int source;
+
+   if (my_rank != 0) {
+      MPI_Send(&local_val, 1, MPI_DOUBLE, 0, 0, comm);
+   } else {
+      for (source = 1; source < comm_sz; source++) {
+         MPI_Recv(&val, 1, MPI_DOUBLE, source, 0, comm,
+               MPI_STATUS_IGNORE);
+         total += val;
+      }
+   }
+   return total;
+}  /* Linear_sum */
+
+
+/*------------------------------------------------------------------*/
+double Mpi_reduce_sum(double local_val, int my_rank, int comm_sz,
+      MPI_Comm comm) {
+   double total = 0.0;
+
+   MPI_Reduce(&local_val, &total, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+   return total;
+}  /* Mpi_reduce_sum */
+
+
+/*------------------------------------------------------------------
+ * Function:    Tree_sum
+ * Purpose:     Binomial tree reduction to process 0.  At stage
+ *              k = 1, 2, 4, ..., processes whose rank is an odd
+ *              multiple of k send their partial sums to rank - k and
+ *              drop out.  The others receive from rank + k, if it
+ *              exists.
+ * Return val:  The sum on process 0
+ */
+double Tree_sum(double local_val, int my_rank, int comm_sz,
+      MPI_Comm comm) {
+   double total = local_val, val;
+   int k;
+
+   for (k = 1; k < comm_sz; k *= 2) {
+      if (my_rank % (2*k) != 0) {
+         MPI_Send(&total, 1, MPI_DOUBLE, my_rank - k, 0, comm);
+         break;
+      } else if (my_rank + k < comm_sz) {
+         MPI_Recv(&val, 1, MPI_DOUBLE, my_rank + k, 0, comm,
+               MPI_STATUS_IGNORE);
+         total += val;
+      }
+   }
+   return total;
+}  /* Tree_sum */
+
+
+/*------------------------------------------------------------------
+ * Function:    Tree_sum_nb
+ * Purpose:     Same tree as Tree_sum, but a process posts the
+ *              receives from all of its children before it waits for
+ *              any of them.  So the children's messages can arrive
+ *              in any order.  The values are added in the same order
+ *              as in Tree_sum.
+ * Return val:  The sum on process 0
+ */
+double Tree_sum_nb(double local_val, int my_rank, int comm_sz,
+      MPI_Comm comm) {
+   double total = local_val;
+   double vals[32];
+   MPI_Request requests[32];
+   int k, n_children = 0, c, parent = -1;
+
+   for (k = 1; k < comm_sz; k *= 2) {
+      if (my_rank % (2*k) != 0) {
+         parent = my_rank - k;
+         break;
+      } else if (my_rank + k < comm_sz) {
+         MPI_Irecv(&vals[n_children], 1, MPI_DOUBLE, my_rank + k, 0,
+               comm, &requests[n_children]);
+         n_children++;
+      }
+   }
+   MPI_Waitall(n_children, requests, MPI_STATUSES_IGNORE);
+   for (c = 0; c < n_children; c++)
+      total += vals[c];
+   if (parent >= 0)
+      MPI_Send(&total, 1, MPI_DOUBLE, parent, 0, comm);
+   return total;
+}  /* Tree_sum_nb */
+
+
+/*------------------------------------------------------------------*/
+double Mpi_allreduce_sum(double local_val, int my_rank, int comm_sz,
+      MPI_Comm comm) {
+   double total;
+
+   MPI_Allreduce(&local_val, &total, 1, MPI_DOUBLE, MPI_SUM, comm);
+   return total;
+}  /* Mpi_allreduce_sum */
+
+
+/*------------------------------------------------------------------
+ * Function:    Rec_dbl_sum
+ * Purpose:     Recursive-doubling allreduce.  Let pow2 be the largest
+ *              power of 2 <= comm_sz.  First, the processes with rank
+ *              >= pow2 send their values to rank - pow2.  Then, at
+ *              stage k = 1, 2, 4, ..., process q < pow2 exchanges
+ *              its partial sum with q ^ k.  Finally, the sum is sent
+ *              back to the processes with rank >= pow2.
+ * Return val:  The sum on every process
+ */
+double Rec_dbl_sum(double local_val, int my_rank, int comm_sz,
+      MPI_Comm comm) {
+   double total = local_val, val;
+   int pow2 = 1, k, partner;
+
+   while (2*pow2 <= comm_sz) pow2 *= 2;
+
+   if (my_rank >= pow2) {
+      MPI_Send(&total, 1, MPI_DOUBLE, my_rank - pow2, 0, comm);
+      MPI_Recv(&total, 1, MPI_DOUBLE, my_rank - pow2, 0, comm,
+            MPI_STATUS_IGNORE);
+      return total;
+   }
+   if (my_rank + pow2 < comm_sz) {
+      MPI_Recv(&val, 1, MPI_DOUBLE, my_rank + pow2, 0, comm,
+            MPI_STATUS_IGNORE);
+      total += val;
+   }
+
+   for (k = 1; k < pow2; k *= 2) {
+      partner = my_rank ^ k;
+      MPI_Sendrecv(&total, 1, MPI_DOUBLE, partner, 0, &val, 1,
+            MPI_DOUBLE, partner, 0, comm, MPI_STATUS_IGNORE);
+      /* Partners get identical sums, since a two-operand add is */
+      /* commutative                                              */
+      total += val;
+   }
+
+   if (my_rank + pow2 < comm_sz)
+      MPI_Send(&total, 1, MPI_DOUBLE, my_rank + pow2, 0, comm);
+   return total;
+}  /* Rec_dbl_sum */
+
+
+/*------------------------------------------------------------------
+ * Function:    Rec_dbl_sum_nb
+ * Purpose:     Same algorithm as Rec_dbl_sum, but each exchange uses
+ *              MPI_Irecv and MPI_Isend, and the extra processes
+ *              (rank >= pow2) post their receive for the result
+ *              before they send their values.
+ * Return val:  The sum on every process
+ */
+double Rec_dbl_sum_nb(double local_val, int my_rank, int comm_sz,
+      MPI_Comm comm) {
+   double total = local_val, val, send_val;
+   int pow2 = 1, k, partner;
+   MPI_Request requests[2];
+
+   while (2*pow2 <= comm_sz) pow2 *= 2;
+
+   if (my_rank >= pow2) {
+      send_val = total;
+      MPI_Irecv(&total, 1, MPI_DOUBLE, my_rank - pow2, 1, comm,
+            &requests[0]);
+      MPI_Isend(&send_val, 1, MPI_DOUBLE, my_rank - pow2, 0, comm,
+            &requests[1]);
+      MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+      return total;
+   }
+   if (my_rank + pow2 < comm_sz) {
+      MPI_Recv(&val, 1, MPI_DOUBLE, my_rank + pow2, 0, comm,
+            MPI_STATUS_IGNORE);
+      total += val;
+   }
+
+   for (k = 1; k < pow2; k *= 2) {
+      partner = my_rank ^ k;
+      send_val = total;
+      MPI_Irecv(&val, 1, MPI_DOUBLE, partner, 0, comm, &requests[0]);
+      MPI_Isend(&send_val, 1, MPI_DOUBLE, partner, 0, comm,
+            &requests[1]);
+      MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+      total += val;
+   }
+
+   if (my_rank + pow2 < comm_sz)
+      MPI_Send(&total, 1, MPI_DOUBLE, my_rank + pow2, 1, comm);
+   return total;
+}  /* Rec_dbl_sum_nb */
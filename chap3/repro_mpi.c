@@ -0,0 +1,68 @@
+/* File:     repro_mpi.c
+ *
+ * Purpose:  Reproducible replacement for MPI_Reduce with MPI_SUM.
+ *
+ * Repro_mpi_sum:  collective:  combine the accumulators of all the
+ *                 processes in comm, in rank order, into the sum of
+ *                 all the leaves on process root
+ *
+ * Notes:
+ * 1.  Process q must have pushed a block of leaves onto its
+ *     accumulator, and the blocks must be in rank order:  e.g., the
+ *     leaves assigned by Repro_leaf_range(leaves, q, comm_sz, ...).
+ * 2.  Each process sends at most REPRO_MAX_NODES nodes, and usually
+ *     about 2*log2(leaves/comm_sz), so the cost is close to that of
+ *     MPI_Gather of a few dozen doubles.
+ *
+ * IPP:  Not discussed, but motivated by MPI_Reduce with MPI_SUM
+ *       in the trapezoidal rule programs, Section 3.4.2 (pp. 104 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "repro_mpi.h"
+
+/*-------------------------------------------------------------------
+ * Function:    Repro_mpi_sum
+ * Purpose:     Gather the nodes of every process' accumulator onto
+ *              root, and combine them with the fixed tree
+ * In args:     acc, leaves:  total number of leaves on all processes,
+ *              root, comm
+ * Return val:  On root, the sum of all the leaves.  0 on the other
+ *              processes.
+ */
+double Repro_mpi_sum(struct repro_acc_s* acc, long leaves, int root,
+      MPI_Comm comm) {
+   int my_rank, comm_sz, q, total = 0;
+   int my_bytes = acc->count*sizeof(struct repro_node_s);
+   int* counts = NULL;
+   int* displs = NULL;
+   struct repro_node_s* nodes = NULL;
+   double sum = 0.0;
+
+   MPI_Comm_rank(comm, &my_rank);
+   MPI_Comm_size(comm, &comm_sz);
+   if (my_rank == root) {
+      counts = malloc(comm_sz*sizeof(int));
+      displs = malloc(comm_sz*sizeof(int));
+   }
+   MPI_Gather(&my_bytes, 1, MPI_INT, counts, 1, MPI_INT, root, comm);
+   if (my_rank == root) {
+      for (q = 0; q < comm_sz; q++) {
+         displs[q] = total;
+         total += counts[q];
+      }
+      nodes = malloc(total);
+   }
+   MPI_Gatherv(acc->nodes, my_bytes, MPI_BYTE, nodes, counts, displs,
+         MPI_BYTE, root, comm);
+
+   if (my_rank == root) {
+      if (leaves > 0)
+         sum = Repro_value(Repro_tree(nodes,
+                  total/sizeof(struct repro_node_s), leaves));
+      free(nodes);
+      free(counts);
+      free(displs);
+   }
+   return sum;
+}  /* Repro_mpi_sum */
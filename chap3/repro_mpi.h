@@ -0,0 +1,19 @@
+/* File:     repro_mpi.h
+ * Purpose:  Header file for repro_mpi.c, which uses the sums in
+ *           repro_sum.c to add values from all the processes in a
+ *           communicator.  The result doesn't depend on the number
+ *           of processes.
+ *
+ * IPP:  Not discussed, but motivated by MPI_Reduce with MPI_SUM
+ *       in the trapezoidal rule programs, Section 3.4.2 (pp. 104 and ff.)
+ */
+#ifndef _REPRO_MPI_H_
+#define _REPRO_MPI_H_
+
+#include <mpi.h>
+#include "repro_sum.h"
+
+double Repro_mpi_sum(struct repro_acc_s* acc, long leaves, int root,
+      MPI_Comm comm);
+
+#endif
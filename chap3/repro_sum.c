@@ -0,0 +1,203 @@
+/* File:     repro_sum.c
+ *
+ * Purpose:  Implement sums that give the same result for any number
+ *           of threads or processes.
+ *
+ * Repro_combine:     add two compensated sums
+ * Repro_acc_init:    empty an accumulator
+ * Repro_acc_push:    add the next leaf sum to an accumulator
+ * Repro_tree:        combine complete subtrees that cover all the
+ *                    leaves
+ * Repro_tree_accs:   combine the subtrees in several accumulators
+ * Repro_sum_leaves:  combine an array of leaf sums
+ * Repro_leaf_range:  block partition of the leaves among processes
+ *
+ * Notes:
+ * 1.  Floating point addition isn't associative, so a reduction
+ *     whose order depends on the number of threads gives different
+ *     results for different numbers of threads.  Here the order is
+ *     fixed by the leaves:  the leaves are combined by the binary
+ *     tree in which node (level, index) is the sum of nodes
+ *     (level-1, 2*index) and (level-1, 2*index + 1).  A node whose
+ *     right child is past the last leaf is equal to its left child.
+ *     A thread with leaves first, ..., last computes the complete
+ *     subtrees inside its range, and Repro_tree finishes the tree.
+ * 2.  The nodes are combined with compensated (Neumaier) addition,
+ *     so the error of the tree is about one rounding, not log2 of
+ *     the number of leaves roundings.
+ * 3.  The cost is one pass over the leaf sums.  If a leaf is a block
+ *     of REPRO_BLOCK terms that are added with ordinary double
+ *     arithmetic, the extra cost is negligible.
+ *
+ * IPP:  Not discussed, but motivated by MPI_Reduce with MPI_SUM
+ *       in the trapezoidal rule programs, Section 3.4.2 (pp. 104 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "repro_sum.h"
+
+static repro_t Eval(struct repro_node_s nodes[], int count, int* next_p,
+      int level, long index, long leaves, int* empty_p);
+
+/*-------------------------------------------------------------------
+ * Function:  Repro_combine
+ * Purpose:   Return x + y
+ */
+repro_t Repro_combine(repro_t x, repro_t y) {
+   Repro_add(&x, y.sum);
+   x.comp += y.comp;
+   return x;
+}  /* Repro_combine */
+
+/*-------------------------------------------------------------------*/
+void Repro_acc_init(struct repro_acc_s* acc) {
+   acc->count = 0;
+}  /* Repro_acc_init */
+
+/*-------------------------------------------------------------------
+ * Function:  Repro_acc_push
+ * Purpose:   Add the sum of leaf to acc.  The leaves pushed on an
+ *            accumulator must be consecutive and increasing.
+ * Note:      As in a binary counter, whenever the last two nodes are
+ *            the two children of a node, they're replaced by their
+ *            parent.  So acc holds at most 2*log2(leaves) nodes.
+ */
+void Repro_acc_push(struct repro_acc_s* acc, long leaf, repro_t val) {
+   struct repro_node_s* left;
+   struct repro_node_s* right;
+
+   if (acc->count == REPRO_MAX_NODES) {
+      fprintf(stderr, "Repro_acc_push:  too many nodes\n");
+      exit(-1);
+   }
+   acc->nodes[acc->count].level = 0;
+   acc->nodes[acc->count].index = leaf;
+   acc->nodes[acc->count].val = val;
+   acc->count++;
+
+   while (acc->count >= 2) {
+      left = &acc->nodes[acc->count-2];
+      right = &acc->nodes[acc->count-1];
+      if (left->level != right->level || left->index % 2 != 0
+            || right->index != left->index + 1) break;
+      left->val = Repro_combine(left->val, right->val);
+      left->level++;
+      left->index /= 2;
+      acc->count--;
+   }
+}  /* Repro_acc_push */
+
+/*-------------------------------------------------------------------
+ * Function:    Eval
+ * Purpose:     Return the value of node (level, index), using the
+ *              nodes in nodes[*next_p], nodes[*next_p + 1], ...
+ *              If the node has no leaves, set *empty_p.
+ */
+static repro_t Eval(struct repro_node_s nodes[], int count, int* next_p,
+      int level, long index, long leaves, int* empty_p) {
+   repro_t left, right;
+   int right_empty;
+
+   *empty_p = 0;
+   if ((index << level) >= leaves) {
+      *empty_p = 1;
+      return Repro_zero();
+   }
+   if (*next_p < count && nodes[*next_p].level == level
+         && nodes[*next_p].index == index)
+      return nodes[(*next_p)++].val;
+   if (level == 0) {
+      fprintf(stderr, "Repro_tree:  leaf %ld is missing\n", index);
+      exit(-1);
+   }
+
+   left = Eval(nodes, count, next_p, level-1, 2*index, leaves, empty_p);
+   right = Eval(nodes, count, next_p, level-1, 2*index+1, leaves,
+         &right_empty);
+   if (right_empty) return left;
+   return Repro_combine(left, right);
+}  /* Eval */
+
+/*-------------------------------------------------------------------
+ * Function:    Repro_tree
+ * Purpose:     Combine nodes, which are complete subtrees covering
+ *              leaves 0, 1, ..., leaves-1 in increasing order, into
+ *              the root of the tree
+ */
+repro_t Repro_tree(struct repro_node_s nodes[], int count, long leaves) {
+   int level = 0, next = 0, empty;
+   repro_t root;
+
+   while ((1L << level) < leaves) level++;
+   root = Eval(nodes, count, &next, level, 0, leaves, &empty);
+   if (next != count) {
+      fprintf(stderr, "Repro_tree:  nodes don't match the tree\n");
+      exit(-1);
+   }
+   return root;
+}  /* Repro_tree */
+
+/*-------------------------------------------------------------------
+ * Function:    Repro_tree_accs
+ * Purpose:     Combine the accumulators accs[0], ..., accs[acc_count-1]
+ *              whose ranges of leaves are consecutive and cover
+ *              leaves 0, 1, ..., leaves-1
+ * Return val:  The sum of all the leaves
+ */
+double Repro_tree_accs(struct repro_acc_s accs[], int acc_count,
+      long leaves) {
+   struct repro_node_s* nodes;
+   int q, count = 0;
+   double sum;
+
+   if (leaves == 0) return 0.0;
+   for (q = 0; q < acc_count; q++)
+      count += accs[q].count;
+   nodes = malloc(count*sizeof(struct repro_node_s));
+   count = 0;
+   for (q = 0; q < acc_count; q++) {
+      memcpy(nodes + count, accs[q].nodes,
+            accs[q].count*sizeof(struct repro_node_s));
+      count += accs[q].count;
+   }
+   sum = Repro_value(Repro_tree(nodes, count, leaves));
+   free(nodes);
+   return sum;
+}  /* Repro_tree_accs */
+
+/*-------------------------------------------------------------------
+ * Function:    Repro_sum_leaves
+ * Purpose:     Return the sum of leaf_sums[0], ..., leaf_sums[leaves-1]
+ *              combined with the fixed tree
+ */
+double Repro_sum_leaves(repro_t leaf_sums[], long leaves) {
+   struct repro_acc_s acc;
+   long leaf;
+
+   if (leaves == 0) return 0.0;
+   Repro_acc_init(&acc);
+   for (leaf = 0; leaf < leaves; leaf++)
+      Repro_acc_push(&acc, leaf, leaf_sums[leaf]);
+   return Repro_value(Repro_tree(acc.nodes, acc.count, leaves));
+}  /* Repro_sum_leaves */
+
+/*-------------------------------------------------------------------
+ * Function:  Repro_leaf_range
+ * Purpose:   Find the block of leaves assigned to rank when leaves
+ *            leaves are divided among count threads or processes.
+ *            If rank gets no leaves, *last_p = *first_p - 1.
+ */
+void Repro_leaf_range(long leaves, int rank, int count,
+      long* first_p, long* last_p) {
+   long quotient = leaves/count;
+   long remainder = leaves % count;
+
+   if (rank < remainder) {
+      *first_p = rank*(quotient + 1);
+      *last_p = *first_p + quotient;
+   } else {
+      *first_p = rank*quotient + remainder;
+      *last_p = *first_p + quotient - 1;
+   }
+}  /* Repro_leaf_range */
@@ -0,0 +1,102 @@
+/* File:     repro_sum.h
+ * Purpose:  Header file for repro_sum.c, which implements sums whose
+ *           value doesn't depend on the number of threads or
+ *           processes used to compute them.
+ *
+ * Usage:
+ *    The terms are divided into "leaves" (e.g., blocks of REPRO_BLOCK
+ *    consecutive terms), and each leaf is summed in a fixed order.
+ *    The leaf sums are then combined by a binary tree whose shape
+ *    only depends on the number of leaves.  A thread or process with
+ *    a contiguous range of leaves pushes its leaf sums, in order, on
+ *    an accumulator:
+ *
+ *       struct repro_acc_s acc;
+ *       Repro_acc_init(&acc);
+ *       for (leaf = my_first; leaf <= my_last; leaf++)
+ *          Repro_acc_push(&acc, leaf, Leaf_sum(leaf));
+ *
+ *    and the accumulators of all the threads, in the order of their
+ *    ranges, are combined with
+ *
+ *       sum = Repro_tree_accs(accs, thread_count, leaves);
+ *
+ *    If the leaf sums are stored in an array (e.g., with a dynamic
+ *    schedule), use Repro_sum_leaves(leaf_sums, leaves).
+ *
+ * IPP:  Not discussed, but motivated by MPI_Reduce with MPI_SUM
+ *       in the trapezoidal rule programs, Section 3.4.2 (pp. 104 and ff.)
+ */
+#ifndef _REPRO_SUM_H_
+#define _REPRO_SUM_H_
+
+#include <math.h>
+
+#ifndef REPRO_BLOCK
+#define REPRO_BLOCK 1024   /* Terms per leaf when terms are blocked */
+#endif
+#define REPRO_MAX_NODES 128
+
+/* A sum with a compensation term:  the value is sum + comp */
+typedef struct {
+   double sum;
+   double comp;
+} repro_t;
+
+/* The subtree of the leaf tree with leaves                      */
+/*    index*2^level, index*2^level + 1, ..., (index+1)*2^level - 1 */
+struct repro_node_s {
+   int     level;
+   long    index;
+   repro_t val;
+};
+
+/* Complete subtrees, in increasing order of their leaves */
+struct repro_acc_s {
+   struct repro_node_s nodes[REPRO_MAX_NODES];
+   int                 count;
+};
+
+/*------------------------------------------------------------------
+ * Function:  Repro_zero
+ * Purpose:   Return a sum with value 0
+ */
+static inline repro_t Repro_zero(void) {
+   repro_t r = {0.0, 0.0};
+   return r;
+}  /* Repro_zero */
+
+/*------------------------------------------------------------------
+ * Function:  Repro_add
+ * Purpose:   Add x to *r, keeping the rounding error in r->comp
+ *            (Neumaier's variant of Kahan summation)
+ */
+static inline void Repro_add(repro_t* r, double x) {
+   double t = r->sum + x;
+
+   if (fabs(r->sum) >= fabs(x))
+      r->comp += (r->sum - t) + x;
+   else
+      r->comp += (x - t) + r->sum;
+   r->sum = t;
+}  /* Repro_add */
+
+/*------------------------------------------------------------------
+ * Function:  Repro_value
+ * Purpose:   Return the value of r
+ */
+static inline double Repro_value(repro_t r) {
+   return r.sum + r.comp;
+}  /* Repro_value */
+
+repro_t Repro_combine(repro_t x, repro_t y);
+void    Repro_acc_init(struct repro_acc_s* acc);
+void    Repro_acc_push(struct repro_acc_s* acc, long leaf, repro_t val);
+repro_t Repro_tree(struct repro_node_s nodes[], int count, long leaves);
+double  Repro_tree_accs(struct repro_acc_s accs[], int acc_count,
+      long leaves);
+double  Repro_sum_leaves(repro_t leaf_sums[], long leaves);
+void    Repro_leaf_range(long leaves, int rank, int count,
+      long* first_p, long* last_p);
+
+#endif
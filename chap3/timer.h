@@ -2,10 +2,16 @@
  *
  * Purpose:  Define a macro that returns the number of seconds that 
  *           have elapsed since some point in the past.  The timer
- *           should return times with microsecond accuracy.
+ *           uses the monotonic clock in instr.h, which has nanosecond
+ *           resolution and doesn't jump when the time of day is set.
+ *           See instr.h for hardware counters and region timers.
  *
- * Note:     The argument passed to the GET_TIME macro should be
- *           a double, *not* a pointer to a double.
+ * Notes:
+ * 1.  The argument passed to the GET_TIME macro should be a double,
+ *     *not* a pointer to a double.
+ * 2.  With -std=c99, include timer.h before any system header to get
+ *     the monotonic clock.  Otherwise clock_gettime isn't declared,
+ *     and the timer uses gettimeofday, as the original timer.h did.
  *
  * Example:  
  *    #include "timer.h"
@@ -25,13 +31,11 @@
 #ifndef _TIMER_H_
 #define _TIMER_H_
 
-#include <sys/time.h>
+#include "instr.h"
 
 /* The argument now should be a double (not a pointer to a double) */
 #define GET_TIME(now) { \
-   struct timeval t; \
-   gettimeofday(&t, NULL); \
-   now = t.tv_sec + t.tv_usec/1000000.0; \
+   now = Instr_seconds(); \
 }
 
 #endif
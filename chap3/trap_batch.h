@@ -0,0 +1,155 @@
+/* File:     trap_batch.h
+ * Purpose:  Batched evaluation of the integrand for the trapezoidal
+ *           rule programs.  Instead of calling f once per point,
+ *           Trap_sum fills an array of TRAP_LANES x values, evaluates
+ *           the integrand on the whole array with F_batch, and adds
+ *           the results into TRAP_LANES separate partial sums.  Each
+ *           lane's sum only depends on its own earlier values, so the
+ *           compiler can keep the lanes in one SIMD register without
+ *           reordering any additions.
+ *
+ * Usage:
+ *    approx = (F_kernel(a) + F_kernel(b))/2.0;
+ *    approx += Trap_sum(a, h, 1, n-1);    sum of f(a + i*h), 1 <= i <= n-1
+ *    approx = h*approx;
+ *
+ * Compile:  The loops over the lanes and F_batch's loop are marked
+ *           with omp simd, so add -fopenmp-simd (or -fopenmp) and -O2
+ *           or higher to the program's compile line.  Add
+ *           -DTRAP_LANES=<w> to change the number of partial sums.
+ *
+ *           Which integrands are vectorized (checked with gcc 12 and
+ *           glibc, -fopt-info-vec):
+ *           -  x*x, the default:  F_batch and the lane loops.
+ *           -  -DTRAP_EXPENSIVE, exp(-x*x)*sin(x) + sqrt(1 + x*x):
+ *              only the lane loops.  F_batch calls the scalar exp
+ *              and sin for each x, since gcc only uses the vector
+ *              versions in glibc's libmvec when -ffast-math is given.
+ *              With -ffast-math, F_batch calls libmvec, which may
+ *              round differently from libm, and the compiler may
+ *              reorder the additions, so note 1 no longer holds.
+ *
+ * Notes:
+ * 1.  The order of the additions is fixed by TRAP_LANES:  point i is
+ *     added to lane (i - first) % TRAP_LANES, in increasing order of
+ *     i, and the lanes are combined by a fixed pairwise tree.  So for
+ *     a given TRAP_LANES, the result doesn't depend on the compiler
+ *     or the vector width of the hardware.  -DTRAP_LANES=1 gives
+ *     the order of the original scalar loop.
+ * 2.  To change the integrand, change F_kernel.  It's defined in the
+ *     header so that it can be inlined into F_batch.
+ * 3.  If REPRO is defined, Trap_blocks divides the points into leaves
+ *     of REPRO_BLOCK points for the reproducible sums in repro_sum.c.
+ *     Then the result doesn't depend on the number of threads or
+ *     processes.
+ *
+ * IPP:      Section 3.4.2 (pp. 104 and ff.)
+ */
+#ifndef _TRAP_BATCH_H_
+#define _TRAP_BATCH_H_
+
+#ifdef TRAP_EXPENSIVE
+#include <math.h>
+#endif
+#ifdef REPRO
+#include "repro_sum.h"
+#endif
+
+#ifndef TRAP_LANES
+#define TRAP_LANES 8
+#endif
+
+/*------------------------------------------------------------------
+ * Function:    F_kernel
+ * Purpose:     The function we're integrating
+ */
+static inline double F_kernel(double x) {
+#  ifdef TRAP_EXPENSIVE
+   return exp(-x*x)*sin(x) + sqrt(1.0 + x*x);
+#  else
+   return x*x;
+#  endif
+}  /* F_kernel */
+
+/*------------------------------------------------------------------
+ * Function:    F_batch
+ * Purpose:     y[j] = f(x[j]) for 0 <= j < count
+ */
+static inline void F_batch(const double x[], double y[], int count) {
+   int j;
+
+#  pragma omp simd
+   for (j = 0; j < count; j++)
+      y[j] = F_kernel(x[j]);
+}  /* F_batch */
+
+/*------------------------------------------------------------------
+ * Function:    Trap_sum
+ * Purpose:     Return the sum of f(a + i*h) for first <= i <= last
+ *              using TRAP_LANES partial sums
+ */
+static inline double Trap_sum(double a, double h, long first, long last) {
+   double x[TRAP_LANES], y[TRAP_LANES], sum[TRAP_LANES];
+   long   i;
+   int    j, width, half;
+
+   for (j = 0; j < TRAP_LANES; j++)
+      sum[j] = 0.0;
+
+   for (i = first; i + TRAP_LANES - 1 <= last; i += TRAP_LANES) {
+#     pragma omp simd
+      for (j = 0; j < TRAP_LANES; j++)
+         x[j] = a + (i + j)*h;
+      F_batch(x, y, TRAP_LANES);
+#     pragma omp simd
+      for (j = 0; j < TRAP_LANES; j++)
+         sum[j] += y[j];
+   }
+
+   /* Leftover points go to the first lanes */
+   width = last - i + 1;
+   if (width > 0) {
+      for (j = 0; j < width; j++)
+         x[j] = a + (i + j)*h;
+      F_batch(x, y, width);
+      for (j = 0; j < width; j++)
+         sum[j] += y[j];
+   }
+
+   /* Combine the lanes:  sum[j] += sum[j + half] until one is left */
+   for (width = TRAP_LANES; width > 1; width = half) {
+      half = (width + 1)/2;
+      for (j = 0; j + half < width; j++)
+         sum[j] += sum[j + half];
+   }
+   return sum[0];
+}  /* Trap_sum */
+
+#ifdef REPRO
+/* Number of leaves for the points 1, 2, ..., n-1 */
+#define Trap_leaves(n) (((n) - 1 + REPRO_BLOCK - 1)/REPRO_BLOCK)
+
+/*------------------------------------------------------------------
+ * Function:    Trap_blocks
+ * Purpose:     Push the sums of f(a + i*h) over the leaves first_leaf,
+ *              ..., last_leaf of the points 1, 2, ..., n-1 on acc.
+ *              Leaf k has points 1 + k*REPRO_BLOCK, ...,
+ *              (k+1)*REPRO_BLOCK.
+ */
+static inline void Trap_blocks(double a, double h, long n, long first_leaf,
+      long last_leaf, struct repro_acc_s* acc) {
+   long    leaf, first, last;
+   repro_t r;
+
+   for (leaf = first_leaf; leaf <= last_leaf; leaf++) {
+      first = 1 + leaf*REPRO_BLOCK;
+      last = first + REPRO_BLOCK - 1;
+      if (last > n-1) last = n-1;
+      r = Repro_zero();
+      r.sum = Trap_sum(a, h, first, last);
+      Repro_acc_push(acc, leaf, r);
+   }
+}  /* Trap_blocks */
+#endif
+
+#endif
@@ -0,0 +1,252 @@
+/* File:     pth_bar_bench.c
+ *
+ * Purpose:  Time the barriers in pth_barrier.c, together with a
+ *           condition variable barrier (as in pth_cond_bar.c) and
+ *           pthread_barrier_t, for 1, 2, 4, ... threads.
+ *
+ * Compile:  gcc -g -Wall -O2 -o pth_bar_bench pth_bar_bench.c
+ *              pth_barrier.c -lpthread
+ *           timer.h needs to be available
+ * Usage:    ./pth_bar_bench <max threads> [barrier count] [barrier ...]
+ *           barrier count is the number of barriers each thread
+ *              executes (default BARRIER_COUNT)
+ *           barrier is one of sense, tree, dissem, futex, hybrid,
+ *              cond, pthread.  The default is all of them.
+ *
+ * Input:    none
+ * Output:   For each number of threads and each barrier, the elapsed
+ *           time and the time per barrier
+ *
+ * Notes:
+ * 1.  The numbers of threads are the powers of 2 less than max
+ *     threads, and max threads.
+ * 2.  Compile with -DDEBUG to check that no thread leaves a barrier
+ *     before every thread has arrived at it.
+ * 3.  The spinning barriers should only be compared with the others
+ *     when there are at least as many cores as threads.
+ *
+ * IPP:      Not discussed, but see Section 4.8 (pp. 176 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "timer.h"
+#include "pth_barrier.h"
+
+#define BARRIER_COUNT 100000
+
+#define BAR_COND    BAR_TYPES
+#define BAR_PTHREAD (BAR_TYPES + 1)
+#define ALL_TYPES   (BAR_TYPES + 2)
+
+const int MAX_THREADS = 1024;
+
+int thread_count;
+int barrier_count;
+int type;
+
+struct barrier_s bar;
+
+/* Condition variable barrier */
+int cond_count = 0;
+int cond_cycle = 0;
+pthread_mutex_t cond_mutex;
+pthread_cond_t ok_to_proceed;
+
+pthread_barrier_t pth_bar;
+
+#ifdef DEBUG
+atomic_int arrivals;
+atomic_int errors;
+#endif
+
+void Usage(char* prog_name);
+void Get_args(int argc, char* argv[], int* max_threads_p, int use[]);
+const char* Type_name(int type);
+double Run(int type, pthread_t thread_handles[]);
+void Cond_wait(void);
+void *Thread_work(void* rank);
+
+/*--------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   pthread_t* thread_handles;
+   int max_threads, use[ALL_TYPES];
+   double elapsed;
+
+   Get_args(argc, argv, &max_threads, use);
+   thread_handles = malloc(max_threads*sizeof(pthread_t));
+   pthread_mutex_init(&cond_mutex, NULL);
+   pthread_cond_init(&ok_to_proceed, NULL);
+
+   printf("%d barriers per thread\n", barrier_count);
+   printf("threads  barrier   elapsed (s)   per barrier (us)\n");
+   thread_count = 1;
+   while (1) {
+      for (type = 0; type < ALL_TYPES; type++) {
+         if (!use[type]) continue;
+         elapsed = Run(type, thread_handles);
+         printf("%7d  %-8s  %e  %e\n", thread_count, Type_name(type),
+               elapsed, 1.0e6*elapsed/barrier_count);
+         fflush(stdout);
+      }
+      if (thread_count == max_threads) break;
+      thread_count = (2*thread_count < max_threads) ?
+         2*thread_count : max_threads;
+   }
+
+   pthread_cond_destroy(&ok_to_proceed);
+   pthread_mutex_destroy(&cond_mutex);
+   free(thread_handles);
+   return 0;
+}  /* main */
+
+/*--------------------------------------------------------------------
+ * Function:    Usage
+ * Purpose:     Print command line for function and terminate
+ * In arg:      prog_name
+ */
+void Usage(char* prog_name) {
+   int type;
+
+   fprintf(stderr, "usage: %s <max threads> [barrier count] [barrier ...]\n",
+         prog_name);
+   fprintf(stderr, "   barrier is one of");
+   for (type = 0; type < ALL_TYPES; type++)
+      fprintf(stderr, " %s", Type_name(type));
+   fprintf(stderr, "\n");
+   exit(0);
+}  /* Usage */
+
+/*--------------------------------------------------------------------
+ * Function:    Get_args
+ * Purpose:     Get the command line args
+ * In args:     argc, argv
+ * Out args:    max_threads_p, use:  use[type] = 1 if type should be
+ *              timed
+ * Global out:  barrier_count
+ */
+void Get_args(int argc, char* argv[], int* max_threads_p, int use[]) {
+   int i, t;
+
+   if (argc < 2) Usage(argv[0]);
+   *max_threads_p = strtol(argv[1], NULL, 10);
+   if (*max_threads_p <= 0 || *max_threads_p > MAX_THREADS) Usage(argv[0]);
+   barrier_count = (argc > 2) ? strtol(argv[2], NULL, 10) : BARRIER_COUNT;
+   if (barrier_count <= 0) Usage(argv[0]);
+
+   for (t = 0; t < ALL_TYPES; t++)
+      use[t] = (argc <= 3);
+   for (i = 3; i < argc; i++) {
+      for (t = 0; t < ALL_TYPES; t++)
+         if (strcmp(argv[i], Type_name(t)) == 0) break;
+      if (t == ALL_TYPES) Usage(argv[0]);
+      use[t] = 1;
+   }
+}  /* Get_args */
+
+/*--------------------------------------------------------------------*/
+const char* Type_name(int type) {
+   if (type == BAR_COND) return "cond";
+   if (type == BAR_PTHREAD) return "pthread";
+   return barrier_names[type];
+}  /* Type_name */
+
+/*--------------------------------------------------------------------
+ * Function:    Run
+ * Purpose:     Start thread_count threads, each of which executes
+ *              barrier_count barriers of the given type
+ * Return val:  Elapsed time
+ */
+double Run(int type, pthread_t thread_handles[]) {
+   long thread;
+   double start, finish;
+
+   if (type < BAR_TYPES)
+      Barrier_init(&bar, type, thread_count);
+   else if (type == BAR_PTHREAD)
+      pthread_barrier_init(&pth_bar, NULL, thread_count);
+#  ifdef DEBUG
+   atomic_store(&arrivals, 0);
+   atomic_store(&errors, 0);
+#  endif
+
+   GET_TIME(start);
+   for (thread = 0; thread < thread_count; thread++)
+      pthread_create(&thread_handles[thread], NULL, Thread_work,
+            (void*) thread);
+   for (thread = 0; thread < thread_count; thread++)
+      pthread_join(thread_handles[thread], NULL);
+   GET_TIME(finish);
+
+#  ifdef DEBUG
+   if (atomic_load(&errors) > 0)
+      printf("%s:  %d threads left a barrier early\n", Type_name(type),
+            atomic_load(&errors));
+#  endif
+   if (type < BAR_TYPES)
+      Barrier_destroy(&bar);
+   else if (type == BAR_PTHREAD)
+      pthread_barrier_destroy(&pth_bar);
+   return finish - start;
+}  /* Run */
+
+/*--------------------------------------------------------------------
+ * Function:    Cond_wait
+ * Purpose:     Condition variable barrier, as in pth_cond_bar.c.  The
+ *              cycle number keeps a thread that's woken by another
+ *              event from leaving too early.
+ */
+void Cond_wait(void) {
+   int my_cycle;
+
+   pthread_mutex_lock(&cond_mutex);
+   my_cycle = cond_cycle;
+   cond_count++;
+   if (cond_count == thread_count) {
+      cond_count = 0;
+      cond_cycle++;
+      pthread_cond_broadcast(&ok_to_proceed);
+   } else {
+      while (my_cycle == cond_cycle)
+         pthread_cond_wait(&ok_to_proceed, &cond_mutex);
+   }
+   pthread_mutex_unlock(&cond_mutex);
+}  /* Cond_wait */
+
+/*-------------------------------------------------------------------
+ * Function:    Thread_work
+ * Purpose:     Run barrier_count barriers
+ * In arg:      rank
+ * Global var:  thread_count, barrier_count, type, and the barriers
+ * Return val:  Ignored
+ */
+void *Thread_work(void* rank) {
+   int my_rank = (long) rank;
+   int i;
+
+   for (i = 0; i < barrier_count; i++) {
+#     ifdef DEBUG
+      atomic_fetch_add(&arrivals, 1);
+#     endif
+      switch (type) {
+         case BAR_COND:
+            Cond_wait();
+            break;
+         case BAR_PTHREAD:
+            pthread_barrier_wait(&pth_bar);
+            break;
+         default:
+            Barrier_wait(&bar, my_rank);
+      }
+#     ifdef DEBUG
+      /* Every thread has arrived at barrier i, and no thread can */
+      /* arrive at barrier i+2 until this thread reaches i+1      */
+      if (atomic_load(&arrivals) < (i+1)*thread_count)
+         atomic_fetch_add(&errors, 1);
+#     endif
+   }
+
+   return NULL;
+}  /* Thread_work */
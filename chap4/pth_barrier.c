@@ -0,0 +1,303 @@
+/* File:     pth_barrier.c
+ *
+ * Purpose:  Implement barriers for Pthreads that scale better than
+ *           the busy-wait and condition variable barriers in
+ *           pth_busy_bar.c and pth_cond_bar.c.
+ *
+ *    sense:   One counter.  The last thread to arrive resets it and
+ *             flips a shared "sense" flag, and the others spin until
+ *             the flag equals their own sense.  Alternating the sense
+ *             means the barrier can be reused right away.
+ *    tree:    Threads arrive at the leaves of a tree of counters with
+ *             BAR_FANIN children per node.  The last thread to arrive
+ *             at a node moves up to its parent, and the last thread at
+ *             the root flips the sense flag.  Each counter is only
+ *             updated by BAR_FANIN threads, so there's much less
+ *             contention than with one counter.
+ *    dissem:  Dissemination barrier.  In round k = 0, 1, ...,
+ *             ceil(log2(p))-1, thread r sets a flag belonging to
+ *             thread (r + 2^k) % p, and waits for its own flag to be
+ *             set by thread (r - 2^k) % p.  There are no counters, and
+ *             each flag has one writer and one reader.
+ *    futex:   One counter, but waiting threads sleep in the kernel
+ *             (Linux futex) until the last thread increments a
+ *             generation number and wakes them.
+ *    hybrid:  Like futex, but threads spin for HYBRID_SPINS checks
+ *             before they sleep, and the last thread only makes the
+ *             wake system call if some thread is asleep.
+ *
+ * Notes:
+ * 1.  The spinning barriers (sense, tree, dissem) are fastest when
+ *     every thread has its own core.  If there are more threads than
+ *     cores, a spinning thread can keep the thread it's waiting for
+ *     from running, so spinning threads call sched_yield after
+ *     YIELD_SPINS checks.
+ * 2.  futex and hybrid only work on Linux.
+ * 3.  Counters and per-thread flags are on their own cache lines.
+ *
+ * IPP:  Not discussed, but an alternative to the barriers in
+ *       Section 4.8 (pp. 176 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include "pth_barrier.h"
+
+#define YIELD_SPINS  1000
+#define HYBRID_SPINS 2000
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX() __builtin_ia32_pause()
+#else
+#define CPU_RELAX()
+#endif
+
+const char* barrier_names[BAR_TYPES] =
+   {"sense", "tree", "dissem", "futex", "hybrid"};
+
+static void Spin_until_equal(atomic_int* word, int val);
+static void Futex_wait(atomic_int* word, int val);
+static void Futex_wake(atomic_int* word);
+static void Tree_init(struct barrier_s* bar);
+static void Sense_wait(struct barrier_s* bar, int my_rank);
+static void Tree_wait(struct barrier_s* bar, int my_rank);
+static void Dissem_wait(struct barrier_s* bar, int my_rank);
+static void Futex_bar_wait(struct barrier_s* bar, int spins);
+
+/*-------------------------------------------------------------------
+ * Function:    Barrier_type
+ * Purpose:     Find the type of barrier with the given name
+ * Return val:  The type, or -1 if there's no such barrier
+ */
+int Barrier_type(const char* name) {
+   int type;
+
+   for (type = 0; type < BAR_TYPES; type++)
+      if (strcmp(name, barrier_names[type]) == 0) return type;
+   return -1;
+}  /* Barrier_type */
+
+/*-------------------------------------------------------------------
+ * Function:  Barrier_init
+ * Purpose:   Initialize a barrier of the given type for thread_count
+ *            threads
+ */
+void Barrier_init(struct barrier_s* bar, int type, int thread_count) {
+   int r, j, k;
+
+   bar->type = type;
+   bar->thread_count = thread_count;
+   bar->threads = aligned_alloc(BAR_CACHE_LINE,
+         thread_count*sizeof(struct bar_thread_s));
+   for (r = 0; r < thread_count; r++) {
+      bar->threads[r].sense = 0;
+      bar->threads[r].parity = 0;
+      for (j = 0; j < 2; j++)
+         for (k = 0; k < BAR_MAX_ROUNDS; k++)
+            atomic_init(&bar->threads[r].flags[j][k], 0);
+   }
+   atomic_init(&bar->counter.count, 0);
+   atomic_init(&bar->sense, 0);
+   atomic_init(&bar->generation, 0);
+   atomic_init(&bar->sleepers, 0);
+
+   bar->nodes = NULL;
+   bar->node_size = bar->node_parent = NULL;
+   if (type == BAR_TREE) Tree_init(bar);
+
+   bar->rounds = 0;
+   while ((1 << bar->rounds) < thread_count) bar->rounds++;
+}  /* Barrier_init */
+
+/*-------------------------------------------------------------------
+ * Function:  Tree_init
+ * Purpose:   Build the tree of counters for BAR_TREE.  Level 0 has
+ *            ceil(p/BAR_FANIN) leaves, each of the next levels has
+ *            ceil(width/BAR_FANIN) nodes, and the last level has one
+ *            node, the root.
+ */
+static void Tree_init(struct barrier_s* bar) {
+   int total = 0, width, level_first, next_first, i, children;
+
+   children = bar->thread_count;
+   do {
+      width = (children + BAR_FANIN - 1)/BAR_FANIN;
+      total += width;
+      children = width;
+   } while (width > 1);
+   bar->nodes = aligned_alloc(BAR_CACHE_LINE,
+         total*sizeof(struct bar_counter_s));
+   bar->node_size = malloc(total*sizeof(int));
+   bar->node_parent = malloc(total*sizeof(int));
+
+   /* Children of the current level:  threads, then nodes */
+   children = bar->thread_count;
+   level_first = 0;
+   while (1) {
+      width = (children + BAR_FANIN - 1)/BAR_FANIN;
+      next_first = level_first + width;
+      for (i = 0; i < width; i++) {
+         atomic_init(&bar->nodes[level_first + i].count, 0);
+         bar->node_size[level_first + i] =
+            (i < width - 1) ? BAR_FANIN : children - i*BAR_FANIN;
+         bar->node_parent[level_first + i] =
+            (width == 1) ? -1 : next_first + i/BAR_FANIN;
+      }
+      if (width == 1) break;
+      children = width;
+      level_first = next_first;
+   }
+}  /* Tree_init */
+
+/*-------------------------------------------------------------------
+ * Function:  Barrier_wait
+ * Purpose:   Return when all thread_count threads have called
+ *            Barrier_wait
+ */
+void Barrier_wait(struct barrier_s* bar, int my_rank) {
+   switch (bar->type) {
+      case BAR_SENSE:  Sense_wait(bar, my_rank);              break;
+      case BAR_TREE:   Tree_wait(bar, my_rank);               break;
+      case BAR_DISSEM: Dissem_wait(bar, my_rank);             break;
+      case BAR_FUTEX:  Futex_bar_wait(bar, 0);                break;
+      case BAR_HYBRID: Futex_bar_wait(bar, HYBRID_SPINS);     break;
+   }
+}  /* Barrier_wait */
+
+/*-------------------------------------------------------------------
+ * Function:  Barrier_destroy
+ * Purpose:   Free the storage used by bar
+ */
+void Barrier_destroy(struct barrier_s* bar) {
+   free(bar->threads);
+   free(bar->nodes);
+   free(bar->node_size);
+   free(bar->node_parent);
+}  /* Barrier_destroy */
+
+/*-------------------------------------------------------------------
+ * Function:  Spin_until_equal
+ * Purpose:   Busy-wait until *word == val, yielding the processor
+ *            every YIELD_SPINS checks
+ */
+static void Spin_until_equal(atomic_int* word, int val) {
+   int spins = 0;
+
+   while (atomic_load_explicit(word, memory_order_acquire) != val) {
+      CPU_RELAX();
+      if (++spins == YIELD_SPINS) {
+         sched_yield();
+         spins = 0;
+      }
+   }
+}  /* Spin_until_equal */
+
+/*-------------------------------------------------------------------*/
+static void Futex_wait(atomic_int* word, int val) {
+   syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}  /* Futex_wait */
+
+/*-------------------------------------------------------------------*/
+static void Futex_wake(atomic_int* word) {
+   syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, __INT_MAX__, NULL, NULL, 0);
+}  /* Futex_wake */
+
+/*-------------------------------------------------------------------
+ * Function:  Sense_wait
+ * Purpose:   Centralized sense-reversing barrier
+ */
+static void Sense_wait(struct barrier_s* bar, int my_rank) {
+   int my_sense = bar->threads[my_rank].sense = !bar->threads[my_rank].sense;
+
+   if (atomic_fetch_add_explicit(&bar->counter.count, 1,
+            memory_order_acq_rel) == bar->thread_count - 1) {
+      atomic_store_explicit(&bar->counter.count, 0, memory_order_relaxed);
+      atomic_store_explicit(&bar->sense, my_sense, memory_order_release);
+   } else {
+      Spin_until_equal(&bar->sense, my_sense);
+   }
+}  /* Sense_wait */
+
+/*-------------------------------------------------------------------
+ * Function:  Tree_wait
+ * Purpose:   Combining tree barrier.  The counter of a node is reset
+ *            by the last thread to arrive, before the sense flag is
+ *            flipped, so it's ready for the next barrier.
+ */
+static void Tree_wait(struct barrier_s* bar, int my_rank) {
+   int my_sense = bar->threads[my_rank].sense = !bar->threads[my_rank].sense;
+   int node = my_rank/BAR_FANIN;
+
+   while (1) {
+      if (atomic_fetch_add_explicit(&bar->nodes[node].count, 1,
+               memory_order_acq_rel) != bar->node_size[node] - 1) {
+         Spin_until_equal(&bar->sense, my_sense);
+         return;
+      }
+      atomic_store_explicit(&bar->nodes[node].count, 0,
+            memory_order_relaxed);
+      if (bar->node_parent[node] < 0) break;
+      node = bar->node_parent[node];
+   }
+   atomic_store_explicit(&bar->sense, my_sense, memory_order_release);
+}  /* Tree_wait */
+
+/*-------------------------------------------------------------------
+ * Function:  Dissem_wait
+ * Purpose:   Dissemination barrier.  Flags alternate between two sets
+ *            (parity), and the value that means "set" alternates
+ *            every other barrier (sense), so no flag ever needs to be
+ *            reset.
+ */
+static void Dissem_wait(struct barrier_s* bar, int my_rank) {
+   struct bar_thread_s* me = &bar->threads[my_rank];
+   int round, partner, sense = !me->sense;
+
+   for (round = 0; round < bar->rounds; round++) {
+      partner = (my_rank + (1 << round)) % bar->thread_count;
+      atomic_store_explicit(&bar->threads[partner].flags[me->parity][round],
+            sense, memory_order_release);
+      Spin_until_equal(&me->flags[me->parity][round], sense);
+   }
+   if (me->parity == 1) me->sense = !me->sense;
+   me->parity = 1 - me->parity;
+}  /* Dissem_wait */
+
+/*-------------------------------------------------------------------
+ * Function:  Futex_bar_wait
+ * Purpose:   Centralized barrier in which waiting threads sleep.
+ *            If spins > 0, check the generation spins times before
+ *            sleeping.
+ * Note:      The generation is read before arriving, so a thread
+ *            can't miss the increment.  futex wait returns right
+ *            away if the generation has already changed.
+ */
+static void Futex_bar_wait(struct barrier_s* bar, int spins) {
+   int gen = atomic_load_explicit(&bar->generation, memory_order_acquire);
+   int i;
+
+   if (atomic_fetch_add_explicit(&bar->counter.count, 1,
+            memory_order_acq_rel) == bar->thread_count - 1) {
+      atomic_store_explicit(&bar->counter.count, 0, memory_order_relaxed);
+      atomic_fetch_add(&bar->generation, 1);
+      if (spins == 0 || atomic_load(&bar->sleepers) > 0)
+         Futex_wake(&bar->generation);
+      return;
+   }
+
+   for (i = 0; i < spins; i++) {
+      if (atomic_load_explicit(&bar->generation, memory_order_acquire)
+            != gen) return;
+      CPU_RELAX();
+   }
+
+   atomic_fetch_add(&bar->sleepers, 1);
+   while (atomic_load_explicit(&bar->generation, memory_order_acquire)
+         == gen)
+      Futex_wait(&bar->generation, gen);
+   atomic_fetch_sub(&bar->sleepers, 1);
+}  /* Futex_bar_wait */
@@ -0,0 +1,74 @@
+/* File:     pth_barrier.h
+ * Purpose:  Header file for pth_barrier.c, which implements several
+ *           kinds of barrier for Pthreads.
+ *
+ * Usage:
+ *    struct barrier_s bar;
+ *    Barrier_init(&bar, BAR_DISSEM, thread_count);  (main thread)
+ *    . . .
+ *    Barrier_wait(&bar, my_rank);                   (every thread)
+ *    . . .
+ *    Barrier_destroy(&bar);                         (main thread)
+ *
+ *    Barrier_type("dissem") returns BAR_DISSEM, etc.
+ *
+ * IPP:  Not discussed, but an alternative to the barriers in
+ *       Section 4.8 (pp. 176 and ff.)
+ */
+#ifndef _PTH_BARRIER_H_
+#define _PTH_BARRIER_H_
+
+#include <stdatomic.h>
+
+#define BAR_SENSE  0   /* Centralized counter with sense reversal    */
+#define BAR_TREE   1   /* Combining tree of counters                 */
+#define BAR_DISSEM 2   /* Dissemination:  log2(p) rounds of flags    */
+#define BAR_FUTEX  3   /* Centralized counter, sleep in futex wait   */
+#define BAR_HYBRID 4   /* Centralized counter, spin then futex wait  */
+#define BAR_TYPES  5
+
+#define BAR_CACHE_LINE 64
+#define BAR_FANIN      4     /* Children per node of the tree        */
+#define BAR_MAX_ROUNDS 32    /* Rounds of the dissemination barrier  */
+
+extern const char* barrier_names[BAR_TYPES];
+
+/* A counter on its own cache line */
+struct bar_counter_s {
+   _Alignas(BAR_CACHE_LINE) atomic_int count;
+};
+
+/* Per-thread state, on its own cache line(s) */
+struct bar_thread_s {
+   _Alignas(BAR_CACHE_LINE) int sense;
+   int         parity;                           /* Dissemination */
+   atomic_int  flags[2][BAR_MAX_ROUNDS];         /* Dissemination */
+};
+
+struct barrier_s {
+   int                   type;
+   int                   thread_count;
+   struct bar_thread_s*  threads;
+
+   /* BAR_SENSE, BAR_FUTEX, BAR_HYBRID */
+   struct bar_counter_s  counter;
+   _Alignas(BAR_CACHE_LINE) atomic_int sense;   /* Also BAR_TREE    */
+   atomic_int            generation;             /* Futex word       */
+   atomic_int            sleepers;
+
+   /* BAR_TREE:  thread r arrives at leaf r/BAR_FANIN.  The leaves  */
+   /* come first, then each level of the tree, and the root is last */
+   struct bar_counter_s* nodes;
+   int*                  node_size;   /* Arrivals expected at node   */
+   int*                  node_parent; /* -1 for the root             */
+
+   /* BAR_DISSEM */
+   int                   rounds;
+};
+
+int  Barrier_type(const char* name);
+void Barrier_init(struct barrier_s* bar, int type, int thread_count);
+void Barrier_wait(struct barrier_s* bar, int my_rank);
+void Barrier_destroy(struct barrier_s* bar);
+
+#endif
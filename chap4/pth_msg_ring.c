@@ -0,0 +1,328 @@
+/* File:     pth_msg_ring.c
+ *
+ * Purpose:  Send messages around a ring of threads, as in pth_msg.c
+ *           and pth_msg_sem.c, using the lock-free queues in
+ *           pth_ring.c.  Thread r sends to thread (r+1) % thread_count
+ *           and receives from thread (r-1+thread_count) % thread_count.
+ *
+ *              spsc:  each thread has an spsc queue of incoming
+ *                     messages
+ *              mpmc:  all the threads send to and receive from one
+ *                     shared mpmc queue
+ *              sem:   each thread has a one-message buffer and two
+ *                     semaphores, as in pth_msg_sem.c
+ *
+ *           With one message per thread (the default), each thread
+ *           prints the message it receives.  With more (streaming
+ *           mode), the program prints the rate at which messages are
+ *           sent and checks that they all arrived.
+ *
+ * Input:    none
+ * Output:   The message received by each thread, or the elapsed time,
+ *           the number of messages per second, and the number of
+ *           messages that were out of order or missing
+ *
+ * Compile:  gcc -g -Wall -O2 -o pth_msg_ring pth_msg_ring.c pth_ring.c
+ *              -lpthread
+ *           timer.h needs to be available
+ * Usage:    ./pth_msg_ring <thread_count> <spsc|mpmc|sem> [messages]
+ *           messages is the number of messages each thread sends
+ *
+ * Notes:
+ * 1.  None of the buffers are allocated while messages are being
+ *     sent:  every queue has RING_SLOTS preallocated slots, and the
+ *     sem buffers are allocated in main.
+ * 2.  With spsc and mpmc a thread alternates between sending and
+ *     receiving, and never blocks, so a full queue can't deadlock the
+ *     ring.  If a thread can neither send nor receive, it calls
+ *     sched_yield after YIELD_SPINS tries, which matters when there are
+ *     more threads than cores.
+ * 3.  With spsc and sem the messages from a thread must arrive in
+ *     order.  With mpmc a thread can receive a message from any
+ *     thread, so the program only checks that the sum of the sequence
+ *     numbers received is the sum of those sent.
+ *
+ * IPP:      Not discussed, but see Section 4.7 (pp. 172 and ff.)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <sched.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "timer.h"
+#include "pth_ring.h"
+
+#define MSG_MAX     100
+#define RING_SLOTS  1024
+#define YIELD_SPINS 100
+
+#define SPSC 0
+#define MPMC 1
+#define SEM  2
+
+const int MAX_THREADS = 1024;
+const char* mode_names[] = {"spsc", "mpmc", "sem"};
+
+struct msg_s {
+   long src;
+   long seq;
+   char text[MSG_MAX];
+};
+
+/* Global variables:  accessible to all threads */
+int thread_count;
+int mode;
+long msg_count;
+
+struct spsc_ring_s* spsc_rings;    /* spsc:  one per thread */
+struct mpmc_ring_s  mpmc_ring;     /* mpmc:  shared         */
+struct msg_s* buffers;             /* sem:   one per thread */
+sem_t* empty;
+sem_t* full;
+
+long* errors;                      /* One entry per thread  */
+long* seq_sums;
+
+void Usage(char* prog_name);
+void Get_args(int argc, char* argv[]);
+int Try_send(long dest, struct msg_s* msg, int size);
+int Try_recv(long my_rank, struct msg_s* msg);
+void Sem_send(long dest, struct msg_s* msg, int size);
+void Sem_recv(long my_rank, struct msg_s* msg);
+void *Send_msgs(void* rank);  /* Thread function */
+
+/*--------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   long       thread;
+   pthread_t* thread_handles;
+   double start, finish, elapsed;
+   long total_errors = 0, seq_sum = 0;
+
+   Get_args(argc, argv);
+
+   thread_handles = malloc(thread_count*sizeof(pthread_t));
+   errors = malloc(thread_count*sizeof(long));
+   seq_sums = malloc(thread_count*sizeof(long));
+   switch (mode) {
+      case SPSC:
+         spsc_rings = aligned_alloc(RING_CACHE_LINE,
+               thread_count*sizeof(struct spsc_ring_s));
+         for (thread = 0; thread < thread_count; thread++)
+            Spsc_init(&spsc_rings[thread], RING_SLOTS, sizeof(struct msg_s));
+         break;
+      case MPMC:
+         Mpmc_init(&mpmc_ring, RING_SLOTS, sizeof(struct msg_s));
+         break;
+      case SEM:
+         buffers = malloc(thread_count*sizeof(struct msg_s));
+         empty = malloc(thread_count*sizeof(sem_t));
+         full = malloc(thread_count*sizeof(sem_t));
+         for (thread = 0; thread < thread_count; thread++) {
+            sem_init(&empty[thread], 0, 1);
+            sem_init(&full[thread], 0, 0);
+         }
+         break;
+   }
+
+   GET_TIME(start);
+   for (thread = 0; thread < thread_count; thread++)
+      pthread_create(&thread_handles[thread], (pthread_attr_t*) NULL,
+          Send_msgs, (void*) thread);
+
+   for (thread = 0; thread < thread_count; thread++)
+      pthread_join(thread_handles[thread], NULL);
+   GET_TIME(finish);
+   elapsed = finish - start;
+
+   for (thread = 0; thread < thread_count; thread++) {
+      total_errors += errors[thread];
+      seq_sum += seq_sums[thread];
+   }
+   if (seq_sum != thread_count*(msg_count*(msg_count - 1)/2))
+      total_errors++;
+   if (msg_count > 1) {
+      printf("%s:  %d threads sent %ld messages each\n", mode_names[mode],
+            thread_count, msg_count);
+      printf("   Elapsed time = %e seconds, %e messages per second\n",
+            elapsed, thread_count*msg_count/elapsed);
+   }
+   if (total_errors > 0)
+      printf("   %ld messages were out of order or missing\n", total_errors);
+
+   switch (mode) {
+      case SPSC:
+         for (thread = 0; thread < thread_count; thread++)
+            Spsc_free(&spsc_rings[thread]);
+         free(spsc_rings);
+         break;
+      case MPMC:
+         Mpmc_free(&mpmc_ring);
+         break;
+      case SEM:
+         for (thread = 0; thread < thread_count; thread++) {
+            sem_destroy(&empty[thread]);
+            sem_destroy(&full[thread]);
+         }
+         free(buffers);
+         free(empty);
+         free(full);
+         break;
+   }
+   free(errors);
+   free(seq_sums);
+   free(thread_handles);
+   return 0;
+}  /* main */
+
+
+/*--------------------------------------------------------------------
+ * Function:    Usage
+ * Purpose:     Print command line for function and terminate
+ * In arg:      prog_name
+ */
+void Usage(char* prog_name) {
+
+   fprintf(stderr, "usage: %s <number of threads> <spsc|mpmc|sem> [messages]\n",
+         prog_name);
+   fprintf(stderr, "   messages is the number sent by each thread\n");
+   exit(0);
+}  /* Usage */
+
+
+/*--------------------------------------------------------------------
+ * Function:    Get_args
+ * Purpose:     Get the command line args
+ * In args:     argc, argv
+ * Globals out: thread_count, mode, msg_count
+ */
+void Get_args(int argc, char* argv[]) {
+   if (argc != 3 && argc != 4) Usage(argv[0]);
+   thread_count = strtol(argv[1], NULL, 10);
+   if (thread_count <= 0 || thread_count > MAX_THREADS) Usage(argv[0]);
+   for (mode = SPSC; mode <= SEM; mode++)
+      if (strcmp(argv[2], mode_names[mode]) == 0) break;
+   if (mode > SEM) Usage(argv[0]);
+   msg_count = (argc == 4) ? strtol(argv[3], NULL, 10) : 1;
+   if (msg_count <= 0) Usage(argv[0]);
+}  /* Get_args */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Try_send
+ * Purpose:     Send the first size bytes of msg to dest without
+ *              blocking (spsc and mpmc)
+ * Return val:  1 if the message was sent, 0 if the queue was full
+ */
+int Try_send(long dest, struct msg_s* msg, int size) {
+   if (mode == SPSC)
+      return Spsc_send(&spsc_rings[dest], msg, size);
+   else
+      return Mpmc_send(&mpmc_ring, msg, size);
+}  /* Try_send */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Try_recv
+ * Purpose:     Receive a message without blocking (spsc and mpmc)
+ * Return val:  1 if a message was received, 0 if the queue was empty
+ */
+int Try_recv(long my_rank, struct msg_s* msg) {
+   if (mode == SPSC)
+      return Spsc_recv(&spsc_rings[my_rank], msg) >= 0;
+   else
+      return Mpmc_recv(&mpmc_ring, msg) >= 0;
+}  /* Try_recv */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Sem_send
+ * Purpose:     Wait until dest's buffer is empty, copy msg into it and
+ *              tell dest
+ */
+void Sem_send(long dest, struct msg_s* msg, int size) {
+   sem_wait(&empty[dest]);
+   memcpy(&buffers[dest], msg, size);
+   sem_post(&full[dest]);
+}  /* Sem_send */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Sem_recv
+ * Purpose:     Wait until there's a message in our buffer, copy it out
+ *              and tell the sender the buffer is empty
+ */
+void Sem_recv(long my_rank, struct msg_s* msg) {
+   sem_wait(&full[my_rank]);
+   memcpy(msg, &buffers[my_rank], sizeof(struct msg_s));
+   sem_post(&empty[my_rank]);
+}  /* Sem_recv */
+
+
+/*-------------------------------------------------------------------
+ * Function:       Send_msgs
+ * Purpose:        Send msg_count messages to dest, and receive
+ *                 msg_count messages.  Print the message if there's
+ *                 only one.
+ * In arg:         rank
+ * Global in:      thread_count, mode, msg_count
+ * Global in/out:  the queues or buffers
+ * Global out:     errors[my_rank], seq_sums[my_rank]
+ * Return val:     Ignored
+ */
+void *Send_msgs(void* rank) {
+   long my_rank = (long) rank;
+   long dest = (my_rank + 1) % thread_count;
+   long source = (my_rank + thread_count - 1) % thread_count;
+   long sent = 0, received = 0, my_errors = 0, my_seq_sum = 0;
+   struct msg_s out, in;
+   int size, progress, spins = 0;
+
+   out.src = my_rank;
+   if (msg_count == 1) {
+      sprintf(out.text, "Hello to %ld from %ld", dest, my_rank);
+      size = offsetof(struct msg_s, text) + strlen(out.text) + 1;
+   } else {
+      out.text[0] = '\0';
+      size = offsetof(struct msg_s, text) + 1;
+   }
+
+   while (sent < msg_count || received < msg_count) {
+      progress = 0;
+      if (mode == SEM) {
+         out.seq = sent++;
+         Sem_send(dest, &out, size);
+         Sem_recv(my_rank, &in);
+         progress = 2;
+      } else {
+         out.seq = sent;
+         if (sent < msg_count && Try_send(dest, &out, size)) {
+            sent++;
+            progress = 1;
+         }
+         if (received < msg_count && Try_recv(my_rank, &in))
+            progress = 2;
+      }
+
+      if (progress == 2) {
+         if (mode != MPMC && (in.src != source || in.seq != received))
+            my_errors++;
+         my_seq_sum += in.seq;
+         received++;
+         if (msg_count == 1)
+            printf("Thread %ld > %s\n", my_rank, in.text);
+      }
+      if (progress) {
+         spins = 0;
+      } else if (++spins == YIELD_SPINS) {
+         sched_yield();
+         spins = 0;
+      }
+   }
+
+   errors[my_rank] = my_errors;
+   seq_sums[my_rank] = my_seq_sum;
+   return NULL;
+}  /* Send_msgs */
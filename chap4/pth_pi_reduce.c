@@ -0,0 +1,229 @@
+/* File:     pth_pi_reduce.c
+ * Purpose:  Estimate pi using the series
+ *
+ *              pi = 4*[1 - 1/3 + 1/5 - 1/7 + 1/9 - . . . ]
+ *
+ *           and compare three ways of adding the threads' partial
+ *           sums:
+ *
+ *              busy:   busy-waiting on a flag, as in pth_pi_busy2.c
+ *              mutex:  a mutex, as in pth_pi_mutex.c
+ *              tree:   the tree in pth_reduce.c, in which no thread
+ *                      waits
+ *
+ * Compile:  gcc -g -Wall -O2 -o pth_pi_reduce pth_pi_reduce.c pth_reduce.c
+ *              -lm -lpthread
+ *           timer.h needs to be available
+ * Run:      ./pth_pi_reduce <number of threads> <n> [reps]
+ *           n is the number of terms of the Maclaurin series to use
+ *           n should be evenly divisible by the number of threads
+ *           reps is the number of runs of each method (default 5)
+ *
+ * Input:    none
+ * Output:   For each method, the estimate of pi, the minimum elapsed
+ *           time over the runs, and the mean time a thread spent
+ *           adding its partial sum into the total
+ *
+ * Notes:
+ *    1.  Unlike pth_pi_busy2.c, flag is atomic, with release/acquire
+ *        ordering, so the busy-wait version is correct with
+ *        optimization turned on.
+ *    2.  With busy-waiting the threads add their sums in rank order,
+ *        and a thread that finishes early spins until all the threads
+ *        with lower ranks are done.  If there are more threads than
+ *        cores, a spinning thread can delay the thread it's waiting
+ *        for.
+ *    3.  The tree adds the sums in a fixed order, so it gives the
+ *        same estimate on every run.  The mutex adds the sums in
+ *        the order the threads arrive.
+ *
+ * IPP:   Not discussed, but compare Sections 4.5-4.6 (pp. 165 and ff.)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "timer.h"
+#include "pth_reduce.h"
+
+#define BUSY  0
+#define MUTEX 1
+#define TREE  2
+#define METHODS 3
+
+const int MAX_THREADS = 1024;
+const char* method_names[METHODS] = {"busy", "mutex", "tree"};
+
+long thread_count;
+long long n;
+int method;
+
+atomic_long flag;
+double sum;
+pthread_mutex_t mutex;
+struct pth_reduce_s red;
+double* combine_times;   /* Time each thread spent adding its sum */
+
+void* Thread_sum(void* rank);
+
+/* Only executed by main thread */
+void Get_args(int argc, char* argv[], int* reps_p);
+void Usage(char* prog_name);
+double Serial_pi(long long n);
+
+int main(int argc, char* argv[]) {
+   long       thread;  /* Use long in case of a 64-bit system */
+   pthread_t* thread_handles;
+   double start, finish, elapsed, min_elapsed, mean_combine;
+   int reps, rep;
+
+   /* Get number of threads and number of terms from command line */
+   Get_args(argc, argv, &reps);
+
+   thread_handles = malloc(thread_count*sizeof(pthread_t));
+   combine_times = malloc(thread_count*sizeof(double));
+   pthread_mutex_init(&mutex, NULL);
+   Pth_reduce_init(&red, thread_count);
+
+   printf("With n = %lld terms and %ld threads,\n", n, thread_count);
+   for (method = 0; method < METHODS; method++) {
+      min_elapsed = 1.0e30;
+      mean_combine = 0.0;
+      for (rep = 0; rep < reps; rep++) {
+         sum = 0.0;
+         atomic_store(&flag, 0);
+         GET_TIME(start);
+         for (thread = 0; thread < thread_count; thread++)
+            pthread_create(&thread_handles[thread], NULL,
+                Thread_sum, (void*)thread);
+         for (thread = 0; thread < thread_count; thread++)
+            pthread_join(thread_handles[thread], NULL);
+         GET_TIME(finish);
+         elapsed = finish - start;
+         if (elapsed < min_elapsed) min_elapsed = elapsed;
+         for (thread = 0; thread < thread_count; thread++)
+            mean_combine += combine_times[thread];
+      }
+      mean_combine /= reps*thread_count;
+      if (method == TREE) sum = Pth_reduce_result(&red);
+
+      printf("   %-5s estimate of pi = %.15f\n", method_names[method],
+            4.0*sum);
+      printf("         elapsed time = %e seconds, combine = %e seconds\n",
+            min_elapsed, mean_combine);
+   }
+
+   GET_TIME(start);
+   sum = Serial_pi(n);
+   GET_TIME(finish);
+   elapsed = finish - start;
+   printf("   Single-threaded estimate of pi = %.15f\n", sum);
+   printf("         elapsed time = %e seconds\n", elapsed);
+   printf("   Math library estimate of pi    = %.15f\n", 4.0*atan(1.0));
+
+   Pth_reduce_free(&red);
+   pthread_mutex_destroy(&mutex);
+   free(combine_times);
+   free(thread_handles);
+   return 0;
+}  /* main */
+
+/*------------------------------------------------------------------
+ * Function:       Thread_sum
+ * Purpose:        Add the terms assigned to this thread, and add the
+ *                 result into the total using method
+ * In arg:         rank
+ * Ret val:        ignored
+ * Globals in:     n, thread_count, method
+ * Global in/out:  sum, flag, red
+ * Global out:     combine_times[my_rank]
+ */
+void* Thread_sum(void* rank) {
+   long my_rank = (long) rank;
+   double factor, my_sum = 0.0, start, finish;
+   long long i;
+   long long my_n = n/thread_count;
+   long long my_first_i = my_n*my_rank;
+   long long my_last_i = my_first_i + my_n;
+
+   if (my_first_i % 2 == 0)
+      factor = 1.0;
+   else
+      factor = -1.0;
+
+   for (i = my_first_i; i < my_last_i; i++, factor = -factor)
+      my_sum += factor/(2*i+1);
+
+   GET_TIME(start);
+   switch (method) {
+      case BUSY:
+         while (atomic_load_explicit(&flag, memory_order_acquire)
+               != my_rank);
+         sum += my_sum;
+         atomic_store_explicit(&flag, (my_rank+1) % thread_count,
+               memory_order_release);
+         break;
+      case MUTEX:
+         pthread_mutex_lock(&mutex);
+         sum += my_sum;
+         pthread_mutex_unlock(&mutex);
+         break;
+      case TREE:
+         Pth_reduce_sum(&red, my_rank, my_sum);
+         break;
+   }
+   GET_TIME(finish);
+   combine_times[my_rank] = finish - start;
+
+   return NULL;
+}  /* Thread_sum */
+
+/*------------------------------------------------------------------
+ * Function:   Serial_pi
+ * Purpose:    Estimate pi using 1 thread
+ * In arg:     n
+ * Return val: Estimate of pi using n terms of Maclaurin series
+ */
+double Serial_pi(long long n) {
+   double sum = 0.0;
+   long long i;
+   double factor = 1.0;
+
+   for (i = 0; i < n; i++, factor = -factor) {
+      sum += factor/(2*i+1);
+   }
+   return 4.0*sum;
+
+}  /* Serial_pi */
+
+/*------------------------------------------------------------------
+ * Function:    Get_args
+ * Purpose:     Get the command line args
+ * In args:     argc, argv
+ * Globals out: thread_count, n
+ * Out arg:     reps_p
+ */
+void Get_args(int argc, char* argv[], int* reps_p) {
+   if (argc != 3 && argc != 4) Usage(argv[0]);
+   thread_count = strtol(argv[1], NULL, 10);
+   if (thread_count <= 0 || thread_count > MAX_THREADS) Usage(argv[0]);
+   n = strtoll(argv[2], NULL, 10);
+   if (n <= 0) Usage(argv[0]);
+   *reps_p = (argc == 4) ? strtol(argv[3], NULL, 10) : 5;
+   if (*reps_p <= 0) Usage(argv[0]);
+}  /* Get_args */
+
+/*------------------------------------------------------------------
+ * Function:  Usage
+ * Purpose:   Print a message explaining how to run the program
+ * In arg:    prog_name
+ */
+void Usage(char* prog_name) {
+   fprintf(stderr, "usage: %s <number of threads> <n> [reps]\n", prog_name);
+   fprintf(stderr, "   n is the number of terms and should be >= 1\n");
+   fprintf(stderr, "   n should be evenly divisible by the number of threads\n");
+   fprintf(stderr, "   reps is the number of runs of each method\n");
+   exit(0);
+}  /* Usage */
@@ -0,0 +1,48 @@
+/* File:     pth_reduce.h
+ * Purpose:  Header file for pth_reduce.c, which implements a sum of
+ *           one double per thread that's combined in a binary tree.
+ *           No thread ever waits for another:  at each node of the
+ *           tree the first thread to arrive leaves its value and
+ *           returns, and the second adds the two values and carries
+ *           the sum up the tree.
+ *
+ * Usage:
+ *    struct pth_reduce_s red;
+ *    Pth_reduce_init(&red, thread_count);       (main thread)
+ *    . . .
+ *    Pth_reduce_sum(&red, my_rank, my_sum);     (every thread, once)
+ *    . . .
+ *    pthread_join . . .                         (or a barrier)
+ *    sum = Pth_reduce_result(&red);
+ *    Pth_reduce_free(&red);
+ *
+ * IPP:  Not discussed, but an alternative to the busy-waiting and
+ *       mutexes in Sections 4.5-4.6 (pp. 165 and ff.)
+ */
+#ifndef _PTH_REDUCE_H_
+#define _PTH_REDUCE_H_
+
+#include <stdatomic.h>
+
+#define CACHE_LINE 64
+
+/* One node of the tree, on its own cache line */
+struct pth_reduce_node_s {
+   _Alignas(CACHE_LINE) double val[2];   /* Left and right child */
+   atomic_int arrived;
+};
+
+struct pth_reduce_s {
+   int                       thread_count;
+   int                       levels;
+   int*                      level_start;  /* First node of each level */
+   struct pth_reduce_node_s* nodes;
+   double                    result;
+};
+
+void   Pth_reduce_init(struct pth_reduce_s* red, int thread_count);
+int    Pth_reduce_sum(struct pth_reduce_s* red, int my_rank, double my_val);
+double Pth_reduce_result(struct pth_reduce_s* red);
+void   Pth_reduce_free(struct pth_reduce_s* red);
+
+#endif
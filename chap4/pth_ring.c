@@ -0,0 +1,204 @@
+/* File:     pth_ring.c
+ *
+ * Purpose:  Implement bounded lock-free message queues for Pthreads.
+ *
+ *    spsc:  A ring of slots with a head index, written only by the
+ *           receiver, and a tail index, written only by the sender.
+ *           The sender copies a message into slot tail and then
+ *           increments tail (release), so the receiver sees the message
+ *           when it sees the new tail (acquire).  Neither index is ever
+ *           updated with a read-modify-write.
+ *    mpmc:  The bounded queue of D. Vyukov.  Each slot has a sequence
+ *           number.  A sender claims position pos with a compare-and-
+ *           swap on enq_pos when slot pos % capacity has seq == pos,
+ *           copies its message, and sets seq = pos + 1.  A receiver
+ *           claims position pos when seq == pos + 1, copies the
+ *           message out, and sets seq = pos + capacity, which is the
+ *           position of the next send into the slot.
+ *
+ * Notes:
+ * 1.  The capacity is rounded up to a power of 2, so a position is
+ *     mapped to a slot with a mask.  Positions are longs, and they
+ *     won't wrap around.
+ * 2.  In spsc each thread keeps a copy of the other thread's index and
+ *     only reloads it when the queue looks full (sender) or empty
+ *     (receiver), so the two cache lines with the indexes aren't
+ *     passed back and forth on every message.
+ * 3.  The functions never block:  Spsc_send and Mpmc_send return 0
+ *     if the queue is full, and Spsc_recv and Mpmc_recv return -1 if
+ *     it's empty.
+ *
+ * IPP:  Not discussed, but an alternative to the message buffers in
+ *       Section 4.7 (pp. 172 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pth_ring.h"
+
+static long Round_capacity(long capacity);
+
+/*-------------------------------------------------------------------
+ * Function:    Round_capacity
+ * Purpose:     Find the smallest power of 2 >= capacity
+ */
+static long Round_capacity(long capacity) {
+   long cap = 1;
+
+   while (cap < capacity) cap *= 2;
+   return cap;
+}  /* Round_capacity */
+
+/*-------------------------------------------------------------------
+ * Function:  Spsc_init
+ * Purpose:   Allocate the slots of a single-sender, single-receiver
+ *            queue with room for at least capacity messages of up to
+ *            slot_size bytes
+ */
+void Spsc_init(struct spsc_ring_s* q, long capacity, int slot_size) {
+   capacity = Round_capacity(capacity);
+   q->mask = capacity - 1;
+   q->slot_size = slot_size;
+   q->data = malloc(capacity*slot_size);
+   q->sizes = malloc(capacity*sizeof(int));
+   atomic_init(&q->head, 0);
+   atomic_init(&q->tail, 0);
+   q->head_cache = q->tail_cache = 0;
+}  /* Spsc_init */
+
+/*-------------------------------------------------------------------
+ * Function:    Spsc_send
+ * Purpose:     Copy the size bytes of msg into the next free slot
+ * Return val:  1 if the message was sent, 0 if the queue is full
+ * Note:        Only one thread may call Spsc_send on q
+ */
+int Spsc_send(struct spsc_ring_s* q, const void* msg, int size) {
+   long tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+   if (tail - q->head_cache > q->mask) {
+      q->head_cache = atomic_load_explicit(&q->head, memory_order_acquire);
+      if (tail - q->head_cache > q->mask) return 0;
+   }
+   memcpy(q->data + (tail & q->mask)*q->slot_size, msg, size);
+   q->sizes[tail & q->mask] = size;
+   atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+   return 1;
+}  /* Spsc_send */
+
+/*-------------------------------------------------------------------
+ * Function:    Spsc_recv
+ * Purpose:     Copy the oldest message into buf, which should have
+ *              room for slot_size bytes
+ * Return val:  The size of the message, or -1 if the queue is empty
+ * Note:        Only one thread may call Spsc_recv on q
+ */
+int Spsc_recv(struct spsc_ring_s* q, void* buf) {
+   long head = atomic_load_explicit(&q->head, memory_order_relaxed);
+   int size;
+
+   if (head == q->tail_cache) {
+      q->tail_cache = atomic_load_explicit(&q->tail, memory_order_acquire);
+      if (head == q->tail_cache) return -1;
+   }
+   size = q->sizes[head & q->mask];
+   memcpy(buf, q->data + (head & q->mask)*q->slot_size, size);
+   atomic_store_explicit(&q->head, head + 1, memory_order_release);
+   return size;
+}  /* Spsc_recv */
+
+/*-------------------------------------------------------------------*/
+void Spsc_free(struct spsc_ring_s* q) {
+   free(q->data);
+   free(q->sizes);
+}  /* Spsc_free */
+
+/*-------------------------------------------------------------------
+ * Function:  Mpmc_init
+ * Purpose:   Allocate the slots of a multiple-sender, multiple-receiver
+ *            queue.  Slot i starts out ready for the send at position i.
+ */
+void Mpmc_init(struct mpmc_ring_s* q, long capacity, int slot_size) {
+   long i;
+
+   capacity = Round_capacity(capacity);
+   q->mask = capacity - 1;
+   q->slot_size = slot_size;
+   q->data = malloc(capacity*slot_size);
+   q->slots = malloc(capacity*sizeof(struct mpmc_slot_s));
+   for (i = 0; i < capacity; i++)
+      atomic_init(&q->slots[i].seq, i);
+   atomic_init(&q->enq_pos, 0);
+   atomic_init(&q->deq_pos, 0);
+}  /* Mpmc_init */
+
+/*-------------------------------------------------------------------
+ * Function:    Mpmc_send
+ * Purpose:     Claim the next position for sending, and copy msg into
+ *              its slot
+ * Return val:  1 if the message was sent, 0 if the queue is full
+ */
+int Mpmc_send(struct mpmc_ring_s* q, const void* msg, int size) {
+   long pos = atomic_load_explicit(&q->enq_pos, memory_order_relaxed);
+   struct mpmc_slot_s* slot;
+   long diff;
+
+   while (1) {
+      slot = &q->slots[pos & q->mask];
+      diff = atomic_load_explicit(&slot->seq, memory_order_acquire) - pos;
+      if (diff == 0) {
+         /* On failure pos is updated to the current enq_pos */
+         if (atomic_compare_exchange_weak_explicit(&q->enq_pos, &pos,
+                  pos + 1, memory_order_relaxed, memory_order_relaxed))
+            break;
+      } else if (diff < 0) {
+         return 0;  /* The slot still holds the message from pos - capacity */
+      } else {
+         pos = atomic_load_explicit(&q->enq_pos, memory_order_relaxed);
+      }
+   }
+
+   memcpy(q->data + (pos & q->mask)*q->slot_size, msg, size);
+   slot->size = size;
+   atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+   return 1;
+}  /* Mpmc_send */
+
+/*-------------------------------------------------------------------
+ * Function:    Mpmc_recv
+ * Purpose:     Claim the next position for receiving, and copy the
+ *              message in its slot into buf
+ * Return val:  The size of the message, or -1 if the queue is empty
+ */
+int Mpmc_recv(struct mpmc_ring_s* q, void* buf) {
+   long pos = atomic_load_explicit(&q->deq_pos, memory_order_relaxed);
+   struct mpmc_slot_s* slot;
+   long diff;
+   int size;
+
+   while (1) {
+      slot = &q->slots[pos & q->mask];
+      diff = atomic_load_explicit(&slot->seq, memory_order_acquire)
+         - (pos + 1);
+      if (diff == 0) {
+         if (atomic_compare_exchange_weak_explicit(&q->deq_pos, &pos,
+                  pos + 1, memory_order_relaxed, memory_order_relaxed))
+            break;
+      } else if (diff < 0) {
+         return -1;  /* Nothing has been sent at pos yet */
+      } else {
+         pos = atomic_load_explicit(&q->deq_pos, memory_order_relaxed);
+      }
+   }
+
+   size = slot->size;
+   memcpy(buf, q->data + (pos & q->mask)*q->slot_size, size);
+   atomic_store_explicit(&slot->seq, pos + q->mask + 1,
+         memory_order_release);
+   return size;
+}  /* Mpmc_recv */
+
+/*-------------------------------------------------------------------*/
+void Mpmc_free(struct mpmc_ring_s* q) {
+   free(q->data);
+   free(q->slots);
+}  /* Mpmc_free */
@@ -0,0 +1,73 @@
+/* File:     pth_ring.h
+ * Purpose:  Header file for pth_ring.c, which implements bounded
+ *           lock-free queues of fixed-size message slots:
+ *
+ *              spsc:  one sending thread and one receiving thread
+ *              mpmc:  any number of sending and receiving threads
+ *
+ *           All the slots are allocated when the queue is created, and
+ *           a message is copied into a slot, so sending and receiving
+ *           never call malloc and never make a system call.
+ *
+ * Usage:
+ *    struct spsc_ring_s q;
+ *    Spsc_init(&q, capacity, slot_size);
+ *    . . .
+ *    if (Spsc_send(&q, msg, size)) . . .     (returns 0 if q is full)
+ *    if ((size = Spsc_recv(&q, buf)) >= 0)   (returns -1 if q is empty)
+ *    . . .
+ *    Spsc_free(&q);
+ *
+ *    The Mpmc_ functions are used in the same way.
+ *
+ * IPP:  Not discussed, but an alternative to the message buffers in
+ *       Section 4.7 (pp. 172 and ff.)
+ */
+#ifndef _PTH_RING_H_
+#define _PTH_RING_H_
+
+#include <stdatomic.h>
+
+#define RING_CACHE_LINE 64
+
+struct spsc_ring_s {
+   long   mask;         /* capacity - 1:  capacity is a power of 2      */
+   int    slot_size;    /* Bytes per message slot                       */
+   char*  data;         /* capacity*slot_size bytes                     */
+   int*   sizes;        /* Bytes in the message in each slot            */
+
+   /* Written by the receiver */
+   _Alignas(RING_CACHE_LINE) atomic_long head;  /* Next slot to read    */
+   long   tail_cache;   /* Receiver's copy of tail                      */
+
+   /* Written by the sender */
+   _Alignas(RING_CACHE_LINE) atomic_long tail;  /* Next slot to write   */
+   long   head_cache;   /* Sender's copy of head                        */
+};
+
+struct mpmc_slot_s {
+   atomic_long seq;     /* Which turn the slot is ready for             */
+   int         size;
+};
+
+struct mpmc_ring_s {
+   long   mask;
+   int    slot_size;
+   char*  data;
+   struct mpmc_slot_s* slots;
+
+   _Alignas(RING_CACHE_LINE) atomic_long enq_pos;
+   _Alignas(RING_CACHE_LINE) atomic_long deq_pos;
+};
+
+void Spsc_init(struct spsc_ring_s* q, long capacity, int slot_size);
+int  Spsc_send(struct spsc_ring_s* q, const void* msg, int size);
+int  Spsc_recv(struct spsc_ring_s* q, void* buf);
+void Spsc_free(struct spsc_ring_s* q);
+
+void Mpmc_init(struct mpmc_ring_s* q, long capacity, int slot_size);
+int  Mpmc_send(struct mpmc_ring_s* q, const void* msg, int size);
+int  Mpmc_recv(struct mpmc_ring_s* q, void* buf);
+void Mpmc_free(struct mpmc_ring_s* q);
+
+#endif
@@ -0,0 +1,198 @@
+/* File:     pth_tok.c
+ *
+ * Purpose:  Tokenize memory-mapped text in parallel.
+ *
+ *    Tok_map:    map a file read-only into memory
+ *    Tok_split:  divide the text into parts byte ranges, each of which
+ *                starts at the beginning of a line
+ *    Tok_scan:   append the tokens in a byte range to a vector of
+ *                (offset, length) pairs
+ *
+ * Notes:
+ * 1.  Since a range starts just after a newline and ends just after a
+ *     newline (or at the end of the text), no token crosses from one
+ *     range into the next, and the ranges can be scanned by different
+ *     threads without stitching tokens back together.  A range is
+ *     empty if there's no newline in it.
+ * 2.  Tok_scan looks at BLOCK = 64 bytes at a time.  It makes a 64-bit
+ *     mask with bit i set if byte i isn't a delimiter.  A token starts
+ *     at each 1 bit whose predecessor is a 0 bit, and ends at each 0
+ *     bit whose predecessor is a 1, so the tokens in a block are found
+ *     by shifting the mask and counting trailing zeroes, without a
+ *     branch per byte.
+ * 3.  With SSE2 (every x86-64 processor) the mask is built 16 bytes at
+ *     a time by comparing with each delimiter.  Otherwise, or when
+ *     compiled with -DTOK_SCALAR, it's built with a table lookup per
+ *     byte.
+ *
+ * IPP:  Not discussed, but an alternative to the tokenizers in
+ *       Section 4.11 (pp. 195 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "pth_tok.h"
+
+#if defined(__SSE2__) && !defined(TOK_SCALAR)
+#include <emmintrin.h>
+#define TOK_SSE2
+static const char delims[] = " \t\n\r";
+#endif
+
+#define BLOCK 64
+
+static const unsigned char is_delim[256] =
+   {[' '] = 1, ['\t'] = 1, ['\n'] = 1, ['\r'] = 1};
+
+static uint64_t Block_mask(const char* p, int n);
+static void Tok_push(struct tok_vec_s* vec, long offset, long length);
+
+/*-------------------------------------------------------------------
+ * Function:    Tok_map
+ * Purpose:     Map the file path into memory
+ * Out arg:     size_p:  the number of bytes in the file
+ * Return val:  The address of the text, or NULL if the file is empty
+ *              or can't be mapped
+ */
+char* Tok_map(const char* path, long* size_p) {
+   int fd = open(path, O_RDONLY);
+   struct stat st;
+   char* text;
+
+   *size_p = 0;
+   if (fd < 0) return NULL;
+   if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      close(fd);
+      return NULL;
+   }
+   text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (text == MAP_FAILED) return NULL;
+   madvise(text, st.st_size, MADV_SEQUENTIAL);
+   *size_p = st.st_size;
+   return text;
+}  /* Tok_map */
+
+/*-------------------------------------------------------------------*/
+void Tok_unmap(char* text, long size) {
+   if (text != NULL) munmap(text, size);
+}  /* Tok_unmap */
+
+/*-------------------------------------------------------------------
+ * Function:  Tok_split
+ * Purpose:   Divide text into parts ranges of about size/parts bytes.
+ *            Range i is bounds[i] <= offset < bounds[i+1], and each
+ *            bounds[i] with 0 < i < parts is just after a newline, or
+ *            is size.
+ */
+void Tok_split(const char* text, long size, int parts, long bounds[]) {
+   long pos;
+   int i;
+
+   bounds[0] = 0;
+   for (i = 1; i < parts; i++) {
+      pos = (long) ((double) size*i/parts);
+      if (pos < bounds[i-1]) pos = bounds[i-1];
+      while (pos > 0 && pos < size && text[pos-1] != '\n') pos++;
+      bounds[i] = pos;
+   }
+   bounds[parts] = size;
+}  /* Tok_split */
+
+/*-------------------------------------------------------------------*/
+void Tok_vec_init(struct tok_vec_s* vec) {
+   vec->capacity = 1024;
+   vec->count = 0;
+   vec->toks = malloc(vec->capacity*sizeof(struct tok_s));
+}  /* Tok_vec_init */
+
+/*-------------------------------------------------------------------*/
+void Tok_vec_free(struct tok_vec_s* vec) {
+   free(vec->toks);
+   vec->toks = NULL;
+   vec->count = vec->capacity = 0;
+}  /* Tok_vec_free */
+
+/*-------------------------------------------------------------------*/
+static void Tok_push(struct tok_vec_s* vec, long offset, long length) {
+   if (vec->count == vec->capacity) {
+      vec->capacity *= 2;
+      vec->toks = realloc(vec->toks, vec->capacity*sizeof(struct tok_s));
+   }
+   vec->toks[vec->count].offset = offset;
+   vec->toks[vec->count].length = length;
+   vec->count++;
+}  /* Tok_push */
+
+/*-------------------------------------------------------------------
+ * Function:    Block_mask
+ * Purpose:     Find the bytes among p[0], . . . , p[n-1] that aren't
+ *              delimiters (n <= BLOCK)
+ * Return val:  A mask with bit i set if p[i] isn't a delimiter.  The
+ *              bits for i >= n are 0.
+ */
+static uint64_t Block_mask(const char* p, int n) {
+   uint64_t delim = 0;
+   int i;
+
+#  ifdef TOK_SSE2
+   if (n == BLOCK) {
+      __m128i v, d;
+      int j, k;
+
+      for (j = 0; j < BLOCK; j += 16) {
+         v = _mm_loadu_si128((const __m128i*) (p + j));
+         d = _mm_setzero_si128();
+         for (k = 0; delims[k] != '\0'; k++)
+            d = _mm_or_si128(d, _mm_cmpeq_epi8(v, _mm_set1_epi8(delims[k])));
+         delim |= (uint64_t) _mm_movemask_epi8(d) << j;
+      }
+      return ~delim;
+   }
+#  endif
+
+   for (i = 0; i < n; i++)
+      delim |= (uint64_t) is_delim[(unsigned char) p[i]] << i;
+   return (n == BLOCK) ? ~delim : ~delim & ((UINT64_C(1) << n) - 1);
+}  /* Block_mask */
+
+/*-------------------------------------------------------------------
+ * Function:    Tok_scan
+ * Purpose:     Append the tokens in text[first], . . . , text[last-1]
+ *              to vec
+ * Return val:  The number of tokens appended
+ */
+long Tok_scan(const char* text, long first, long last,
+      struct tok_vec_s* vec) {
+   long start_count = vec->count, pos, tok_start = 0;
+   uint64_t in, prev, starts, ends, bit;
+   uint64_t carry = 0;   /* 1 if the byte before the block is in a token */
+   int n, b;
+
+   for (pos = first; pos < last; pos += BLOCK) {
+      n = (last - pos < BLOCK) ? last - pos : BLOCK;
+      in = Block_mask(text + pos, n);
+      prev = (in << 1) | carry;
+      starts = in & ~prev;
+      ends = ~in & prev;
+      if (n < BLOCK) ends &= (UINT64_C(1) << n) - 1;
+      while (starts | ends) {
+         bit = (starts | ends) & -(starts | ends);
+         b = __builtin_ctzll(bit);
+         if (starts & bit)
+            tok_start = pos + b;
+         else
+            Tok_push(vec, tok_start, pos + b - tok_start);
+         starts &= ~bit;
+         ends &= ~bit;
+      }
+      carry = (n == BLOCK) ? in >> 63 : (in >> (n - 1)) & 1;
+   }
+   if (carry) Tok_push(vec, tok_start, last - tok_start);
+
+   return vec->count - start_count;
+}  /* Tok_scan */
@@ -0,0 +1,43 @@
+/* File:     pth_tok.h
+ * Purpose:  Header file for pth_tok.c, which tokenizes text that's
+ *           mapped into memory.  A token is a maximal run of bytes that
+ *           aren't delimiters (space, tab, newline, carriage return),
+ *           and it's stored as an offset and length into the text, so
+ *           nothing is copied.
+ *
+ * Usage:
+ *    text = Tok_map(path, &size);
+ *    Tok_split(text, size, parts, bounds);
+ *    . . .
+ *    Tok_vec_init(&vec);
+ *    Tok_scan(text, bounds[i], bounds[i+1], &vec);   (in parallel)
+ *    . . .  text + vec.toks[j].offset, vec.toks[j].length . . .
+ *    Tok_vec_free(&vec);
+ *    Tok_unmap(text, size);
+ *
+ * IPP:  Not discussed, but an alternative to the tokenizers in
+ *       Section 4.11 (pp. 195 and ff.)
+ */
+#ifndef _PTH_TOK_H_
+#define _PTH_TOK_H_
+
+struct tok_s {
+   long offset;         /* From the start of the text */
+   long length;
+};
+
+struct tok_vec_s {
+   struct tok_s* toks;
+   long          count;
+   long          capacity;
+};
+
+char* Tok_map(const char* path, long* size_p);
+void  Tok_unmap(char* text, long size);
+void  Tok_split(const char* text, long size, int parts, long bounds[]);
+void  Tok_vec_init(struct tok_vec_s* vec);
+void  Tok_vec_free(struct tok_vec_s* vec);
+long  Tok_scan(const char* text, long first, long last,
+         struct tok_vec_s* vec);
+
+#endif
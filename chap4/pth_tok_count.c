@@ -0,0 +1,543 @@
+/* File:
+ *    pth_tok_count.c
+ *
+ * Purpose:
+ *    Use threads to count the tokens in a text file, and write either
+ *    the k most frequent tokens or an index giving the lines each
+ *    token occurs on.  The file is tokenized as in
+ *    pth_tokenize_mmap.c, but instead of printing the tokens, each
+ *    thread adds them to its own hash tables.  Then the threads merge
+ *    the tables.
+ *
+ * Input:
+ *    A text file, named on the command line
+ * Output:
+ *    A binary file (see below).  With "t", also a text version on
+ *    stdout, in which lines are numbered from 1.  The number of
+ *    tokens and distinct tokens, and the time taken by each phase.
+ *
+ * Compile:
+ *    gcc -g -Wall -O2 -o pth_tok_count pth_tok_count.c pth_tok.c
+ *       pth_tok_hash.c -lpthread
+ *    timer.h needs to be available
+ * Usage:
+ *    pth_tok_count <thread_count> <file> <out file> <k | index> [t]
+ *       k:      write the k most frequent tokens
+ *       index:  write every token with the lines it occurs on
+ *       t:      also print the output as text
+ *
+ * Algorithm:
+ *    1.  Count:  Thread r tokenizes range r of the file (see Tok_split)
+ *        CHUNK bytes at a time.  Each token is added to one of
+ *        TOK_PARTS tables, chosen by the top bits of its hash.  In
+ *        index mode, the thread also counts newlines so it knows the
+ *        line (in its range) of each token.
+ *    2.  Merge:  Thread r merges table q of every thread into one
+ *        table, for q = r, r + thread_count, . . .  Since every copy
+ *        of a token is in the same partition, no two threads update
+ *        the same table, and there are no locks.  Then the thread
+ *        finds the k most frequent tokens in its partitions, or sorts
+ *        each partition and encodes it.
+ *    3.  Output:  The main thread picks the k most frequent tokens from
+ *        the threads' lists, or writes the encoded partitions in order.
+ *
+ * Binary format (integers in the machine's byte order):
+ *    top k:  "TOKK", u64 n, and then n times:
+ *               u32 length, the token's bytes, u64 count
+ *    index:  "TOKI", u64 n, and then n times:
+ *               u32 length, the token's bytes, u64 count,
+ *               u64 number of lines, u64 bytes of line numbers,
+ *               the line numbers (starting at 0) as differences from
+ *                  the preceding line number, each in LEB128 (7 bits
+ *                  per byte, high bit set if more bytes follow)
+ *    In the index, tokens are sorted within each of the TOK_PARTS
+ *    partitions, so the output doesn't depend on the number of
+ *    threads.
+ *
+ * IPP:  Not discussed, but see Section 4.11  (pp. 195 and ff.)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "timer.h"
+#include "pth_tok.h"
+#include "pth_tok_hash.h"
+
+#define CHUNK (1 << 20)      /* Bytes tokenized at a time     */
+#define LOCAL_CAPACITY 1024  /* Initial slots of each table   */
+
+const int MAX_THREADS = 1024;
+
+struct out_buf_s {
+   char* data;
+   long  size;
+   long  capacity;
+};
+
+int thread_count;
+char* text;
+long size;
+long* bounds;
+int index_mode;
+long k;
+
+struct tok_hash_s (*local)[TOK_PARTS];  /* local[r][q]:  thread r, part q */
+long* line_counts;                      /* Newlines in each range         */
+long* line_bases;                       /* Line number of start of range  */
+long* token_counts;
+
+struct tok_hash_s merged[TOK_PARTS];
+struct tok_entry_s*** tops;             /* Each thread's top k            */
+long* top_counts;
+struct tok_entry_s** part_entries[TOK_PARTS];  /* Sorted (index mode)    */
+struct out_buf_s bufs[TOK_PARTS];
+
+void Usage(char* prog_name);
+void Get_args(int argc, char* argv[], int* dump_p);
+void *Count(void* rank);   /* Thread functions */
+void *Merge(void* rank);
+void Run_threads(void* (*fn)(void*), pthread_t thread_handles[]);
+long Count_newlines(long first, long last);
+void Heap_insert(struct tok_entry_s* heap[], long* count_p,
+      struct tok_entry_s* e);
+void Encode_part(int q);
+int  Cmp_count(const void* a, const void* b);
+int  Cmp_str(const void* a, const void* b);
+void Put_bytes(struct out_buf_s* buf, const void* p, long n);
+void Put_u32(struct out_buf_s* buf, uint32_t x);
+void Put_u64(struct out_buf_s* buf, uint64_t x);
+void Put_varint(struct out_buf_s* buf, uint64_t x);
+long Write_top(FILE* fp, int dump);
+long Write_index(FILE* fp, int dump);
+
+/*--------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   long thread, total = 0, distinct = 0, counted;
+   pthread_t* thread_handles;
+   double start, mid, finish, end;
+   int dump, q;
+   FILE* fp;
+
+   Get_args(argc, argv, &dump);
+   text = Tok_map(argv[2], &size);
+   if (text == NULL)
+      fprintf(stderr, "%s is empty or can't be read\n", argv[2]);
+   fp = fopen(argv[3], "wb");
+   if (fp == NULL) {
+      fprintf(stderr, "Can't open %s\n", argv[3]);
+      exit(1);
+   }
+
+   thread_handles = malloc(thread_count*sizeof(pthread_t));
+   bounds = malloc((thread_count+1)*sizeof(long));
+   local = malloc(thread_count*sizeof(*local));
+   line_counts = malloc(thread_count*sizeof(long));
+   line_bases = malloc(thread_count*sizeof(long));
+   token_counts = malloc(thread_count*sizeof(long));
+   tops = malloc(thread_count*sizeof(struct tok_entry_s**));
+   top_counts = malloc(thread_count*sizeof(long));
+   Tok_split(text, size, thread_count, bounds);
+
+   GET_TIME(start);
+   Run_threads(Count, thread_handles);
+   line_bases[0] = 0;
+   for (thread = 1; thread < thread_count; thread++)
+      line_bases[thread] = line_bases[thread-1] + line_counts[thread-1];
+   GET_TIME(mid);
+   Run_threads(Merge, thread_handles);
+   GET_TIME(finish);
+   if (index_mode)
+      counted = Write_index(fp, dump);
+   else
+      counted = Write_top(fp, dump);
+   fclose(fp);
+   GET_TIME(end);
+
+   for (thread = 0; thread < thread_count; thread++)
+      total += token_counts[thread];
+   for (q = 0; q < TOK_PARTS; q++)
+      distinct += merged[q].size;
+   printf("%ld bytes, %ld tokens, %ld distinct tokens\n", size, total,
+         distinct);
+   if (index_mode && counted != total)
+      printf("The index has %ld tokens!\n", counted);
+   printf("Count = %e, merge = %e, output = %e seconds\n", mid - start,
+         finish - mid, end - finish);
+   printf("Total = %e seconds, %e bytes per second\n", end - start,
+         end > start ? size/(end - start) : 0.0);
+
+   for (q = 0; q < TOK_PARTS; q++) {
+      Tok_hash_free(&merged[q]);
+      free(part_entries[q]);
+      free(bufs[q].data);
+   }
+   for (thread = 0; thread < thread_count; thread++)
+      free(tops[thread]);
+   free(top_counts);
+   free(tops);
+   free(token_counts);
+   free(line_bases);
+   free(line_counts);
+   free(local);
+   free(bounds);
+   free(thread_handles);
+   Tok_unmap(text, size);
+   return 0;
+}  /* main */
+
+
+/*--------------------------------------------------------------------
+ * Function:    Usage
+ * Purpose:     Print command line for function and terminate
+ * In arg:      prog_name
+ */
+void Usage(char* prog_name) {
+
+   fprintf(stderr, "usage: %s <number of threads> <file> <out file> <k | index> [t]\n",
+         prog_name);
+   fprintf(stderr, "   k:      write the k most frequent tokens\n");
+   fprintf(stderr, "   index:  write the lines each token occurs on\n");
+   fprintf(stderr, "   t:      also print the output as text\n");
+   exit(0);
+}  /* Usage */
+
+
+/*--------------------------------------------------------------------
+ * Function:    Get_args
+ * Purpose:     Get the command line args
+ * In args:     argc, argv
+ * Out arg:     dump_p:  1 if the output should be printed as text
+ * Globals out: thread_count, index_mode, k
+ */
+void Get_args(int argc, char* argv[], int* dump_p) {
+   if (argc != 5 && argc != 6) Usage(argv[0]);
+   thread_count = strtol(argv[1], NULL, 10);
+   if (thread_count <= 0 || thread_count > MAX_THREADS) Usage(argv[0]);
+   index_mode = (strcmp(argv[4], "index") == 0);
+   if (!index_mode) {
+      k = strtol(argv[4], NULL, 10);
+      if (k <= 0) Usage(argv[0]);
+   }
+   *dump_p = (argc == 6);
+   if (*dump_p && strcmp(argv[5], "t") != 0) Usage(argv[0]);
+}  /* Get_args */
+
+
+/*--------------------------------------------------------------------
+ * Function:    Run_threads
+ * Purpose:     Start thread_count threads running fn, and wait for them
+ */
+void Run_threads(void* (*fn)(void*), pthread_t thread_handles[]) {
+   long thread;
+
+   for (thread = 0; thread < thread_count; thread++)
+      pthread_create(&thread_handles[thread], (pthread_attr_t*) NULL,
+          fn, (void*) thread);
+   for (thread = 0; thread < thread_count; thread++)
+      pthread_join(thread_handles[thread], NULL);
+}  /* Run_threads */
+
+
+/*--------------------------------------------------------------------*/
+long Count_newlines(long first, long last) {
+   long count = 0;
+   const char* p = text + first;
+   const char* end = text + last;
+
+   while (p < end && (p = memchr(p, '\n', end - p)) != NULL) {
+      count++;
+      p++;
+   }
+   return count;
+}  /* Count_newlines */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Count
+ * Purpose:     Add the tokens in this thread's range to its tables
+ * In arg:      rank
+ * Global in:   text, bounds, index_mode
+ * Global out:  local[my_rank], line_counts[my_rank],
+ *              token_counts[my_rank]
+ * Return val:  Ignored
+ */
+void *Count(void* rank) {
+   long my_rank = (long) rank;
+   long first = bounds[my_rank], last, i, pos, line = 0, tokens = 0;
+   struct tok_vec_s vec;
+   struct tok_s* tok;
+   struct tok_entry_s* e;
+   uint64_t hash;
+   int q;
+
+   for (q = 0; q < TOK_PARTS; q++)
+      Tok_hash_init(&local[my_rank][q], LOCAL_CAPACITY);
+   Tok_vec_init(&vec);
+
+   /* Tokenize CHUNK bytes at a time, ending each chunk at a newline */
+   pos = first;
+   while (first < bounds[my_rank+1]) {
+      last = first + CHUNK;
+      if (last >= bounds[my_rank+1])
+         last = bounds[my_rank+1];
+      else
+         while (last < bounds[my_rank+1] && text[last-1] != '\n') last++;
+
+      vec.count = 0;
+      Tok_scan(text, first, last, &vec);
+      for (i = 0; i < vec.count; i++) {
+         tok = &vec.toks[i];
+         hash = Tok_hash_fn(text + tok->offset, tok->length);
+         e = Tok_hash_find(&local[my_rank][Tok_part(hash)],
+               text + tok->offset, tok->length, hash);
+         e->count++;
+         if (index_mode) {
+            line += Count_newlines(pos, tok->offset);
+            pos = tok->offset;
+            Tok_hash_add_line(e, line);
+         }
+      }
+      tokens += vec.count;
+      first = last;
+   }
+   line += Count_newlines(pos, bounds[my_rank+1]);
+
+   line_counts[my_rank] = line;
+   token_counts[my_rank] = tokens;
+   Tok_vec_free(&vec);
+   return NULL;
+}  /* Count */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Merge
+ * Purpose:     Merge the tables in partitions my_rank, my_rank +
+ *              thread_count, . . . .  Then find the top k tokens in
+ *              these partitions, or sort and encode them.
+ * In arg:      rank
+ * Global in:   local, line_bases, index_mode, k
+ * Global out:  merged, tops[my_rank], top_counts[my_rank], or
+ *              part_entries, bufs
+ * Return val:  Ignored
+ */
+void *Merge(void* rank) {
+   long my_rank = (long) rank;
+   long thread, i, count = 0;
+   struct tok_entry_s** heap = NULL;
+   int q;
+
+   if (!index_mode) heap = malloc(k*sizeof(struct tok_entry_s*));
+   for (q = my_rank; q < TOK_PARTS; q += thread_count) {
+      Tok_hash_init(&merged[q], LOCAL_CAPACITY);
+      for (thread = 0; thread < thread_count; thread++) {
+         Tok_hash_merge(&merged[q], &local[thread][q], line_bases[thread]);
+         Tok_hash_free(&local[thread][q]);
+      }
+      if (index_mode) {
+         Encode_part(q);
+      } else {
+         for (i = 0; i < merged[q].capacity; i++)
+            if (merged[q].table[i].str != NULL)
+               Heap_insert(heap, &count, &merged[q].table[i]);
+      }
+   }
+
+   tops[my_rank] = heap;
+   top_counts[my_rank] = count;
+   return NULL;
+}  /* Merge */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Heap_insert
+ * Purpose:     Keep the k entries that come first in count order.  The
+ *              heap's root is the entry that comes last, so it's the
+ *              one replaced by a better entry.
+ * In/out args: heap, count_p
+ */
+void Heap_insert(struct tok_entry_s* heap[], long* count_p,
+      struct tok_entry_s* e) {
+   long i, child;
+   struct tok_entry_s* tmp;
+
+   if (*count_p < k) {
+      i = (*count_p)++;
+      heap[i] = e;
+      while (i > 0 && Tok_entry_cmp_count(heap[(i-1)/2], heap[i]) < 0) {
+         tmp = heap[i]; heap[i] = heap[(i-1)/2]; heap[(i-1)/2] = tmp;
+         i = (i-1)/2;
+      }
+   } else if (Tok_entry_cmp_count(e, heap[0]) < 0) {
+      heap[0] = e;
+      i = 0;
+      while ((child = 2*i + 1) < *count_p) {
+         if (child + 1 < *count_p
+               && Tok_entry_cmp_count(heap[child+1], heap[child]) > 0)
+            child++;
+         if (Tok_entry_cmp_count(heap[child], heap[i]) <= 0) break;
+         tmp = heap[i]; heap[i] = heap[child]; heap[child] = tmp;
+         i = child;
+      }
+   }
+}  /* Heap_insert */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Encode_part
+ * Purpose:     Sort the entries of partition q by token, and encode
+ *              them in bufs[q] in the index format
+ */
+void Encode_part(int q) {
+   struct tok_entry_s** entries;
+   struct tok_entry_s* e;
+   long i, j, n = 0, prev, start;
+   uint64_t nbytes;
+
+   entries = malloc((merged[q].size + 1)*sizeof(struct tok_entry_s*));
+   for (i = 0; i < merged[q].capacity; i++)
+      if (merged[q].table[i].str != NULL)
+         entries[n++] = &merged[q].table[i];
+   qsort(entries, n, sizeof(struct tok_entry_s*), Cmp_str);
+   part_entries[q] = entries;
+
+   for (i = 0; i < n; i++) {
+      e = entries[i];
+      Put_u32(&bufs[q], e->length);
+      Put_bytes(&bufs[q], e->str, e->length);
+      Put_u64(&bufs[q], e->count);
+      Put_u64(&bufs[q], e->line_count);
+      Put_u64(&bufs[q], 0);  /* Filled in below */
+      start = bufs[q].size;
+      for (j = 0, prev = 0; j < e->line_count; j++) {
+         Put_varint(&bufs[q], e->lines[j] - prev);
+         prev = e->lines[j];
+      }
+      nbytes = bufs[q].size - start;
+      memcpy(bufs[q].data + start - sizeof(nbytes), &nbytes, sizeof(nbytes));
+   }
+}  /* Encode_part */
+
+
+/*-------------------------------------------------------------------*/
+int Cmp_count(const void* a, const void* b) {
+   return Tok_entry_cmp_count(*(struct tok_entry_s* const*) a,
+         *(struct tok_entry_s* const*) b);
+}  /* Cmp_count */
+
+/*-------------------------------------------------------------------*/
+int Cmp_str(const void* a, const void* b) {
+   return Tok_entry_cmp_str(*(struct tok_entry_s* const*) a,
+         *(struct tok_entry_s* const*) b);
+}  /* Cmp_str */
+
+
+/*-------------------------------------------------------------------*/
+void Put_bytes(struct out_buf_s* buf, const void* p, long n) {
+   if (buf->size + n > buf->capacity) {
+      buf->capacity = 2*(buf->size + n) + 4096;
+      buf->data = realloc(buf->data, buf->capacity);
+   }
+   memcpy(buf->data + buf->size, p, n);
+   buf->size += n;
+}  /* Put_bytes */
+
+/*-------------------------------------------------------------------*/
+void Put_u32(struct out_buf_s* buf, uint32_t x) {
+   Put_bytes(buf, &x, sizeof(x));
+}  /* Put_u32 */
+
+/*-------------------------------------------------------------------*/
+void Put_u64(struct out_buf_s* buf, uint64_t x) {
+   Put_bytes(buf, &x, sizeof(x));
+}  /* Put_u64 */
+
+/*-------------------------------------------------------------------*/
+void Put_varint(struct out_buf_s* buf, uint64_t x) {
+   unsigned char bytes[10];
+   int n = 0;
+
+   do {
+      bytes[n] = x & 0x7f;
+      x >>= 7;
+      if (x != 0) bytes[n] |= 0x80;
+      n++;
+   } while (x != 0);
+   Put_bytes(buf, bytes, n);
+}  /* Put_varint */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Write_top
+ * Purpose:     Choose the k most frequent tokens from the threads'
+ *              lists, and write them
+ * Return val:  The sum of their counts
+ */
+long Write_top(FILE* fp, int dump) {
+   struct tok_entry_s** all;
+   struct out_buf_s buf = {NULL, 0, 0};
+   long thread, i, n = 0, sum = 0;
+
+   for (thread = 0; thread < thread_count; thread++)
+      n += top_counts[thread];
+   all = malloc((n + 1)*sizeof(struct tok_entry_s*));
+   n = 0;
+   for (thread = 0; thread < thread_count; thread++)
+      for (i = 0; i < top_counts[thread]; i++)
+         all[n++] = tops[thread][i];
+   qsort(all, n, sizeof(struct tok_entry_s*), Cmp_count);
+   if (n > k) n = k;
+
+   Put_bytes(&buf, "TOKK", 4);
+   Put_u64(&buf, n);
+   for (i = 0; i < n; i++) {
+      Put_u32(&buf, all[i]->length);
+      Put_bytes(&buf, all[i]->str, all[i]->length);
+      Put_u64(&buf, all[i]->count);
+      sum += all[i]->count;
+      if (dump)
+         printf("%10ld  %.*s\n", all[i]->count, (int) all[i]->length,
+               all[i]->str);
+   }
+   fwrite(buf.data, 1, buf.size, fp);
+
+   free(buf.data);
+   free(all);
+   return sum;
+}  /* Write_top */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Write_index
+ * Purpose:     Write the encoded partitions, in order
+ * Return val:  The sum of the counts of all the tokens
+ */
+long Write_index(FILE* fp, int dump) {
+   struct out_buf_s buf = {NULL, 0, 0};
+   struct tok_entry_s* e;
+   long n = 0, i, j, sum = 0;
+   int q;
+
+   for (q = 0; q < TOK_PARTS; q++)
+      n += merged[q].size;
+   Put_bytes(&buf, "TOKI", 4);
+   Put_u64(&buf, n);
+   fwrite(buf.data, 1, buf.size, fp);
+   for (q = 0; q < TOK_PARTS; q++) {
+      if (bufs[q].size > 0) fwrite(bufs[q].data, 1, bufs[q].size, fp);
+      for (i = 0; i < merged[q].size; i++) {
+         e = part_entries[q][i];
+         sum += e->count;
+         if (!dump) continue;
+         printf("%.*s %ld:", (int) e->length, e->str, e->count);
+         for (j = 0; j < e->line_count; j++)
+            printf(" %ld", e->lines[j] + 1);
+         printf("\n");
+      }
+   }
+
+   free(buf.data);
+   return sum;
+}  /* Write_index */
@@ -0,0 +1,167 @@
+/* File:     pth_tok_hash.c
+ *
+ * Purpose:  Implement an open-addressing hash table of tokens with
+ *           counts and, optionally, lists of line numbers.
+ *
+ * Notes:
+ * 1.  The hash is 64-bit FNV-1a.  Collisions are resolved with linear
+ *     probing, and the table is doubled when it's half full.
+ * 2.  A table isn't thread-safe.  Each thread should have its own
+ *     tables, and tables should only be merged into a table that no
+ *     other thread is using.
+ * 3.  Tok_hash_merge adds line_base to the line numbers in src, so if
+ *     the tables for consecutive blocks of lines are merged in order,
+ *     each list of lines in dst stays sorted.
+ *
+ * IPP:  Not discussed
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pth_tok_hash.h"
+
+static void Tok_hash_grow(struct tok_hash_s* h);
+
+/*-------------------------------------------------------------------*/
+uint64_t Tok_hash_fn(const char* str, long length) {
+   uint64_t hash = UINT64_C(14695981039346656037);
+   long i;
+
+   for (i = 0; i < length; i++) {
+      hash ^= (unsigned char) str[i];
+      hash *= UINT64_C(1099511628211);
+   }
+   return hash;
+}  /* Tok_hash_fn */
+
+/*-------------------------------------------------------------------
+ * Function:  Tok_hash_init
+ * Purpose:   Allocate an empty table with at least capacity slots
+ */
+void Tok_hash_init(struct tok_hash_s* h, long capacity) {
+   h->capacity = 16;
+   while (h->capacity < capacity) h->capacity *= 2;
+   h->size = 0;
+   h->table = calloc(h->capacity, sizeof(struct tok_entry_s));
+}  /* Tok_hash_init */
+
+/*-------------------------------------------------------------------*/
+void Tok_hash_free(struct tok_hash_s* h) {
+   long i;
+
+   for (i = 0; i < h->capacity; i++)
+      free(h->table[i].lines);
+   free(h->table);
+   h->table = NULL;
+   h->capacity = h->size = 0;
+}  /* Tok_hash_free */
+
+/*-------------------------------------------------------------------
+ * Function:  Tok_hash_grow
+ * Purpose:   Double the number of slots, and reinsert the entries
+ */
+static void Tok_hash_grow(struct tok_hash_s* h) {
+   struct tok_entry_s* old = h->table;
+   long old_cap = h->capacity, i, slot, mask;
+
+   h->capacity *= 2;
+   h->table = calloc(h->capacity, sizeof(struct tok_entry_s));
+   mask = h->capacity - 1;
+   for (i = 0; i < old_cap; i++) {
+      if (old[i].str == NULL) continue;
+      slot = old[i].hash & mask;
+      while (h->table[slot].str != NULL) slot = (slot + 1) & mask;
+      h->table[slot] = old[i];
+   }
+   free(old);
+}  /* Tok_hash_grow */
+
+/*-------------------------------------------------------------------
+ * Function:    Tok_hash_find
+ * Purpose:     Find the entry for the token str[0..length-1], and
+ *              insert it with count 0 if it isn't in the table
+ * Return val:  The entry.  It's only valid until the next insertion.
+ */
+struct tok_entry_s* Tok_hash_find(struct tok_hash_s* h, const char* str,
+      long length, uint64_t hash) {
+   long mask = h->capacity - 1, slot = hash & mask;
+   struct tok_entry_s* e;
+
+   while (1) {
+      e = &h->table[slot];
+      if (e->str == NULL) break;
+      if (e->hash == hash && e->length == length
+            && memcmp(e->str, str, length) == 0)
+         return e;
+      slot = (slot + 1) & mask;
+   }
+
+   if (2*(h->size + 1) > h->capacity) {
+      Tok_hash_grow(h);
+      return Tok_hash_find(h, str, length, hash);
+   }
+   e->str = str;
+   e->length = length;
+   e->hash = hash;
+   h->size++;
+   return e;
+}  /* Tok_hash_find */
+
+/*-------------------------------------------------------------------
+ * Function:  Tok_hash_add_line
+ * Purpose:   Add line to the lines of e, unless it's already the last
+ *            one
+ */
+void Tok_hash_add_line(struct tok_entry_s* e, long line) {
+   if (e->line_count > 0 && e->lines[e->line_count-1] == line) return;
+   if (e->line_count == e->line_cap) {
+      e->line_cap = (e->line_cap == 0) ? 4 : 2*e->line_cap;
+      e->lines = realloc(e->lines, e->line_cap*sizeof(long));
+   }
+   e->lines[e->line_count++] = line;
+}  /* Tok_hash_add_line */
+
+/*-------------------------------------------------------------------
+ * Function:  Tok_hash_merge
+ * Purpose:   Add the counts and lines of the entries of src into dst
+ */
+void Tok_hash_merge(struct tok_hash_s* dst, struct tok_hash_s* src,
+      long line_base) {
+   struct tok_entry_s *s, *d;
+   long i, j;
+
+   for (i = 0; i < src->capacity; i++) {
+      s = &src->table[i];
+      if (s->str == NULL) continue;
+      d = Tok_hash_find(dst, s->str, s->length, s->hash);
+      d->count += s->count;
+      for (j = 0; j < s->line_count; j++)
+         Tok_hash_add_line(d, s->lines[j] + line_base);
+   }
+}  /* Tok_hash_merge */
+
+/*-------------------------------------------------------------------
+ * Function:    Tok_entry_cmp_str
+ * Purpose:     Compare the tokens of two entries as strings
+ * Return val:  < 0, 0, > 0 as in strcmp
+ */
+int Tok_entry_cmp_str(const struct tok_entry_s* a,
+      const struct tok_entry_s* b) {
+   long len = (a->length < b->length) ? a->length : b->length;
+   int c = memcmp(a->str, b->str, len);
+
+   if (c != 0) return c;
+   return (a->length > b->length) - (a->length < b->length);
+}  /* Tok_entry_cmp_str */
+
+/*-------------------------------------------------------------------
+ * Function:    Tok_entry_cmp_count
+ * Purpose:     Order entries by decreasing count, and entries with
+ *              the same count by their tokens
+ * Return val:  < 0 if a comes first, > 0 if b does
+ */
+int Tok_entry_cmp_count(const struct tok_entry_s* a,
+      const struct tok_entry_s* b) {
+   if (a->count != b->count) return (a->count > b->count) ? -1 : 1;
+   return Tok_entry_cmp_str(a, b);
+}  /* Tok_entry_cmp_count */
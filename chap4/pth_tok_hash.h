@@ -0,0 +1,61 @@
+/* File:     pth_tok_hash.h
+ * Purpose:  Header file for pth_tok_hash.c, which implements a hash
+ *           table of tokens for counting them and for building lists
+ *           of the lines they occur on.  Keys aren't copied:  a key
+ *           points to the first occurrence of the token in the text
+ *           (which is mapped by Tok_map), so each distinct token is
+ *           stored once.
+ *
+ * Usage:
+ *    struct tok_hash_s h;
+ *    Tok_hash_init(&h, capacity);
+ *    e = Tok_hash_find(&h, str, length, Tok_hash_fn(str, length));
+ *    e->count++;
+ *    . . .
+ *    Tok_hash_merge(&dst, &src, line_base);
+ *    Tok_hash_free(&h);
+ *
+ * IPP:  Not discussed
+ */
+#ifndef _PTH_TOK_HASH_H_
+#define _PTH_TOK_HASH_H_
+
+#include <stdint.h>
+
+/* The top TOK_PART_BITS bits of the hash choose one of TOK_PARTS */
+/* partitions, and the low bits choose the slot in a partition's  */
+/* table.                                                         */
+#define TOK_PART_BITS 6
+#define TOK_PARTS     (1 << TOK_PART_BITS)
+#define Tok_part(hash) ((int) ((hash) >> (64 - TOK_PART_BITS)))
+
+struct tok_entry_s {
+   const char* str;        /* NULL if the slot is empty   */
+   long        length;
+   uint64_t    hash;
+   long        count;
+   long*       lines;      /* Lines the token occurs on   */
+   long        line_count;
+   long        line_cap;
+};
+
+struct tok_hash_s {
+   struct tok_entry_s* table;
+   long                capacity;   /* A power of 2 */
+   long                size;
+};
+
+uint64_t Tok_hash_fn(const char* str, long length);
+void     Tok_hash_init(struct tok_hash_s* h, long capacity);
+void     Tok_hash_free(struct tok_hash_s* h);
+struct tok_entry_s* Tok_hash_find(struct tok_hash_s* h, const char* str,
+            long length, uint64_t hash);
+void     Tok_hash_add_line(struct tok_entry_s* e, long line);
+void     Tok_hash_merge(struct tok_hash_s* dst, struct tok_hash_s* src,
+            long line_base);
+int      Tok_entry_cmp_count(const struct tok_entry_s* a,
+            const struct tok_entry_s* b);
+int      Tok_entry_cmp_str(const struct tok_entry_s* a,
+            const struct tok_entry_s* b);
+
+#endif
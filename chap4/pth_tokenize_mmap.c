@@ -0,0 +1,175 @@
+/* File:
+ *    pth_tokenize_mmap.c
+ *
+ * Purpose:
+ *    Use threads to tokenize a text file.  Unlike pth_tokenize_r.c,
+ *    the threads don't take turns reading lines:  the file is mapped
+ *    into memory, each thread tokenizes its own block of lines at the
+ *    same time as the others, and a token is stored as an offset and
+ *    length in the mapped file, so nothing is copied.
+ *
+ * Input:
+ *    A text file, named on the command line
+ * Output:
+ *    The number of tokens, the time to tokenize the file and the rate
+ *    in bytes per second, and whether the tokens match those found by
+ *    a single thread.  With "p", each thread's tokens, as in
+ *    pth_tokenize_r.c.
+ *
+ * Compile:
+ *    gcc -g -Wall -O2 -o pth_tokenize_mmap pth_tokenize_mmap.c pth_tok.c
+ *       -lpthread
+ *    timer.h needs to be available
+ * Usage:
+ *    pth_tokenize_mmap <thread_count> <file> [p]
+ *
+ * Algorithm:
+ *    Tok_split divides the file into thread_count ranges that start
+ *    at the beginning of a line, and thread r calls Tok_scan on range
+ *    r.  See pth_tok.c.
+ *
+ * IPP:  Not discussed, but an alternative to Section 4.11  (pp. 195
+ *       and ff.)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "timer.h"
+#include "pth_tok.h"
+
+const int MAX_THREADS = 1024;
+
+int thread_count;
+char* text;
+long size;
+long* bounds;
+struct tok_vec_s* vecs;      /* One per thread */
+
+void Usage(char* prog_name);
+void *Tokenize(void* rank);  /* Thread function */
+void Print_tokens(void);
+int  Check_tokens(void);
+
+/*--------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   long       thread, total = 0;
+   pthread_t* thread_handles;
+   double start, finish, elapsed;
+
+   if (argc != 3 && argc != 4) Usage(argv[0]);
+   thread_count = strtol(argv[1], NULL, 10);
+   if (thread_count <= 0 || thread_count > MAX_THREADS) Usage(argv[0]);
+   if (argc == 4 && strcmp(argv[3], "p") != 0) Usage(argv[0]);
+
+   text = Tok_map(argv[2], &size);
+   if (text == NULL)
+      fprintf(stderr, "%s is empty or can't be read\n", argv[2]);
+
+   thread_handles = malloc(thread_count*sizeof(pthread_t));
+   bounds = malloc((thread_count+1)*sizeof(long));
+   vecs = malloc(thread_count*sizeof(struct tok_vec_s));
+   Tok_split(text, size, thread_count, bounds);
+
+   GET_TIME(start);
+   for (thread = 0; thread < thread_count; thread++)
+      pthread_create(&thread_handles[thread], (pthread_attr_t*) NULL,
+          Tokenize, (void*) thread);
+
+   for (thread = 0; thread < thread_count; thread++)
+      pthread_join(thread_handles[thread], NULL);
+   GET_TIME(finish);
+   elapsed = finish - start;
+
+   if (argc == 4) Print_tokens();
+   for (thread = 0; thread < thread_count; thread++)
+      total += vecs[thread].count;
+   printf("%ld bytes, %ld tokens\n", size, total);
+   printf("Elapsed time = %e seconds, %e bytes per second\n", elapsed,
+         elapsed > 0 ? size/elapsed : 0.0);
+   if (Check_tokens())
+      printf("The tokens match the single-threaded tokens\n");
+   else
+      printf("The tokens DON'T match the single-threaded tokens\n");
+
+   for (thread = 0; thread < thread_count; thread++)
+      Tok_vec_free(&vecs[thread]);
+   free(vecs);
+   free(bounds);
+   free(thread_handles);
+   Tok_unmap(text, size);
+   return 0;
+}  /* main */
+
+
+/*--------------------------------------------------------------------
+ * Function:    Usage
+ * Purpose:     Print command line for function and terminate
+ * In arg:      prog_name
+ */
+void Usage(char* prog_name) {
+
+   fprintf(stderr, "usage: %s <number of threads> <file> [p]\n", prog_name);
+   fprintf(stderr, "   p:  print the tokens\n");
+   exit(0);
+}  /* Usage */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Tokenize
+ * Purpose:     Tokenize the lines in this thread's range
+ * In arg:      rank
+ * Global vars: text, bounds (in), vecs[my_rank] (out)
+ * Return val:  Ignored
+ */
+void *Tokenize(void* rank) {
+   long my_rank = (long) rank;
+
+   Tok_vec_init(&vecs[my_rank]);
+   Tok_scan(text, bounds[my_rank], bounds[my_rank+1], &vecs[my_rank]);
+
+   return NULL;
+}  /* Tokenize */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Print_tokens
+ * Purpose:     Print each thread's tokens, in order
+ */
+void Print_tokens(void) {
+   long thread, i;
+   struct tok_s* tok;
+
+   for (thread = 0; thread < thread_count; thread++)
+      for (i = 0; i < vecs[thread].count; i++) {
+         tok = &vecs[thread].toks[i];
+         printf("Thread %ld > string %ld = %.*s\n", thread, i + 1,
+               (int) tok->length, text + tok->offset);
+      }
+}  /* Print_tokens */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Check_tokens
+ * Purpose:     Tokenize the whole file with one call to Tok_scan, and
+ *              compare with the threads' tokens
+ * Return val:  1 if they're the same, 0 otherwise
+ */
+int Check_tokens(void) {
+   struct tok_vec_s all;
+   long thread, i, j = 0;
+   int ok = 1;
+
+   Tok_vec_init(&all);
+   Tok_scan(text, 0, size, &all);
+   for (thread = 0; thread < thread_count && ok; thread++)
+      for (i = 0; i < vecs[thread].count && ok; i++, j++)
+         if (j >= all.count
+               || vecs[thread].toks[i].offset != all.toks[j].offset
+               || vecs[thread].toks[i].length != all.toks[j].length)
+            ok = 0;
+   if (j != all.count) ok = 0;
+   Tok_vec_free(&all);
+   return ok;
+}  /* Check_tokens */
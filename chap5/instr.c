@@ -0,0 +1,337 @@
+/* File:     instr.c
+ *
+ * Purpose:  Region timers and hardware counters.  See instr.h.
+ *
+ * Notes:
+ * 1.  Each thread opens its own group of counters the first time it
+ *     enters a region, with perf_event_open(pid = 0, cpu = -1), so the
+ *     counters only count the calling thread, on any core.  The cycle
+ *     counter leads the group, so all the counters are read with one
+ *     call to read, and they're scheduled on the PMU together.
+ * 2.  If a different thread uses a rank (e.g., if the OpenMP runtime
+ *     creates new threads for a parallel region), it reopens the
+ *     rank's counters.
+ * 3.  If the group doesn't fit on the PMU with other users' counters,
+ *     the kernel multiplexes it and the counts are too small.  They're
+ *     not scaled.
+ * 4.  Only user mode events are counted (exclude_kernel), so the
+ *     counters work with perf_event_paranoid = 2.
+ *
+ * IPP:  Not discussed, but see Section 2.6 on performance and Section
+ *       3.6.1 (p. 121) on timing
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "instr.h"
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+struct instr_thread_s {
+   _Alignas(INSTR_CACHE_LINE) int fd[INSTR_COUNTERS];
+   int    slot[INSTR_COUNTERS];  /* Position of counter in a group read */
+   int    members;               /* Counters open in the group          */
+   char*  owner;                 /* &my_tag of the thread that opened   */
+   struct instr_region_s regions[INSTR_MAX_REGIONS];
+};
+
+static int instr_threads = 0;
+static struct instr_thread_s* threads = NULL;
+static int region_count = 0;
+static const char* region_names[INSTR_MAX_REGIONS];
+static int use_perf = 1;
+static unsigned long long flop_event = 0;
+static int counting[INSTR_COUNTERS];
+
+/* Each thread's my_tag has a different address */
+static _Thread_local char my_tag;
+
+static const char* counter_names[INSTR_COUNTERS] =
+   {"cycles", "instructions", "LLC misses", "FLOPs"};
+
+static void Open_counters(int rank);
+static void Read_counters(int rank, long long vals[]);
+
+/*------------------------------------------------------------------
+ * Function:  Instr_init
+ * Purpose:   Allocate totals for threads threads, and read the
+ *            environment variables INSTR_PERF and INSTR_FLOP_EVENT
+ */
+void Instr_init(int threads_in) {
+   char* env;
+   int t, c;
+
+   instr_threads = threads_in;
+   threads = aligned_alloc(INSTR_CACHE_LINE,
+         threads_in*sizeof(struct instr_thread_s));
+   memset(threads, 0, threads_in*sizeof(struct instr_thread_s));
+   for (t = 0; t < threads_in; t++)
+      for (c = 0; c < INSTR_COUNTERS; c++)
+         threads[t].fd[c] = -1;
+   for (c = 0; c < INSTR_COUNTERS; c++)
+      counting[c] = 0;
+
+   env = getenv("INSTR_PERF");
+   use_perf = (env == NULL || strcmp(env, "0") != 0);
+   env = getenv("INSTR_FLOP_EVENT");
+   if (env != NULL) flop_event = strtoull(env, NULL, 16);
+}  /* Instr_init */
+
+/*------------------------------------------------------------------
+ * Function:  Instr_region
+ * Purpose:   Return the number of the region called name, adding it if
+ *            it's new.  Called by one thread.
+ */
+int Instr_region(const char* name) {
+   int r;
+
+   for (r = 0; r < region_count; r++)
+      if (strcmp(region_names[r], name) == 0) return r;
+   if (region_count == INSTR_MAX_REGIONS) {
+      fprintf(stderr, "Instr:  more than %d regions\n", INSTR_MAX_REGIONS);
+      exit(-1);
+   }
+   region_names[region_count] = name;
+   return region_count++;
+}  /* Instr_region */
+
+#ifdef __linux__
+/*------------------------------------------------------------------
+ * Function:  Open_event
+ * Purpose:   Open one counter for the calling thread
+ * Return val:  The file descriptor, or -1
+ */
+static int Open_event(unsigned type, unsigned long long config,
+      int group_fd) {
+   struct perf_event_attr attr;
+
+   memset(&attr, 0, sizeof(attr));
+   attr.size = sizeof(attr);
+   attr.type = type;
+   attr.config = config;
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   attr.read_format = PERF_FORMAT_GROUP;
+   return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}  /* Open_event */
+#endif
+
+/*------------------------------------------------------------------
+ * Function:  Open_counters
+ * Purpose:   Open the counters of rank for the calling thread
+ */
+static void Open_counters(int rank) {
+   struct instr_thread_s* ts = &threads[rank];
+   int c;
+
+   for (c = 0; c < INSTR_COUNTERS; c++) {
+      if (ts->fd[c] >= 0) close(ts->fd[c]);
+      ts->fd[c] = -1;
+   }
+   ts->members = 0;
+   ts->owner = &my_tag;
+   if (!use_perf) return;
+
+#  ifdef __linux__
+   ts->fd[INSTR_CYCLES] = Open_event(PERF_TYPE_HARDWARE,
+         PERF_COUNT_HW_CPU_CYCLES, -1);
+   if (ts->fd[INSTR_CYCLES] < 0) return;
+   ts->fd[INSTR_INSTRS] = Open_event(PERF_TYPE_HARDWARE,
+         PERF_COUNT_HW_INSTRUCTIONS, ts->fd[INSTR_CYCLES]);
+   ts->fd[INSTR_LLC_MISSES] = Open_event(PERF_TYPE_HARDWARE,
+         PERF_COUNT_HW_CACHE_MISSES, ts->fd[INSTR_CYCLES]);
+   if (flop_event != 0)
+      ts->fd[INSTR_FLOPS] = Open_event(PERF_TYPE_RAW, flop_event,
+            ts->fd[INSTR_CYCLES]);
+
+   /* The values in a group read are in the order the counters were */
+   /* opened                                                         */
+   for (c = 0; c < INSTR_COUNTERS; c++)
+      if (ts->fd[c] >= 0) {
+         ts->slot[c] = ts->members++;
+         counting[c] = 1;
+      }
+#  endif
+}  /* Open_counters */
+
+/*------------------------------------------------------------------
+ * Function:  Read_counters
+ * Purpose:   Read the counters of rank.  Counters that aren't open are
+ *            0.
+ */
+static void Read_counters(int rank, long long vals[]) {
+   struct instr_thread_s* ts = &threads[rank];
+   unsigned long long buf[1 + INSTR_COUNTERS];
+   int c;
+
+   for (c = 0; c < INSTR_COUNTERS; c++)
+      vals[c] = 0;
+   if (ts->members == 0) return;
+   if (read(ts->fd[INSTR_CYCLES], buf, sizeof(buf)) <= 0) return;
+   for (c = 0; c < INSTR_COUNTERS; c++)
+      if (ts->fd[c] >= 0)
+         vals[c] = buf[1 + ts->slot[c]];
+}  /* Read_counters */
+
+/*------------------------------------------------------------------
+ * Function:  Instr_begin
+ * Purpose:   Start measuring region in thread rank
+ */
+void Instr_begin(int rank, int region) {
+   struct instr_region_s* r = &threads[rank].regions[region];
+
+   if (threads[rank].owner != &my_tag) Open_counters(rank);
+   Read_counters(rank, r->start);
+   r->start_ns = Instr_ns();
+}  /* Instr_begin */
+
+/*------------------------------------------------------------------
+ * Function:  Instr_end
+ * Purpose:   Stop measuring region in thread rank, and add the time
+ *            and counts to the thread's totals
+ */
+void Instr_end(int rank, int region) {
+   struct instr_region_s* r = &threads[rank].regions[region];
+   long long now = Instr_ns(), vals[INSTR_COUNTERS];
+   int c;
+
+   Read_counters(rank, vals);
+   r->ns += now - r->start_ns;
+   for (c = 0; c < INSTR_COUNTERS; c++)
+      r->count[c] += vals[c] - r->start[c];
+   r->calls++;
+}  /* Instr_end */
+
+/*------------------------------------------------------------------
+ * Function:  Instr_add_flops
+ * Purpose:   Add flops floating point operations to region in thread
+ *            rank
+ */
+void Instr_add_flops(int rank, int region, double flops) {
+   threads[rank].regions[region].flops += flops;
+}  /* Instr_add_flops */
+
+/*------------------------------------------------------------------
+ * Function:  Instr_counting
+ * Purpose:   Return 1 if some thread opened counter
+ */
+int Instr_counting(int counter) {
+   return counting[counter];
+}  /* Instr_counting */
+
+/*------------------------------------------------------------------
+ * Function:  Instr_total
+ * Purpose:   Add the totals of the threads for region.  ns is the
+ *            largest time of any thread, and calls is the largest
+ *            number of calls.
+ */
+void Instr_total(int region, struct instr_region_s* total) {
+   struct instr_region_s* r;
+   int t, c;
+
+   memset(total, 0, sizeof(*total));
+   for (t = 0; t < instr_threads; t++) {
+      r = &threads[t].regions[region];
+      if (r->ns > total->ns) total->ns = r->ns;
+      if (r->calls > total->calls) total->calls = r->calls;
+      for (c = 0; c < INSTR_COUNTERS; c++)
+         total->count[c] += r->count[c];
+      total->flops += r->flops;
+   }
+}  /* Instr_total */
+
+/*------------------------------------------------------------------
+ * Function:  Print_region
+ * Purpose:   Print one line of the report
+ */
+static void Print_region(FILE* fp, const char* name,
+      struct instr_region_s* r) {
+   double seconds = r->ns/1.0e9;
+   double flops = (r->flops > 0.0) ? r->flops : r->count[INSTR_FLOPS];
+
+   fprintf(fp, "%-16s %8lld %e", name, r->calls, seconds);
+   if (flops > 0.0 && seconds > 0.0)
+      fprintf(fp, " %9.3f", flops/seconds/1.0e9);
+   else
+      fprintf(fp, " %9s", "-");
+   if (counting[INSTR_CYCLES])
+      fprintf(fp, " %e %e %6.3f", (double) r->count[INSTR_CYCLES],
+            (double) r->count[INSTR_INSTRS],
+            r->count[INSTR_CYCLES] > 0 ?
+               (double) r->count[INSTR_INSTRS]/r->count[INSTR_CYCLES] : 0.0);
+   if (counting[INSTR_LLC_MISSES])
+      fprintf(fp, " %e %8.3f", (double) r->count[INSTR_LLC_MISSES],
+            r->count[INSTR_INSTRS] > 0 ?
+               1000.0*r->count[INSTR_LLC_MISSES]/r->count[INSTR_INSTRS] : 0.0);
+   fprintf(fp, "\n");
+}  /* Print_region */
+
+/*------------------------------------------------------------------
+ * Function:  Instr_report
+ * Purpose:   Print the totals for each region, and if per_thread is
+ *            nonzero, the totals of each thread
+ */
+void Instr_report(FILE* fp, int per_thread) {
+   struct instr_region_s total;
+   char name[64];
+   int r, t, c;
+
+   fprintf(fp, "Region              Calls     Time (s)   GFLOP/s");
+   if (counting[INSTR_CYCLES])
+      fprintf(fp, "       Cycles  Instructions    IPC");
+   if (counting[INSTR_LLC_MISSES])
+      fprintf(fp, "   LLC misses  Miss/Kinst");
+   fprintf(fp, "\n");
+   for (r = 0; r < region_count; r++) {
+      Instr_total(r, &total);
+      Print_region(fp, region_names[r], &total);
+      if (per_thread)
+         for (t = 0; t < instr_threads; t++) {
+            snprintf(name, sizeof(name), "  thread %d", t);
+            Print_region(fp, name, &threads[t].regions[r]);
+         }
+   }
+   if (use_perf && !counting[INSTR_CYCLES])
+      fprintf(fp, "(perf_event_open failed:  no hardware counters)\n");
+   else
+      for (c = 0; c < INSTR_COUNTERS; c++)
+         if (use_perf && !counting[c] && (c != INSTR_FLOPS || flop_event))
+            fprintf(fp, "(%s aren't counted on this system)\n",
+                  counter_names[c]);
+}  /* Instr_report */
+
+/*------------------------------------------------------------------
+ * Function:  Instr_finalize
+ * Purpose:   Close the counters and free the totals
+ */
+void Instr_finalize(void) {
+   int t, c;
+
+   for (t = 0; t < instr_threads; t++)
+      for (c = 0; c < INSTR_COUNTERS; c++)
+         if (threads[t].fd[c] >= 0) close(threads[t].fd[c]);
+   free(threads);
+   threads = NULL;
+   instr_threads = region_count = 0;
+}  /* Instr_finalize */
+
+/*------------------------------------------------------------------
+ * Function:  Instr_tsc_ghz
+ * Purpose:   Estimate the rate of the time stamp counter in GHz by
+ *            comparing it with the monotonic clock over 20 ms
+ */
+double Instr_tsc_ghz(void) {
+   long long ns0, ns1;
+   unsigned long long tsc0, tsc1;
+
+   ns0 = Instr_ns();
+   tsc0 = Instr_tsc();
+   do {
+      ns1 = Instr_ns();
+   } while (ns1 - ns0 < 20000000);
+   tsc1 = Instr_tsc();
+   return (double) (tsc1 - tsc0)/(ns1 - ns0);
+}  /* Instr_tsc_ghz */
@@ -0,0 +1,161 @@
+/* File:     instr.h
+ * Purpose:  Timers and hardware counters for measuring kernels.
+ *
+ *           Instr_ns and Instr_seconds read the monotonic clock, which
+ *           has nanosecond resolution and isn't changed when the
+ *           system's time of day is set.  Instr_tsc reads the time
+ *           stamp counter on x86.  These three are inline, so a
+ *           program that only uses them doesn't need instr.c.
+ *           Instr_tsc_ghz, which finds the rate of the counter, is in
+ *           instr.c.
+ *
+ *           instr.c times named regions of a program, and on Linux it
+ *           counts cycles, instructions, last level cache misses and
+ *           (optionally) floating point operations in each region with
+ *           perf_event_open.  Each thread adds to its own totals, and
+ *           Instr_report adds the totals of the threads.
+ *
+ * Example:
+ *    #include "instr.h"
+ *    . . .
+ *    Instr_init(thread_count);
+ *    mult = Instr_region("mult");
+ *    . . .
+ *    (In thread my_rank)
+ *    Instr_begin(my_rank, mult);
+ *    Code to be measured
+ *    Instr_end(my_rank, mult);
+ *    Instr_add_flops(my_rank, mult, 2.0*my_rows*n*n);
+ *    . . .
+ *    Instr_report(stdout, 0);
+ *    Instr_finalize();
+ *
+ *    INSTR_SCOPE(my_rank, mult) {
+ *       Code to be measured
+ *    }
+ *
+ *    does the same as the calls to Instr_begin and Instr_end, but the
+ *    block mustn't be left with break, return or goto.
+ *
+ * Notes:
+ * 1.  The counters are turned off by setting the environment variable
+ *     INSTR_PERF to 0.  If perf_event_open fails (e.g., because
+ *     /proc/sys/kernel/perf_event_paranoid is too high, or in a
+ *     virtual machine without a PMU), only the times are reported.
+ * 2.  There's no portable perf event for floating point operations.
+ *     To count them, set INSTR_FLOP_EVENT to the raw event code in
+ *     hex, e.g., on Intel Skylake and later 0x1fc7 counts scalar and
+ *     128-bit double operations (FP_ARITH_INST_RETIRED).  Otherwise
+ *     GFLOP/s is computed from the counts passed to Instr_add_flops.
+ * 3.  The time of a region is the largest total time of any thread in
+ *     the region.  The counts are the sums over the threads.
+ *
+ * IPP:  Not discussed, but see Section 2.6 on performance and Section
+ *       3.6.1 (p. 121) on timing
+ */
+#ifndef _INSTR_H_
+#define _INSTR_H_
+
+/* clock_gettime is POSIX, so ask for it in case this is the first
+ * header included, e.g., with -std=c99 */
+#if !defined(_POSIX_C_SOURCE) && !defined(_XOPEN_SOURCE) && \
+      !defined(_GNU_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define INSTR_CACHE_LINE  64
+#define INSTR_MAX_REGIONS 32
+
+/* Counters */
+#define INSTR_CYCLES      0
+#define INSTR_INSTRS      1
+#define INSTR_LLC_MISSES  2
+#define INSTR_FLOPS       3
+#define INSTR_COUNTERS    4
+
+struct instr_region_s {
+   long long calls;
+   long long ns;
+   long long count[INSTR_COUNTERS];
+   double    flops;          /* From Instr_add_flops */
+
+   /* Values when the region was entered */
+   long long start_ns;
+   long long start[INSTR_COUNTERS];
+};
+
+void   Instr_init(int threads);
+int    Instr_region(const char* name);
+void   Instr_begin(int rank, int region);
+void   Instr_end(int rank, int region);
+void   Instr_add_flops(int rank, int region, double flops);
+int    Instr_counting(int counter);
+void   Instr_total(int region, struct instr_region_s* total);
+void   Instr_report(FILE* fp, int per_thread);
+void   Instr_finalize(void);
+double Instr_tsc_ghz(void);
+
+#define INSTR_SCOPE(rank, region) \
+   for (int _instr_once = (Instr_begin(rank, region), 1); _instr_once; \
+         _instr_once = (Instr_end(rank, region), 0))
+
+/*------------------------------------------------------------------
+ * Function:  Instr_ns
+ * Purpose:   Return the monotonic clock in nanoseconds
+ * Note:      If a system header was included before instr.h in a
+ *            strict ISO C build, clock_gettime isn't declared, and
+ *            the time of day from gettimeofday is used instead.
+ */
+static inline long long Instr_ns(void) {
+#  ifdef CLOCK_MONOTONIC
+   struct timespec t;
+
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec*1000000000LL + t.tv_nsec;
+#  else
+   struct timeval t;
+
+   gettimeofday(&t, NULL);
+   return t.tv_sec*1000000000LL + t.tv_usec*1000LL;
+#  endif
+}  /* Instr_ns */
+
+/*------------------------------------------------------------------
+ * Function:  Instr_seconds
+ * Purpose:   Return the monotonic clock in seconds (see Instr_ns)
+ */
+static inline double Instr_seconds(void) {
+#  ifdef CLOCK_MONOTONIC
+   struct timespec t;
+
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec/1.0e9;
+#  else
+   struct timeval t;
+
+   gettimeofday(&t, NULL);
+   return t.tv_sec + t.tv_usec/1.0e6;
+#  endif
+}  /* Instr_seconds */
+
+/*------------------------------------------------------------------
+ * Function:  Instr_tsc
+ * Purpose:   Return the time stamp counter, or Instr_ns if the
+ *            processor isn't x86.  The counter ticks at a fixed rate,
+ *            and on most systems it's synchronized across cores.
+ */
+static inline unsigned long long Instr_tsc(void) {
+#  if defined(__x86_64__) || defined(__i386__)
+   return __rdtsc();
+#  else
+   return Instr_ns();
+#  endif
+}  /* Instr_tsc */
+
+#endif
@@ -0,0 +1,159 @@
+/* File:     mat_alloc.c
+ *
+ * Purpose:  Allocate aligned, padded matrices backed by huge pages.  See
+ *           mat_alloc.h.
+ *
+ * Notes:
+ * 1.  Each block starts with a header of MAT_CACHE_LINE bytes that says
+ *     how it was allocated, and the matrix follows the header.  So
+ *     Mat_free needs only the pointer to the matrix, and the matrix
+ *     starts on a cache line.
+ * 2.  Huge pages are only used for blocks of at least MAT_HUGE_PAGE
+ *     bytes.  For transparent huge pages, the block is mapped with
+ *     mmap, aligned on a huge page, and given to madvise.  The kernel
+ *     may still use 4 KB pages (e.g., if
+ *     /sys/kernel/mm/transparent_hugepage/enabled is never), and
+ *     Mat_huge_kb can be used to check.  For explicit huge pages, the
+ *     block is mapped with MAP_HUGETLB, and the length is a whole number
+ *     of huge pages.
+ * 3.  Only the page with the header is written, so the other pages are
+ *     put on a NUMA node when they're first written (see omp_numa.h).
+ *
+ * IPP:  Not discussed, but see Section 2.2 on caches and virtual
+ *       memory
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "mat_alloc.h"
+
+#define MAT_MALLOC  0
+#define MAT_THP     1
+#define MAT_HUGETLB 2
+
+struct mat_header_s {
+   void*  base;     /* Start of the block         */
+   size_t len;      /* Length of the block        */
+   int    kind;     /* MAT_MALLOC, MAT_THP, . . . */
+};
+
+static int Huge_kind(void);
+
+/*------------------------------------------------------------------
+ * Function:  Huge_kind
+ * Purpose:   Return the kind of huge pages selected by MAT_HUGE
+ */
+static int Huge_kind(void) {
+   const char* env = getenv("MAT_HUGE");
+
+   if (env == NULL || strcmp(env, "thp") == 0) return MAT_THP;
+   if (strcmp(env, "explicit") == 0) return MAT_HUGETLB;
+   if (strcmp(env, "none") == 0) return MAT_MALLOC;
+   fprintf(stderr, "Mat_alloc:  MAT_HUGE = %s isn't thp, explicit or "
+         "none, using thp\n", env);
+   return MAT_THP;
+}  /* Huge_kind */
+
+/*------------------------------------------------------------------
+ * Function:  Mat_ld
+ * Purpose:   Return the padded leading dimension of a matrix with n
+ *            columns of doubles
+ */
+long Mat_ld(long n) {
+   const long line = MAT_CACHE_LINE/sizeof(double);
+   const char* env = getenv("MAT_PAD");
+   long ld;
+
+   if (env != NULL && strcmp(env, "0") == 0) return n;
+   ld = (n + line - 1)/line*line;
+   if (ld % (8*line) == 0) ld += line;
+   return ld;
+}  /* Mat_ld */
+
+/*------------------------------------------------------------------
+ * Function:  Mat_alloc
+ * Purpose:   Allocate an m x n matrix of doubles
+ * Out arg:   ld_p:  the leading dimension.  If ld_p is NULL, the rows
+ *               aren't padded.
+ * Ret val:   The matrix, or NULL if there isn't enough memory
+ */
+double* Mat_alloc(long m, long n, long* ld_p) {
+   struct mat_header_s h;
+   long ld = (ld_p == NULL) ? n : Mat_ld(n);
+   size_t bytes = m*ld*sizeof(double) + MAT_CACHE_LINE;
+   char* start = NULL;
+
+   h.kind = (bytes < MAT_HUGE_PAGE) ? MAT_MALLOC : Huge_kind();
+
+   if (h.kind == MAT_HUGETLB) {
+      h.len = (bytes + MAT_HUGE_PAGE - 1)/MAT_HUGE_PAGE*MAT_HUGE_PAGE;
+      h.base = mmap(NULL, h.len, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (h.base != MAP_FAILED)
+         start = h.base;
+      else
+         h.kind = MAT_THP;
+   }
+
+   if (h.kind == MAT_THP) {
+      h.len = bytes + MAT_HUGE_PAGE;
+      h.base = mmap(NULL, h.len, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (h.base == MAP_FAILED) return NULL;
+      start = (char*) (((uintptr_t) h.base + MAT_HUGE_PAGE - 1)
+            & ~(uintptr_t) (MAT_HUGE_PAGE - 1));
+#     ifdef MADV_HUGEPAGE
+      madvise(start, bytes, MADV_HUGEPAGE);
+#     endif
+   }
+
+   if (h.kind == MAT_MALLOC) {
+      h.len = bytes;
+      if (posix_memalign(&h.base, MAT_CACHE_LINE, bytes) != 0)
+         return NULL;
+      start = h.base;
+   }
+
+   memcpy(start, &h, sizeof(h));
+   if (ld_p != NULL) *ld_p = ld;
+   return (double*) (start + MAT_CACHE_LINE);
+}  /* Mat_alloc */
+
+/*------------------------------------------------------------------
+ * Function:  Mat_free
+ * Purpose:   Free a matrix allocated by Mat_alloc
+ */
+void Mat_free(double* a) {
+   struct mat_header_s h;
+
+   if (a == NULL) return;
+   memcpy(&h, (char*) a - MAT_CACHE_LINE, sizeof(h));
+   if (h.kind == MAT_MALLOC)
+      free(h.base);
+   else
+      munmap(h.base, h.len);
+}  /* Mat_free */
+
+/*------------------------------------------------------------------
+ * Function:  Mat_huge_kb
+ * Purpose:   Return the kilobytes of the process's memory that are in
+ *            huge pages, from /proc/self/smaps_rollup, or -1 if the
+ *            file can't be read
+ */
+long Mat_huge_kb(void) {
+   FILE* fp = fopen("/proc/self/smaps_rollup", "r");
+   char line[256];
+   long kb, total = 0;
+
+   if (fp == NULL) return -1;
+   while (fgets(line, sizeof(line), fp) != NULL)
+      if (sscanf(line, "AnonHugePages: %ld", &kb) == 1 ||
+            sscanf(line, "Private_Hugetlb: %ld", &kb) == 1 ||
+            sscanf(line, "Shared_Hugetlb: %ld", &kb) == 1)
+         total += kb;
+   fclose(fp);
+   return total;
+}  /* Mat_huge_kb */
@@ -0,0 +1,48 @@
+/* File:     mat_alloc.h
+ * Purpose:  Header file for mat_alloc.c, which allocates the storage of
+ *           large matrices.
+ *
+ *           The storage is aligned on a 64-byte cache line, and if it's
+ *           at least MAT_HUGE_PAGE bytes, it's backed by 2 MB huge pages,
+ *           so that a 5000 x 5000 matrix of doubles needs about 100 TLB
+ *           entries instead of 50,000.  The rows can be padded:  the
+ *           leading dimension ld (the distance between the starts of
+ *           consecutive rows) is rounded up to a whole number of cache
+ *           lines, and if the rows would then be a multiple of 512 bytes
+ *           apart, a cache line is added.  Otherwise, when n is a power
+ *           of 2, the elements of a column of B fall in a few sets of the
+ *           cache, and a loop down the column evicts its own lines.
+ *
+ * Usage:
+ *    long ld;
+ *    double* A = Mat_alloc(m, n, &ld);
+ *    A[i*ld + j] is element (i, j)
+ *    . . .
+ *    Mat_free(A);
+ *
+ *    If the code indexes with n, pass NULL for ld, and the rows aren't
+ *    padded.
+ *
+ * Environment:
+ *    MAT_HUGE   thp:  use transparent huge pages (madvise), the default
+ *               explicit:  use pages from the huge page pool
+ *                  (/proc/sys/vm/nr_hugepages), or transparent huge
+ *                  pages if the pool is empty
+ *               none:  4 KB pages
+ *    MAT_PAD    0:  don't pad the rows
+ *
+ * IPP:  Not discussed, but see Section 2.2 on caches and virtual
+ *       memory
+ */
+#ifndef _MAT_ALLOC_H_
+#define _MAT_ALLOC_H_
+
+#define MAT_CACHE_LINE 64
+#define MAT_HUGE_PAGE  (2L*1024*1024)
+
+double* Mat_alloc(long m, long n, long* ld_p);
+void    Mat_free(double* a);
+long    Mat_ld(long n);
+long    Mat_huge_kb(void);
+
+#endif
@@ -3,10 +3,15 @@
 *                                                                             *
 *  Program illustrate the use of dynamic memory allocation to create          *
 *  contiguous 2D-matrices and use traditional array indexing.                 *
-*  It also illustrate the use of gettime to measure wall clock time.          *
+*  It also illustrate the use of gettime to measure wall clock time, and     *
+*  instr.c to report GFLOP/s and hardware counters for each thread.           *
 *                                                                             *
-*  To Compile: gcc -Wall -O -fopenmp matmul_1d.c                              * 
+*  To Compile: gcc -Wall -O -fopenmp matmul_1d.c instr.c                      * 
 *              add -DNTHREADS=P create P threads                              *
+*              add -DNUMA and omp_numa.c to bind the threads and put          *
+*              each thread's rows on its NUMA node (see omp_numa.h)           *
+*              add -DMAT_ALLOC and mat_alloc.c for aligned, padded rows       *
+*              on huge pages (see mat_alloc.h)                                *
 *  To run: ./a.out <size> <P>                                                 *
 *                                                                             *
 *  Author: Purushotham Bangalore                                              *
@@ -15,25 +20,34 @@
 ******************************************************************************/
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/time.h>
+#include <omp.h>
+#include "instr.h"
+#ifdef NUMA
+#include "omp_numa.h"
+#endif
+#ifdef MAT_ALLOC
+#include "mat_alloc.h"
+#endif
 
 #ifndef NTHREADS
 #define NTHREADS 1
 #endif
 
+/* Monotonic wall clock time in seconds, see instr.h */
 double gettime(void) {
-  struct timeval tval;
-
-  gettimeofday(&tval, NULL);
-
-  return( (double)tval.tv_sec + (double)tval.tv_usec/1000000.0 );
+  return Instr_seconds();
 }
 
 double **allocarray(int P, int Q) {
   int i;
+  long ld = Q;
   double *p, **a;
   
+#ifdef MAT_ALLOC
+  p = Mat_alloc(P, Q, &ld);
+#else
   p = (double *)malloc(P*Q*sizeof(double));
+#endif
   a = (double **)malloc(P*sizeof(double*));
 
   if (p == NULL || a == NULL) 
@@ -41,13 +55,27 @@ double **allocarray(int P, int Q) {
 
   /* for row major storage */
   for (i = 0; i < P; i++)
-    a[i] = &p[i*Q];
+    a[i] = &p[i*ld];
   
   return a;
 }
 
+#ifdef NUMA
+/* place the pages of a:  thread p*Q+q first writes block (p,q) */
+void placearray(double **a, int mrows, int ncols, int P, int Q) {
+  long ld = (mrows > 1) ? a[1] - a[0] : ncols;
+
+  Numa_place(&a[0][0], (size_t)mrows*ld*sizeof(double));
+  Numa_first_touch(&a[0][0], mrows, ld, P, Q);
+}
+#endif
+
 void freearray(double **a) {
+#ifdef MAT_ALLOC
+  Mat_free(&a[0][0]);
+#else
   free(&a[0][0]);
+#endif
   free(a);
 }
 
@@ -90,7 +118,8 @@ double **matmul1(double **a, double **b, double **c, int N)
 }
 
 /* output array address is passed as an argument */
-void matmul2(double **a, double **b, double ***c, int N) 
+/* each thread's rows are measured as region mult */
+void matmul2(double **a, double **b, double ***c, int N, int mult) 
 {
     int i, j, k;
     double sum;
@@ -98,14 +127,25 @@ void matmul2(double **a, double **b, double ***c, int N)
        and replace (*c) below with out, 
        if you like to make referencing easier to understand */
        
-#pragma omp parallel for default(none) shared(a,b,c,N) private(i,j,k,sum) num_threads(NTHREADS)
-    for (i=0; i<N; i++)
-      for (j=0; j<N; j++) {
-        sum = 0.0;
-	for (k=0; k<N; k++)
-	  sum += a[i][k]*b[k][j];
-	(*c)[i][j] = sum;
+#pragma omp parallel default(none) shared(a,b,c,N,mult) private(i,j,k,sum) num_threads(NTHREADS)
+    {
+      int rank = omp_get_thread_num();
+      long rows = 0;
+
+      Instr_begin(rank, mult);
+#pragma omp for nowait
+      for (i=0; i<N; i++) {
+        for (j=0; j<N; j++) {
+          sum = 0.0;
+	  for (k=0; k<N; k++)
+	    sum += a[i][k]*b[k][j];
+	  (*c)[i][j] = sum;
+        }
+        rows++;
       }
+      Instr_end(rank, mult);
+      Instr_add_flops(rank, mult, 2.0*rows*N*N);
+    }
 }
 
 int main(int argc, char **argv) 
@@ -113,6 +153,7 @@ int main(int argc, char **argv)
     int N;
     double **a=NULL, **b=NULL, **c=NULL;
     double starttime, endtime;
+    int mult;
 
     if (argc != 2) {
       printf("Usage: %s <N>\n", argv[0]);
@@ -125,17 +166,28 @@ int main(int argc, char **argv)
     a = allocarray(N, N);
     b = allocarray(N, N);
     c = allocarray(N, N);
+#ifdef NUMA
+    Numa_init(NTHREADS);
+    placearray(a, N, N, NTHREADS, 1);
+    placearray(b, N, N, NTHREADS, 1);
+    placearray(c, N, N, NTHREADS, 1);
+#endif
     
     /* Initialize the matrices */
     srand48(123456);
     a = initarray(a, N, N, (double)(1.0));
     b = initarray(b, N, N, (double)(2.0));
     c = initarray(c, N, N, (double)0.0);
+#ifdef MAT_ALLOC
+    printf("Huge pages = %ld kB\n", Mat_huge_kb());
+#endif
 
     /* Perform matrix multiplication */
+    Instr_init(NTHREADS);
+    mult = Instr_region("matmul2");
     starttime = gettime();
     // c = matmul1(a,b,c,N);
-    matmul2(a,b,&c,N);
+    matmul2(a,b,&c,N,mult);
     endtime = gettime();
 
 #ifdef DEBUG_PRINT
@@ -147,6 +199,8 @@ int main(int argc, char **argv)
 #endif
 
     printf("Time taken for size %d = %lf seconds\n", N, endtime-starttime);
+    Instr_report(stdout, NTHREADS > 1);
+    Instr_finalize();
 
     freearray(a);
     freearray(b);
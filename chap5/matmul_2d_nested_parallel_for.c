@@ -18,7 +18,7 @@
 ******************************************************************************/
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/time.h>
+#include "instr.h"
 
 #ifndef PTHREADS
 #define PTHREADS 1
@@ -27,12 +27,9 @@
 #define QTHREADS 1
 #endif
 
+/* Monotonic wall clock time in seconds, see instr.h */
 double gettime(void) {
-  struct timeval tval;
-
-  gettimeofday(&tval, NULL);
-
-  return( (double)tval.tv_sec + (double)tval.tv_usec/1000000.0 );
+  return Instr_seconds();
 }
 
 double **allocarray(int P, int Q) {
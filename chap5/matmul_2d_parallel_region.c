@@ -9,6 +9,13 @@
 *                                                                             *
 * To Compile: gcc -Wall -O -fopenmp matmul_2d_parallel_region.c  -o matmul_2d_parallel_region             * 
 * To run: ./matmul_2d_parallel_region <size> <P> <Q>                                              *
+* Add -DNUMA and omp_numa.c to bind the threads and put block (p,q) of        *
+* each matrix on the NUMA node of thread p*Q+q (see omp_numa.h).              *
+* Add -DMAT_ALLOC and mat_alloc.c for aligned, padded rows on huge pages      *
+* (see mat_alloc.h).                                                          *
+* Add -DSTRASSEN and omp_strassen.c -lm to multiply by Strassen-Winograd      *
+* with P*Q threads, down to STRASSEN_CUTOFF, and compare with matmul2         *
+* (see omp_strassen.h).                                                       *
 *                                                                             *
 *  Author: Purushotham Bangalore                                              *
 *  Email: puri@uab.edu                                                        *
@@ -16,22 +23,33 @@
 ******************************************************************************/
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/time.h>
+#include "instr.h"
+#ifdef NUMA
+#include "omp_numa.h"
+#endif
+#ifdef MAT_ALLOC
+#include "mat_alloc.h"
+#endif
+#ifdef STRASSEN
+#include "omp_strassen.h"
+#endif
 #include <omp.h>
 
+/* Monotonic wall clock time in seconds, see instr.h */
 double gettime(void) {
-  struct timeval tval;
-
-  gettimeofday(&tval, NULL);
-
-  return( (double)tval.tv_sec + (double)tval.tv_usec/1000000.0 );
+  return Instr_seconds();
 }
 
 double **allocarray(int P, int Q) {
   int i;
+  long ld = Q;
   double *p, **a;
   
+#ifdef MAT_ALLOC
+  p = Mat_alloc(P, Q, &ld);
+#else
   p = (double *)malloc(P*Q*sizeof(double));
+#endif
   a = (double **)malloc(P*sizeof(double*));
 
   if (p == NULL || a == NULL) 
@@ -39,13 +57,32 @@ double **allocarray(int P, int Q) {
 
   /* for row major storage */
   for (i = 0; i < P; i++)
-    a[i] = &p[i*Q];
+    a[i] = &p[i*ld];
   
   return a;
 }
 
+/* distance between the starts of the rows, see allocarray */
+long ldarray(double **a, int mrows, int ncols) {
+  return (mrows > 1) ? a[1] - a[0] : ncols;
+}
+
+#ifdef NUMA
+/* place the pages of a:  thread p*Q+q first writes block (p,q) */
+void placearray(double **a, int mrows, int ncols, int P, int Q) {
+  long ld = ldarray(a, mrows, ncols);
+
+  Numa_place(&a[0][0], (size_t)mrows*ld*sizeof(double));
+  Numa_first_touch(&a[0][0], mrows, ld, P, Q);
+}
+#endif
+
 void freearray(double **a) {
+#ifdef MAT_ALLOC
+  Mat_free(&a[0][0]);
+#else
   free(&a[0][0]);
+#endif
   free(a);
 }
 
@@ -132,6 +169,10 @@ int main(int argc, char **argv)
     int N, P, Q;
     double **a=NULL, **b=NULL, **c=NULL;
     double starttime, endtime;
+#ifdef STRASSEN
+    double **r=NULL, classic;
+    long cutoff;
+#endif
 
     if (argc != 4) {
       printf("Usage: %s <N> <P> <Q>\n", argv[0]);
@@ -146,18 +187,47 @@ int main(int argc, char **argv)
     a = allocarray(N, N);
     b = allocarray(N, N);
     c = allocarray(N, N);
+#ifdef NUMA
+    Numa_init(P*Q);
+    placearray(a, N, N, P, Q);
+    placearray(b, N, N, P, Q);
+    placearray(c, N, N, P, Q);
+#endif
     
     /* Initialize the matrices */
     srand48(123456);
     a = initarray(a, N, N, (double)(1.0));
     b = initarray(b, N, N, (double)(2.0));
     c = initarray(c, N, N, (double)0.0);
+#ifdef MAT_ALLOC
+    printf("Huge pages = %ld kB\n", Mat_huge_kb());
+#endif
 
     /* Perform matrix multiplication */
+#ifdef STRASSEN
+    cutoff = Strassen_cutoff();
+    starttime = gettime();
+    Strassen(P*Q, N, a[0], ldarray(a, N, N), b[0], ldarray(b, N, N),
+             c[0], ldarray(c, N, N), cutoff);
+    endtime = gettime();
+
+    /* the classic product, for the time and the error */
+    r = allocarray(N, N);
+    classic = gettime();
+    matmul2(a,b,&r,N,P,Q);
+    classic = gettime() - classic;
+    printf("Strassen with cutoff %ld: %.1f%% of the flops, speedup %.2f over matmul2 (%lf seconds)\n",
+           cutoff, 100.0*Strassen_flops(N, cutoff)/(2.0*N*N*N),
+           classic/(endtime-starttime), classic);
+    printf("Relative error = %e\n", Strassen_error(N, c[0], ldarray(c, N, N),
+           r[0], ldarray(r, N, N)));
+    freearray(r);
+#else
     starttime = gettime();
    // c = matmul1(a,b,c,N);
     matmul2(a,b,&c,N,P,Q);
     endtime = gettime();
+#endif
 
 #ifdef DEBUG_PRINT
     printarray(a, N, N);
@@ -17,16 +17,13 @@
 ******************************************************************************/
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/time.h>
+#include "instr.h"
 #include <omp.h>
 #include<string.h>
 
+/* Monotonic wall clock time in seconds, see instr.h */
 double gettime(void) {
-  struct timeval tval;
-
-  gettimeofday(&tval, NULL);
-
-  return( (double)tval.tv_sec + (double)tval.tv_usec/1000000.0 );
+  return Instr_seconds();
 }
 
 void file_write(char* path, double **A, int m, int n,int P,int Q,int iterations){
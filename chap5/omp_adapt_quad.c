@@ -0,0 +1,322 @@
+/* File:    omp_adapt_quad.c
+ * Purpose: Estimate a definite integral using adaptive quadrature.
+ *          Instead of using n equal trapezoids, the interval is
+ *          bisected only where an error estimate says the current
+ *          approximation isn't good enough.  The refinement of the
+ *          two halves of an interval is done by OpenMP tasks.
+ *
+ * Input:   a, b, tol
+ * Output:  estimate of integral from a to b of f(x), its error if
+ *          the exact integral is known, the number of evaluations of
+ *          f, and, for comparison, the error of the trapezoidal rule
+ *          using the same number of evaluations
+ *
+ * Compile: gcc -g -Wall -O2 -fopenmp -o omp_adapt_quad omp_adapt_quad.c -lm
+ * Usage:   ./omp_adapt_quad <number of threads> <f> <rule> [cutoff]
+ *             f:       x2, peak, sqrt, or sin (see Integrands below)
+ *             rule:    s for adaptive Simpson, k for adaptive
+ *                      7-point Gauss/15-point Kronrod
+ *             cutoff:  depth below which no tasks are created,
+ *                      default log2(number of threads) + TASK_EXTRA
+ *
+ * Notes:
+ *   1.  An interval [l, r] is accepted when its error estimate is at
+ *       most tol*(r-l)/(b-a), so the estimated errors of the
+ *       accepted intervals add up to at most tol.
+ *   2.  Intervals are never bisected more than MAX_DEPTH times.
+ *   3.  New tasks are only created above depth task_cutoff.  Below
+ *       it each task refines its interval serially.  The default
+ *       allows up to about 2^TASK_EXTRA tasks per thread, which is
+ *       enough to balance the load without spending more time
+ *       creating tasks than evaluating f.
+ *   4.  To add an integrand, write the function and add it to the
+ *       integrands[] table.
+ *
+ * IPP:  Section 5.5 (pp. 224 and ff.)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#define MAX_DEPTH 50
+#define TASK_EXTRA 4    /* Extra task levels beyond log2(threads) */
+#define MAX_THREADS 1024
+#define PAD 8         /* doubles per 64-byte cache line */
+
+typedef double (*integrand_t)(double x);
+
+/* Integrands */
+double X2(double x);
+double Peak(double x);
+double Sqrt(double x);
+double Sin(double x);
+double X2_exact(double a, double b);
+double Peak_exact(double a, double b);
+double Sqrt_exact(double a, double b);
+double Sin_exact(double a, double b);
+
+struct integrand_s {
+   char*       name;
+   integrand_t f;
+   double      (*exact)(double a, double b);
+};
+
+struct integrand_s integrands[] = {
+   {"x2",   X2,   X2_exact},
+   {"peak", Peak, Peak_exact},
+   {"sqrt", Sqrt, Sqrt_exact},
+   {"sin",  Sin,  Sin_exact}
+};
+#define NUM_INTEGRANDS (sizeof(integrands)/sizeof(struct integrand_s))
+
+integrand_t f;
+int         task_cutoff;
+long        evals[MAX_THREADS*PAD];   /* One cache line per thread */
+
+void   Usage(char* prog_name);
+double Simpson(double a, double b, double fa, double fm, double fb,
+      double whole, double tol, int depth);
+double Gauss_kronrod(double a, double b, double* err_p);
+double Kronrod(double a, double b, double est, double err, double tol,
+      int depth);
+double Trap(double a, double b, long n);
+
+int main(int argc, char* argv[]) {
+   double  a, b, tol, approx = 0.0, err, fa, fm, fb, whole;
+   double  start, finish, exact, trap;
+   int     thread_count, i;
+   long    total_evals = 0;
+   char    rule;
+   struct integrand_s* ig = NULL;
+
+   if (argc != 4 && argc != 5) Usage(argv[0]);
+   thread_count = strtol(argv[1], NULL, 10);
+   for (i = 0; i < NUM_INTEGRANDS; i++)
+      if (strcmp(argv[2], integrands[i].name) == 0) ig = &integrands[i];
+   rule = argv[3][0];
+   if (thread_count <= 0 || thread_count > MAX_THREADS || ig == NULL
+         || (rule != 's' && rule != 'k')) Usage(argv[0]);
+   if (argc == 5) {
+      task_cutoff = strtol(argv[4], NULL, 10);
+      if (task_cutoff < 0) Usage(argv[0]);
+   } else {
+      /* Smallest d with 2^d >= thread_count, plus TASK_EXTRA */
+      for (task_cutoff = 0; (1 << task_cutoff) < thread_count;
+            task_cutoff++);
+      task_cutoff += TASK_EXTRA;
+   }
+   f = ig->f;
+
+   printf("Enter a, b, and tol\n");
+   scanf("%lf %lf %lf", &a, &b, &tol);
+
+   start = omp_get_wtime();
+#  pragma omp parallel num_threads(thread_count)
+#  pragma omp single
+   {
+      if (rule == 's') {
+         fa = f(a);
+         fm = f((a+b)/2);
+         fb = f(b);
+         evals[omp_get_thread_num()*PAD] += 3;
+         whole = (b-a)/6*(fa + 4*fm + fb);
+         approx = Simpson(a, b, fa, fm, fb, whole, tol, 0);
+      } else {
+         whole = Gauss_kronrod(a, b, &err);
+         approx = Kronrod(a, b, whole, err, tol, 0);
+      }
+   }
+   finish = omp_get_wtime();
+
+   for (i = 0; i < thread_count; i++)
+      total_evals += evals[i*PAD];
+   exact = ig->exact(a, b);
+   trap = Trap(a, b, total_evals - 1);
+
+   printf("Adaptive %s estimate of the integral of %s from %f to %f\n",
+         rule == 's' ? "Simpson" : "Gauss-Kronrod", ig->name, a, b);
+   printf("   = %.14e\n", approx);
+   printf("   Error = %.3e, tol = %.3e\n", fabs(approx - exact), tol);
+   printf("   Function evaluations = %ld\n", total_evals);
+   printf("   Elapsed time = %e seconds\n", finish - start);
+   printf("Trapezoidal rule with the same number of evaluations\n");
+   printf("   Error = %.3e\n", fabs(trap - exact));
+   return 0;
+}  /* main */
+
+/*--------------------------------------------------------------------
+ * Function:    Usage
+ * Purpose:     Print command line for function and terminate
+ * In arg:      prog_name
+ */
+void Usage(char* prog_name) {
+   int i;
+
+   fprintf(stderr, "usage: %s <number of threads> <f> <s|k> [cutoff]\n",
+         prog_name);
+   fprintf(stderr, "   f is one of");
+   for (i = 0; i < NUM_INTEGRANDS; i++)
+      fprintf(stderr, " %s", integrands[i].name);
+   fprintf(stderr, "\n");
+   exit(0);
+}  /* Usage */
+
+/*------------------------------------------------------------------
+ * Integrands:  each function f is paired with a function that
+ * returns the exact integral of f from a to b.
+ *
+ *    x2:    x*x, the integrand of the trapezoidal rule programs
+ *    peak:  1/(1e-6 + (x - 0.3)^2), with a sharp peak at x = 0.3
+ *    sqrt:  sqrt(|x|), whose derivative is infinite at 0
+ *    sin:   sin(x)
+ */
+double X2(double x) { return x*x; }
+double X2_exact(double a, double b) { return (b*b*b - a*a*a)/3.0; }
+
+#define PEAK_EPS 1.0e-6
+#define PEAK_X 0.3
+double Peak(double x) {
+   return 1.0/(PEAK_EPS + (x - PEAK_X)*(x - PEAK_X));
+}
+double Peak_exact(double a, double b) {
+   double s = sqrt(PEAK_EPS);
+   return (atan((b - PEAK_X)/s) - atan((a - PEAK_X)/s))/s;
+}
+
+double Sqrt(double x) { return sqrt(fabs(x)); }
+double Sqrt_exact(double a, double b) {
+   /* Antiderivative of sqrt(|x|) is sign(x)*2/3*|x|^1.5 */
+   double Fb = (b >= 0 ? 1 : -1)*2.0/3.0*pow(fabs(b), 1.5);
+   double Fa = (a >= 0 ? 1 : -1)*2.0/3.0*pow(fabs(a), 1.5);
+   return Fb - Fa;
+}
+
+double Sin(double x) { return sin(x); }
+double Sin_exact(double a, double b) { return cos(a) - cos(b); }
+
+/*------------------------------------------------------------------
+ * Function:    Simpson
+ * Purpose:     Adaptive Simpson's rule.  whole is Simpson's rule on
+ *              [a, b], and fa, fm, fb are f at a, (a+b)/2, and b.
+ *              If Simpson's rule on the two halves differs from
+ *              whole by at most 15*tol, accept the halves (with
+ *              Richardson extrapolation).  Otherwise refine each
+ *              half with tolerance tol/2 in its own task.
+ * Return val:  Estimate of the integral from a to b
+ */
+double Simpson(double a, double b, double fa, double fm, double fb,
+      double whole, double tol, int depth) {
+   double m = (a + b)/2, h = b - a;
+   double lm = (a + m)/2, rm = (m + b)/2;
+   double flm = f(lm), frm = f(rm);
+   double left = h/12*(fa + 4*flm + fm);
+   double right = h/12*(fm + 4*frm + fb);
+   double delta = left + right - whole;
+   double left_int, right_int;
+
+   evals[omp_get_thread_num()*PAD] += 2;
+   if (depth >= MAX_DEPTH || fabs(delta) <= 15*tol)
+      return left + right + delta/15;
+
+#  pragma omp task shared(left_int) final(depth >= task_cutoff)
+   left_int = Simpson(a, m, fa, flm, fm, left, tol/2, depth+1);
+   right_int = Simpson(m, b, fm, frm, fb, right, tol/2, depth+1);
+#  pragma omp taskwait
+
+   return left_int + right_int;
+}  /* Simpson */
+
+/*------------------------------------------------------------------
+ * Function:    Gauss_kronrod
+ * Purpose:     Apply the 15-point Kronrod rule to [a, b], and
+ *              estimate its error by comparing it with the embedded
+ *              7-point Gauss rule
+ * Out arg:     err_p
+ * Return val:  Kronrod estimate of the integral
+ */
+double Gauss_kronrod(double a, double b, double* err_p) {
+   static const double xgk[8] = {
+      0.991455371120812639206854697526329,
+      0.949107912342758524526189684047851,
+      0.864864423359769072789712788640926,
+      0.741531185599394439863864773280788,
+      0.586087235467691130294144845693013,
+      0.405845151377397166906606412076961,
+      0.207784955007898467600689403773245,
+      0.000000000000000000000000000000000};
+   static const double wgk[8] = {
+      0.022935322010529224963732008058970,
+      0.063092092629978553290700663189204,
+      0.104790010322250183839876322541518,
+      0.140653259715525918745189590510238,
+      0.169004726639267902826583426598550,
+      0.190350578064785409913256402421014,
+      0.204432940075298892414161999234649,
+      0.209482141084727828012999174891714};
+   static const double wg[4] = {
+      0.129484966168869693270611432679082,
+      0.279705391489276667901467771423780,
+      0.381830050505118944950369775488975,
+      0.417959183673469387755102040816327};
+   double c = (a + b)/2, h = (b - a)/2;
+   double fc = f(c), f1, f2, resk, resg;
+   int j;
+
+   resk = wgk[7]*fc;
+   resg = wg[3]*fc;
+   for (j = 0; j < 7; j++) {
+      f1 = f(c - h*xgk[j]);
+      f2 = f(c + h*xgk[j]);
+      resk += wgk[j]*(f1 + f2);
+      if (j % 2 == 1) resg += wg[j/2]*(f1 + f2);
+   }
+   evals[omp_get_thread_num()*PAD] += 15;
+   *err_p = fabs((resk - resg)*h);
+   return resk*h;
+}  /* Gauss_kronrod */
+
+/*------------------------------------------------------------------
+ * Function:    Kronrod
+ * Purpose:     Adaptive Gauss-Kronrod quadrature.  est and err are
+ *              the Kronrod estimate and error estimate on [a, b].
+ *              If err <= tol accept est, otherwise refine each half
+ *              with tolerance tol/2 in its own task.
+ * Return val:  Estimate of the integral from a to b
+ */
+double Kronrod(double a, double b, double est, double err, double tol,
+      int depth) {
+   double m = (a + b)/2;
+   double left, right, left_err, right_err, left_int, right_int;
+
+   if (depth >= MAX_DEPTH || err <= tol)
+      return est;
+
+   left = Gauss_kronrod(a, m, &left_err);
+   right = Gauss_kronrod(m, b, &right_err);
+#  pragma omp task shared(left_int) final(depth >= task_cutoff)
+   left_int = Kronrod(a, m, left, left_err, tol/2, depth+1);
+   right_int = Kronrod(m, b, right, right_err, tol/2, depth+1);
+#  pragma omp taskwait
+
+   return left_int + right_int;
+}  /* Kronrod */
+
+/*------------------------------------------------------------------
+ * Function:    Trap
+ * Purpose:     Serial trapezoidal rule with n trapezoids, for
+ *              comparison
+ */
+double Trap(double a, double b, long n) {
+   double  h, approx;
+   long    i;
+
+   if (n < 1) n = 1;
+   h = (b-a)/n;
+   approx = (f(a) + f(b))/2.0;
+   for (i = 1; i <= n-1; i++)
+     approx += f(a + i*h);
+   return h*approx;
+}  /* Trap */
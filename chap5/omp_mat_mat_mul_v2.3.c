@@ -33,6 +33,28 @@
  *         print C
  *     6.  Uses the OpenMP library function omp_get_wtime() to
  *         return the time elapsed since some point in the past
+ *     7.  If ROOFLINE is defined, the program measures the peak
+ *         GFLOP/s and GB/s of the node, and compares the product with
+ *         the roofline.  Each iteration carries out 2n^3 flops, and
+ *         moves the bytes of the product (see Roofline_matmul_bytes)
+ *         and of the copy of C to A.  Compile with
+ *
+ *            gcc -g -Wall -O3 -march=native -fopenmp -DROOFLINE \
+ *               -o omp_mat_mat_mul_v2.3 omp_mat_mat_mul_v2.3.c roofline.c
+ *     8.  If NUMA is defined, the threads are bound to cores and their
+ *         placement is printed, and the pages of each thread's rows of
+ *         A, B and C are first written by the thread (see omp_numa.h).
+ *         Compile with
+ *
+ *            gcc -g -Wall -fopenmp -DNUMA -o omp_mat_mat_mul_v2.3 \
+ *               omp_mat_mat_mul_v2.3.c omp_numa.c
+ *     9.  If MAT_ALLOC is defined, the matrices are allocated with
+ *         Mat_alloc, so they're aligned on a cache line and backed by
+ *         huge pages (see mat_alloc.h).  The rows aren't padded, since
+ *         the subscripts use n.  Compile with
+ *
+ *            gcc -g -Wall -fopenmp -DMAT_ALLOC -o omp_mat_mat_mul_v2.3 \
+ *               omp_mat_mat_mul_v2.3.c mat_alloc.c
  *
  * IPP:    Section 5.9 (pp. 253 and ff.)
  */
@@ -41,6 +63,15 @@
 #include <stdlib.h>
 #include <omp.h>
 #include<string.h>
+#ifdef ROOFLINE
+#include "roofline.h"
+#endif
+#ifdef NUMA
+#include "omp_numa.h"
+#endif
+#ifdef MAT_ALLOC
+#include "mat_alloc.h"
+#endif
 
 /* Serial functions */
 void Get_args(int argc, char* argv[], int* thread_count_p, 
@@ -157,11 +188,31 @@ int main(int argc, char* argv[]) {
    //double* y;
 
    Get_args(argc, argv, &thread_count, &m, &n,&iterations);
+#  ifdef NUMA
+   Numa_init(thread_count);
+#  endif
+#  ifdef ROOFLINE
+   Roofline_init(thread_count);
+#  endif
 
+#  ifdef MAT_ALLOC
+   A = Mat_alloc(m, n, NULL);
+   B = Mat_alloc(m, n, NULL);
+   C = Mat_alloc(m, n, NULL);
+#  else
    A = malloc(m*n*sizeof(double));
    B = malloc(m*n*sizeof(double));
    C = malloc(m*n*sizeof(double));
+#  endif
    //B = malloc(m*n*sizeof(double));
+#  ifdef NUMA
+   Numa_place(A, m*n*sizeof(double));
+   Numa_place(B, m*n*sizeof(double));
+   Numa_place(C, m*n*sizeof(double));
+   Numa_first_touch(A, m, n, thread_count, 1);
+   Numa_first_touch(B, m, n, thread_count, 1);
+   Numa_first_touch(C, m, n, thread_count, 1);
+#  endif
    
  # ifdef DEBUG
       Read_matrix("Enter the matrix", A, m, n);
@@ -184,6 +235,9 @@ int main(int argc, char* argv[]) {
     
     
     
+#  ifdef MAT_ALLOC
+   printf("Huge pages = %ld kB\n", Mat_huge_kb());
+#  endif
    Omp_mat_mat_mul(A, B, C, m, n, thread_count,iterations);
 
 #  ifdef DEBUG
@@ -196,9 +250,15 @@ int main(int argc, char* argv[]) {
 
 #  endif
 
+#  ifdef MAT_ALLOC
+   Mat_free(A);
+   Mat_free(B);
+   Mat_free(C);
+#  else
    free(A);
    free(B);
    free(C);
+#  endif
 
    return 0;
 }  /* main */
@@ -372,6 +432,10 @@ void Omp_mat_mat_mul(double A[], double B[], double C[],
    finish = omp_get_wtime();
    elapsed = finish - start;
    printf("Elapsed time for size=%d, iterations=%d, threads=%d, Takes %e seconds\n", n,iterations,thread_count,elapsed);
+#  ifdef ROOFLINE
+   Roofline_report("Omp_mat_mat_mul", 2.0*m*n*n*iterations,
+         (Roofline_matmul_bytes(m, n, n) + 16.0*m*n)*iterations, elapsed);
+#  endif
 
 }  /* Omp_mat_mat_mul */
 
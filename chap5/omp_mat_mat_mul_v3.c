@@ -33,6 +33,36 @@
  *         print C
  *     6.  Uses the OpenMP library function omp_get_wtime() to
  *         return the time elapsed since some point in the past
+ *     7.  If ROOFLINE is defined, the program measures the peak
+ *         GFLOP/s and GB/s of the node, and compares the product with
+ *         the roofline.  The product carries out 2mn^2 flops, and moves
+ *         the bytes given by Roofline_matmul_bytes, plus the copy of C
+ *         to A.  Compile with
+ *
+ *            gcc -g -Wall -O3 -march=native -fopenmp -DROOFLINE \
+ *               -o omp_mat_mat_mul_v3 omp_mat_mat_mul_v3.c roofline.c
+ *     8.  If NUMA is defined, the threads are bound to cores and their
+ *         placement is printed, and the pages of thread p*y + q's block
+ *         (p, q) of A, B and C are first written by the thread (see
+ *         omp_numa.h).  Compile with
+ *
+ *            gcc -g -Wall -fopenmp -DNUMA -o omp_mat_mat_mul_v3 \
+ *               omp_mat_mat_mul_v3.c omp_numa.c
+ *     9.  If MAT_ALLOC is defined, the matrices are allocated with
+ *         Mat_alloc, so they're aligned on a cache line and backed by
+ *         huge pages (see mat_alloc.h).  The rows aren't padded, since
+ *         the subscripts use n.  Compile with
+ *
+ *            gcc -g -Wall -fopenmp -DMAT_ALLOC -o omp_mat_mat_mul_v3 \
+ *               omp_mat_mat_mul_v3.c mat_alloc.c
+ *     10. If STRASSEN is defined, m must equal n, and the product is
+ *         computed by Strassen-Winograd with OpenMP tasks, down to the
+ *         cutoff in STRASSEN_CUTOFF (see omp_strassen.h).  It's then
+ *         computed by the classic algorithm, and the times, the flops
+ *         saved and the relative error are printed.  Compile with
+ *
+ *            gcc -g -Wall -O3 -fopenmp -DSTRASSEN -o omp_mat_mat_mul_v3 \
+ *               omp_mat_mat_mul_v3.c omp_strassen.c -lm
  *
  * IPP:    Section 5.9 (pp. 253 and ff.)
  */
@@ -40,6 +70,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <omp.h>
+#ifdef ROOFLINE
+#include "roofline.h"
+#endif
+#ifdef NUMA
+#include "omp_numa.h"
+#endif
+#ifdef MAT_ALLOC
+#include "mat_alloc.h"
+#endif
+#ifdef STRASSEN
+#include "omp_strassen.h"
+#endif
 
 /* Serial functions */
 void Get_args(int argc, char* argv[], int* thread_count_x, int* thread_count_y, 
@@ -55,6 +97,10 @@ void Print_vector(char* title, double y[], double m);
 /* Parallel function */
 void Omp_mat_vect(double A[], double x[], double y[],
       int m, int n, int thread_count_x,int thread_count_y);
+#ifdef STRASSEN
+void Omp_strassen(double A[], double B[], double C[], int n,
+      int thread_count);
+#endif
 void file_read(char* path,double B[],int m, int n){
    // Specify the path to the input file
     //const char *path = "/scratch/ualmkc001/A.txt";
@@ -130,11 +176,37 @@ int main(int argc, char* argv[]) {
    //double* y;
 
    Get_args(argc, argv, &thread_count_x,&thread_count_y, &m, &n);
+#  ifdef STRASSEN
+   if (m != n) {
+      fprintf(stderr, "Strassen needs a square matrix:  m = n\n");
+      exit(0);
+   }
+#  endif
+#  ifdef NUMA
+   Numa_init(thread_count_x*thread_count_y);
+#  endif
+#  ifdef ROOFLINE
+   Roofline_init(thread_count_x*thread_count_y);
+#  endif
 
+#  ifdef MAT_ALLOC
+   A = Mat_alloc(m, n, NULL);
+   B = Mat_alloc(m, n, NULL);
+   C = Mat_alloc(m, n, NULL);
+#  else
    A = malloc(m*n*sizeof(double));
    B = malloc(m*n*sizeof(double));
    C = malloc(m*n*sizeof(double));
+#  endif
    //B = malloc(m*n*sizeof(double));
+#  ifdef NUMA
+   Numa_place(A, m*n*sizeof(double));
+   Numa_place(B, m*n*sizeof(double));
+   Numa_place(C, m*n*sizeof(double));
+   Numa_first_touch(A, m, n, thread_count_x, thread_count_y);
+   Numa_first_touch(B, m, n, thread_count_x, thread_count_y);
+   Numa_first_touch(C, m, n, thread_count_x, thread_count_y);
+#  endif
    
  # ifdef DEBUG
       Read_matrix("Enter the matrix", A, m, n);
@@ -157,7 +229,14 @@ int main(int argc, char* argv[]) {
     
     
     
+#  ifdef MAT_ALLOC
+   printf("Huge pages = %ld kB\n", Mat_huge_kb());
+#  endif
+#  ifdef STRASSEN
+   Omp_strassen(A, B, C, n, thread_count_x*thread_count_y);
+#  else
    Omp_mat_vect(A, B, C, m, n, thread_count_x,thread_count_y);
+#  endif
 
 #  ifdef DEBUG
       Print_matrix("The product is", C, m,n);
@@ -168,9 +247,15 @@ int main(int argc, char* argv[]) {
 
 #  endif
 
+#  ifdef MAT_ALLOC
+   Mat_free(A);
+   Mat_free(B);
+   Mat_free(C);
+#  else
    free(A);
    free(B);
    free(C);
+#  endif
 
    return 0;
 }  /* main */
@@ -346,10 +431,47 @@ void Omp_mat_vect(double A[], double B[], double C[],
    finish = omp_get_wtime();
    elapsed = finish - start;
    printf("Elapsed time = %e seconds\n", elapsed);
+#  ifdef ROOFLINE
+   Roofline_report("Omp_mat_mat_mul", 2.0*m*n*n,
+         Roofline_matmul_bytes(m, n, n) + 16.0*m*n, elapsed);
+#  endif
 
 }  /* Omp_mat_vect */
 
 
+#ifdef STRASSEN
+/*------------------------------------------------------------------
+ * Function:  Omp_strassen
+ * Purpose:   Multiply two nxn matrices with Strassen-Winograd, and
+ *            compare the time and the result with the classic algorithm
+ * In args:   A, B, n, thread_count
+ * Out arg:   C
+ */
+void Omp_strassen(double A[], double B[], double C[], int n,
+      int thread_count) {
+   long cutoff = Strassen_cutoff();
+   double start, strassen, classic;
+   double* R = malloc((long) n*n*sizeof(double));
+
+   start = omp_get_wtime();
+   Strassen(thread_count, n, A, n, B, n, C, n, cutoff);
+   strassen = omp_get_wtime() - start;
+   printf("Elapsed time = %e seconds\n", strassen);
+
+   start = omp_get_wtime();
+   Strassen_classic(thread_count, n, A, n, B, n, R, n);
+   classic = omp_get_wtime() - start;
+
+   printf("Strassen with cutoff %ld:  %.1f%% of the flops, speedup %.2f "
+         "over classic (%e seconds)\n", cutoff,
+         100.0*Strassen_flops(n, cutoff)/(2.0*n*n*n), classic/strassen,
+         classic);
+   printf("Relative error = %e\n", Strassen_error(n, C, n, R, n));
+   free(R);
+}  /* Omp_strassen */
+#endif
+
+
 /*------------------------------------------------------------------
  * Function:    Print_matrix
  * Purpose:     Print the matrix
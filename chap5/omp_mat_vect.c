@@ -33,6 +33,27 @@
  *         print y
  *     6.  Uses the OpenMP library function omp_get_wtime() to
  *         return the time elapsed since some point in the past
+ *     7.  If ROOFLINE is defined, the program measures the peak
+ *         GFLOP/s and GB/s of the node, and compares the product with
+ *         the roofline.  The product carries out 2mn flops and moves at
+ *         least 8(mn + m + n) bytes.  Compile with
+ *
+ *            gcc -g -Wall -O3 -march=native -fopenmp -DROOFLINE \
+ *               -o omp_mat_vect omp_mat_vect.c roofline.c
+ *     8.  If NUMA is defined, the threads are bound to cores and their
+ *         placement is printed, and the pages of each thread's rows of A
+ *         and y are first written by the thread (see omp_numa.h).
+ *         Compile with
+ *
+ *            gcc -g -Wall -fopenmp -DNUMA -o omp_mat_vect omp_mat_vect.c \
+ *               omp_numa.c
+ *     9.  If MAT_ALLOC is defined, the matrix is allocated with
+ *         Mat_alloc, so it's aligned on a cache line and backed by
+ *         huge pages (see mat_alloc.h).  The rows aren't padded, since
+ *         the subscripts use n.  Compile with
+ *
+ *            gcc -g -Wall -fopenmp -DMAT_ALLOC -o omp_mat_vect \
+ *               omp_mat_vect.c mat_alloc.c
  *
  * IPP:    Section 5.9 (pp. 253 and ff.)
  */
@@ -40,6 +61,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <omp.h>
+#ifdef ROOFLINE
+#include "roofline.h"
+#endif
+#ifdef NUMA
+#include "omp_numa.h"
+#endif
+#ifdef MAT_ALLOC
+#include "mat_alloc.h"
+#endif
 
 /* Serial functions */
 void Get_args(int argc, char* argv[], int* thread_count_p, 
@@ -130,11 +160,27 @@ int main(int argc, char* argv[]) {
    double* y;
 
    Get_args(argc, argv, &thread_count, &m, &n);
+#  ifdef NUMA
+   Numa_init(thread_count);
+#  endif
+#  ifdef ROOFLINE
+   Roofline_init(thread_count);
+#  endif
 
+#  ifdef MAT_ALLOC
+   A = Mat_alloc(m, n, NULL);
+#  else
    A = malloc(m*n*sizeof(double));
+#  endif
    x = malloc(n*sizeof(double));
    y = malloc(m*sizeof(double));
    //B = malloc(m*n*sizeof(double));
+#  ifdef NUMA
+   Numa_place(A, m*n*sizeof(double));
+   Numa_place(x, n*sizeof(double));
+   Numa_first_touch(A, m, n, thread_count, 1);
+   Numa_first_touch(y, m, 1, thread_count, 1);
+#  endif
    
  # ifdef DEBUG
       Read_matrix("Enter the matrix", A, m, n);
@@ -157,6 +203,9 @@ int main(int argc, char* argv[]) {
     
     
     
+#  ifdef MAT_ALLOC
+   printf("Huge pages = %ld kB\n", Mat_huge_kb());
+#  endif
    Omp_mat_vect(A, x, y, m, n, thread_count);
 
 #  ifdef DEBUG
@@ -168,7 +217,11 @@ int main(int argc, char* argv[]) {
 
 #  endif
 
+#  ifdef MAT_ALLOC
+   Mat_free(A);
+#  else
    free(A);
+#  endif
    free(x);
    free(y);
 
@@ -297,6 +350,10 @@ void Omp_mat_vect(double A[], double x[], double y[],
    finish = omp_get_wtime();
    elapsed = finish - start;
    printf("Elapsed time = %e seconds\n", elapsed);
+#  ifdef ROOFLINE
+   Roofline_report("Omp_mat_vect", 2.0*m*n, 8.0*((double) m*n + m + n),
+         elapsed);
+#  endif
 
 }  /* Omp_mat_vect */
 
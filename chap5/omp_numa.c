@@ -0,0 +1,249 @@
+/* File:     omp_numa.c
+ *
+ * Purpose:  Bind the threads of an OpenMP program to cores, report the
+ *           binding, and place the pages of arrays on the NUMA nodes
+ *           by first touch or by interleaving.  See omp_numa.h.
+ *
+ * Notes:
+ * 1.  The topology is read from /sys/devices/system, and the system
+ *     calls are made directly, so libnuma isn't needed.  On a system
+ *     without NUMA information there's one node, and only the binding
+ *     has an effect.
+ * 2.  The threads are bound in a parallel region with thread_count
+ *     threads.  The OpenMP runtime keeps the threads of a team for
+ *     later parallel regions with the same number of threads, and
+ *     thread t of the later regions is the thread that was bound as
+ *     thread t.  Nested parallel regions create new threads, which
+ *     aren't bound.
+ * 3.  The cores are the ones the process is allowed to run on (e.g.,
+ *     with taskset or a batch system), in the order of their ids.  If
+ *     there are more threads than cores, thread t is bound to core
+ *     t % cores.
+ * 4.  Numa_first_touch splits the rows of a into P blocks and the
+ *     columns into Q blocks, and the last block gets the remainder, as
+ *     in the kernels in this directory.  A parallel for with
+ *     schedule(static) gives the extra rows to the first threads
+ *     instead, so the partitions only agree when P evenly divides m,
+ *     but a few rows on the wrong node don't matter.
+ * 5.  Only pages that haven't been written are placed.  So Numa_place
+ *     and Numa_first_touch should be called right after malloc, and
+ *     the arrays should be large enough that malloc gets fresh pages
+ *     from the system (more than 128 KB with glibc).
+ *
+ * IPP:  Not discussed, but see Section 2.3.3 on shared-memory systems
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <omp.h>
+#include "omp_numa.h"
+
+#define MPOL_INTERLEAVE_MODE 3   /* MPOL_INTERLEAVE in <numaif.h> */
+
+static int node_count = 0;
+static unsigned long node_mask = 0;
+static int interleave = 0;
+
+static int  Read_nodes(void);
+static int  Bind_order(const char* policy, int cpus[]);
+
+/*------------------------------------------------------------------
+ * Function:  Read_nodes
+ * Purpose:   Find the online nodes from /sys/devices/system/node/online,
+ *            which is a list like 0-1,3, and store them in node_mask
+ * Ret val:   The number of nodes, 1 if the file doesn't exist
+ */
+static int Read_nodes(void) {
+   FILE* fp;
+   char line[256], *tok, *save;
+   int first, last, node, count = 0;
+
+   node_mask = 0;
+   fp = fopen("/sys/devices/system/node/online", "r");
+   if (fp != NULL) {
+      if (fgets(line, sizeof(line), fp) != NULL)
+         for (tok = strtok_r(line, ",\n", &save); tok != NULL;
+               tok = strtok_r(NULL, ",\n", &save)) {
+            if (sscanf(tok, "%d-%d", &first, &last) != 2) last = first;
+            for (node = first; node <= last && node < NUMA_MAX_NODES;
+                  node++) {
+               node_mask |= 1UL << node;
+               count++;
+            }
+         }
+      fclose(fp);
+   }
+   if (count == 0) {
+      node_mask = 1;
+      count = 1;
+   }
+   return count;
+}  /* Read_nodes */
+
+/*------------------------------------------------------------------
+ * Function:  Numa_nodes
+ * Purpose:   Return the number of online NUMA nodes
+ */
+int Numa_nodes(void) {
+   if (node_count == 0) node_count = Read_nodes();
+   return node_count;
+}  /* Numa_nodes */
+
+/*------------------------------------------------------------------
+ * Function:  Numa_node_of_cpu
+ * Purpose:   Return the node of a cpu:  /sys/devices/system/cpu/cpuN
+ *            contains a link nodeK.  Return 0 if there's no link.
+ */
+int Numa_node_of_cpu(int cpu) {
+   char path[64];
+   DIR* dir;
+   struct dirent* ent;
+   int node = 0;
+
+   snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+   dir = opendir(path);
+   if (dir == NULL) return 0;
+   while ((ent = readdir(dir)) != NULL)
+      if (strncmp(ent->d_name, "node", 4) == 0 &&
+            sscanf(ent->d_name + 4, "%d", &node) == 1)
+         break;
+   closedir(dir);
+   return node;
+}  /* Numa_node_of_cpu */
+
+/*------------------------------------------------------------------
+ * Function:  Bind_order
+ * Purpose:   List the cores the process may run on in the order the
+ *            threads are bound to them
+ * In arg:    policy:  "close" or "spread"
+ * Out arg:   cpus
+ * Ret val:   The number of cores
+ * Note:      For spread, the cores are taken round-robin from the
+ *            nodes:  the first core of each node, then the second, etc.
+ */
+static int Bind_order(const char* policy, int cpus[]) {
+   cpu_set_t set;
+   int allowed[CPU_SETSIZE], node[CPU_SETSIZE], taken[CPU_SETSIZE];
+   int cpu, count = 0, i, n, next;
+
+   if (sched_getaffinity(0, sizeof(set), &set) != 0) return 0;
+   for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &set)) {
+         allowed[count] = cpu;
+         node[count] = Numa_node_of_cpu(cpu) % NUMA_MAX_NODES;
+         taken[count] = 0;
+         count++;
+      }
+
+   if (strcmp(policy, "spread") != 0) {
+      memcpy(cpus, allowed, count*sizeof(int));
+      return count;
+   }
+
+   /* Each pass takes the first core not yet taken from each node */
+   next = 0;
+   while (next < count)
+      for (n = 0; n < NUMA_MAX_NODES && next < count; n++)
+         for (i = 0; i < count; i++)
+            if (!taken[i] && node[i] == n) {
+               cpus[next++] = allowed[i];
+               taken[i] = 1;
+               break;
+            }
+   return count;
+}  /* Bind_order */
+
+/*------------------------------------------------------------------
+ * Function:  Numa_init
+ * Purpose:   Read NUMA_BIND and NUMA_INTERLEAVE, bind thread_count
+ *            threads, and print the node and core of each thread
+ */
+void Numa_init(int thread_count) {
+   const char* policy = getenv("NUMA_BIND");
+   const char* env = getenv("NUMA_INTERLEAVE");
+   int cpus[CPU_SETSIZE], cpu_count = 0;
+   int* where = malloc(2*thread_count*sizeof(int));
+   int t;
+
+   Numa_nodes();
+   interleave = (env != NULL && strcmp(env, "0") != 0);
+   if (policy == NULL)
+      policy = (getenv("OMP_PROC_BIND") != NULL) ? "none" : "spread";
+   if (strcmp(policy, "none") != 0)
+      cpu_count = Bind_order(policy, cpus);
+
+#  pragma omp parallel num_threads(thread_count) \
+      shared(cpus, cpu_count, where)
+   {
+      int my_rank = omp_get_thread_num();
+      cpu_set_t set;
+
+      if (cpu_count > 0) {
+         CPU_ZERO(&set);
+         CPU_SET(cpus[my_rank % cpu_count], &set);
+         if (sched_setaffinity(0, sizeof(set), &set) != 0)
+            fprintf(stderr, "Numa:  can't bind thread %d to cpu %d\n",
+                  my_rank, cpus[my_rank % cpu_count]);
+      }
+      where[2*my_rank] = sched_getcpu();
+      where[2*my_rank + 1] = Numa_node_of_cpu(where[2*my_rank]);
+   }
+
+   printf("NUMA:  %d node%s, binding = %s%s, pages %s\n", node_count,
+         (node_count == 1) ? "" : "s", policy,
+         (cpu_count > 0) ? "" : " (OpenMP runtime)",
+         !interleave ? "placed by first touch" :
+         (node_count == 1) ? "placed by first touch (interleave "
+                             "ignored: 1 node)" : "interleaved");
+   for (t = 0; t < thread_count; t++)
+      printf("   Thread %d:  cpu %d, node %d\n", t, where[2*t],
+            where[2*t + 1]);
+   free(where);
+}  /* Numa_init */
+
+/*------------------------------------------------------------------
+ * Function:  Numa_place
+ * Purpose:   If NUMA_INTERLEAVE is set, spread the pages of the array
+ *            p of bytes bytes round-robin across the nodes
+ * Note:      Only the whole pages in the array are interleaved.
+ */
+void Numa_place(void* p, size_t bytes) {
+   static int warned = 0;
+   long page = sysconf(_SC_PAGESIZE);
+   unsigned long start = ((unsigned long) p + page - 1) & ~(page - 1);
+   unsigned long end = ((unsigned long) p + bytes) & ~(page - 1);
+
+   if (!interleave || Numa_nodes() == 1 || end <= start) return;
+   if (syscall(SYS_mbind, start, end - start, MPOL_INTERLEAVE_MODE,
+            &node_mask, NUMA_MAX_NODES + 1, 0) != 0 && !warned) {
+      perror("Numa:  mbind");
+      warned = 1;
+   }
+}  /* Numa_place */
+
+/*------------------------------------------------------------------
+ * Function:  Numa_first_touch
+ * Purpose:   Zero the m x n row-major array a with P*Q threads, so that
+ *            the pages of block (p, q) are put on the node of thread
+ *            p*Q + q
+ */
+void Numa_first_touch(double a[], long m, long n, int P, int Q) {
+#  pragma omp parallel num_threads(P*Q) default(none) shared(a, m, n, P, Q)
+   {
+      int my_rank = omp_get_thread_num();
+      int p = my_rank/Q, q = my_rank % Q;
+      long i_first = p*(m/P), i_last = i_first + m/P;
+      long j_first = q*(n/Q), j_last = j_first + n/Q;
+      long i;
+
+      if (p == P-1) i_last = m;
+      if (q == Q-1) j_last = n;
+      for (i = i_first; i < i_last; i++)
+         memset(a + i*n + j_first, 0, (j_last - j_first)*sizeof(double));
+   }
+}  /* Numa_first_touch */
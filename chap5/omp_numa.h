@@ -0,0 +1,52 @@
+/* File:     omp_numa.h
+ * Purpose:  Header file for omp_numa.c, which places the threads and
+ *           the pages of the matrices of an OpenMP program on the NUMA
+ *           nodes of a multi-socket system.
+ *
+ *           A page is put on the node of the thread that first writes
+ *           to it.  If the matrices are initialized by the master
+ *           thread, all of their pages are on one node, and the threads
+ *           on the other nodes read them remotely.  So the pages are
+ *           first written by a parallel loop with the same partition as
+ *           the kernel, and the threads are bound to cores, so that a
+ *           thread runs on the same node in the kernel as when it wrote
+ *           its pages.
+ *
+ * Usage:
+ *    Numa_init(thread_count);
+ *    A = malloc(m*n*sizeof(double));
+ *    Numa_place(A, m*n*sizeof(double));
+ *    Numa_first_touch(A, m, n, P, Q);
+ *    Initialize A, e.g., serially
+ *    . . .
+ *    Kernel using P*Q threads, in which thread p*Q + q uses block
+ *    row p and block column q of A
+ *
+ * Environment:
+ *    NUMA_BIND        spread:  thread t is bound to a core on node
+ *                       t % nodes (default)
+ *                     close:  the threads are bound to consecutive cores
+ *                     none:  the threads aren't bound by omp_numa.  If
+ *                       NUMA_BIND isn't set and OMP_PROC_BIND is, the
+ *                       binding of the OpenMP runtime is used.
+ *    NUMA_INTERLEAVE  If set (and not 0), Numa_place spreads the pages
+ *                     of an array round-robin across the nodes, and
+ *                     Numa_first_touch doesn't change their placement.
+ *
+ * IPP:  Not discussed, but see Section 2.3.3 on shared-memory systems
+ *       and Section 5.10 on cache coherence and false sharing
+ */
+#ifndef _OMP_NUMA_H_
+#define _OMP_NUMA_H_
+
+#include <stddef.h>
+
+#define NUMA_MAX_NODES 64
+
+void Numa_init(int thread_count);
+int  Numa_nodes(void);
+int  Numa_node_of_cpu(int cpu);
+void Numa_place(void* p, size_t bytes);
+void Numa_first_touch(double a[], long m, long n, int P, int Q);
+
+#endif
@@ -15,6 +15,13 @@
  * Notes:
  *    1.  The radius of convergence is only 1.  So the series converges
  *        *very* slowly.
+ *    2.  If REPRO is defined, the terms are divided into leaves of
+ *        REPRO_BLOCK terms, and the leaf sums are combined by the
+ *        fixed tree in repro_sum.c instead of the reduction clause.
+ *        Then the estimate is the same for every thread_count.
+ *        Compile with
+ *
+ *           gcc -g -Wall -fopenmp -DREPRO -o omp_pi omp_pi.c repro_sum.c -lm
  *
  * IPP:   Section 5.5.4 (pp. 229 and ff.)
  */        
@@ -23,20 +30,32 @@
 #include <stdlib.h>
 #include <math.h>
 #include <omp.h> 
+#ifdef REPRO
+#include "repro_sum.h"
+#endif
 
 void Usage(char* prog_name);
+#ifdef REPRO
+double Repro_pi_sum(long long n, int thread_count);
+#endif
 
 int main(int argc, char* argv[]) {
-   long long n, i;
+   long long n;
    int thread_count;
-   double factor;
    double sum = 0.0;
+#  ifndef REPRO
+   long long i;
+   double factor;
+#  endif
 
    if (argc != 3) Usage(argv[0]);
    thread_count = strtol(argv[1], NULL, 10);
    n = strtoll(argv[2], NULL, 10);
    if (thread_count < 1 || n < 1) Usage(argv[0]);
 
+#  ifdef REPRO
+   sum = Repro_pi_sum(n, thread_count);
+#  else
 #  pragma omp parallel for num_threads(thread_count) \
       reduction(+: sum) private(factor)
    for (i = 0; i < n; i++) {
@@ -46,6 +65,7 @@ int main(int argc, char* argv[]) {
       printf("Thread %d > i = %lld, my_sum = %f\n", my_rank, i, my_sum);
 #     endif
    }
+#  endif
 
    sum = 4.0*sum;
    printf("With n = %lld terms and %d threads,\n", n, thread_count);
@@ -65,3 +85,47 @@ void Usage(char* prog_name) {
    fprintf(stderr, "   n is the number of terms and should be >= 1\n");
    exit(0);
 }  /* Usage */
+
+#ifdef REPRO
+/*------------------------------------------------------------------
+ * Function:  Repro_pi_sum
+ * Purpose:   Add the first n terms of the series with a sum that
+ *            doesn't depend on thread_count.  Each thread adds the
+ *            terms in its block of leaves, one leaf at a time, in
+ *            order, and the leaf sums are combined by Repro_tree_accs.
+ * In args:   n, thread_count
+ * Ret val:   1 - 1/3 + 1/5 - . . . +- 1/(2n-1)
+ */
+double Repro_pi_sum(long long n, int thread_count) {
+   long leaves = (n + REPRO_BLOCK - 1)/REPRO_BLOCK;
+   struct repro_acc_s* accs;
+   double sum;
+
+   accs = malloc(thread_count*sizeof(struct repro_acc_s));
+#  pragma omp parallel num_threads(thread_count)
+   {
+      int my_rank = omp_get_thread_num();
+      long first_leaf, last_leaf, leaf;
+      long long i, last;
+      double factor;
+      repro_t leaf_sum;
+
+      Repro_leaf_range(leaves, my_rank, thread_count, &first_leaf,
+            &last_leaf);
+      Repro_acc_init(&accs[my_rank]);
+      for (leaf = first_leaf; leaf <= last_leaf; leaf++) {
+         leaf_sum = Repro_zero();
+         last = (leaf + 1)*REPRO_BLOCK;
+         if (last > n) last = n;
+         for (i = leaf*REPRO_BLOCK; i < last; i++) {
+            factor = (i % 2 == 0) ? 1.0 : -1.0;
+            leaf_sum.sum += factor/(2*i+1);
+         }
+         Repro_acc_push(&accs[my_rank], leaf, leaf_sum);
+      }
+   }
+   sum = Repro_tree_accs(accs, thread_count, leaves);
+   free(accs);
+   return sum;
+}  /* Repro_pi_sum */
+#endif
@@ -0,0 +1,69 @@
+/* File:     omp_roofline.c
+ *
+ * Purpose:  Measure the peak floating point rate and the memory bandwidth
+ *           of a node for 1, 2, 4, ..., thread_count threads, so that the
+ *           peaks of a node type can be given to the roofline reports of
+ *           the other programs with ROOF_GFLOPS and ROOF_GBS.
+ *
+ * Compile:  gcc -g -Wall -O3 -march=native -fopenmp -o omp_roofline \
+ *              omp_roofline.c roofline.c
+ * Usage:    ./omp_roofline <thread_count> [doubles]
+ *              doubles:  length of the STREAM arrays (default:  4 times
+ *                        the last level cache)
+ *
+ * Output:   For each number of threads, the peak GFLOP/s, the STREAM
+ *           triad GB/s and the ridge point:  kernels with a lower
+ *           arithmetic intensity are memory bound.
+ *
+ * Notes:
+ * 1.  Use the same compiler flags as the kernels:  the FMA probe is only
+ *     vectorized as far as the flags allow.
+ * 2.  Set OMP_PROC_BIND=spread so that the threads use all the sockets.
+ *
+ * IPP:  Not discussed, but see Section 2.6 on performance
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "roofline.h"
+
+void Usage(char* prog_name);
+
+/*------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int thread_count, threads;
+   long n;
+   double gflops, gbs;
+   struct roof_peak_s peak;
+
+   if (argc != 2 && argc != 3) Usage(argv[0]);
+   thread_count = strtol(argv[1], NULL, 10);
+   if (thread_count <= 0) Usage(argv[0]);
+   Roofline_peak(&peak);
+   n = (argc == 3) ? strtol(argv[2], NULL, 10) : 4*peak.llc/sizeof(double);
+   if (n <= 0) Usage(argv[0]);
+
+   printf("Last level cache = %ld bytes, STREAM arrays = %ld doubles\n",
+         peak.llc, n);
+   printf("%8s %12s %12s %12s\n", "Threads", "GFLOP/s", "GB/s",
+         "Ridge");
+   for (threads = 1; ; threads *= 2) {
+      if (threads > thread_count) threads = thread_count;
+      gflops = Roofline_fma_probe(threads);
+      gbs = Roofline_stream_probe(threads, n);
+      printf("%8d %12.3f %12.3f %12.3f\n", threads, gflops, gbs,
+            gflops/gbs);
+      if (threads == thread_count) break;
+   }
+
+   return 0;
+}  /* main */
+
+/*------------------------------------------------------------------
+ * Function:  Usage
+ * Purpose:   Print a message showing how to run the program and quit
+ * In arg:    prog_name
+ */
+void Usage(char* prog_name) {
+   fprintf(stderr, "usage: %s <thread_count> [doubles]\n", prog_name);
+   exit(0);
+}  /* Usage */
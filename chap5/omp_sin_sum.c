@@ -3,7 +3,8 @@
  *          applied to a nonnegative integer i and evaluation of the 
  *          function requires work proportional to i.
  *
- * Compile: gcc -g -Wall -fopenmp -I. -o omp_sin_sum omp_sin_sum.c
+ * Compile: gcc -g -Wall -fopenmp -I. -o omp_sin_sum omp_sin_sum.c \
+ *             omp_trace.c -lm
  * Usage:   ./omp_sin_sum <number of threads> <number of terms>
  *
  * Input:   none
@@ -25,6 +26,38 @@
  * 4.  Uses the OpenMP library function omp_get_wtime to take timings.
  * 5.  DEBUG flag will print which iterations were assigned to each
  *     thread.
+ * 6.  If REPRO is defined, the sums don't depend on the number of
+ *     threads or the schedule.  Sum stores f(i) in an array, and
+ *     Check_sum divides the terms into leaves of REPRO_BLOCK terms.
+ *     In both cases the leaf sums are combined by the fixed tree in
+ *     repro_sum.c.  Compile with
+ *
+ *        gcc -g -Wall -fopenmp -DREPRO -o omp_sin_sum omp_sin_sum.c \
+ *           omp_trace.c repro_sum.c -lm
+ *
+ * 7.  If WS is defined, Sum ignores OMP_SCHEDULE and uses the work-
+ *     stealing scheduler in omp_ws.c.  The iterations are divided
+ *     among the threads so that each gets about the same number of
+ *     calls to sin, and a thread that finishes early steals
+ *     iterations from another.  Compile with
+ *
+ *        gcc -g -Wall -fopenmp -DWS -o omp_sin_sum omp_sin_sum.c \
+ *           omp_trace.c omp_ws.c -lm
+ *
+ *     omp_ws_bench.c compares it with the OpenMP schedules.
+ * 8.  The sums of consecutive sines in f and Check_sum are computed by
+ *     Sin_range in sin_range.h.  Compile with -O3 and -DSIN_RECUR to
+ *     use the angle-addition formulas instead of calling sin for each
+ *     term, or with -O3 -ffast-math -DSIN_VEC to use the vectorized
+ *     sin in the math library.  See sin_range.h for the accuracy.
+ * 9.  If the environment variable LOOP_TRACE is set to a file name, the
+ *     loop in Sum is traced with omp_trace.c:  after the sum, the
+ *     program prints the number of iterations and the busy and idle
+ *     time of each thread, and it writes the ranges of iterations
+ *     executed by each thread to the file in Chrome trace format.
+ *     Unlike DEBUG, this doesn't need a recompile, e.g.,
+ *
+ *        LOOP_TRACE=sum.json OMP_SCHEDULE=guided ./omp_sin_sum 4 10000
  *
  * IPP:  Section 5.7 (pp. 236 and ff.)
  */
@@ -33,6 +66,15 @@
 #include <stdlib.h>
 #include <math.h>
 #include <omp.h>
+#include "sin_range.h"
+#include "omp_trace.h"
+#ifdef REPRO
+#include "repro_sum.h"
+#endif
+#ifdef WS
+#include "omp_ws.h"
+#define WS_GRAIN 1
+#endif
 
 #ifdef DEBUG
 int*    iterations;
@@ -42,6 +84,9 @@ void Usage(char* prog_name);
 double Sum(long n, int thread_count);
 double Check_sum(long n, int thread_count);
 double f(long i);
+#ifdef WS
+double Cost(long i);
+#endif
 void Print_iters(int iterations[], long n);
 
 int main(int argc, char* argv[]) {
@@ -54,6 +99,7 @@ int main(int argc, char* argv[]) {
    if (argc != 3) Usage(argv[0]);
    thread_count = strtol(argv[1], NULL, 10);
    n = strtol(argv[2], NULL, 10);
+   Trace_init(thread_count);
 #  ifdef DEBUG
    iterations = malloc((n+1)*sizeof(int));
 #  endif
@@ -69,6 +115,7 @@ int main(int argc, char* argv[]) {
    printf("Check = %.14e\n", check);
    printf("With n = %ld terms, the error is %.14e\n", n, error);
    printf("Elapsed time = %e seconds\n", finish-start);
+   Trace_finish();
 #  ifdef DEBUG
    Print_iters(iterations, n);
    free(iterations);
@@ -97,17 +144,22 @@ void Usage(char* prog_name) {
  * Return val:  
  */
 double f(long i) {
-   long j;
    long start = i*(i+1)/2;
    long finish = start + i;
-   double return_val = 0.0;
 
-   for (j = start; j <= finish; j++) {
-      return_val += sin(j);
-   }
-   return return_val;
+   return Sin_range(start, finish);
 }  /* f */
 
+#ifdef WS
+/*------------------------------------------------------------------
+ * Function:    Cost
+ * Purpose:     Estimate the work in f(i):  i+1 calls to sin
+ */
+double Cost(long i) {
+   return i + 1.0;
+}  /* Cost */
+#endif
+
 /*------------------------------------------------------------------
  * Function:    Sum
  * Purpose:     Find the sum of the terms f(0), f(1), . . ., f(n),
@@ -122,7 +174,56 @@ double f(long i) {
 double Sum(long n, int thread_count) {
    double approx = 0.0;
    long i;
+#  ifdef REPRO
+   repro_t* terms = malloc((n+1)*sizeof(repro_t));
+#  endif
+#  ifdef WS
+   struct ws_sched_s ws;
+
+   Ws_init(&ws, thread_count, 0, n+1, Cost, WS_GRAIN);
+   Trace_loop_begin("Sum");
+#  pragma omp parallel num_threads(thread_count) \
+      reduction(+: approx) private(i)
+   {
+      int my_rank = omp_get_thread_num();
+      long first, last;
+
+      while (Ws_next(&ws, my_rank, &first, &last))
+         for (i = first; i < last; i++) {
+#           ifdef REPRO
+            terms[i] = Repro_zero();
+            terms[i].sum = f(i);
+#           else
+            approx += f(i);
+#           endif
+#           ifdef DEBUG
+            iterations[i] = my_rank;
+#           endif
+            Trace_iter(i);
+         }
+   }
+   Trace_loop_end();
+#  ifdef DEBUG
+   printf("%ld ranges were stolen\n", Ws_steals(&ws));
+#  endif
+   Ws_free(&ws);
+#  elif defined(REPRO)
+
+   Trace_loop_begin("Sum");
+#  pragma omp parallel for num_threads(thread_count) \
+      schedule(runtime)
+   for (i = 0; i <= n; i++) {
+     terms[i] = Repro_zero();
+     terms[i].sum = f(i);
+#    ifdef DEBUG
+     iterations[i] = omp_get_thread_num();
+#    endif
+     Trace_iter(i);
+   }
+   Trace_loop_end();
+#  else
 
+   Trace_loop_begin("Sum");
 #  pragma omp parallel for num_threads(thread_count) \
       reduction(+: approx) schedule(runtime)
    for (i = 0; i <= n; i++) {
@@ -130,26 +231,69 @@ double Sum(long n, int thread_count) {
 #    ifdef DEBUG
      iterations[i] = omp_get_thread_num();
 #    endif
+     Trace_iter(i);
    }
+   Trace_loop_end();
+#  endif
+#  ifdef REPRO
+   approx = Repro_sum_leaves(terms, n+1);
+   free(terms);
+#  endif
 
    return approx;
 }  /* Sum */
 
 /*------------------------------------------------------------------
  */
+#ifdef REPRO
+double Check_sum(long n, int thread_count) {
+   long finish = n*(n+3)/2;
+   long leaves = (finish + REPRO_BLOCK)/REPRO_BLOCK;
+   struct repro_acc_s* accs;
+   double check;
+
+   accs = malloc(thread_count*sizeof(struct repro_acc_s));
+#  pragma omp parallel num_threads(thread_count) \
+      default(none) shared(finish, leaves, accs, thread_count)
+   {
+      int my_rank = omp_get_thread_num();
+      long first_leaf, last_leaf, leaf, last;
+      repro_t leaf_sum;
+
+      Repro_leaf_range(leaves, my_rank, thread_count, &first_leaf,
+            &last_leaf);
+      Repro_acc_init(&accs[my_rank]);
+      for (leaf = first_leaf; leaf <= last_leaf; leaf++) {
+         leaf_sum = Repro_zero();
+         last = (leaf + 1)*REPRO_BLOCK - 1;
+         if (last > finish) last = finish;
+         leaf_sum.sum = Sin_range(leaf*REPRO_BLOCK, last);
+         Repro_acc_push(&accs[my_rank], leaf, leaf_sum);
+      }
+   }
+   check = Repro_tree_accs(accs, thread_count, leaves);
+   free(accs);
+   return check;
+}  /* Check_sum */
+#else
 double Check_sum(long n, int thread_count) {
-   long i;
    long finish = n*(n+3)/2;
    double check = 0.0;
 
-#  pragma omp parallel for num_threads(thread_count) \
-      default(none) shared(n, finish) private(i) \
+   /* Each thread adds a block of consecutive terms */
+#  pragma omp parallel num_threads(thread_count) \
+      default(none) shared(finish, thread_count) \
       reduction(+: check)
-   for (i = 0; i <= finish; i++) {
-      check += sin(i);
+   {
+      int my_rank = omp_get_thread_num();
+      long my_first = (finish + 1)*my_rank/thread_count;
+      long my_last = (finish + 1)*(my_rank + 1)/thread_count - 1;
+
+      check += Sin_range(my_first, my_last);
    }
    return check;
 }  /* Check_sum */
+#endif
 
 /*------------------------------------------------------------------
  * Function:  Print_iters
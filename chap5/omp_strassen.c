@@ -0,0 +1,274 @@
+/* File:     omp_strassen.c
+ *
+ * Purpose:  Strassen-Winograd matrix multiplication with OpenMP tasks.
+ *           See omp_strassen.h.
+ *
+ * Notes:
+ * 1.  If A = [A11 A12; A21 A22] and B = [B11 B12; B21 B22], Winograd's
+ *     form of Strassen's algorithm computes
+ *
+ *        S1 = A21 + A22   T1 = B12 - B11   M1 = A11 B11   M5 = S1 T1
+ *        S2 = S1 - A11    T2 = B22 - T1    M2 = A12 B21   M6 = S2 T2
+ *        S3 = A11 - A21   T3 = B22 - B12   M3 = S4 B22    M7 = S3 T3
+ *        S4 = A12 - S2    T4 = T2 - B21    M4 = A22 T4
+ *
+ *        U2 = M1 + M6,  U3 = U2 + M7,  U4 = U2 + M5
+ *
+ *        C11 = M1 + M2,  C12 = U4 + M3,  C21 = U3 - M4,  C22 = U3 + M5
+ *
+ * 2.  If n is odd, the algorithm is applied to the leading n-1 x n-1
+ *     submatrices, and the last row and column are "peeled":  the
+ *     contribution of the last column of A and last row of B is added
+ *     to the leading submatrix of C, and the last row and column of C
+ *     are computed by the classic kernel.
+ * 3.  The 7 products of a level are OpenMP tasks, down to the level
+ *     where there are at least 4 tasks per thread.  Below that they're
+ *     computed by the task that created them.  The additions of a
+ *     level are done by one thread.
+ * 4.  A call on an n x n matrix allocates 15 temporary n/2 x n/2
+ *     matrices, 15n^2/4 doubles, so a serial recursion holds at most
+ *     5n^2 doubles at once.  But the 7^d calls at each depth
+ *     d <= task_depth can all be live together, and each of them holds
+ *     its own temporaries.  So with D = task_depth, the temporaries can take
+ *     up to about (10(7/4)^D - 5)n^2 doubles:  25.6n^2 for D = 2
+ *     (2 to 12 threads) and 48.6n^2 for D = 3 (13 to 85 threads).
+ *     The peak is usually lower, since a task only allocates once it
+ *     starts, and with one thread the tasks run one at a time, so it's
+ *     5n^2.
+ * 5.  The error of Strassen-Winograd is bounded by a larger multiple
+ *     of the unit roundoff than the error of the classic algorithm, and
+ *     it grows with the number of levels.  Strassen_error measures it.
+ *
+ * IPP:  Not discussed, but see Section 5.9 (pp. 253 and ff.) on
+ *       matrix multiplication and Exercise 5.16 on tasks
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+#include "omp_strassen.h"
+
+/* The products are tasks for depth < task_depth */
+static int task_depth = 0;
+
+static void Block_mult(long m, long k, long n, const double A[], long lda,
+      const double B[], long ldb, double C[], long ldc, int add);
+static void Add(long h, const double X[], long ldx, const double Y[],
+      long ldy, double Z[], long ldz, double sign);
+static void Strassen_rec(long n, const double A[], long lda,
+      const double B[], long ldb, double C[], long ldc, long cutoff,
+      int depth);
+
+/*------------------------------------------------------------------
+ * Function:  Block_mult
+ * Purpose:   Classic product of the m x k matrix A and the k x n matrix
+ *            B, in blocks of STRASSEN_BLOCK rows and columns
+ * In args:   m, k, n, A, lda, B, ldb, ldc
+ *            add:  if nonzero, C = C + AB, otherwise C = AB
+ * In/out:    C
+ */
+static void Block_mult(long m, long k, long n, const double A[], long lda,
+      const double B[], long ldb, double C[], long ldc, int add) {
+   long ii, kk, jj, i, p, j, i_end, p_end, j_end;
+   double a;
+
+   if (!add)
+      for (i = 0; i < m; i++)
+         for (j = 0; j < n; j++)
+            C[i*ldc + j] = 0.0;
+
+   for (ii = 0; ii < m; ii += STRASSEN_BLOCK) {
+      i_end = (ii + STRASSEN_BLOCK < m) ? ii + STRASSEN_BLOCK : m;
+      for (kk = 0; kk < k; kk += STRASSEN_BLOCK) {
+         p_end = (kk + STRASSEN_BLOCK < k) ? kk + STRASSEN_BLOCK : k;
+         for (jj = 0; jj < n; jj += STRASSEN_BLOCK) {
+            j_end = (jj + STRASSEN_BLOCK < n) ? jj + STRASSEN_BLOCK : n;
+            for (i = ii; i < i_end; i++)
+               for (p = kk; p < p_end; p++) {
+                  a = A[i*lda + p];
+                  for (j = jj; j < j_end; j++)
+                     C[i*ldc + j] += a*B[p*ldb + j];
+               }
+         }
+      }
+   }
+}  /* Block_mult */
+
+/*------------------------------------------------------------------
+ * Function:  Add
+ * Purpose:   Z = X + sign*Y for h x h matrices
+ */
+static void Add(long h, const double X[], long ldx, const double Y[],
+      long ldy, double Z[], long ldz, double sign) {
+   long i, j;
+
+   for (i = 0; i < h; i++)
+      for (j = 0; j < h; j++)
+         Z[i*ldz + j] = X[i*ldx + j] + sign*Y[i*ldy + j];
+}  /* Add */
+
+/*------------------------------------------------------------------
+ * Function:  Strassen_rec
+ * Purpose:   C = AB for n x n matrices, by one level of
+ *            Strassen-Winograd and recursive calls for the products
+ */
+static void Strassen_rec(long n, const double A[], long lda,
+      const double B[], long ldb, double C[], long ldc, long cutoff,
+      int depth) {
+   long h = n/2, hh = h*h, n1 = n-1;
+   double *work, *S1, *S2, *S3, *S4, *T1, *T2, *T3, *T4;
+   double *M1, *M2, *M3, *M4, *M5, *M6, *M7;
+   const double *A11, *A12, *A21, *A22, *B11, *B12, *B21, *B22;
+   int tasks = (depth < task_depth);
+
+   if (n <= cutoff) {
+      Block_mult(n, n, n, A, lda, B, ldb, C, ldc, 0);
+      return;
+   }
+
+   if (n % 2 != 0) {
+      Strassen_rec(n1, A, lda, B, ldb, C, ldc, cutoff, depth);
+      /* C11 += (last column of A)(last row of B) */
+      Block_mult(n1, 1, n1, A + n1, lda, B + n1*ldb, ldb, C, ldc, 1);
+      /* Last column of C */
+      Block_mult(n1, n, 1, A, lda, B + n1, ldb, C + n1, ldc, 0);
+      /* Last row of C */
+      Block_mult(1, n, n, A + n1*lda, lda, B, ldb, C + n1*ldc, ldc, 0);
+      return;
+   }
+
+   work = malloc(15*hh*sizeof(double));
+   if (work == NULL) {
+      fprintf(stderr, "Strassen:  can't allocate %ld doubles\n", 15*hh);
+      exit(-1);
+   }
+   S1 = work;      S2 = S1 + hh;  S3 = S2 + hh;  S4 = S3 + hh;
+   T1 = S4 + hh;   T2 = T1 + hh;  T3 = T2 + hh;  T4 = T3 + hh;
+   M1 = T4 + hh;   M2 = M1 + hh;  M3 = M2 + hh;  M4 = M3 + hh;
+   M5 = M4 + hh;   M6 = M5 + hh;  M7 = M6 + hh;
+
+   A11 = A;  A12 = A + h;  A21 = A + h*lda;  A22 = A21 + h;
+   B11 = B;  B12 = B + h;  B21 = B + h*ldb;  B22 = B21 + h;
+
+   Add(h, A21, lda, A22, lda, S1, h, 1.0);
+   Add(h, S1, h, A11, lda, S2, h, -1.0);
+   Add(h, A11, lda, A21, lda, S3, h, -1.0);
+   Add(h, A12, lda, S2, h, S4, h, -1.0);
+   Add(h, B12, ldb, B11, ldb, T1, h, -1.0);
+   Add(h, B22, ldb, T1, h, T2, h, -1.0);
+   Add(h, B22, ldb, B12, ldb, T3, h, -1.0);
+   Add(h, T2, h, B21, ldb, T4, h, -1.0);
+
+#  pragma omp task if(tasks)
+   Strassen_rec(h, A11, lda, B11, ldb, M1, h, cutoff, depth+1);
+#  pragma omp task if(tasks)
+   Strassen_rec(h, A12, lda, B21, ldb, M2, h, cutoff, depth+1);
+#  pragma omp task if(tasks)
+   Strassen_rec(h, S4, h, B22, ldb, M3, h, cutoff, depth+1);
+#  pragma omp task if(tasks)
+   Strassen_rec(h, A22, lda, T4, h, M4, h, cutoff, depth+1);
+#  pragma omp task if(tasks)
+   Strassen_rec(h, S1, h, T1, h, M5, h, cutoff, depth+1);
+#  pragma omp task if(tasks)
+   Strassen_rec(h, S2, h, T2, h, M6, h, cutoff, depth+1);
+#  pragma omp task if(tasks)
+   Strassen_rec(h, S3, h, T3, h, M7, h, cutoff, depth+1);
+#  pragma omp taskwait
+
+   Add(h, M1, h, M2, h, C, ldc, 1.0);                  /* C11      */
+   Add(h, M1, h, M6, h, M6, h, 1.0);                   /* M6 = U2  */
+   Add(h, M6, h, M7, h, M7, h, 1.0);                   /* M7 = U3  */
+   Add(h, M6, h, M5, h, M6, h, 1.0);                   /* M6 = U4  */
+   Add(h, M6, h, M3, h, C + h, ldc, 1.0);              /* C12      */
+   Add(h, M7, h, M4, h, C + h*ldc, ldc, -1.0);         /* C21      */
+   Add(h, M7, h, M5, h, C + h*ldc + h, ldc, 1.0);      /* C22      */
+
+   free(work);
+}  /* Strassen_rec */
+
+/*------------------------------------------------------------------
+ * Function:  Strassen
+ * Purpose:   C = AB for n x n matrices, using thread_count threads, by
+ *            Strassen-Winograd down to the cutoff
+ */
+void Strassen(int thread_count, long n, const double A[], long lda,
+      const double B[], long ldb, double C[], long ldc, long cutoff) {
+   long tasks;
+
+   if (cutoff < 1) cutoff = 1;
+   task_depth = 0;
+   for (tasks = 1; tasks < 4*thread_count; tasks *= 7)
+      task_depth++;
+
+#  pragma omp parallel num_threads(thread_count) default(none) \
+      shared(n, A, lda, B, ldb, C, ldc, cutoff)
+#  pragma omp single
+   Strassen_rec(n, A, lda, B, ldb, C, ldc, cutoff, 0);
+}  /* Strassen */
+
+/*------------------------------------------------------------------
+ * Function:  Strassen_classic
+ * Purpose:   C = AB for n x n matrices with the blocked classic kernel,
+ *            using thread_count threads, each of which computes a block
+ *            of rows of C
+ */
+void Strassen_classic(int thread_count, long n, const double A[],
+      long lda, const double B[], long ldb, double C[], long ldc) {
+   long ii, rows;
+
+#  pragma omp parallel for num_threads(thread_count) default(none) \
+      private(rows) shared(n, A, lda, B, ldb, C, ldc) schedule(dynamic)
+   for (ii = 0; ii < n; ii += STRASSEN_BLOCK) {
+      rows = (ii + STRASSEN_BLOCK < n) ? STRASSEN_BLOCK : n - ii;
+      Block_mult(rows, n, n, A + ii*lda, lda, B, ldb, C + ii*ldc, ldc, 0);
+   }
+}  /* Strassen_classic */
+
+/*------------------------------------------------------------------
+ * Function:  Strassen_cutoff
+ * Purpose:   Return the cutoff from STRASSEN_CUTOFF, or
+ *            STRASSEN_CUTOFF_DEF if it isn't set
+ */
+long Strassen_cutoff(void) {
+   char* env = getenv("STRASSEN_CUTOFF");
+   long cutoff = (env != NULL) ? strtol(env, NULL, 10) : 0;
+
+   return (cutoff > 0) ? cutoff : STRASSEN_CUTOFF_DEF;
+}  /* Strassen_cutoff */
+
+/*------------------------------------------------------------------
+ * Function:  Strassen_flops
+ * Purpose:   Return the number of floating point operations carried
+ *            out by Strassen with this cutoff.  The classic algorithm
+ *            carries out 2n^3.
+ */
+double Strassen_flops(long n, long cutoff) {
+   double h = n/2, n1 = n-1;
+
+   if (cutoff < 1) cutoff = 1;
+   if (n <= cutoff)
+      return 2.0*n*n*n;
+   else if (n % 2 != 0)
+      return Strassen_flops(n-1, cutoff) + 2.0*n1*n1 + 2.0*n*n1
+         + 2.0*n*n;
+   else
+      return 7.0*Strassen_flops(n/2, cutoff) + 15.0*h*h;
+}  /* Strassen_flops */
+
+/*------------------------------------------------------------------
+ * Function:  Strassen_error
+ * Purpose:   Return max |C - R| / max |R| for n x n matrices, where R
+ *            is the product computed by the classic algorithm
+ */
+double Strassen_error(long n, const double C[], long ldc,
+      const double R[], long ldr) {
+   double diff = 0.0, norm = 0.0;
+   long i, j;
+
+   for (i = 0; i < n; i++)
+      for (j = 0; j < n; j++) {
+         diff = fmax(diff, fabs(C[i*ldc + j] - R[i*ldr + j]));
+         norm = fmax(norm, fabs(R[i*ldr + j]));
+      }
+   return (norm > 0.0) ? diff/norm : diff;
+}  /* Strassen_error */
@@ -0,0 +1,43 @@
+/* File:     omp_strassen.h
+ * Purpose:  Header file for omp_strassen.c, which multiplies square
+ *           matrices with the Strassen-Winograd algorithm, using OpenMP
+ *           tasks for the products of the submatrices.
+ *
+ *           Each level of the recursion replaces the 8 products of n/2 x
+ *           n/2 submatrices of the classic algorithm by 7 products and 15
+ *           additions.  Below the cutoff, the product is computed by a
+ *           blocked classic kernel.  So with cutoff c, the algorithm
+ *           carries out about (7/8)^L of the flops of the classic
+ *           algorithm, where L = log2(n/c) is the number of levels.
+ *
+ * Usage:
+ *    Strassen(thread_count, n, A, lda, B, ldb, C, ldc, Strassen_cutoff());
+ *    Strassen_classic(thread_count, n, A, lda, B, ldb, R, ldr);
+ *    printf("error = %e\n", Strassen_error(n, C, ldc, R, ldr));
+ *
+ *    The matrices are stored by rows, and element (i, j) of A is
+ *    A[i*lda + j].
+ *
+ * Environment:
+ *    STRASSEN_CUTOFF   Order of the largest product computed by the
+ *                      classic kernel (default STRASSEN_CUTOFF_DEF)
+ *
+ * IPP:  Not discussed, but see Section 5.9 (pp. 253 and ff.) on
+ *       matrix multiplication and Exercise 5.16 on tasks
+ */
+#ifndef _OMP_STRASSEN_H_
+#define _OMP_STRASSEN_H_
+
+#define STRASSEN_CUTOFF_DEF 128
+#define STRASSEN_BLOCK      64    /* Block size of the classic kernel */
+
+void   Strassen(int thread_count, long n, const double A[], long lda,
+         const double B[], long ldb, double C[], long ldc, long cutoff);
+void   Strassen_classic(int thread_count, long n, const double A[],
+         long lda, const double B[], long ldb, double C[], long ldc);
+long   Strassen_cutoff(void);
+double Strassen_flops(long n, long cutoff);
+double Strassen_error(long n, const double C[], long ldc,
+         const double R[], long ldr);
+
+#endif
@@ -0,0 +1,258 @@
+/* File:     omp_trace.c
+ *
+ * Purpose:  Record the iterations of OpenMP parallel for loops
+ *           executed by each thread, and report the load balance.
+ *
+ * Notes:
+ * 1.  Each thread keeps the range of consecutive iterations it's
+ *     executing.  When Trace_iter(i) is called with i = last + 1, the
+ *     range is extended.  Otherwise the range is stored in the
+ *     thread's ring buffer and a new range starts.  So a block
+ *     schedule stores one range per thread, and schedule(static,1)
+ *     stores one per iteration.
+ * 2.  A range starts when the thread finished its previous iteration
+ *     in the loop (or when the loop started), and ends when its last
+ *     iteration finished.  A thread's busy time is the sum of the
+ *     lengths of its ranges, and its idle time is the rest of the
+ *     loop's elapsed time, i.e., the time spent waiting at the
+ *     implicit barrier at the end of the loop.  The times are wall
+ *     clock times, so if there are more threads than cores, a thread's
+ *     busy time includes the time it wasn't running.  Trace_loop_end
+ *     should be called right after the loop, since the loop's elapsed
+ *     time ends when it's called.
+ * 3.  The imbalance is the largest busy time divided by the mean.  The
+ *     straggler is the thread that finished last.
+ * 4.  The ring buffer keeps the last TRACE_RING ranges of each thread.
+ *     Older ranges are overwritten, and the number that were lost is
+ *     reported.  The totals printed by Trace_finish include every
+ *     range.
+ * 5.  The cost of Trace_iter is a call to omp_get_wtime.  When
+ *     LOOP_TRACE isn't set, it's a test of a global variable.
+ * 6.  Loops in nested parallel regions aren't supported.
+ *
+ * IPP:  Not discussed, but see Section 5.7 (pp. 236 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "omp_trace.h"
+
+int trace_on = 0;
+
+static int trace_threads;
+static struct trace_thread_s* threads;
+static const char* trace_file;
+static double trace_t0;
+
+/* Totals for thread t in loop l are in totals[l*trace_threads + t] */
+struct trace_total_s {
+   long   iters;
+   long   ranges;
+   double busy;
+   double last_end;
+};
+
+static int         loop_count = 0;
+static const char* loop_names[TRACE_MAX_LOOPS];
+static double      loop_starts[TRACE_MAX_LOOPS];
+static double      loop_ends[TRACE_MAX_LOOPS];
+static struct trace_total_s* totals;
+
+static void Push_range(struct trace_thread_s* ts);
+static void Print_loop(int loop);
+
+/*------------------------------------------------------------------
+ * Function:  Trace_init
+ * Purpose:   Turn tracing on if LOOP_TRACE is set, and allocate a ring
+ *            buffer for each thread
+ */
+void Trace_init(int thread_count) {
+   int t;
+
+   trace_file = getenv("LOOP_TRACE");
+   if (trace_file == NULL || trace_file[0] == '\0') return;
+   trace_on = 1;
+   trace_threads = thread_count;
+   threads = aligned_alloc(TRACE_CACHE_LINE,
+         thread_count*sizeof(struct trace_thread_s));
+   for (t = 0; t < thread_count; t++) {
+      memset(&threads[t], 0, sizeof(struct trace_thread_s));
+      threads[t].ring = malloc(TRACE_RING*sizeof(struct trace_range_s));
+   }
+   totals = malloc(TRACE_MAX_LOOPS*thread_count*sizeof(struct trace_total_s));
+   trace_t0 = omp_get_wtime();
+}  /* Trace_init */
+
+/*------------------------------------------------------------------
+ * Function:  Trace_loop_begin
+ * Purpose:   Start tracing a new loop.  Called by the main thread
+ *            before the loop.
+ */
+void Trace_loop_begin(const char* name) {
+   int t;
+
+   if (!trace_on) return;
+   if (loop_count == TRACE_MAX_LOOPS) {
+      fprintf(stderr, "Trace:  more than %d loops, not tracing %s\n",
+            TRACE_MAX_LOOPS, name);
+      trace_on = 0;
+      return;
+   }
+   loop_names[loop_count] = name;
+   loop_starts[loop_count] = omp_get_wtime();
+   for (t = 0; t < trace_threads; t++) {
+      threads[t].open = 0;
+      threads[t].prev_end = loop_starts[loop_count];
+      threads[t].iters = threads[t].ranges = 0;
+      threads[t].busy = 0.0;
+   }
+}  /* Trace_loop_begin */
+
+/*------------------------------------------------------------------
+ * Function:  Push_range
+ * Purpose:   Store the calling thread's current range in its ring
+ *            buffer
+ */
+static void Push_range(struct trace_thread_s* ts) {
+   ts->ring[ts->next & (TRACE_RING - 1)] = ts->cur;
+   ts->next++;
+   ts->ranges++;
+   ts->busy += ts->cur.end - ts->cur.start;
+   ts->open = 0;
+}  /* Push_range */
+
+/*------------------------------------------------------------------
+ * Function:  Trace_iter_record
+ * Purpose:   Record the end of iteration i by the calling thread.
+ *            Called by Trace_iter.
+ */
+void Trace_iter_record(long i) {
+   int my_rank = omp_get_thread_num();
+   struct trace_thread_s* ts;
+   double now = omp_get_wtime();
+
+   if (my_rank >= trace_threads) return;
+   ts = &threads[my_rank];
+   if (ts->open && i == ts->cur.last + 1) {
+      ts->cur.last = i;
+   } else {
+      if (ts->open) Push_range(ts);
+      ts->cur.first = ts->cur.last = i;
+      ts->cur.start = ts->prev_end;
+      ts->cur.loop = loop_count;
+      ts->open = 1;
+   }
+   ts->cur.end = ts->prev_end = now;
+   ts->iters++;
+}  /* Trace_iter_record */
+
+/*------------------------------------------------------------------
+ * Function:  Trace_loop_end
+ * Purpose:   Close each thread's last range, and save the totals for
+ *            the loop.  Called by the main thread right after the loop.
+ */
+void Trace_loop_end(void) {
+   int t;
+   struct trace_thread_s* ts;
+   struct trace_total_s* total;
+
+   if (!trace_on) return;
+   loop_ends[loop_count] = omp_get_wtime();
+   for (t = 0; t < trace_threads; t++) {
+      ts = &threads[t];
+      if (ts->open) Push_range(ts);
+      total = &totals[loop_count*trace_threads + t];
+      total->iters = ts->iters;
+      total->ranges = ts->ranges;
+      total->busy = ts->busy;
+      total->last_end = ts->prev_end;
+   }
+   loop_count++;
+}  /* Trace_loop_end */
+
+/*------------------------------------------------------------------
+ * Function:  Print_loop
+ * Purpose:   Print the iterations, busy and idle time of each thread in
+ *            loop, the imbalance, and the straggler
+ */
+static void Print_loop(int loop) {
+   double elapsed = loop_ends[loop] - loop_starts[loop];
+   double mean = 0.0, max_busy = 0.0, last_end = 0.0;
+   int t, straggler = 0;
+   struct trace_total_s* total;
+
+   printf("\nTrace of loop %s:  elapsed time = %e seconds\n",
+         loop_names[loop], elapsed);
+   printf("Thread  Iterations    Ranges        Busy        Idle\n");
+   for (t = 0; t < trace_threads; t++) {
+      total = &totals[loop*trace_threads + t];
+      if (total->busy > max_busy) max_busy = total->busy;
+      if (total->iters > 0 && total->last_end > last_end) {
+         last_end = total->last_end;
+         straggler = t;
+      }
+      mean += total->busy;
+      printf("%6d  %10ld  %8ld  %e  %e\n", t, total->iters, total->ranges,
+            total->busy, elapsed - total->busy);
+   }
+   mean /= trace_threads;
+   printf("Imbalance (max busy/mean busy) = %.3f, last thread to finish = %d\n",
+         mean > 0.0 ? max_busy/mean : 1.0, straggler);
+}  /* Print_loop */
+
+/*------------------------------------------------------------------
+ * Function:  Trace_finish
+ * Purpose:   Print the totals for each loop, write the ranges in the
+ *            ring buffers to LOOP_TRACE in Chrome trace format, and
+ *            free the buffers.  Times in the file are in microseconds
+ *            from Trace_init.
+ */
+void Trace_finish(void) {
+   FILE* fp;
+   long first, r, lost = 0;
+   int t, loop, comma = 0;
+   struct trace_range_s* range;
+
+   if (threads == NULL) return;
+   for (loop = 0; loop < loop_count; loop++)
+      Print_loop(loop);
+
+   fp = fopen(trace_file, "w");
+   if (fp == NULL) {
+      fprintf(stderr, "Trace:  can't open %s\n", trace_file);
+   } else {
+      fprintf(fp, "{\"traceEvents\":[\n");
+      for (t = 0; t < trace_threads; t++) {
+         fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+               "\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+               comma ? ",\n" : "", t, t);
+         comma = 1;
+         first = (threads[t].next > TRACE_RING) ?
+            threads[t].next - TRACE_RING : 0;
+         lost += first;
+         for (r = first; r < threads[t].next; r++) {
+            range = &threads[t].ring[r & (TRACE_RING - 1)];
+            fprintf(fp, ",\n{\"name\":\"%s %ld-%ld\",\"cat\":\"%s\","
+                  "\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,"
+                  "\"tid\":%d,\"args\":{\"first\":%ld,\"last\":%ld}}",
+                  loop_names[range->loop], range->first, range->last,
+                  loop_names[range->loop],
+                  1.0e6*(range->start - trace_t0),
+                  1.0e6*(range->end - range->start), t,
+                  range->first, range->last);
+         }
+      }
+      fprintf(fp, "\n]}\n");
+      fclose(fp);
+      if (lost > 0)
+         fprintf(stderr, "Trace:  %ld old ranges were overwritten\n", lost);
+   }
+
+   for (t = 0; t < trace_threads; t++)
+      free(threads[t].ring);
+   free(threads);
+   free(totals);
+   threads = NULL;
+   trace_on = 0;
+}  /* Trace_finish */
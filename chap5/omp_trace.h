@@ -0,0 +1,75 @@
+/* File:     omp_trace.h
+ * Purpose:  Header file for omp_trace.c, which records which thread
+ *           executed which iterations of an OpenMP parallel for loop,
+ *           and when.  Tracing is turned on when the program runs,
+ *           by setting the environment variable LOOP_TRACE to the name
+ *           of a file, so the program doesn't need to be recompiled.
+ *
+ * Usage:
+ *    Trace_init(thread_count);                  (main thread, once)
+ *    . . .
+ *    Trace_loop_begin("Sum");                   (main thread)
+ *    #  pragma omp parallel for . . .
+ *    for (i = 0; i < n; i++) {
+ *       . . .
+ *       Trace_iter(i);                          (end of each iteration)
+ *    }
+ *    Trace_loop_end();                          (main thread, right after)
+ *    . . .
+ *    Trace_finish();                            (main thread, once)
+ *
+ *    With LOOP_TRACE set, Trace_finish prints each thread's iterations,
+ *    busy time and idle time in each loop, and the imbalance, and it
+ *    writes the ranges of iterations executed by each
+ *    thread to the file in Chrome trace format (open it with
+ *    chrome://tracing or https://ui.perfetto.dev).
+ *
+ * IPP:  Not discussed, but see Section 5.7 (pp. 236 and ff.)
+ */
+#ifndef _OMP_TRACE_H_
+#define _OMP_TRACE_H_
+
+#define TRACE_CACHE_LINE 64
+#define TRACE_RING       65536  /* Ranges kept per thread:  a power of 2 */
+#define TRACE_MAX_LOOPS  64
+
+/* Iterations first, . . . , last of a loop, executed without a break */
+struct trace_range_s {
+   long   first;
+   long   last;
+   double start;
+   double end;
+   int    loop;
+};
+
+struct trace_thread_s {
+   _Alignas(TRACE_CACHE_LINE) struct trace_range_s* ring;
+   long   next;          /* Ranges ever recorded:  slot next % TRACE_RING */
+   int    open;          /* 1 if cur is being extended                    */
+   struct trace_range_s cur;
+   double prev_end;      /* End of the last iteration in this loop        */
+
+   /* Totals for the current loop */
+   long   iters;
+   long   ranges;
+   double busy;
+};
+
+extern int trace_on;
+
+void Trace_init(int thread_count);
+void Trace_loop_begin(const char* name);
+void Trace_iter_record(long i);
+void Trace_loop_end(void);
+void Trace_finish(void);
+
+/*------------------------------------------------------------------
+ * Function:  Trace_iter
+ * Purpose:   Record that the calling thread has finished iteration i.
+ *            If tracing is off, this is just a test of trace_on.
+ */
+static inline void Trace_iter(long i) {
+   if (trace_on) Trace_iter_record(i);
+}  /* Trace_iter */
+
+#endif
@@ -6,13 +6,21 @@
  * Output:  estimate of integral from a to b of f(x)
  *          using n trapezoids.
  *
- * Compile: gcc -g -Wall -fopenmp -o omp_trap2b omp_trap2b.c
+ * Compile: gcc -g -Wall -O3 -fopenmp -o omp_trap2b omp_trap2b.c
  * Usage:   ./omp_trap2b <number of threads>
  *
  * Notes:   
  *   1.  The function f(x) is hardwired.
  *   2.  This version assumes that n is evenly divisible by the 
  *       number of threads
+ *   3.  If REPRO is defined, each thread adds a block of the leaves
+ *       of REPRO_BLOCK points used by repro_sum.c, and the leaf sums
+ *       are combined by a fixed tree instead of the reduction clause.
+ *       Then the result is the same for every number of threads, and
+ *       the same as omp_trap3 compiled with -DREPRO.  Compile with
+ *
+ *          gcc -g -Wall -O3 -fopenmp -DREPRO -o omp_trap2b omp_trap2b.c \
+ *             repro_sum.c
  *
  * IPP:  Section 5.4 (pp. 223 and ff.)
  */
@@ -21,16 +29,25 @@
 #include <stdlib.h>
 #include <math.h>
 #include <omp.h>
+#ifdef REPRO
+#include "trap_batch.h"
+#endif
 
 void Usage(char* prog_name);
 double f(double x);    /* Function we're integrating */
 double Local_trap(double a, double b, int n);
+#ifdef REPRO
+void Local_trap_repro(double a, double b, int n, struct repro_acc_s accs[]);
+#endif
 
 int main(int argc, char* argv[]) {
    double  global_result = 0.0;  /* Store result in global_result */
    double  a, b;                 /* Left and right endpoints      */
    int     n;                    /* Total number of trapezoids    */
    int     thread_count;
+#  ifdef REPRO
+   struct repro_acc_s* accs;
+#  endif
 
    if (argc != 2) Usage(argv[0]);
    thread_count = strtol(argv[1], NULL, 10);
@@ -38,9 +55,19 @@ int main(int argc, char* argv[]) {
    scanf("%lf %lf %d", &a, &b, &n);
    if (n % thread_count != 0) Usage(argv[0]);
 
+#  ifdef REPRO
+   accs = malloc(thread_count*sizeof(struct repro_acc_s));
+#  pragma omp parallel num_threads(thread_count)
+   Local_trap_repro(a, b, n, accs);
+   global_result = (f(a) + f(b))/2.0
+      + Repro_tree_accs(accs, thread_count, Trap_leaves(n));
+   global_result = global_result*(b-a)/n;
+   free(accs);
+#  else
 #  pragma omp parallel num_threads(thread_count) \
       reduction(+: global_result)
    global_result += Local_trap(a, b, n);
+#  endif
 
    printf("With n = %d trapezoids, our estimate\n", n);
    printf("of the integral from %f to %f = %.14e\n",
@@ -108,3 +135,29 @@ double Local_trap(double a, double b, int n) {
 
    return my_result;
 }  /* Trap */
+
+#ifdef REPRO
+/*------------------------------------------------------------------
+ * Function:    Local_trap_repro
+ * Purpose:     Add up f at this thread's block of the leaves of the
+ *              points a + i*h, 1 <= i <= n-1
+ * Input args:
+ *    a: left endpoint
+ *    b: right endpoint
+ *    n: number of trapezoids
+ * Output arg:
+ *    accs:  accs[my_rank] holds the thread's subtrees of leaf sums
+ */
+void Local_trap_repro(double a, double b, int n, struct repro_acc_s accs[]) {
+   double h = (b-a)/n;
+   long   leaves = Trap_leaves(n);
+   long   first_leaf, last_leaf;
+   int my_rank = omp_get_thread_num();
+   int thread_count = omp_get_num_threads();
+
+   Repro_leaf_range(leaves, my_rank, thread_count, &first_leaf,
+         &last_leaf);
+   Repro_acc_init(&accs[my_rank]);
+   Trap_blocks(a, h, n, first_leaf, last_leaf, &accs[my_rank]);
+}  /* Local_trap_repro */
+#endif
@@ -6,13 +6,25 @@
  * Output:  estimate of integral from a to b of f(x)
  *          using n trapezoids.
  *
- * Compile: gcc -g -Wall -fopenmp -o omp_trap3 omp_trap3.c
+ * Compile: gcc -g -Wall -O3 -fopenmp -o omp_trap3 omp_trap3.c
  * Usage:   ./omp_trap3 <number of threads>
  *
  * Notes:   
- *   1.  The function f(x) is hardwired.
+ *   1.  The function f(x) is hardwired.  It's defined by F_kernel in
+ *       trap_batch.h.
  *   2.  In this version, it's not necessary for n to be
  *       evenly divisible by thread_count.
+ *   3.  Each thread gets a block of consecutive points, and evaluates
+ *       f on them in batches of TRAP_LANES points with Trap_sum.  So
+ *       for fixed TRAP_LANES and thread_count the order of the
+ *       additions is fixed.
+ *   4.  If REPRO is defined, the points are divided into leaves of
+ *       REPRO_BLOCK points, and the leaf sums are combined by the
+ *       fixed tree in repro_sum.c.  Then the result is the same for
+ *       every thread_count.  Compile with
+ *
+ *          gcc -g -Wall -O3 -fopenmp -DREPRO -o omp_trap3 omp_trap3.c \
+ *             repro_sum.c
  *
  * IPP:  Section 5.5 (pp. 224 and ff.)
  */
@@ -21,6 +33,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <omp.h>
+#include "trap_batch.h"
 
 void Usage(char* prog_name);
 double f(double x);    /* Function we're integrating */
@@ -63,10 +76,7 @@ void Usage(char* prog_name) {
  * Return val:  f(x)
  */
 double f(double x) {
-   double return_val;
-
-   return_val = x*x;
-   return return_val;
+   return F_kernel(x);
 }  /* f */
 
 /*------------------------------------------------------------------
@@ -81,14 +91,48 @@ double f(double x) {
  */
 double Trap(double a, double b, int n, int thread_count) {
    double  h, approx;
-   int  i;
+
+#  ifdef REPRO
+   long leaves = Trap_leaves(n);
+   struct repro_acc_s* accs;
+#  endif
 
    h = (b-a)/n; 
    approx = (f(a) + f(b))/2.0; 
-#  pragma omp parallel for num_threads(thread_count) \
+#  ifdef REPRO
+   accs = malloc(thread_count*sizeof(struct repro_acc_s));
+#  pragma omp parallel num_threads(thread_count)
+   {
+      int  my_rank = omp_get_thread_num();
+      long first_leaf, last_leaf;
+
+      Repro_leaf_range(leaves, my_rank, thread_count, &first_leaf,
+            &last_leaf);
+      Repro_acc_init(&accs[my_rank]);
+      Trap_blocks(a, h, n, first_leaf, last_leaf, &accs[my_rank]);
+   }
+   approx += Repro_tree_accs(accs, thread_count, leaves);
+   free(accs);
+#  else
+#  pragma omp parallel num_threads(thread_count) \
       reduction(+: approx)
-   for (i = 1; i <= n-1; i++)
-     approx += f(a + i*h);
+   {
+      int  my_rank = omp_get_thread_num();
+      long quotient = (n-1)/thread_count;
+      long remainder = (n-1) % thread_count;
+      long my_first, my_count;
+
+      /* Points 1, 2, ..., n-1 are divided into blocks */
+      if (my_rank < remainder) {
+         my_count = quotient + 1;
+         my_first = 1 + my_rank*my_count;
+      } else {
+         my_count = quotient;
+         my_first = 1 + my_rank*my_count + remainder;
+      }
+      approx += Trap_sum(a, h, my_first, my_first + my_count - 1);
+   }
+#  endif
    approx = h*approx; 
 
    return approx;
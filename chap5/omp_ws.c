@@ -0,0 +1,238 @@
+/* File:     omp_ws.c
+ *
+ * Purpose:  Implement a work-stealing scheduler for the iterations of
+ *           a loop.
+ *
+ *    1.  Ws_init divides the iterations into thread_count contiguous
+ *        ranges with (about) the same total cost, and puts range r
+ *        in thread r's deque.
+ *    2.  When thread r calls Ws_next, it takes the range at the
+ *        bottom of its deque.  While the range has more than grain
+ *        iterations, the thread pushes the upper half back on its
+ *        deque, and keeps the lower half.
+ *    3.  If its deque is empty, the thread steals the range at the top
+ *        of another thread's deque, which is the largest range there,
+ *        and splits it in the same way.
+ *
+ * Notes:
+ * 1.  The deque is the one of D. Chase and Y. Lev (SPAA 2005) with
+ *     the C11 memory orders of N. M. Le et al. (PPoPP 2013).  Since a
+ *     range is split in halves, a deque never holds more than about
+ *     log2(n) ranges, so it has a fixed size.  If it's full, the range
+ *     isn't split any further.
+ * 2.  remaining is the number of iterations that haven't been handed
+ *     out by Ws_next.  When it's zero, every iteration has been given
+ *     to some thread, and threads with empty deques stop looking for
+ *     work.
+ * 3.  With cost = NULL the initial ranges have the same number of
+ *     iterations, as with schedule(static).  With a good cost
+ *     function, there should be few steals.
+ * 4.  A thread that can't find work calls sched_yield after
+ *     YIELD_TRIES failed steals, in case there are more threads than
+ *     cores.
+ *
+ * IPP:  Not discussed, but an alternative to the schedules in
+ *       Section 5.7 (pp. 236 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include "omp_ws.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX() __builtin_ia32_pause()
+#else
+#define CPU_RELAX()
+#endif
+
+#define YIELD_TRIES 100
+
+#define STEAL_EMPTY 0
+#define STEAL_OK    1
+#define STEAL_RACE  2
+
+static void Push(struct ws_deque_s* dq, struct ws_range_s range, int* ok_p);
+static int  Take(struct ws_deque_s* dq, struct ws_range_s* range_p);
+static int  Steal(struct ws_deque_s* dq, struct ws_range_s* range_p);
+
+/*-------------------------------------------------------------------
+ * Function:  Ws_init
+ * Purpose:   Divide first, . . . , last-1 among the threads' deques
+ * In args:   cost:  estimated cost of iteration i, or NULL
+ *            grain: the largest number of iterations Ws_next returns
+ */
+void Ws_init(struct ws_sched_s* ws, int thread_count, long first,
+      long last, double (*cost)(long), long grain) {
+   struct ws_range_s range;
+   double total = 0.0, sum = 0.0;
+   long i, start = first;
+   int r, ok;
+
+   ws->thread_count = thread_count;
+   ws->grain = (grain > 0) ? grain : 1;
+   ws->deques = aligned_alloc(WS_CACHE_LINE,
+         thread_count*sizeof(struct ws_deque_s));
+   atomic_init(&ws->remaining, (last > first) ? last - first : 0);
+   for (r = 0; r < thread_count; r++) {
+      atomic_init(&ws->deques[r].top, 0);
+      atomic_init(&ws->deques[r].bottom, 0);
+      ws->deques[r].steals = 0;
+      ws->deques[r].seed = 2*r + 1;
+   }
+
+   if (cost != NULL)
+      for (i = first; i < last; i++)
+         total += cost(i);
+
+   /* Range r ends at the first i with cost(first) + . . . + cost(i) */
+   /* >= (r+1)*total/thread_count                                    */
+   i = first;
+   for (r = 0; r < thread_count; r++) {
+      range.first = start;
+      if (r == thread_count - 1) {
+         range.last = last;
+      } else if (cost == NULL) {
+         range.last = first + (last - first)*(r + 1)/thread_count;
+      } else {
+         while (i < last && sum < total*(r + 1)/thread_count)
+            sum += cost(i++);
+         range.last = i;
+      }
+      if (range.last > range.first) Push(&ws->deques[r], range, &ok);
+      start = range.last;
+   }
+}  /* Ws_init */
+
+/*-------------------------------------------------------------------
+ * Function:    Ws_next
+ * Purpose:     Get the next range of iterations for thread my_rank
+ * Out args:    first_p, last_p:  the range is *first_p, . . . ,
+ *                 *last_p - 1
+ * Return val:  1 if there's a range, 0 if every iteration has been
+ *              handed out
+ */
+int Ws_next(struct ws_sched_s* ws, int my_rank, long* first_p,
+      long* last_p) {
+   struct ws_deque_s* me = &ws->deques[my_rank];
+   struct ws_range_s range, upper;
+   int victim, ok = 1, tries = 0;
+
+   while (!Take(me, &range)) {
+      if (atomic_load_explicit(&ws->remaining, memory_order_acquire) == 0)
+         return 0;
+      if (ws->thread_count == 1) continue;
+      victim = rand_r(&me->seed) % (ws->thread_count - 1);
+      if (victim >= my_rank) victim++;
+      if (Steal(&ws->deques[victim], &range) == STEAL_OK) {
+         me->steals++;
+         break;
+      }
+      if (++tries == YIELD_TRIES) {
+         sched_yield();
+         tries = 0;
+      } else {
+         CPU_RELAX();
+      }
+   }
+
+   while (range.last - range.first > ws->grain && ok) {
+      upper.first = range.first + (range.last - range.first)/2;
+      upper.last = range.last;
+      Push(me, upper, &ok);
+      if (ok) range.last = upper.first;
+   }
+
+   atomic_fetch_sub_explicit(&ws->remaining, range.last - range.first,
+         memory_order_acq_rel);
+   *first_p = range.first;
+   *last_p = range.last;
+   return 1;
+}  /* Ws_next */
+
+/*-------------------------------------------------------------------
+ * Function:    Ws_steals
+ * Purpose:     Total number of ranges stolen.  Call after the loop.
+ */
+long Ws_steals(struct ws_sched_s* ws) {
+   long steals = 0;
+   int r;
+
+   for (r = 0; r < ws->thread_count; r++)
+      steals += ws->deques[r].steals;
+   return steals;
+}  /* Ws_steals */
+
+/*-------------------------------------------------------------------*/
+void Ws_free(struct ws_sched_s* ws) {
+   free(ws->deques);
+}  /* Ws_free */
+
+/*-------------------------------------------------------------------
+ * Function:  Push
+ * Purpose:   Push range on the bottom of dq.  Only called by the
+ *            owner.
+ * Out arg:   ok_p:  0 if dq was full, 1 otherwise
+ */
+static void Push(struct ws_deque_s* dq, struct ws_range_s range, int* ok_p) {
+   long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+   long t = atomic_load_explicit(&dq->top, memory_order_acquire);
+
+   if (b - t >= WS_DEQUE_SIZE - 1) {
+      *ok_p = 0;
+      return;
+   }
+   dq->ranges[b & (WS_DEQUE_SIZE - 1)] = range;
+   atomic_thread_fence(memory_order_release);
+   atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+   *ok_p = 1;
+}  /* Push */
+
+/*-------------------------------------------------------------------
+ * Function:    Take
+ * Purpose:     Remove the range at the bottom of dq.  Only called by
+ *              the owner.  If there's one range, the owner races with
+ *              thieves for it with a compare-and-swap on top.
+ * Return val:  1 if a range was removed, 0 if dq was empty
+ */
+static int Take(struct ws_deque_s* dq, struct ws_range_s* range_p) {
+   long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed) - 1;
+   long t;
+   int got = 1;
+
+   atomic_store_explicit(&dq->bottom, b, memory_order_relaxed);
+   atomic_thread_fence(memory_order_seq_cst);
+   t = atomic_load_explicit(&dq->top, memory_order_relaxed);
+   if (t <= b) {
+      *range_p = dq->ranges[b & (WS_DEQUE_SIZE - 1)];
+      if (t == b) {
+         if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1,
+                  memory_order_seq_cst, memory_order_relaxed))
+            got = 0;
+         atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+      }
+   } else {
+      got = 0;
+      atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+   }
+   return got;
+}  /* Take */
+
+/*-------------------------------------------------------------------
+ * Function:    Steal
+ * Purpose:     Remove the range at the top of dq.  Called by thieves.
+ * Return val:  STEAL_OK, STEAL_EMPTY, or STEAL_RACE if another thread
+ *              got the range first
+ */
+static int Steal(struct ws_deque_s* dq, struct ws_range_s* range_p) {
+   long t = atomic_load_explicit(&dq->top, memory_order_acquire);
+   long b;
+
+   atomic_thread_fence(memory_order_seq_cst);
+   b = atomic_load_explicit(&dq->bottom, memory_order_acquire);
+   if (t >= b) return STEAL_EMPTY;
+   *range_p = dq->ranges[t & (WS_DEQUE_SIZE - 1)];
+   if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1,
+            memory_order_seq_cst, memory_order_relaxed))
+      return STEAL_RACE;
+   return STEAL_OK;
+}  /* Steal */
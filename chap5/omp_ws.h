@@ -0,0 +1,63 @@
+/* File:     omp_ws.h
+ * Purpose:  Header file for omp_ws.c, a work-stealing scheduler for
+ *           the iterations of a loop.  It can be used in place of the
+ *           schedule clause of a parallel for directive.
+ *
+ * Usage:
+ *    struct ws_sched_s ws;
+ *    Ws_init(&ws, thread_count, first, last, cost, grain);
+ *
+ *    #  pragma omp parallel num_threads(thread_count)
+ *    {
+ *       long my_first, my_last, i;
+ *       while (Ws_next(&ws, omp_get_thread_num(), &my_first, &my_last))
+ *          for (i = my_first; i < my_last; i++)
+ *             . . .
+ *    }
+ *    Ws_free(&ws);
+ *
+ *    cost(i) estimates the work in iteration i.  If cost is NULL,
+ *    the iterations are assumed to take the same time.
+ *
+ * IPP:  Not discussed, but an alternative to the schedules in
+ *       Section 5.7 (pp. 236 and ff.)
+ */
+#ifndef _OMP_WS_H_
+#define _OMP_WS_H_
+
+#include <stdatomic.h>
+
+#define WS_CACHE_LINE 64
+#define WS_DEQUE_SIZE 128   /* Ranges in a deque:  a power of 2 */
+
+/* The iterations first, first+1, . . . , last-1 */
+struct ws_range_s {
+   long first;
+   long last;
+};
+
+/* Chase-Lev deque:  the owner pushes and takes at bottom, and     */
+/* thieves steal at top.                                           */
+struct ws_deque_s {
+   _Alignas(WS_CACHE_LINE) atomic_long top;
+   _Alignas(WS_CACHE_LINE) atomic_long bottom;
+   struct ws_range_s ranges[WS_DEQUE_SIZE];
+   long steals;                  /* Ranges stolen by the owner   */
+   unsigned seed;                /* Choice of victims            */
+};
+
+struct ws_sched_s {
+   int                thread_count;
+   long               grain;     /* Largest range returned       */
+   struct ws_deque_s* deques;
+   _Alignas(WS_CACHE_LINE) atomic_long remaining;
+};
+
+void Ws_init(struct ws_sched_s* ws, int thread_count, long first,
+      long last, double (*cost)(long), long grain);
+int  Ws_next(struct ws_sched_s* ws, int my_rank, long* first_p,
+      long* last_p);
+long Ws_steals(struct ws_sched_s* ws);
+void Ws_free(struct ws_sched_s* ws);
+
+#endif
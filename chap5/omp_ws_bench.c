@@ -0,0 +1,213 @@
+/* File:    omp_ws_bench.c
+ * Purpose: Compare the work-stealing scheduler in omp_ws.c with the
+ *          OpenMP schedules on loops in which the iterations do
+ *          different amounts of work.
+ *
+ *          Workloads:
+ *             tri:    term i makes i+1 calls to sin, as in
+ *                     omp_sin_sum.c
+ *             irreg:  term i makes 1-100 calls to sin, except for
+ *                     about 1 in 97 terms, which make 5000
+ *
+ *          Schedules:
+ *             static:   schedule(static), one block per thread
+ *             cyclic:   schedule(static,1)
+ *             dynamic:  schedule(dynamic,1)
+ *             guided:   schedule(guided)
+ *             ws:       omp_ws.c, initial ranges with equal cost
+ *             ws-flat:  omp_ws.c, initial ranges with equal numbers
+ *                       of iterations
+ *
+ * Compile: gcc -g -Wall -O2 -fopenmp -o omp_ws_bench omp_ws_bench.c
+ *             omp_ws.c -lm
+ * Usage:   ./omp_ws_bench <number of threads> <number of terms> [reps]
+ *
+ * Input:   none
+ * Output:  For each workload and schedule, the minimum elapsed time
+ *          over reps runs (default 3), the imbalance, the number of
+ *          steals, and the difference between the sum and the sum
+ *          computed with the static schedule
+ *
+ * Notes:
+ * 1.  The imbalance is the largest number of calls to sin made by one
+ *     thread, divided by the mean.  1.0 is perfect balance.  For static
+ *     and cyclic it only depends on the schedule, but for the others it
+ *     depends on how fast the threads ran:  if there are more threads
+ *     than cores, a thread that runs first may take most of the work.
+ * 2.  The OpenMP schedules use schedule(runtime) and omp_set_schedule.
+ *
+ * IPP:  Not discussed, but see Section 5.7 (pp. 236 and ff.)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include "omp_ws.h"
+
+#define TRI   0
+#define IRREG 1
+#define WORKLOADS 2
+
+#define STATIC  0
+#define CYCLIC  1
+#define DYNAMIC 2
+#define GUIDED  3
+#define WS      4
+#define WS_FLAT 5
+#define SCHEDULES 6
+
+const char* workload_names[WORKLOADS] = {"tri", "irreg"};
+const char* schedule_names[SCHEDULES] =
+   {"static", "cyclic", "dynamic", "guided", "ws", "ws-flat"};
+
+int workload;
+
+void Usage(char* prog_name);
+long Len(long i);
+double Cost(long i);
+double Term(long i);
+double Run(int schedule, long n, int thread_count, long calls[],
+      long* steals_p);
+
+int main(int argc, char* argv[]) {
+   long    n, steals, min_steals = 0, *calls, max_calls, total_calls;
+   int     thread_count, reps, rep, schedule, t;
+   double  start, elapsed, min_elapsed = 0.0, sum, ref = 0.0;
+
+   if (argc != 3 && argc != 4) Usage(argv[0]);
+   thread_count = strtol(argv[1], NULL, 10);
+   n = strtol(argv[2], NULL, 10);
+   reps = (argc == 4) ? strtol(argv[3], NULL, 10) : 3;
+   if (thread_count <= 0 || n < 0 || reps <= 0) Usage(argv[0]);
+   calls = malloc(thread_count*sizeof(long));
+
+   printf("%d threads, n = %ld\n", thread_count, n);
+   printf("workload  schedule   elapsed (s)   imbalance    steals   "
+         "sum - static sum\n");
+   for (workload = 0; workload < WORKLOADS; workload++)
+      for (schedule = 0; schedule < SCHEDULES; schedule++) {
+         for (rep = 0; rep < reps; rep++) {
+            start = omp_get_wtime();
+            sum = Run(schedule, n, thread_count, calls, &steals);
+            elapsed = omp_get_wtime() - start;
+            if (rep == 0 || elapsed < min_elapsed) {
+               min_elapsed = elapsed;
+               min_steals = steals;
+            }
+         }
+         if (schedule == STATIC) ref = sum;
+         max_calls = total_calls = 0;
+         for (t = 0; t < thread_count; t++) {
+            total_calls += calls[t];
+            if (calls[t] > max_calls) max_calls = calls[t];
+         }
+         printf("%-8s  %-8s   %e  %9.4f  %8ld   %e\n",
+               workload_names[workload], schedule_names[schedule],
+               min_elapsed,
+               total_calls > 0 ? (double) max_calls*thread_count/total_calls
+                  : 1.0,
+               min_steals, sum - ref);
+      }
+
+   free(calls);
+   return 0;
+}  /* main */
+
+/*--------------------------------------------------------------------
+ * Function:    Usage
+ * Purpose:     Print command line for function and terminate
+ * In arg:      prog_name
+ */
+void Usage(char* prog_name) {
+
+   fprintf(stderr, "usage: %s <number of threads> <number of terms> [reps]\n",
+         prog_name);
+   exit(0);
+}  /* Usage */
+
+/*------------------------------------------------------------------
+ * Function:    Len
+ * Purpose:     Number of calls to sin made by term i
+ */
+long Len(long i) {
+   unsigned long h;
+
+   if (workload == TRI) return i + 1;
+   h = (unsigned long) i*0x9E3779B97F4A7C15UL;
+   h ^= h >> 29;
+   return (h % 97 == 0) ? 5000 : 1 + h % 100;
+}  /* Len */
+
+/*------------------------------------------------------------------*/
+double Cost(long i) {
+   return Len(i);
+}  /* Cost */
+
+/*------------------------------------------------------------------
+ * Function:    Term
+ * Purpose:     sin(start) + sin(start+1) + . . . + sin(start+Len(i)-1),
+ *              where start = i(i+1)/2 for tri, and i for irreg
+ */
+double Term(long i) {
+   long j, start = (workload == TRI) ? i*(i+1)/2 : i;
+   long finish = start + Len(i);
+   double val = 0.0;
+
+   for (j = start; j < finish; j++)
+      val += sin(j);
+   return val;
+}  /* Term */
+
+/*------------------------------------------------------------------
+ * Function:    Run
+ * Purpose:     Find Term(0) + . . . + Term(n) using schedule
+ * Out args:    calls[t]:  the number of calls to sin made by thread t
+ *              steals_p:  the number of ranges stolen (ws only)
+ * Return val:  The sum
+ */
+double Run(int schedule, long n, int thread_count, long calls[],
+      long* steals_p) {
+   double sum = 0.0;
+   struct ws_sched_s ws;
+
+   *steals_p = 0;
+   if (schedule == WS || schedule == WS_FLAT) {
+      Ws_init(&ws, thread_count, 0, n+1, schedule == WS ? Cost : NULL, 1);
+#     pragma omp parallel num_threads(thread_count) reduction(+: sum)
+      {
+         int my_rank = omp_get_thread_num();
+         long first, last, i, my_calls = 0;
+
+         while (Ws_next(&ws, my_rank, &first, &last))
+            for (i = first; i < last; i++) {
+               sum += Term(i);
+               my_calls += Len(i);
+            }
+         calls[my_rank] = my_calls;
+      }
+      *steals_p = Ws_steals(&ws);
+      Ws_free(&ws);
+      return sum;
+   }
+
+   switch (schedule) {
+      case STATIC:  omp_set_schedule(omp_sched_static, 0);  break;
+      case CYCLIC:  omp_set_schedule(omp_sched_static, 1);  break;
+      case DYNAMIC: omp_set_schedule(omp_sched_dynamic, 1); break;
+      case GUIDED:  omp_set_schedule(omp_sched_guided, 0);  break;
+   }
+#  pragma omp parallel num_threads(thread_count) reduction(+: sum)
+   {
+      long i, my_calls = 0;
+
+#     pragma omp for schedule(runtime) nowait
+      for (i = 0; i <= n; i++) {
+         sum += Term(i);
+         my_calls += Len(i);
+      }
+      calls[omp_get_thread_num()] = my_calls;
+   }
+   return sum;
+}  /* Run */
@@ -0,0 +1,215 @@
+/* File:     roofline.c
+ *
+ * Purpose:  Measure the peaks of the roofline model, and report the
+ *           GFLOP/s, GB/s and arithmetic intensity of a kernel.  See
+ *           roofline.h.
+ *
+ * Notes:
+ * 1.  The FMA probe runs ROOF_CHAINS independent chains of
+ *
+ *        x = x*a + b
+ *
+ *     in each thread.  There are enough chains to hide the latency of
+ *     the multiply-add units, and the inner loop over the chains can be
+ *     vectorized, so this is about the best rate the compiler can get
+ *     from a loop with the flags it was given.  Each update counts as 2
+ *     floating point operations, whether or not it's a fused
+ *     multiply-add.
+ * 2.  The bandwidth probe is the STREAM triad a[i] = b[i] + s*c[i] on
+ *     arrays that are at least 4 times the size of the last level
+ *     cache, and it counts 24 bytes per iteration, as STREAM does (the
+ *     write-allocate of a isn't counted).  The arrays are initialized
+ *     in parallel, so on a NUMA node the pages are spread across the
+ *     sockets the same way as the iterations.
+ * 3.  Each probe is run ROOF_TRIALS times, and the best time is used.
+ *
+ * IPP:  Not discussed, but see Section 2.6 on performance
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <omp.h>
+#include "roofline.h"
+
+#define ROOF_CHAINS   32
+#define ROOF_FMA_REPS 4000000L
+#define ROOF_TRIALS   5
+#define ROOF_A        0.999999
+#define ROOF_B        1.0e-6
+
+static struct roof_peak_s peak = {0.0, 0.0, 0};
+
+/* Keeps the compiler from removing the probes */
+volatile double roof_sink;
+
+/*------------------------------------------------------------------
+ * Function:  Llc_size
+ * Purpose:   Return the size of the last level cache in bytes, or 32 MB
+ *            if the system doesn't say
+ */
+static long Llc_size(void) {
+   long size = 0;
+
+#  ifdef _SC_LEVEL3_CACHE_SIZE
+   size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+   if (size <= 0) size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#  endif
+   return (size > 0) ? size : 32L*1024*1024;
+}  /* Llc_size */
+
+/*------------------------------------------------------------------
+ * Function:  Roofline_fma_probe
+ * Purpose:   Return the peak GFLOP/s of thread_count threads
+ */
+double Roofline_fma_probe(int thread_count) {
+   double start, elapsed, best = 0.0;
+   int trial;
+
+   for (trial = 0; trial < ROOF_TRIALS; trial++) {
+#     pragma omp parallel num_threads(thread_count) \
+         default(none) shared(start, elapsed, roof_sink)
+      {
+         double x[ROOF_CHAINS], sum = 0.0;
+         long r;
+         int c;
+
+         for (c = 0; c < ROOF_CHAINS; c++)
+            x[c] = 1.0 + c*1.0e-3;
+#        pragma omp barrier
+#        pragma omp master
+         start = omp_get_wtime();
+         for (r = 0; r < ROOF_FMA_REPS; r++)
+            for (c = 0; c < ROOF_CHAINS; c++)
+               x[c] = x[c]*ROOF_A + ROOF_B;
+#        pragma omp barrier
+#        pragma omp master
+         elapsed = omp_get_wtime() - start;
+         for (c = 0; c < ROOF_CHAINS; c++)
+            sum += x[c];
+         roof_sink = sum;
+      }
+      if (trial == 0 || elapsed < best) best = elapsed;
+   }
+   return 2.0*ROOF_CHAINS*ROOF_FMA_REPS*thread_count/best/1.0e9;
+}  /* Roofline_fma_probe */
+
+/*------------------------------------------------------------------
+ * Function:  Roofline_stream_probe
+ * Purpose:   Return the STREAM triad bandwidth of thread_count threads
+ *            on arrays of n doubles, in GB/s
+ */
+double Roofline_stream_probe(int thread_count, long n) {
+   double *a, *b, *c, start, elapsed, best = 0.0;
+   long i;
+   int trial;
+
+   a = malloc(n*sizeof(double));
+   b = malloc(n*sizeof(double));
+   c = malloc(n*sizeof(double));
+   if (a == NULL || b == NULL || c == NULL) {
+      fprintf(stderr, "Roofline:  can't allocate %ld doubles\n", 3*n);
+      exit(-1);
+   }
+#  pragma omp parallel for num_threads(thread_count) schedule(static)
+   for (i = 0; i < n; i++) {
+      a[i] = 0.0;
+      b[i] = 1.0;
+      c[i] = 2.0;
+   }
+
+   for (trial = 0; trial < ROOF_TRIALS; trial++) {
+      start = omp_get_wtime();
+#     pragma omp parallel for num_threads(thread_count) schedule(static)
+      for (i = 0; i < n; i++)
+         a[i] = b[i] + 3.0*c[i];
+      elapsed = omp_get_wtime() - start;
+      if (trial == 0 || elapsed < best) best = elapsed;
+   }
+   roof_sink = a[n/2];
+
+   free(a);
+   free(b);
+   free(c);
+   return 24.0*n/best/1.0e9;
+}  /* Roofline_stream_probe */
+
+/*------------------------------------------------------------------
+ * Function:  Roofline_init
+ * Purpose:   Find the peaks for thread_count threads, from ROOF_GFLOPS
+ *            and ROOF_GBS or by running the probes, and print them
+ */
+void Roofline_init(int thread_count) {
+   char* env;
+   long n;
+
+   peak.llc = Llc_size();
+   env = getenv("ROOF_GFLOPS");
+   peak.gflops = (env != NULL) ? strtod(env, NULL) : 0.0;
+   if (peak.gflops <= 0.0) peak.gflops = Roofline_fma_probe(thread_count);
+   env = getenv("ROOF_GBS");
+   peak.gbs = (env != NULL) ? strtod(env, NULL) : 0.0;
+   if (peak.gbs <= 0.0) {
+      n = 4*peak.llc/sizeof(double);
+      if (n < (1L << 22)) n = 1L << 22;
+      peak.gbs = Roofline_stream_probe(thread_count, n);
+   }
+
+   printf("Roofline with %d threads:  peak = %.3f GFLOP/s, %.3f GB/s, "
+         "ridge point = %.3f flop/byte\n", thread_count, peak.gflops,
+         peak.gbs, peak.gflops/peak.gbs);
+}  /* Roofline_init */
+
+/*------------------------------------------------------------------
+ * Function:  Roofline_peak
+ * Purpose:   Return the peaks found by Roofline_init
+ */
+void Roofline_peak(struct roof_peak_s* peak_p) {
+   *peak_p = peak;
+   if (peak_p->llc == 0) peak_p->llc = Llc_size();
+}  /* Roofline_peak */
+
+/*------------------------------------------------------------------
+ * Function:  Roofline_matmul_bytes
+ * Purpose:   Return the number of bytes moved to or from memory by the
+ *            product C = AB of an m x k matrix A and a k x n matrix B,
+ *            when it's computed an element of C at a time
+ * Notes:
+ * 1.  A is read once, and C is written once.  If B fits in the last
+ *     level cache, it's read once, otherwise it's read again for each
+ *     row of C.
+ * 2.  This is a lower bound:  it ignores the write-allocate of C and
+ *     the unused parts of the cache lines of B.
+ */
+double Roofline_matmul_bytes(double m, double n, double k) {
+   struct roof_peak_s pk;
+   double b_bytes = 8.0*k*n;
+
+   Roofline_peak(&pk);
+   if (b_bytes > pk.llc) b_bytes *= m;
+   return 8.0*m*k + 8.0*m*n + b_bytes;
+}  /* Roofline_matmul_bytes */
+
+/*------------------------------------------------------------------
+ * Function:  Roofline_report
+ * Purpose:   Print the rate, bandwidth and arithmetic intensity of a
+ *            kernel that carried out flops floating point operations and
+ *            moved bytes bytes in seconds seconds, and compare it with
+ *            the roofline if Roofline_init has been called
+ */
+void Roofline_report(const char* name, double flops, double bytes,
+      double seconds) {
+   double gflops = flops/seconds/1.0e9;
+   double gbs = bytes/seconds/1.0e9;
+   double ai = flops/bytes;
+   double attainable;
+
+   printf("%s:  %.3f GFLOP/s, %.3f GB/s, AI = %.3f flop/byte\n",
+         name, gflops, gbs, ai);
+   if (peak.gflops <= 0.0) return;
+
+   attainable = ai*peak.gbs;
+   if (attainable > peak.gflops) attainable = peak.gflops;
+   printf("   attainable = %.3f GFLOP/s (%s bound), achieved %.1f%%\n",
+         attainable, (ai*peak.gbs < peak.gflops) ? "memory" : "compute",
+         100.0*gflops/attainable);
+}  /* Roofline_report */
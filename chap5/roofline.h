@@ -0,0 +1,45 @@
+/* File:     roofline.h
+ * Purpose:  Header file for roofline.c, which measures the peak floating
+ *           point rate and memory bandwidth of a node, and compares the
+ *           performance of a kernel with the roofline model
+ *
+ *              attainable GFLOP/s = min(peak GFLOP/s, AI * peak GB/s)
+ *
+ *           where the arithmetic intensity AI of the kernel is the number
+ *           of floating point operations it carries out per byte it moves
+ *           to or from memory.  If AI * peak GB/s < peak GFLOP/s, the
+ *           kernel is memory bound, otherwise it's compute bound.
+ *
+ * Example:
+ *    Roofline_init(thread_count);
+ *    . . .
+ *    Roofline_report("mat-vect", 2.0*m*n, 8.0*(m*n + m + n), elapsed);
+ *
+ * Notes:
+ * 1.  The environment variables ROOF_GFLOPS and ROOF_GBS set the peaks
+ *     without running the probes, e.g., for a node type whose peaks were
+ *     measured with omp_roofline.
+ * 2.  The peaks depend on the compiler flags.  Compile roofline.c with
+ *     the same flags as the kernel (e.g., -O3 -march=native), so that
+ *     the FMA probe uses the same vector instructions.
+ *
+ * IPP:  Not discussed, but see Section 2.6 on performance
+ */
+#ifndef _ROOFLINE_H_
+#define _ROOFLINE_H_
+
+struct roof_peak_s {
+   double gflops;    /* Peak rate of multiplies and adds      */
+   double gbs;       /* STREAM triad bandwidth, 10^9 bytes/s  */
+   long   llc;       /* Size of the last level cache in bytes */
+};
+
+void   Roofline_init(int thread_count);
+void   Roofline_peak(struct roof_peak_s* peak);
+double Roofline_fma_probe(int thread_count);
+double Roofline_stream_probe(int thread_count, long n);
+double Roofline_matmul_bytes(double m, double n, double k);
+void   Roofline_report(const char* name, double flops, double bytes,
+         double seconds);
+
+#endif